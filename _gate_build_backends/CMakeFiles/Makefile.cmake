@@ -0,0 +1,74 @@
+# CMAKE generated file: DO NOT EDIT!
+# Generated by "Unix Makefiles" Generator, CMake Version 3.25
+
+# The generator used is:
+set(CMAKE_DEPENDS_GENERATOR "Unix Makefiles")
+
+# The top level Makefile was generated from the following files:
+set(CMAKE_MAKEFILE_DEPENDS
+  "CMakeCache.txt"
+  "/root/repo/CMakeLists.txt"
+  "CMakeFiles/3.25.1/CMakeCXXCompiler.cmake"
+  "CMakeFiles/3.25.1/CMakeSystem.cmake"
+  "/root/repo/examples/CMakeLists.txt"
+  "/usr/share/cmake-3.25/Modules/CMakeCXXInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeCommonLanguageInclude.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeGenericSystem.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeInitializeConfigs.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeLanguageInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeSystemSpecificInformation.cmake"
+  "/usr/share/cmake-3.25/Modules/CMakeSystemSpecificInitialize.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckCXXSourceCompiles.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckIncludeFileCXX.cmake"
+  "/usr/share/cmake-3.25/Modules/CheckLibraryExists.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/CMakeCommonCompilerMacros.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/GNU-CXX.cmake"
+  "/usr/share/cmake-3.25/Modules/Compiler/GNU.cmake"
+  "/usr/share/cmake-3.25/Modules/FindPackageHandleStandardArgs.cmake"
+  "/usr/share/cmake-3.25/Modules/FindPackageMessage.cmake"
+  "/usr/share/cmake-3.25/Modules/FindThreads.cmake"
+  "/usr/share/cmake-3.25/Modules/Internal/CheckSourceCompiles.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux-GNU-CXX.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux-GNU.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/Linux.cmake"
+  "/usr/share/cmake-3.25/Modules/Platform/UnixPaths.cmake"
+  )
+
+# The corresponding makefile is:
+set(CMAKE_MAKEFILE_OUTPUTS
+  "Makefile"
+  "CMakeFiles/cmake.check_cache"
+  )
+
+# Byproducts of CMake generate step:
+set(CMAKE_MAKEFILE_PRODUCTS
+  "CMakeFiles/CMakeDirectoryInformation.cmake"
+  "examples/CMakeFiles/CMakeDirectoryInformation.cmake"
+  )
+
+# Dependency information for all targets:
+set(CMAKE_DEPEND_INFO_FILES
+  "CMakeFiles/tinyalsa-cxx.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_conversion_benchmark.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_conversion_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_frame_pool_benchmark.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_interleaved_reader.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_interleaved_writer.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_mmap_reader.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_pcminfo.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_pcmlist.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_recorder_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_remix_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_resampler_benchmark.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_allocation_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_event_loop_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_fake_device_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_frame_ring_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_mixer_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_mmap_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_pcm_group_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_pcm_list_benchmark.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_reactor_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_trace_check.dir/DependInfo.cmake"
+  "examples/CMakeFiles/tinyalsa_example_xrun_check.dir/DependInfo.cmake"
+  )
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "CMakeFiles/tinyalsa-cxx.dir/tinyalsa.cpp.o"
+  "CMakeFiles/tinyalsa-cxx.dir/tinyalsa.cpp.o.d"
+  "libtinyalsa-cxx.a"
+  "libtinyalsa-cxx.pdb"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa-cxx.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
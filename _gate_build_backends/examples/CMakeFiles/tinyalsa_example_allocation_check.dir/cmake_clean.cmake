@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../allocation_check"
+  "../allocation_check.pdb"
+  "CMakeFiles/tinyalsa_example_allocation_check.dir/allocation_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_allocation_check.dir/allocation_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_allocation_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../conversion_benchmark"
+  "../conversion_benchmark.pdb"
+  "CMakeFiles/tinyalsa_example_conversion_benchmark.dir/conversion_benchmark.cpp.o"
+  "CMakeFiles/tinyalsa_example_conversion_benchmark.dir/conversion_benchmark.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_conversion_benchmark.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
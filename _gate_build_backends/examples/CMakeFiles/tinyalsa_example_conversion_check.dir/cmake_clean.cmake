@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../conversion_check"
+  "../conversion_check.pdb"
+  "CMakeFiles/tinyalsa_example_conversion_check.dir/conversion_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_conversion_check.dir/conversion_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_conversion_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
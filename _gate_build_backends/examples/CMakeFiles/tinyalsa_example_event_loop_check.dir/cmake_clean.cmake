@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../event_loop_check"
+  "../event_loop_check.pdb"
+  "CMakeFiles/tinyalsa_example_event_loop_check.dir/event_loop_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_event_loop_check.dir/event_loop_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_event_loop_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../fake_device_check"
+  "../fake_device_check.pdb"
+  "CMakeFiles/tinyalsa_example_fake_device_check.dir/fake_device_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_fake_device_check.dir/fake_device_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_fake_device_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../frame_pool_benchmark"
+  "../frame_pool_benchmark.pdb"
+  "CMakeFiles/tinyalsa_example_frame_pool_benchmark.dir/frame_pool_benchmark.cpp.o"
+  "CMakeFiles/tinyalsa_example_frame_pool_benchmark.dir/frame_pool_benchmark.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_frame_pool_benchmark.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../frame_ring_check"
+  "../frame_ring_check.pdb"
+  "CMakeFiles/tinyalsa_example_frame_ring_check.dir/frame_ring_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_frame_ring_check.dir/frame_ring_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_frame_ring_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../interleaved_writer"
+  "../interleaved_writer.pdb"
+  "CMakeFiles/tinyalsa_example_interleaved_writer.dir/interleaved_writer.cpp.o"
+  "CMakeFiles/tinyalsa_example_interleaved_writer.dir/interleaved_writer.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_interleaved_writer.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../mixer_check"
+  "../mixer_check.pdb"
+  "CMakeFiles/tinyalsa_example_mixer_check.dir/mixer_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_mixer_check.dir/mixer_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_mixer_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
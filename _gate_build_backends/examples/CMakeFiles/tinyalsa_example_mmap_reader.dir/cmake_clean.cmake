@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../mmap_reader"
+  "../mmap_reader.pdb"
+  "CMakeFiles/tinyalsa_example_mmap_reader.dir/mmap_reader.cpp.o"
+  "CMakeFiles/tinyalsa_example_mmap_reader.dir/mmap_reader.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_mmap_reader.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../pcm_group_check"
+  "../pcm_group_check.pdb"
+  "CMakeFiles/tinyalsa_example_pcm_group_check.dir/pcm_group_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_pcm_group_check.dir/pcm_group_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_pcm_group_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../pcm_list_benchmark"
+  "../pcm_list_benchmark.pdb"
+  "CMakeFiles/tinyalsa_example_pcm_list_benchmark.dir/pcm_list_benchmark.cpp.o"
+  "CMakeFiles/tinyalsa_example_pcm_list_benchmark.dir/pcm_list_benchmark.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_pcm_list_benchmark.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../pcminfo"
+  "../pcminfo.pdb"
+  "CMakeFiles/tinyalsa_example_pcminfo.dir/pcminfo.cpp.o"
+  "CMakeFiles/tinyalsa_example_pcminfo.dir/pcminfo.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_pcminfo.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../pcmlist"
+  "../pcmlist.pdb"
+  "CMakeFiles/tinyalsa_example_pcmlist.dir/pcmlist.cpp.o"
+  "CMakeFiles/tinyalsa_example_pcmlist.dir/pcmlist.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_pcmlist.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
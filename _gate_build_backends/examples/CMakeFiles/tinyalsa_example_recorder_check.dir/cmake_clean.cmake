@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../recorder_check"
+  "../recorder_check.pdb"
+  "CMakeFiles/tinyalsa_example_recorder_check.dir/recorder_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_recorder_check.dir/recorder_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_recorder_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../remix_check"
+  "../remix_check.pdb"
+  "CMakeFiles/tinyalsa_example_remix_check.dir/remix_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_remix_check.dir/remix_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_remix_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
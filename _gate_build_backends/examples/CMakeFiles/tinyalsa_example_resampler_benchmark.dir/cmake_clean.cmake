@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../resampler_benchmark"
+  "../resampler_benchmark.pdb"
+  "CMakeFiles/tinyalsa_example_resampler_benchmark.dir/resampler_benchmark.cpp.o"
+  "CMakeFiles/tinyalsa_example_resampler_benchmark.dir/resampler_benchmark.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_resampler_benchmark.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
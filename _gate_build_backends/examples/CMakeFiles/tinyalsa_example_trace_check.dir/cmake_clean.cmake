@@ -0,0 +1,11 @@
+file(REMOVE_RECURSE
+  "../trace_check"
+  "../trace_check.pdb"
+  "CMakeFiles/tinyalsa_example_trace_check.dir/trace_check.cpp.o"
+  "CMakeFiles/tinyalsa_example_trace_check.dir/trace_check.cpp.o.d"
+)
+
+# Per-language clean rules from dependency scanning.
+foreach(lang CXX)
+  include(CMakeFiles/tinyalsa_example_trace_check.dir/cmake_clean_${lang}.cmake OPTIONAL)
+endforeach()
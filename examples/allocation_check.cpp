@@ -0,0 +1,201 @@
+#include <tinyalsa.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#include <errno.h>
+
+// The allocation functions of the C library are replaced,
+// so that allocations made anywhere in the process are seen,
+// including the ones made by operator new.
+
+extern "C" {
+
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void* ptr);
+
+} // extern "C"
+
+namespace {
+
+/// Set while allocations are not allowed.
+std::atomic<bool> armed { false };
+
+/// The number of allocations made while armed.
+std::atomic<std::size_t> allocations { 0 };
+
+/// Counts an allocation, if they're not allowed.
+void check_allocation() noexcept
+{
+  if (armed.load(std::memory_order_relaxed)) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+/// The number of periods transferred in each direction.
+constexpr std::size_t period_total = 1000;
+
+/// The number of frames in one period.
+constexpr tinyalsa::size_type period_size = 256;
+
+/// The number of frames between injected xruns,
+/// so that the recovery path is checked too.
+constexpr tinyalsa::size_type xrun_interval = 10000;
+
+} // namespace
+
+extern "C" {
+
+void* malloc(std::size_t size)
+{
+  check_allocation();
+  return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size)
+{
+  check_allocation();
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, std::size_t size)
+{
+  check_allocation();
+  return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size)
+{
+  check_allocation();
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, std::size_t alignment, std::size_t size)
+{
+  check_allocation();
+  *ptr = __libc_memalign(alignment, size);
+  return *ptr ? 0 : ENOMEM;
+}
+
+void free(void* ptr)
+{
+  __libc_free(ptr);
+}
+
+} // extern "C"
+
+int main()
+{
+  tinyalsa::set_backend(tinyalsa::get_fake_backend());
+
+  tinyalsa::fake_pcm_config fake_config;
+  fake_config.speed = 0;
+  fake_config.xrun_interval = xrun_interval;
+
+  tinyalsa::set_fake_pcm_config(fake_config);
+
+  tinyalsa::pcm_config config;
+  config.period_size = period_size;
+
+  tinyalsa::inline_pcm<tinyalsa::interleaved_pcm_reader> reader;
+  tinyalsa::inline_pcm<tinyalsa::interleaved_pcm_writer> writer;
+
+  // Eight bytes per frame is more than the default format and channel count need.
+  auto* frames = static_cast<unsigned char*>(std::calloc(period_size, 8));
+  if (!frames) {
+    std::printf("Failed to allocate frames.\n");
+    return EXIT_FAILURE;
+  }
+
+  // The first call to printf allocates the buffer of stdout,
+  // so it's made before any allocation is counted.
+  std::printf("Setting up PCMs.\n");
+
+  armed.store(true);
+
+  reader->set_xrun_policy(tinyalsa::xrun_policy::prepare);
+  writer->set_xrun_policy(tinyalsa::xrun_policy::prefill_silence);
+
+  auto open_result = reader->open();
+  if (open_result.failed()) {
+    std::printf("Failed to open capture PCM: %s\n", open_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  open_result = writer->open();
+  if (open_result.failed()) {
+    std::printf("Failed to open playback PCM: %s\n", open_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  // The fake backend allocates the devices it emulates,
+  // so opening is expected to allocate with it.
+  auto open_allocations = allocations.exchange(0);
+
+  auto setup_result = reader->setup(config);
+  if (setup_result.failed()) {
+    std::printf("Failed to setup capture PCM: %s\n", setup_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  setup_result = writer->setup(config);
+  if (setup_result.failed()) {
+    std::printf("Failed to setup playback PCM: %s\n", setup_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto setup_allocations = allocations.exchange(0);
+
+  reader->prepare();
+  writer->prepare();
+  reader->start();
+
+  for (std::size_t i = 0; i < period_total; i++) {
+
+    auto read_result = reader->read_unformatted(frames, period_size);
+    if (read_result.failed()) {
+      std::printf("Failed to read frames: %s\n", read_result.error_description());
+      return EXIT_FAILURE;
+    }
+
+    auto write_result = writer->write_unformatted(frames, read_result.value);
+    if (write_result.failed()) {
+      std::printf("Failed to write frames: %s\n", write_result.error_description());
+      return EXIT_FAILURE;
+    }
+  }
+
+  armed.store(false);
+
+  auto transfer_allocations = allocations.load();
+
+  auto overruns = reader->get_xrun_counters().overruns;
+  auto underruns = writer->get_xrun_counters().underruns;
+
+  std::free(frames);
+
+  std::printf("Allocations while opening:         %zu\n", open_allocations);
+  std::printf("Allocations while setting up:      %zu\n", setup_allocations);
+  std::printf("Allocations while transferring:    %zu\n", transfer_allocations);
+  std::printf("Recovered overruns and underruns:  %zu, %zu\n",
+              std::size_t(overruns),
+              std::size_t(underruns));
+
+  if (setup_allocations) {
+    std::printf("FAIL: the PCMs allocated memory while being set up.\n");
+    return EXIT_FAILURE;
+  }
+
+  if (transfer_allocations) {
+    std::printf("FAIL: the PCMs allocated memory after being set up.\n");
+    return EXIT_FAILURE;
+  }
+
+  std::printf("PASS\n");
+
+  return EXIT_SUCCESS;
+}
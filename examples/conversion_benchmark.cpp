@@ -0,0 +1,146 @@
+#include <tinyalsa.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+using tinyalsa::conversion_isa;
+using tinyalsa::sample_format;
+using tinyalsa::size_type;
+
+/// Names a sample format.
+struct format_entry final
+{
+  sample_format format;
+  const char* name;
+};
+
+const format_entry formats[] {
+  { sample_format::s8,      "s8"      },
+  { sample_format::s16_le,  "s16_le"  },
+  { sample_format::s16_be,  "s16_be"  },
+  { sample_format::s18_3le, "s18_3le" },
+  { sample_format::s18_3be, "s18_3be" },
+  { sample_format::s20_3le, "s20_3le" },
+  { sample_format::s20_3be, "s20_3be" },
+  { sample_format::s24_3le, "s24_3le" },
+  { sample_format::s24_3be, "s24_3be" },
+  { sample_format::s24_le,  "s24_le"  },
+  { sample_format::s24_be,  "s24_be"  },
+  { sample_format::s32_le,  "s32_le"  },
+  { sample_format::s32_be,  "s32_be"  },
+  { sample_format::u8,      "u8"      },
+  { sample_format::u16_le,  "u16_le"  },
+  { sample_format::u16_be,  "u16_be"  },
+  { sample_format::u18_3le, "u18_3le" },
+  { sample_format::u18_3be, "u18_3be" },
+  { sample_format::u20_3le, "u20_3le" },
+  { sample_format::u20_3be, "u20_3be" },
+  { sample_format::u24_3le, "u24_3le" },
+  { sample_format::u24_3be, "u24_3be" },
+  { sample_format::u24_le,  "u24_le"  },
+  { sample_format::u24_be,  "u24_be"  },
+  { sample_format::u32_le,  "u32_le"  },
+  { sample_format::u32_be,  "u32_be"  }
+};
+
+/// Names an instruction set.
+struct isa_entry final
+{
+  conversion_isa isa;
+  const char* name;
+};
+
+const isa_entry isas[] {
+  { conversion_isa::scalar, "scalar" },
+  { conversion_isa::sse2,   "sse2"   },
+  { conversion_isa::avx2,   "avx2"   },
+  { conversion_isa::neon,   "neon"   }
+};
+
+/// The number of samples converted per call.
+constexpr size_type block_size = 4096;
+
+/// The number of calls made per measurement.
+constexpr int repeat_count = 2000;
+
+/// Makes the compiler assume that a buffer is used elsewhere,
+/// so that conversions are not optimized out.
+inline void escape(void* buffer)
+{
+  asm volatile("" : : "r"(buffer) : "memory");
+}
+
+/// Measures the throughput of a conversion.
+///
+/// @return The number of millions of samples converted per second.
+template <typename Convert>
+double measure(Convert convert, void* output)
+{
+  // Warms up the caches and the branch predictors.
+  convert();
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < repeat_count; i++) {
+    convert();
+    escape(output);
+  }
+
+  auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  return (double(block_size) * repeat_count) / elapsed;
+}
+
+} // namespace
+
+int main()
+{
+  std::vector<unsigned char> raw(block_size * 4);
+  std::vector<float> floats(block_size);
+  std::vector<std::int32_t> ints(block_size);
+
+  for (size_type i = 0; i < raw.size(); i++) {
+    raw[i] = (unsigned char) ((i * 2654435761u) >> 24);
+  }
+
+  for (size_type i = 0; i < block_size; i++) {
+    floats[i] = float(int(i % 2001) - 1000) / 1000.0f;
+  }
+
+  std::printf("%-8s %-7s %14s %14s %14s %14s\n", "format", "isa", "to_int32", "from_int32", "to_float", "from_float");
+  std::printf("%-8s %-7s %14s %14s %14s %14s\n", "", "", "(Msamples/s)", "(Msamples/s)", "(Msamples/s)", "(Msamples/s)");
+
+  for (const auto& f : formats) {
+
+    for (const auto& isa : isas) {
+
+      if (tinyalsa::set_conversion_isa(isa.isa).failed()) {
+        continue;
+      }
+
+      auto to_int32 = measure([&]() {
+        tinyalsa::convert_to_int32(f.format, raw.data(), ints.data(), block_size);
+      }, ints.data());
+
+      auto from_int32 = measure([&]() {
+        tinyalsa::convert_from_int32(ints.data(), f.format, raw.data(), block_size);
+      }, raw.data());
+
+      auto to_float = measure([&]() {
+        tinyalsa::convert_to_float(f.format, raw.data(), floats.data(), block_size);
+      }, floats.data());
+
+      auto from_float = measure([&]() {
+        tinyalsa::convert_from_float(floats.data(), f.format, raw.data(), block_size);
+      }, raw.data());
+
+      std::printf("%-8s %-7s %14.1f %14.1f %14.1f %14.1f\n", f.name, isa.name, to_int32, from_int32, to_float, from_float);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
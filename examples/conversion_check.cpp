@@ -0,0 +1,248 @@
+#include <tinyalsa.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+using tinyalsa::conversion_isa;
+using tinyalsa::sample_format;
+using tinyalsa::size_type;
+
+/// Names a sample format.
+struct format_entry final
+{
+  sample_format format;
+  const char* name;
+  size_type container;
+};
+
+const format_entry formats[] {
+  { sample_format::s8,      "s8",      1 },
+  { sample_format::s16_le,  "s16_le",  2 },
+  { sample_format::s16_be,  "s16_be",  2 },
+  { sample_format::s18_3le, "s18_3le", 3 },
+  { sample_format::s18_3be, "s18_3be", 3 },
+  { sample_format::s20_3le, "s20_3le", 3 },
+  { sample_format::s20_3be, "s20_3be", 3 },
+  { sample_format::s24_3le, "s24_3le", 3 },
+  { sample_format::s24_3be, "s24_3be", 3 },
+  { sample_format::s24_le,  "s24_le",  4 },
+  { sample_format::s24_be,  "s24_be",  4 },
+  { sample_format::s32_le,  "s32_le",  4 },
+  { sample_format::s32_be,  "s32_be",  4 },
+  { sample_format::u8,      "u8",      1 },
+  { sample_format::u16_le,  "u16_le",  2 },
+  { sample_format::u16_be,  "u16_be",  2 },
+  { sample_format::u18_3le, "u18_3le", 3 },
+  { sample_format::u18_3be, "u18_3be", 3 },
+  { sample_format::u20_3le, "u20_3le", 3 },
+  { sample_format::u20_3be, "u20_3be", 3 },
+  { sample_format::u24_3le, "u24_3le", 3 },
+  { sample_format::u24_3be, "u24_3be", 3 },
+  { sample_format::u24_le,  "u24_le",  4 },
+  { sample_format::u24_be,  "u24_be",  4 },
+  { sample_format::u32_le,  "u32_le",  4 },
+  { sample_format::u32_be,  "u32_be",  4 }
+};
+
+/// Names an instruction set.
+struct isa_entry final
+{
+  conversion_isa isa;
+  const char* name;
+};
+
+const isa_entry isas[] {
+  { conversion_isa::sse2, "sse2" },
+  { conversion_isa::avx2, "avx2" },
+  { conversion_isa::neon, "neon" }
+};
+
+/// The sample counts that are checked. Every count up to a few
+/// vectors is included, so that each tail length is covered,
+/// along with a few that span several conversion blocks.
+std::vector<size_type> make_counts()
+{
+  std::vector<size_type> counts;
+
+  for (size_type i = 0; i <= 67; i++) {
+    counts.push_back(i);
+  }
+
+  counts.push_back(255);
+  counts.push_back(256);
+  counts.push_back(257);
+  counts.push_back(1000);
+  counts.push_back(4099);
+
+  return counts;
+}
+
+/// The largest sample count that is checked.
+constexpr size_type max_count = 4099;
+
+/// Generates pseudo-random numbers.
+std::uint32_t next_random(std::uint32_t& state)
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+/// The number of conversions that did not match the reference.
+int mismatches = 0;
+
+/// Compares the output of a kernel against the reference.
+///
+/// @return True if they match, false otherwise.
+bool compare(const void* expected, const void* actual, size_type size,
+             const char* isa, const char* function, const char* format, size_type count, bool dithered)
+{
+  if (std::memcmp(expected, actual, size) == 0) {
+    return true;
+  }
+
+  std::printf("FAIL: %s %s %s with %zu samples%s\n",
+              isa, function, format, count, dithered ? " (dithered)" : "");
+
+  mismatches++;
+
+  return false;
+}
+
+/// The input and output buffers of one check.
+struct buffers final
+{
+  /// Random bytes in the source format.
+  std::vector<unsigned char> raw;
+  /// Random integer samples, with the edges of the range.
+  std::vector<std::int32_t> ints;
+  /// Random float samples, including some out of range.
+  std::vector<float> floats;
+  /// The outputs of the reference and of the kernel being checked.
+  std::vector<unsigned char> expected_raw, actual_raw;
+  std::vector<std::int32_t> expected_ints, actual_ints;
+  std::vector<float> expected_floats, actual_floats;
+
+  buffers()
+    : raw((max_count * 4) + 3),
+      ints(max_count),
+      floats(max_count),
+      expected_raw((max_count * 4) + 3),
+      actual_raw((max_count * 4) + 3),
+      expected_ints(max_count),
+      actual_ints(max_count),
+      expected_floats(max_count),
+      actual_floats(max_count)
+  {
+    std::uint32_t state = 0x12345678;
+
+    for (auto& byte : raw) {
+      byte = (unsigned char) next_random(state);
+    }
+
+    const std::int32_t edges[] { 0, 1, -1, 0x7fffffff, std::int32_t(0x80000000), 0x7fffff80, std::int32_t(0x80000080) };
+
+    for (size_type i = 0; i < max_count; i++) {
+      ints[i] = (i < 7) ? edges[i] : std::int32_t(next_random(state));
+    }
+
+    const float float_edges[] { 0.0f, -0.0f, 1.0f, -1.0f, 1.5f, -1.5f, 0.99999994f, -0.99999994f, 1e-10f };
+
+    for (size_type i = 0; i < max_count; i++) {
+      if (i < 9) {
+        floats[i] = float_edges[i];
+      } else {
+        floats[i] = (float(std::int32_t(next_random(state))) / 2147483648.0f) * 1.25f;
+      }
+    }
+  }
+};
+
+/// Checks every conversion of one format with one instruction set.
+void check_format(buffers& b, const isa_entry& isa, const format_entry& f, const std::vector<size_type>& counts)
+{
+  for (auto count : counts) {
+
+    auto bytes = count * f.container;
+
+    // The raw samples are misaligned by a varying number of bytes.
+    auto offset = count % 4;
+
+    const auto* raw = b.raw.data() + offset;
+    auto* expected_raw = b.expected_raw.data() + offset;
+    auto* actual_raw = b.actual_raw.data() + offset;
+
+    tinyalsa::set_conversion_isa(conversion_isa::scalar);
+    tinyalsa::convert_to_int32(f.format, raw, b.expected_ints.data(), count);
+    tinyalsa::set_conversion_isa(isa.isa);
+    tinyalsa::convert_to_int32(f.format, raw, b.actual_ints.data(), count);
+    compare(b.expected_ints.data(), b.actual_ints.data(), count * sizeof(std::int32_t), isa.name, "to_int32", f.name, count, false);
+
+    tinyalsa::set_conversion_isa(conversion_isa::scalar);
+    tinyalsa::convert_to_float(f.format, raw, b.expected_floats.data(), count);
+    tinyalsa::set_conversion_isa(isa.isa);
+    tinyalsa::convert_to_float(f.format, raw, b.actual_floats.data(), count);
+    compare(b.expected_floats.data(), b.actual_floats.data(), count * sizeof(float), isa.name, "to_float", f.name, count, false);
+
+    for (int dithered = 0; dithered < 2; dithered++) {
+
+      tinyalsa::dither expected_dither;
+      tinyalsa::dither actual_dither;
+
+      auto* expected_d = dithered ? &expected_dither : nullptr;
+      auto* actual_d = dithered ? &actual_dither : nullptr;
+
+      tinyalsa::set_conversion_isa(conversion_isa::scalar);
+      tinyalsa::convert_from_int32(b.ints.data(), f.format, expected_raw, count, expected_d);
+      tinyalsa::set_conversion_isa(isa.isa);
+      tinyalsa::convert_from_int32(b.ints.data(), f.format, actual_raw, count, actual_d);
+      compare(expected_raw, actual_raw, bytes, isa.name, "from_int32", f.name, count, dithered);
+
+      tinyalsa::set_conversion_isa(conversion_isa::scalar);
+      tinyalsa::convert_from_float(b.floats.data(), f.format, expected_raw, count, expected_d);
+      tinyalsa::set_conversion_isa(isa.isa);
+      tinyalsa::convert_from_float(b.floats.data(), f.format, actual_raw, count, actual_d);
+      compare(expected_raw, actual_raw, bytes, isa.name, "from_float", f.name, count, dithered);
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  auto counts = make_counts();
+
+  buffers b;
+
+  int checked = 0;
+
+  for (const auto& isa : isas) {
+
+    if (!tinyalsa::is_conversion_isa_supported(isa.isa)) {
+      std::printf("SKIP: %s is not supported\n", isa.name);
+      continue;
+    }
+
+    auto before = mismatches;
+
+    for (const auto& f : formats) {
+      check_format(b, isa, f, counts);
+    }
+
+    std::printf("%s: %s matches the scalar kernels\n", (mismatches == before) ? "PASS" : "FAIL", isa.name);
+
+    checked++;
+  }
+
+  if (!checked) {
+    std::printf("No vector instruction set is supported, so there is nothing to compare.\n");
+  }
+
+  return mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,151 @@
+#include <tinyalsa.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+using tinyalsa::size_type;
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// The number of PCMs registered with the loop.
+constexpr size_type pcm_count = 3;
+
+/// Counts the events of one PCM. The first handler to be called
+/// removes its own PCM and the PCM of the next handler, whose
+/// event is still waiting to be dispatched in the same batch.
+class removing_handler final : public tinyalsa::pcm_event_handler
+{
+public:
+  /// The loop that the PCM is registered with.
+  tinyalsa::pcm_event_loop* loop = nullptr;
+  /// The PCM that's removed along with this one.
+  tinyalsa::pcm* next = nullptr;
+  /// The number of events received.
+  size_type calls = 0;
+  /// The outcome of removing this PCM and the next one.
+  tinyalsa::result self_removed;
+  tinyalsa::result next_removed;
+  /// Set once any handler removed PCMs.
+  static bool removed;
+
+  void on_read_ready(tinyalsa::pcm& p) noexcept override
+  {
+    on_event(p);
+  }
+  void on_write_ready(tinyalsa::pcm& p) noexcept override
+  {
+    on_event(p);
+  }
+  void on_xrun(tinyalsa::pcm& p) noexcept override
+  {
+    on_event(p);
+  }
+private:
+  void on_event(tinyalsa::pcm& p) noexcept
+  {
+    calls++;
+
+    if (removed) {
+      return;
+    }
+
+    removed = true;
+
+    self_removed = loop->remove(p);
+    next_removed = loop->remove(*next);
+  }
+};
+
+bool removing_handler::removed = false;
+
+} // namespace
+
+int main()
+{
+  // The hardware keeps up instantly, so every
+  // started PCM is ready as soon as it's polled.
+  tinyalsa::fake_pcm_config fake_config;
+  fake_config.speed = 0;
+  tinyalsa::set_fake_pcm_config(fake_config);
+
+  tinyalsa::set_backend(tinyalsa::get_fake_backend());
+
+  tinyalsa::interleaved_pcm_reader readers[pcm_count];
+
+  removing_handler handlers[pcm_count];
+
+  tinyalsa::pcm_event_loop loop;
+
+  for (size_type i = 0; i < pcm_count; i++) {
+
+    handlers[i].loop = &loop;
+    handlers[i].next = &readers[(i + 1) % pcm_count];
+
+    if (readers[i].open(0, 0, true).failed() || readers[i].setup().failed() || readers[i].prepare().failed()
+     || readers[i].start().failed() || loop.add(readers[i], handlers[i]).failed()) {
+      check(false, "PCMs are registered");
+      return EXIT_FAILURE;
+    }
+  }
+
+  auto first_run = loop.run_once(1000);
+
+  size_type remover = pcm_count;
+
+  for (size_type i = 0; i < pcm_count; i++) {
+    if (handlers[i].calls && (remover == pcm_count)) {
+      remover = i;
+    }
+  }
+
+  if (remover == pcm_count) {
+    check(false, "events are dispatched");
+    return EXIT_FAILURE;
+  }
+
+  auto removed_next = (remover + 1) % pcm_count;
+  auto remaining = (remover + 2) % pcm_count;
+
+  check(!handlers[remover].self_removed.failed() && !handlers[remover].next_removed.failed(),
+        "handler removes its own PCM and another one during dispatch");
+
+  check(handlers[removed_next].calls == 0, "handler of a PCM removed during dispatch isn't called");
+
+  check(!first_run.failed() && (first_run.value == 2) && (handlers[remaining].calls == 1),
+        "other PCMs of the batch are still dispatched");
+
+  check(loop.size() == 1, "removed PCMs are no longer counted");
+
+  check(loop.remove(readers[removed_next]).error == ENOENT, "PCM removed during dispatch can't be removed again");
+
+  auto second_run = loop.run_once(1000);
+
+  check(!second_run.failed() && (second_run.value == 1) && (handlers[remaining].calls == 2)
+        && (handlers[remover].calls == 1) && (handlers[removed_next].calls == 0),
+        "removed PCMs get no events in later runs");
+
+  // A removed PCM may be registered again once the dispatch that removed it is over.
+  check(!loop.add(readers[removed_next], handlers[removed_next]).failed() && (loop.size() == 2),
+        "removed PCM is registered again");
+
+  auto third_run = loop.run_once(1000);
+
+  check(!third_run.failed() && (third_run.value == 2) && (handlers[removed_next].calls == 1),
+        "PCM registered again gets events");
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
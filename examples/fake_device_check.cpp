@@ -0,0 +1,209 @@
+#include <tinyalsa.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// Polls through the fake backend and measures how long it took.
+///
+/// @param elapsed_ms Receives the number of milliseconds spent polling.
+///
+/// @return The value returned by the poll function.
+int timed_poll(pollfd* fds, unsigned long count, int timeout_ms, double& elapsed_ms)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  auto ready = tinyalsa::get_fake_backend().poll(fds, count, timeout_ms);
+
+  elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+  return ready;
+}
+
+} // namespace
+
+int main()
+{
+  tinyalsa::set_backend(tinyalsa::get_fake_backend());
+
+  tinyalsa::pcm_config config;
+  config.rate = 48000;
+  config.period_size = 480;
+  config.period_count = 4;
+  // Capture devices stop at ten buffers by default, which is
+  // longer than this waits for an overrun.
+  config.stop_threshold = config.period_size * config.period_count;
+
+  tinyalsa::interleaved_pcm_reader reader;
+  tinyalsa::interleaved_pcm_writer writer;
+
+  if (reader.open(0, 0, true).failed()
+   || writer.open(0, 0, true).failed()
+   || reader.setup(config).failed()
+   || writer.setup(config).failed()
+   || reader.prepare().failed()
+   || writer.prepare().failed()) {
+    std::printf("Failed to set up the fake devices.\n");
+    return EXIT_FAILURE;
+  }
+
+  int pipe_fds[2];
+
+  if (::pipe(pipe_fds) != 0) {
+    std::printf("Failed to create a pipe.\n");
+    return EXIT_FAILURE;
+  }
+
+  double elapsed_ms = 0;
+
+  // A prepared capture device is not running, so it never becomes ready.
+  pollfd capture_fd { reader.get_file_descriptor(), POLLIN, 0 };
+
+  auto ready = timed_poll(&capture_fd, 1, 100, elapsed_ms);
+  check((ready == 0) && (elapsed_ms >= 95) && (elapsed_ms < 1000), "idle fake device times out");
+
+  ready = timed_poll(&capture_fd, 1, -1, elapsed_ms);
+  check((ready == 0) && (elapsed_ms < 100), "idle fake device without a timeout returns");
+
+  ready = timed_poll(&capture_fd, 1, 0, elapsed_ms);
+  check(ready == 0, "idle fake device with no timeout returns zero");
+
+  // A prepared playback device has an empty buffer, so it's writable.
+  pollfd mixed[2] {
+    { writer.get_file_descriptor(), POLLOUT, 0 },
+    { pipe_fds[0], POLLIN, 0 }
+  };
+
+  ready = timed_poll(mixed, 2, 100, elapsed_ms);
+  check((ready == 1) && (mixed[0].revents == POLLOUT) && (mixed[1].revents == 0) && (elapsed_ms < 50),
+        "ready fake device with an idle pipe");
+
+  char byte = 0;
+  if (::write(pipe_fds[1], &byte, 1) != 1) {
+    std::printf("Failed to write to the pipe.\n");
+    return EXIT_FAILURE;
+  }
+
+  ready = timed_poll(mixed, 2, 100, elapsed_ms);
+  check((ready == 2) && (mixed[0].revents == POLLOUT) && (mixed[1].revents == POLLIN),
+        "ready fake device with a ready pipe");
+
+  pollfd mixed_idle[2] {
+    { reader.get_file_descriptor(), POLLIN, 0 },
+    { pipe_fds[0], POLLIN, 0 }
+  };
+
+  ready = timed_poll(mixed_idle, 2, 100, elapsed_ms);
+  check((ready == 1) && (mixed_idle[0].revents == 0) && (mixed_idle[1].revents == POLLIN),
+        "idle fake device with a ready pipe");
+
+  if (::read(pipe_fds[0], &byte, 1) != 1) {
+    std::printf("Failed to read from the pipe.\n");
+    return EXIT_FAILURE;
+  }
+
+  ready = timed_poll(mixed_idle, 2, 100, elapsed_ms);
+  check((ready == 0) && (elapsed_ms >= 95) && (elapsed_ms < 1000), "idle fake device with an idle pipe times out");
+
+  // A running capture device becomes ready once a period is captured.
+  reader.start();
+
+  ready = timed_poll(mixed_idle, 2, 1000, elapsed_ms);
+  check((ready == 1) && (mixed_idle[0].revents == POLLIN) && (elapsed_ms >= 5) && (elapsed_ms < 50),
+        "running fake device with an idle pipe becomes ready after a period");
+
+  // Not reading makes the capture device overrun.
+  ::usleep(100000);
+
+  ready = timed_poll(&capture_fd, 1, 100, elapsed_ms);
+  check((ready == 1) && (capture_fd.revents == POLLERR), "overrun fake device reports an error");
+
+  ::close(pipe_fds[0]);
+  ::close(pipe_fds[1]);
+
+  // The control devices of the fake cards can be enumerated.
+  tinyalsa::fake_pcm_config fake_config;
+  fake_config.cards = 2;
+  fake_config.devices = 3;
+  tinyalsa::set_fake_pcm_config(fake_config);
+
+  tinyalsa::pcm_list list;
+
+  bool in_order = (list.size() == 12);
+
+  for (tinyalsa::size_type i = 0; in_order && (i < list.size()); i++) {
+    const auto& info = list.data()[i];
+    in_order = (info.card == (i / 6))
+            && (info.device == ((i / 2) % 3))
+            && (info.is_capture == ((i % 2) == 1));
+  }
+
+  check(in_order, "fake cards are listed in order");
+
+  char root[] = "/tmp/fake_device_check.XXXXXX";
+
+  tinyalsa::pcm_registry registry;
+
+  if (!::mkdtemp(root) || registry.open(root).failed()) {
+    std::printf("Failed to open the registry.\n");
+    return EXIT_FAILURE;
+  }
+
+  check(registry.snapshot().size() == 12, "fake cards are in the registry");
+
+  // Touching a control device makes the registry query the card again.
+  char control_path[64];
+  std::snprintf(control_path, sizeof(control_path), "%s/controlC1", root);
+
+  auto control_fd = ::open(control_path, O_CREAT | O_WRONLY | O_CLOEXEC, 0644);
+  if (control_fd < 0) {
+    std::printf("Failed to create a control device node.\n");
+    return EXIT_FAILURE;
+  }
+
+  ::close(control_fd);
+
+  auto changes = registry.update(100);
+  check(!changes.failed() && (changes.value == 0), "unchanged card is not published again");
+
+  ::chmod(control_path, 0600);
+
+  changes = registry.update(100);
+  check(!changes.failed() && (changes.value == 0), "attribute change of an unchanged card is not published");
+
+  fake_config.devices = 2;
+  tinyalsa::set_fake_pcm_config(fake_config);
+
+  ::chmod(control_path, 0644);
+
+  changes = registry.update(100);
+  check(!changes.failed() && (changes.value == 1) && (registry.snapshot().size() == 10),
+        "changed card is published");
+
+  registry.close();
+
+  ::unlink(control_path);
+  ::rmdir(root);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+#include <tinyalsa.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/resource.h>
+
+namespace {
+
+/// The number of periods to capture in each run.
+constexpr std::size_t period_total = 100000;
+
+/// Indicates the number of minor page faults taken so far.
+long minor_faults()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+/// Makes the compiler assume that a buffer and its contents are
+/// used elsewhere. Otherwise, it may drop a malloc and free pair
+/// along with the writes in between, leaving nothing to measure.
+inline void escape(void* buffer)
+{
+  asm volatile("" : : "r"(buffer) : "memory");
+}
+
+/// Stands in for a capture read, by filling the buffer
+/// and summing it so that the writes are not optimized out.
+unsigned capture(void* buffer, std::size_t size, std::size_t period)
+{
+  std::memset(buffer, int(period & 0xff), size);
+
+  escape(buffer);
+
+  auto bytes = static_cast<const unsigned char*>(buffer);
+
+  return unsigned(bytes[0]) + unsigned(bytes[size - 1]);
+}
+
+/// Contains the outcome of one run.
+struct run_result final
+{
+  /// The number of nanoseconds per period.
+  double ns_per_period = 0;
+  /// The number of page faults per period.
+  double faults_per_period = 0;
+  /// The sum of the captured bytes.
+  unsigned checksum = 0;
+};
+
+template <typename Acquire, typename Release>
+run_result run(std::size_t size, Acquire acquire, Release release)
+{
+  run_result out;
+
+  auto faults = minor_faults();
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < period_total; i++) {
+    auto* buffer = acquire();
+    out.checksum += capture(buffer, size, i);
+    release(buffer);
+  }
+
+  auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+  out.ns_per_period = elapsed / double(period_total);
+  out.faults_per_period = double(minor_faults() - faults) / double(period_total);
+
+  return out;
+}
+
+void print(const char* name, std::size_t frames, const run_result& r)
+{
+  std::printf("%-10s %8zu %14.1f %14.3f\n", name, frames, r.ns_per_period, r.faults_per_period);
+}
+
+} // namespace
+
+int main()
+{
+  const tinyalsa::size_type period_sizes[] { 256, 1024, 8192, 65536 };
+
+  std::printf("%-10s %8s %14s %14s\n", "allocator", "frames", "ns/period", "faults/period");
+
+  for (auto period_size : period_sizes) {
+
+    tinyalsa::pcm_config config;
+    config.channels = 2;
+    config.format = tinyalsa::sample_format::s32_le;
+    config.period_size = period_size;
+    config.period_count = 4;
+
+    tinyalsa::frame_pool pool;
+
+    auto alloc_result = pool.allocate(config);
+    if (alloc_result.failed()) {
+      std::printf("Failed to allocate frame pool: %s\n", alloc_result.error_description());
+      return EXIT_FAILURE;
+    }
+
+    auto size = pool.buffer_size();
+
+    auto pooled = run(size,
+                      [&pool]() { return pool.acquire(); },
+                      [&pool](void* buffer) { pool.release(buffer); });
+
+    auto heap = run(size,
+                    [size]() { return std::malloc(size); },
+                    [](void* buffer) { std::free(buffer); });
+
+    print("frame_pool", period_size, pooled);
+    print("malloc", period_size, heap);
+
+    if (!pool.is_locked()) {
+      std::printf("(the pool could not be locked into memory)\n");
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,313 @@
+#include <tinyalsa.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <sound/asound.h>
+#include <sys/ioctl.h>
+
+namespace {
+
+using tinyalsa::size_type;
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// Each frame is a single 32-bit index into the stream,
+/// so that lost, repeated or reordered frames are found.
+using frame_type = std::uint32_t;
+
+/// The index of the next frame read from the fake capture PCM.
+frame_type next_captured = 0;
+
+/// The backend that reads are passed on to.
+tinyalsa::pcm_backend counting_backend;
+
+/// Numbers the frames read from the fake PCM, which
+/// otherwise captures whatever is in its buffer.
+int counting_ioctl(int fd, unsigned long request, void* arg)
+{
+  auto result = tinyalsa::get_fake_backend().ioctl(fd, request, arg);
+
+  if ((result == 0) && (request == SNDRV_PCM_IOCTL_READI_FRAMES)) {
+    const auto* transfer = static_cast<const snd_xferi*>(arg);
+    auto* frames = static_cast<frame_type*>(transfer->buf);
+    for (snd_pcm_sframes_t i = 0; i < transfer->result; i++) {
+      frames[i] = next_captured++;
+    }
+  }
+
+  return result;
+}
+
+/// Writes frames numbered from a given index into the ring.
+///
+/// @return The number of frames written.
+size_type write_numbered(tinyalsa::frame_ring& ring, frame_type first, size_type frame_count)
+{
+  std::vector<frame_type> frames(frame_count);
+
+  for (size_type i = 0; i < frame_count; i++) {
+    frames[i] = first + frame_type(i);
+  }
+
+  return ring.write(frames.data(), frame_count);
+}
+
+/// Reads frames from the ring and checks that they're numbered from a given index.
+bool read_numbered(tinyalsa::frame_ring& ring, frame_type first, size_type frame_count)
+{
+  std::vector<frame_type> frames(frame_count);
+
+  if (ring.read(frames.data(), frame_count) != frame_count) {
+    return false;
+  }
+
+  for (size_type i = 0; i < frame_count; i++) {
+    if (frames[i] != (first + frame_type(i))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Checks the regions handed out on either side of the wrap.
+void check_regions()
+{
+  tinyalsa::frame_ring ring;
+
+  check(!ring.allocate(100, sizeof(frame_type)).failed() && (ring.capacity() == 128)
+        && (ring.frame_size() == sizeof(frame_type)), "capacity is rounded up to a power of two");
+
+  check(ring.begin_read(1).frame_count == 0, "empty ring has nothing to read");
+
+  auto first = ring.begin_write(1000);
+
+  check(first.frame_count == 128, "write region is limited to the capacity");
+
+  const auto* base = static_cast<const unsigned char*>(first.frames);
+
+  // Moves both indices to 100 frames before the wrap.
+  check((write_numbered(ring, 0, 100) == 100) && read_numbered(ring, 0, 100), "frames are read in the order they're written");
+
+  auto tail = ring.begin_write(128);
+
+  check((tail.frame_count == 28) && (static_cast<const unsigned char*>(tail.frames) == (base + (100 * sizeof(frame_type)))),
+        "write region is split at the end of the ring");
+
+  check(write_numbered(ring, 100, 60) == 60, "write continues across the wrap");
+
+  check((ring.writable() == 68) && (ring.readable() == 60), "writable and readable frames are counted across the wrap");
+
+  check(ring.begin_write(128).frame_count == 68, "write region after the wrap ends at the read index");
+
+  auto read_tail = ring.begin_read(128);
+
+  check((read_tail.frame_count == 28) && (read_tail.frames == tail.frames), "read region is split at the end of the ring");
+
+  check(read_numbered(ring, 100, 60), "read continues across the wrap");
+
+  check((write_numbered(ring, 160, 200) == 128) && (ring.writable() == 0), "write stops once the ring is full");
+
+  check(ring.begin_write(1).frame_count == 0, "full ring has nothing to write");
+
+  check(read_numbered(ring, 160, 128) && (ring.readable() == 0), "full ring is read back");
+}
+
+/// Checks that a waiting consumer is woken by the producer, or times out.
+void check_wait()
+{
+  tinyalsa::frame_ring ring;
+
+  if (ring.allocate(64, sizeof(frame_type)).failed()) {
+    check(false, "wait: ring is allocated");
+    return;
+  }
+
+  check(ring.wait_readable(65, 0).error == EINVAL, "wait: more frames than the capacity can't be waited for");
+
+  auto start = std::chrono::steady_clock::now();
+
+  auto timed_out = ring.wait_readable(1, 20);
+
+  auto elapsed = std::chrono::steady_clock::now() - start;
+
+  check((timed_out.error == ETIMEDOUT) && (elapsed >= std::chrono::milliseconds(15)), "wait: empty ring times out");
+
+  tinyalsa::result woken;
+
+  std::thread consumer([&ring, &woken]() {
+    woken = ring.wait_readable(10, 5000);
+  });
+
+  // Gives the consumer time to block, then writes in two steps
+  // so that the first one doesn't satisfy the wait.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  write_numbered(ring, 0, 5);
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+  start = std::chrono::steady_clock::now();
+
+  write_numbered(ring, 5, 5);
+
+  consumer.join();
+
+  elapsed = std::chrono::steady_clock::now() - start;
+
+  check(!woken.failed() && (elapsed < std::chrono::milliseconds(1000)), "wait: producer wakes the consumer");
+
+  check(read_numbered(ring, 0, 10), "wait: frames are read after waking");
+}
+
+/// Passes frames from a producer thread to a consumer thread.
+void check_threads()
+{
+  constexpr frame_type frame_total = 1000000;
+
+  tinyalsa::frame_ring ring;
+
+  if (ring.allocate(100, sizeof(frame_type)).failed()) {
+    check(false, "threads: ring is allocated");
+    return;
+  }
+
+  // Set if the consumer gives up, so that the producer doesn't wait for it.
+  std::atomic<bool> stopped { false };
+
+  std::thread producer([&ring, &stopped]() {
+
+    frame_type next = 0;
+
+    // Odd sizes, so that writes land on either side of the wrap.
+    size_type chunk = 1;
+
+    while ((next < frame_total) && !stopped.load(std::memory_order_relaxed)) {
+
+      chunk = (chunk % 37) + 1;
+
+      auto count = std::min(size_type(frame_total - next), chunk);
+
+      auto region = ring.begin_write(count);
+      if (!region.frame_count) {
+        std::this_thread::yield();
+        continue;
+      }
+
+      auto* frames = static_cast<frame_type*>(region.frames);
+
+      for (size_type i = 0; i < region.frame_count; i++) {
+        frames[i] = next++;
+      }
+
+      ring.commit_write(region.frame_count);
+    }
+  });
+
+  frame_type expected = 0;
+
+  bool in_order = true;
+
+  bool waited = true;
+
+  frame_type frames[64];
+
+  while (in_order && waited && (expected < frame_total)) {
+
+    waited = !ring.wait_readable(1, 5000).failed();
+
+    auto count = ring.read(frames, 53);
+
+    for (size_type i = 0; i < count; i++) {
+      in_order = in_order && (frames[i] == expected++);
+    }
+  }
+
+  stopped.store(true, std::memory_order_relaxed);
+
+  producer.join();
+
+  check(waited, "threads: consumer is never stuck waiting");
+  check(in_order && (expected == frame_total), "threads: every frame is passed on in order");
+}
+
+/// Checks that captured frames are read into the ring on both sides of the wrap.
+void check_pump_capture()
+{
+  tinyalsa::fake_pcm_config fake_config;
+  fake_config.speed = 0;
+  tinyalsa::set_fake_pcm_config(fake_config);
+
+  counting_backend = tinyalsa::get_fake_backend();
+  counting_backend.ioctl = counting_ioctl;
+  tinyalsa::set_backend(counting_backend);
+
+  tinyalsa::pcm_config config;
+  config.channels = 1;
+  config.rate = 48000;
+  config.format = tinyalsa::sample_format::s32_le;
+  config.period_size = 64;
+  config.period_count = 4;
+
+  tinyalsa::interleaved_pcm_reader reader;
+
+  if (reader.open(0, 0, true).failed() || reader.setup(config).failed() || reader.prepare().failed()) {
+    check(false, "pump capture: capture PCM is set up");
+    return;
+  }
+
+  tinyalsa::frame_ring ring;
+
+  if (ring.allocate(128, sizeof(frame_type)).failed()) {
+    check(false, "pump capture: ring is allocated");
+    return;
+  }
+
+  auto first = tinyalsa::pump_capture(reader, ring, 100);
+
+  check(!first.failed() && (first.value == 100) && read_numbered(ring, 0, 100), "pump capture: frames are read into the ring");
+
+  auto wrapped = tinyalsa::pump_capture(reader, ring, 200);
+
+  check(!wrapped.failed() && (wrapped.value == 128) && (ring.readable() == 128), "pump capture: ring is filled across the wrap");
+
+  check(read_numbered(ring, 100, 128), "pump capture: frames across the wrap are in order");
+
+  write_numbered(ring, 0, 128);
+
+  check(tinyalsa::pump_capture(reader, ring, 1).error == ENOBUFS, "pump capture: full ring fails with ENOBUFS");
+
+  tinyalsa::set_backend(tinyalsa::get_fake_backend());
+}
+
+} // namespace
+
+int main()
+{
+  check_regions();
+  check_wait();
+  check_threads();
+  check_pump_capture();
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
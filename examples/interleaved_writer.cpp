@@ -0,0 +1,42 @@
+#include <tinyalsa.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+
+int main()
+{
+  // One second of 16-bit stereo silence.
+  static short int frames[48000 * 2];
+
+  constexpr const unsigned int frame_count = sizeof(frames) / (2 * sizeof(frames[0]));
+
+  tinyalsa::interleaved_pcm_writer pcm_writer;
+
+  auto open_result = pcm_writer.open();
+  if (open_result.failed()) {
+    std::printf("Failed to open PCM: %s\n", open_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto setup_result = pcm_writer.setup();
+  if (setup_result.failed()) {
+    std::printf("Failed to setup PCM: %s\n", setup_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto prepare_result = pcm_writer.prepare();
+  if (prepare_result.failed()) {
+    std::printf("Failed to prepare PCM: %s\n", prepare_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto write_result = pcm_writer.write_all(frames, frame_count);
+  if (write_result.failed()) {
+    std::printf("Failed to write PCM: %s\n", write_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  std::printf("Wrote %lu frames to PCM.\n", write_result.unwrap());
+
+  return EXIT_SUCCESS;
+}
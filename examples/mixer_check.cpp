@@ -0,0 +1,335 @@
+#include <tinyalsa.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include <sound/asound.h>
+#include <sys/ioctl.h>
+
+namespace {
+
+using tinyalsa::size_type;
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// The number of frames in one period.
+constexpr size_type period_size = 64;
+
+/// The number of periods in the buffer, which is also
+/// the number of periods that the ring of a client holds.
+constexpr size_type period_count = 4;
+
+/// The number of channels.
+constexpr size_type channels = 2;
+
+/// The bytes written to the playback PCM.
+std::vector<unsigned char> played;
+
+/// The number of bytes in one frame of the playback PCM.
+size_type played_frame_size = 0;
+
+/// The backend that the calls are passed on to.
+tinyalsa::pcm_backend capture_backend;
+
+/// Keeps the frames written to the fake PCM.
+int capture_ioctl(int fd, unsigned long request, void* arg)
+{
+  auto result = tinyalsa::get_fake_backend().ioctl(fd, request, arg);
+
+  if ((result == 0) && (request == SNDRV_PCM_IOCTL_WRITEI_FRAMES)) {
+    const auto* transfer = static_cast<const snd_xferi*>(arg);
+    const auto* bytes = static_cast<const unsigned char*>(transfer->buf);
+    auto size = size_type(transfer->result) * played_frame_size;
+    played.insert(played.end(), bytes, bytes + size);
+  }
+
+  return result;
+}
+
+/// Describes how the samples of one format are made and summed.
+template <typename sample_type>
+struct format_traits;
+
+template <>
+struct format_traits<std::int16_t> final
+{
+  static constexpr tinyalsa::sample_format format = tinyalsa::sample_format::s16_le;
+  static constexpr const char* name = "s16";
+  /// The sample of the first client, for a frame of its stream.
+  static std::int16_t first(size_type frame, size_type channel)
+  {
+    return std::int16_t(((frame * 997) + (channel * 331)) & 0xffff);
+  }
+  /// The sample of the second client, which saturates
+  /// the sum in both directions on some frames.
+  static std::int16_t second(size_type channel)
+  {
+    return channel ? std::int16_t(-20000) : std::int16_t(20000);
+  }
+};
+
+template <>
+struct format_traits<std::int32_t> final
+{
+  static constexpr tinyalsa::sample_format format = tinyalsa::sample_format::s32_le;
+  static constexpr const char* name = "s32";
+  static std::int32_t first(size_type frame, size_type channel)
+  {
+    return std::int32_t(std::uint32_t((frame * 2654435761u) + (channel * 40503u)));
+  }
+  static std::int32_t second(size_type channel)
+  {
+    return channel ? std::int32_t(-2000000000) : std::int32_t(2000000000);
+  }
+};
+
+/// Adds two samples, saturating at the edges of their range.
+template <typename sample_type>
+sample_type saturate_add(sample_type a, sample_type b)
+{
+  auto sum = std::int64_t(a) + std::int64_t(b);
+  sum = std::min(sum, std::int64_t(std::numeric_limits<sample_type>::max()));
+  sum = std::max(sum, std::int64_t(std::numeric_limits<sample_type>::min()));
+  return sample_type(sum);
+}
+
+/// Writes frames of the first client's stream into its ring.
+///
+/// @param next The index of the next frame of the stream.
+template <typename sample_type>
+void write_first(tinyalsa::software_mixer& mixer, size_type client, size_type& next, size_type frame_count)
+{
+  std::vector<sample_type> frames(frame_count * channels);
+
+  for (size_type i = 0; i < frame_count; i++) {
+    for (size_type c = 0; c < channels; c++) {
+      frames[(i * channels) + c] = format_traits<sample_type>::first(next + i, c);
+    }
+  }
+
+  next += mixer.write(client, frames.data(), frame_count);
+}
+
+/// Writes one period of the second client's stream into its ring.
+template <typename sample_type>
+bool write_second(tinyalsa::software_mixer& mixer, size_type client)
+{
+  std::vector<sample_type> frames(period_size * channels);
+
+  for (size_type i = 0; i < period_size; i++) {
+    for (size_type c = 0; c < channels; c++) {
+      frames[(i * channels) + c] = format_traits<sample_type>::second(c);
+    }
+  }
+
+  return mixer.write(client, frames.data(), period_size) == period_size;
+}
+
+/// Mixes one period and gets what was played.
+///
+/// @return True on success, false on failure.
+template <typename sample_type>
+bool run_period(tinyalsa::software_mixer& mixer, size_type expected_clients, std::vector<sample_type>& period)
+{
+  played.clear();
+
+  auto run_result = mixer.run_once(1000);
+  if (run_result.failed() || (run_result.value != expected_clients)) {
+    return false;
+  }
+
+  period.resize(played.size() / sizeof(sample_type));
+
+  std::memcpy(period.data(), played.data(), period.size() * sizeof(sample_type));
+
+  return period.size() == (period_size * channels);
+}
+
+/// Checks that a period holds the sum of both clients.
+///
+/// @param first_frame The index in the first client's stream
+/// of the frame mixed at the start of the period.
+/// @param first_frames The number of frames of the first
+/// client mixed in, after which it's silent.
+/// @param with_second Whether or not the second client was mixed in.
+template <typename sample_type>
+bool matches(const std::vector<sample_type>& period, size_type first_frame, size_type first_frames, bool with_second)
+{
+  for (size_type i = 0; i < period_size; i++) {
+    for (size_type c = 0; c < channels; c++) {
+
+      sample_type expected = 0;
+
+      if (i < first_frames) {
+        expected = format_traits<sample_type>::first(first_frame + i, c);
+      }
+
+      if (with_second) {
+        expected = saturate_add(expected, format_traits<sample_type>::second(c));
+      }
+
+      if (period[(i * channels) + c] != expected) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/// Runs the checks with one sample format.
+template <typename sample_type>
+void check_format()
+{
+  char description[256];
+
+  const auto* name = format_traits<sample_type>::name;
+
+  tinyalsa::pcm_config config;
+  config.channels = channels;
+  config.rate = 48000;
+  config.format = format_traits<sample_type>::format;
+  config.period_size = period_size;
+  config.period_count = period_count;
+
+  played_frame_size = channels * sizeof(sample_type);
+
+  tinyalsa::software_mixer mixer;
+
+  auto first = mixer.open(0, 0, config, 2).failed() ? tinyalsa::generic_result<size_type> { EIO, 0 } : mixer.add_client();
+  auto second = first.failed() ? first : mixer.add_client();
+
+  if (first.failed() || second.failed()) {
+    std::snprintf(description, sizeof(description), "%s: mixer opens with two clients", name);
+    check(false, description);
+    return;
+  }
+
+  size_type next = 0;
+
+  std::vector<sample_type> period;
+
+  // A late client is mixed as silence for the rest of the period.
+  write_first<sample_type>(mixer, first.value, next, 37);
+  write_second<sample_type>(mixer, second.value);
+
+  std::snprintf(description, sizeof(description), "%s: late client is mixed as silence after its last frame", name);
+  check(run_period(mixer, 2, period) && matches(period, 0, 37, true), description);
+
+  std::snprintf(description, sizeof(description), "%s: late client is counted as an underrun", name);
+  check((mixer.get_underruns(first.value) == 1) && (mixer.get_underruns(second.value) == 0), description);
+
+  // The ring is kept full from now on, so that each period starts
+  // 37 frames past a period boundary and wraps around the ring.
+  bool all_matched = true;
+
+  size_type mixed = 37;
+
+  for (size_type i = 0; i < (period_count * 4); i++) {
+
+    write_first<sample_type>(mixer, first.value, next, mixer.writable(first.value));
+
+    all_matched = write_second<sample_type>(mixer, second.value)
+               && run_period(mixer, 2, period)
+               && matches(period, mixed, period_size, true)
+               && all_matched;
+
+    mixed += period_size;
+  }
+
+  std::snprintf(description, sizeof(description), "%s: frames that wrap around the ring are mixed", name);
+  check(all_matched, description);
+
+  std::snprintf(description, sizeof(description), "%s: clients that keep up are not counted as underruns", name);
+  check((mixer.get_underruns(first.value) == 1) && (mixer.get_underruns(second.value) == 0), description);
+
+  // The first client stops writing. What's left in its ring is
+  // played, after which it's mixed as silence without stalling the other.
+  all_matched = true;
+
+  for (size_type i = 1; i < period_count; i++) {
+    all_matched = write_second<sample_type>(mixer, second.value)
+               && run_period(mixer, 2, period)
+               && matches(period, mixed, period_size, true)
+               && all_matched;
+
+    mixed += period_size;
+  }
+
+  std::snprintf(description, sizeof(description), "%s: frames left in the ring of a client are played", name);
+  check(all_matched && (mixer.get_underruns(first.value) == 1), description);
+
+  all_matched = true;
+
+  for (int i = 0; i < 3; i++) {
+    all_matched = write_second<sample_type>(mixer, second.value)
+               && run_period(mixer, 1, period)
+               && matches(period, 0, 0, true)
+               && all_matched;
+  }
+
+  std::snprintf(description, sizeof(description), "%s: empty client doesn't stall the other and is counted", name);
+  check(all_matched && (mixer.get_underruns(first.value) == 4) && (mixer.get_underruns(second.value) == 0), description);
+
+  // A removed client keeps its slot until the next period.
+  std::snprintf(description, sizeof(description), "%s: client is removed", name);
+  check(!mixer.remove_client(first.value).failed() && (mixer.write(first.value, period.data(), 1) == 0), description);
+
+  std::snprintf(description, sizeof(description), "%s: slot of a removed client is busy until a period is mixed", name);
+  check(mixer.add_client().error == EBUSY, description);
+
+  std::snprintf(description, sizeof(description), "%s: removed client is not mixed", name);
+  check(write_second<sample_type>(mixer, second.value) && run_period(mixer, 1, period) && matches(period, 0, 0, true),
+        description);
+
+  auto again = mixer.add_client();
+
+  std::snprintf(description, sizeof(description), "%s: slot is reused with an empty ring", name);
+  check(!again.failed() && (again.value == first.value) && (mixer.get_underruns(again.value) == 0)
+        && (mixer.writable(again.value) == (period_size * period_count)), description);
+
+  next = 0;
+
+  write_first<sample_type>(mixer, again.value, next, period_size);
+
+  std::snprintf(description, sizeof(description), "%s: client added again is mixed", name);
+  check(write_second<sample_type>(mixer, second.value) && run_period(mixer, 2, period) && matches(period, 0, period_size, true),
+        description);
+}
+
+} // namespace
+
+int main()
+{
+  // The fake hardware keeps up instantly, so
+  // that every call to run_once mixes a period.
+  tinyalsa::fake_pcm_config fake_config;
+  fake_config.speed = 0;
+  tinyalsa::set_fake_pcm_config(fake_config);
+
+  capture_backend = tinyalsa::get_fake_backend();
+  capture_backend.ioctl = capture_ioctl;
+  tinyalsa::set_backend(capture_backend);
+
+  check_format<std::int16_t>();
+  check_format<std::int32_t>();
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,251 @@
+#include <tinyalsa.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+
+namespace {
+
+using tinyalsa::size_type;
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// The number of frames in one period.
+constexpr size_type period_size = 64;
+
+/// The number of periods in the buffer.
+constexpr size_type period_count = 4;
+
+/// The number of frames in the buffer.
+constexpr size_type buffer_size = period_size * period_count;
+
+/// The number of bytes in one frame, with two channels of s16.
+constexpr size_type frame_size = 4;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// Makes the fake devices opened from now on run at a given speed.
+///
+/// @param speed How many times faster than real time the devices run.
+void set_speed(double speed)
+{
+  tinyalsa::fake_pcm_config config;
+  config.speed = speed;
+  tinyalsa::set_fake_pcm_config(config);
+}
+
+/// Gets the configuration that every PCM is set up with.
+///
+/// @param stop_threshold The stop threshold, or zero for the default.
+tinyalsa::pcm_config make_config(size_type stop_threshold = 0)
+{
+  tinyalsa::pcm_config config;
+  config.channels = 2;
+  config.rate = 48000;
+  config.format = tinyalsa::sample_format::s16_le;
+  config.period_size = period_size;
+  config.period_count = period_count;
+  config.stop_threshold = stop_threshold;
+  return config;
+}
+
+/// Gets the byte offset of a region from the start of the buffer.
+long offset_of(const tinyalsa::mmap_region& region, const void* base)
+{
+  return static_cast<const unsigned char*>(region.frames) - static_cast<const unsigned char*>(base);
+}
+
+/// Gets the application position reported by the device.
+size_type get_appl_ptr(tinyalsa::pcm& pcm)
+{
+  auto status = pcm.get_status();
+
+  return status.failed() ? size_type(-1) : status.unwrap().appl_ptr;
+}
+
+/// Checks the regions handed out by a playback PCM.
+void check_playback()
+{
+  set_speed(0);
+
+  tinyalsa::mmap_pcm_writer writer;
+
+  if (writer.open(0, 0, true).failed() || writer.setup(make_config()).failed() || writer.prepare().failed()) {
+    check(false, "playback: PCM is set up");
+    return;
+  }
+
+  auto available = writer.available();
+
+  check(!available.failed() && (available.value == buffer_size), "playback: whole buffer is writable after prepare");
+
+  auto first = writer.begin(buffer_size * 2);
+
+  check(!first.failed() && (first.value.frame_count == buffer_size), "playback: region is limited to the buffer");
+
+  if (first.failed()) {
+    return;
+  }
+
+  const void* base = first.value.frames;
+
+  check(!writer.commit(200).failed() && (get_appl_ptr(writer) == 200), "playback: commit moves the application pointer");
+
+  check(writer.commit(buffer_size).error == EINVAL, "playback: more frames than available can't be committed");
+
+  // The fake hardware keeps up instantly once started,
+  // so that the whole buffer is writable again.
+  if (writer.start().failed()) {
+    check(false, "playback: PCM is started");
+    return;
+  }
+
+  auto tail = writer.begin(buffer_size);
+
+  check(!tail.failed() && (tail.value.frame_count == (buffer_size - 200)) && (offset_of(tail.value, base) == long(200 * frame_size)),
+        "playback: region is split at the end of the buffer");
+
+  check(!writer.commit(buffer_size - 200).failed() && (get_appl_ptr(writer) == buffer_size),
+        "playback: commit reaches the end of the buffer");
+
+  auto head = writer.begin(buffer_size);
+
+  check(!head.failed() && (head.value.frame_count == buffer_size) && (offset_of(head.value, base) == 0),
+        "playback: region wraps around to the start of the buffer");
+
+  check(!writer.commit(100).failed() && (get_appl_ptr(writer) == (buffer_size + 100)),
+        "playback: application pointer keeps counting past the buffer");
+}
+
+/// Checks the regions handed out by a capture PCM.
+void check_capture()
+{
+  set_speed(0);
+
+  tinyalsa::mmap_pcm_reader reader;
+
+  if (reader.open(0, 0, true).failed() || reader.setup(make_config()).failed() || reader.prepare().failed()) {
+    check(false, "capture: PCM is set up");
+    return;
+  }
+
+  auto available = reader.available();
+
+  check(!available.failed() && (available.value == 0), "capture: nothing is readable before the start");
+
+  // Once started, the fake hardware fills the buffer instantly.
+  if (reader.start().failed()) {
+    check(false, "capture: PCM is started");
+    return;
+  }
+
+  available = reader.available();
+
+  check(!available.failed() && (available.value == buffer_size), "capture: whole buffer is readable after the start");
+
+  auto first = reader.begin(100);
+
+  check(!first.failed() && (first.value.frame_count == 100), "capture: region is limited to the frames requested");
+
+  if (first.failed()) {
+    return;
+  }
+
+  const void* base = first.value.frames;
+
+  check(!reader.commit(100).failed() && (get_appl_ptr(reader) == 100), "capture: commit moves the application pointer");
+
+  auto tail = reader.begin(buffer_size);
+
+  check(!tail.failed() && (tail.value.frame_count == (buffer_size - 100)) && (offset_of(tail.value, base) == long(100 * frame_size)),
+        "capture: region is split at the end of the buffer");
+
+  check(!reader.commit(buffer_size - 100).failed(), "capture: rest of the buffer is committed");
+
+  auto head = reader.begin(buffer_size);
+
+  check(!head.failed() && (head.value.frame_count == buffer_size) && (offset_of(head.value, base) == 0),
+        "capture: region wraps around to the start of the buffer");
+}
+
+/// Checks that an xrun makes begin fail with EPIPE, and that
+/// regions are handed out again once the PCM is recovered.
+///
+/// @param pcm The memory mapped PCM, set up and prepared.
+/// @param name Prefixes the description of each check.
+void check_xrun(tinyalsa::mmap_pcm& pcm, bool is_capture, const char* name)
+{
+  char description[256];
+
+  if (!is_capture) {
+    auto region = pcm.begin(buffer_size);
+    if (region.failed() || pcm.commit(region.value.frame_count).failed()) {
+      std::snprintf(description, sizeof(description), "%s: buffer is filled", name);
+      check(false, description);
+      return;
+    }
+  }
+
+  if (pcm.start().failed()) {
+    std::snprintf(description, sizeof(description), "%s: PCM is started", name);
+    check(false, description);
+    return;
+  }
+
+  // The buffer lasts about 5 milliseconds, and nothing is transferred.
+  ::usleep(50000);
+
+  auto region = pcm.begin(period_size);
+
+  auto counters = pcm.get_xrun_counters();
+
+  std::snprintf(description, sizeof(description), "%s: begin returns EPIPE after an xrun", name);
+  check(region.error == EPIPE, description);
+
+  std::snprintf(description, sizeof(description), "%s: xrun is counted but not recovered", name);
+  check(((is_capture ? counters.overruns : counters.underruns) == 1) && (counters.recoveries == 0), description);
+
+  std::snprintf(description, sizeof(description), "%s: regions are handed out after recovery", name);
+  check(!pcm.recover(region.error).failed() && !pcm.begin(period_size).failed(), description);
+}
+
+} // namespace
+
+int main()
+{
+  tinyalsa::set_backend(tinyalsa::get_fake_backend());
+
+  check_playback();
+  check_capture();
+
+  // Real time, so that the buffers run out by themselves. By default,
+  // capture PCMs only stop once ten buffers are overwritten.
+  set_speed(1.0);
+
+  tinyalsa::mmap_pcm_writer writer;
+  if (writer.open(0, 0, true).failed() || writer.setup(make_config(buffer_size)).failed() || writer.prepare().failed()) {
+    check(false, "underrun: PCM is set up");
+  } else {
+    check_xrun(writer, false, "underrun");
+  }
+
+  tinyalsa::mmap_pcm_reader reader;
+  if (reader.open(0, 0, true).failed() || reader.setup(make_config(buffer_size)).failed() || reader.prepare().failed()) {
+    check(false, "overrun: PCM is set up");
+  } else {
+    check_xrun(reader, true, "overrun");
+  }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,59 @@
+#include <tinyalsa.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+
+int main()
+{
+  tinyalsa::mmap_pcm_reader pcm_reader;
+
+  auto open_result = pcm_reader.open();
+  if (open_result.failed()) {
+    std::printf("Failed to open PCM: %s\n", open_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto setup_result = pcm_reader.setup();
+  if (setup_result.failed()) {
+    std::printf("Failed to setup PCM: %s\n", setup_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto prepare_result = pcm_reader.prepare();
+  if (prepare_result.failed()) {
+    std::printf("Failed to prepare PCM: %s\n", prepare_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto start_result = pcm_reader.start();
+  if (start_result.failed()) {
+    std::printf("Failed to start PCM: %s\n", start_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto wait_result = pcm_reader.wait();
+  if (wait_result.failed()) {
+    std::printf("Failed to wait for PCM: %s\n", wait_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto begin_result = pcm_reader.begin(1024);
+  if (begin_result.failed()) {
+    std::printf("Failed to access PCM buffer: %s\n", begin_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  auto region = begin_result.unwrap();
+
+  // The frames at region.frames may be processed in place here.
+
+  auto commit_result = pcm_reader.commit(region.frame_count);
+  if (commit_result.failed()) {
+    std::printf("Failed to commit PCM buffer: %s\n", commit_result.error_description());
+    return EXIT_FAILURE;
+  }
+
+  std::printf("Accessed %lu frames from PCM.\n", region.frame_count);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,154 @@
+#include <tinyalsa.hpp>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+
+#include <sound/asound.h>
+#include <sys/ioctl.h>
+
+namespace {
+
+using tinyalsa::size_type;
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// The number of times a PCM was linked to another.
+size_type link_count = 0;
+
+/// The number of times each PCM was unlinked, by file descriptor.
+std::map<int, size_type> unlink_counts;
+
+/// The backend that the calls are passed on to.
+tinyalsa::pcm_backend counting_backend;
+
+/// Counts the attempts to link and unlink the fake PCMs, which don't support it.
+int counting_ioctl(int fd, unsigned long request, void* arg)
+{
+  if (request == SNDRV_PCM_IOCTL_LINK) {
+    link_count++;
+  } else if (request == SNDRV_PCM_IOCTL_UNLINK) {
+    unlink_counts[fd]++;
+  }
+
+  return tinyalsa::get_fake_backend().ioctl(fd, request, arg);
+}
+
+/// Checks that every PCM is in a given state.
+template <size_type count>
+bool all_in_state(tinyalsa::pcm* (&pcms)[count], tinyalsa::pcm_state state)
+{
+  for (auto* p : pcms) {
+    auto status = p->get_status();
+    if (status.failed() || (status.value.state != state)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+int main()
+{
+  // The hardware keeps up instantly, so that the
+  // members keep running until they're dropped.
+  tinyalsa::fake_pcm_config fake_config;
+  fake_config.speed = 0;
+  tinyalsa::set_fake_pcm_config(fake_config);
+
+  counting_backend = tinyalsa::get_fake_backend();
+  counting_backend.ioctl = counting_ioctl;
+  tinyalsa::set_backend(counting_backend);
+
+  tinyalsa::pcm_config config;
+  config.rate = 48000;
+  config.period_size = 256;
+  config.period_count = 4;
+
+  tinyalsa::interleaved_pcm_writer first;
+  tinyalsa::interleaved_pcm_writer second;
+  tinyalsa::interleaved_pcm_reader third;
+
+  if (first.open(0, 0, true).failed() || first.setup(config).failed()
+   || second.open(0, 0, true).failed() || second.setup(config).failed()
+   || third.open(0, 0, true).failed() || third.setup(config).failed()) {
+    check(false, "PCMs are set up");
+    return EXIT_FAILURE;
+  }
+
+  tinyalsa::pcm* members[] { &first, &second, &third };
+
+  tinyalsa::pcm_group group;
+
+  tinyalsa::interleaved_pcm_writer closed;
+
+  check(group.add(closed).error == EBADF, "closed PCM can't be added");
+
+  check(!group.add(first).failed() && (group.size() == 1) && (link_count == 0), "first member is added without linking");
+
+  check(group.add(first).error == EEXIST, "member can't be added twice");
+
+  // The fake backend refuses to link, so the group unlinks
+  // the members it has and falls back to timed starts.
+  check(!group.add(second).failed() && (group.size() == 2), "member is added when linking fails");
+  check((link_count == 1) && !group.is_linked(), "group falls back to timed starts when linking fails");
+  check((unlink_counts[first.get_file_descriptor()] == 1) && (unlink_counts[second.get_file_descriptor()] == 1),
+        "members are unlinked when linking fails");
+
+  check(!group.add(third).failed() && (group.size() == 3) && (link_count == 1), "no more links are tried after a failure");
+
+  check(group.get_start_skew() == 0, "skew is zero before a start");
+
+  check(!group.prepare().failed() && all_in_state(members, tinyalsa::pcm_state::prepared), "every member is prepared");
+
+  constexpr size_type lead_time_us = 5000;
+
+  auto start_time = std::chrono::steady_clock::now();
+
+  auto start_result = group.start(lead_time_us);
+
+  auto elapsed = std::chrono::steady_clock::now() - start_time;
+
+  check(!start_result.failed() && all_in_state(members, tinyalsa::pcm_state::running), "every member is started");
+  check(elapsed >= std::chrono::microseconds(lead_time_us), "timed start waits for the lead time");
+
+  // The members are started back to back, long before the lead time is over again.
+  auto skew = group.get_start_skew();
+  check((skew >= 0) && (skew < std::int64_t(lead_time_us * 1000)), "start skew is measured between the members");
+
+  check(!group.drop().failed() && all_in_state(members, tinyalsa::pcm_state::setup), "every member is dropped");
+
+  auto unlinks = unlink_counts[second.get_file_descriptor()];
+
+  check(!group.remove(second).failed() && (group.size() == 2), "member is removed");
+  check(unlink_counts[second.get_file_descriptor()] == unlinks, "member of a group that isn't linked isn't unlinked again");
+  check(group.remove(second).error == ENOENT, "member can't be removed twice");
+
+  check(!group.prepare().failed() && !group.start(0).failed() && (second.get_status().value.state == tinyalsa::pcm_state::setup),
+        "removed member isn't started with the group");
+
+  group.drop();
+
+  group.remove(first);
+  group.remove(third);
+
+  // An empty group tries to link its members again.
+  check(!group.add(first).failed() && !group.add(second).failed() && (link_count == 2), "emptied group tries to link again");
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
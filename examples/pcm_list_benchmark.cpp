@@ -0,0 +1,109 @@
+#include <tinyalsa.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+
+/// The number of times each enumeration is repeated.
+constexpr int repeat_count = 200;
+
+/// The number of PCM devices on each fake card.
+constexpr tinyalsa::size_type devices_per_card = 8;
+
+/// Lists the PCMs through the control devices,
+/// the way @ref tinyalsa::pcm_list does.
+///
+/// @return The number of PCMs found.
+tinyalsa::size_type list_controls()
+{
+  tinyalsa::pcm_list list;
+
+  return list.size();
+}
+
+/// Lists the PCMs by opening every PCM device and asking it
+/// for its information, which is what the list used to do.
+///
+/// @return The number of PCMs found.
+tinyalsa::size_type list_nodes(tinyalsa::size_type card_count)
+{
+  tinyalsa::size_type found = 0;
+
+  for (tinyalsa::size_type card = 0; card < card_count; card++) {
+
+    for (tinyalsa::size_type device = 0; device < devices_per_card; device++) {
+
+      tinyalsa::interleaved_pcm_writer writer;
+
+      if (!writer.open(card, device).failed() && !writer.get_info().failed()) {
+        found++;
+      }
+
+      tinyalsa::interleaved_pcm_reader reader;
+
+      if (!reader.open(card, device).failed() && !reader.get_info().failed()) {
+        found++;
+      }
+    }
+  }
+
+  return found;
+}
+
+/// Measures the average time of one enumeration.
+///
+/// @param found Receives the number of PCMs found.
+///
+/// @return The number of microseconds per enumeration.
+template <typename Enumerate>
+double run(Enumerate enumerate, tinyalsa::size_type& found)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  for (int i = 0; i < repeat_count; i++) {
+    found = enumerate();
+  }
+
+  auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  return elapsed / repeat_count;
+}
+
+} // namespace
+
+int main()
+{
+  // The fake devices answer instantly, so this measures the
+  // overhead of the library rather than that of a driver.
+  tinyalsa::set_backend(tinyalsa::get_fake_backend());
+
+  const tinyalsa::size_type card_counts[] { 1, 4, 16, 32 };
+
+  std::printf("%-8s %8s %8s %16s %16s\n", "cards", "pcms", "nodes", "control (us)", "nodes (us)");
+
+  for (auto card_count : card_counts) {
+
+    tinyalsa::fake_pcm_config config;
+    config.cards = card_count;
+    config.devices = devices_per_card;
+    tinyalsa::set_fake_pcm_config(config);
+
+    tinyalsa::size_type control_found = 0;
+    tinyalsa::size_type node_found = 0;
+
+    auto control_us = run(list_controls, control_found);
+
+    auto node_us = run([card_count]() { return list_nodes(card_count); }, node_found);
+
+    std::printf("%-8zu %8zu %8zu %16.1f %16.1f\n", card_count, control_found, node_found, control_us, node_us);
+
+    if (control_found != (card_count * devices_per_card * 2)) {
+      std::printf("Expected %zu PCMs.\n", card_count * devices_per_card * 2);
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,236 @@
+#include <tinyalsa.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef __cpp_impl_coroutine
+
+#include <cstdint>
+#include <map>
+#include <vector>
+
+#include <sound/asound.h>
+#include <sys/ioctl.h>
+
+namespace {
+
+using tinyalsa::size_type;
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// Each frame is a single 32-bit sample, numbered within its stream.
+using frame_type = std::uint32_t;
+
+/// The number of frames in one period.
+constexpr size_type period_size = 256;
+
+/// The number of periods in the buffer.
+constexpr size_type period_count = 4;
+
+/// The number of frames in one transfer. It's a little less than the buffer,
+/// so that the first write completes right away and the later ones don't.
+constexpr size_type transfer_frames = 1000;
+
+/// The number of transfers each coroutine awaits.
+constexpr size_type transfer_count = 3;
+
+/// The number of readers and of writers.
+constexpr size_type stream_count = 2;
+
+/// The frames written to each fake PCM, by file descriptor.
+std::map<int, std::vector<frame_type>> written;
+
+/// The number of frames read from each fake PCM, by file descriptor.
+std::map<int, frame_type> read_counts;
+
+/// The backend that the calls are passed on to.
+tinyalsa::pcm_backend recording_backend;
+
+/// Keeps the frames written to the fake PCMs
+/// and numbers the frames read from them.
+int recording_ioctl(int fd, unsigned long request, void* arg)
+{
+  auto result = tinyalsa::get_fake_backend().ioctl(fd, request, arg);
+
+  if ((result == 0) && (request == SNDRV_PCM_IOCTL_WRITEI_FRAMES)) {
+    const auto* transfer = static_cast<const snd_xferi*>(arg);
+    const auto* frames = static_cast<const frame_type*>(transfer->buf);
+    written[fd].insert(written[fd].end(), frames, frames + transfer->result);
+  } else if ((result == 0) && (request == SNDRV_PCM_IOCTL_READI_FRAMES)) {
+    const auto* transfer = static_cast<const snd_xferi*>(arg);
+    auto* frames = static_cast<frame_type*>(transfer->buf);
+    for (snd_pcm_sframes_t i = 0; i < transfer->result; i++) {
+      frames[i] = read_counts[fd]++;
+    }
+  }
+
+  return result;
+}
+
+/// A coroutine that starts right away and
+/// is not waited on by anything but the reactor.
+struct task final
+{
+  struct promise_type final
+  {
+    task get_return_object() noexcept { return task(); }
+    std::suspend_never initial_suspend() noexcept { return std::suspend_never(); }
+    std::suspend_never final_suspend() noexcept { return std::suspend_never(); }
+    void return_void() noexcept { }
+    void unhandled_exception() noexcept { std::abort(); }
+  };
+};
+
+/// What a coroutine found once it finished.
+struct stream_outcome final
+{
+  /// Whether or not the coroutine finished.
+  bool finished = false;
+  /// Whether or not every transfer completed in full.
+  bool complete = true;
+  /// Whether or not the frames were read in the order they were captured.
+  bool in_order = true;
+};
+
+/// Writes numbered frames to a PCM with several transfers.
+task write_stream(tinyalsa::pcm_reactor& reactor, tinyalsa::interleaved_pcm_writer& writer, stream_outcome& outcome)
+{
+  std::vector<frame_type> frames(transfer_frames);
+
+  for (size_type t = 0; t < transfer_count; t++) {
+
+    for (size_type f = 0; f < transfer_frames; f++) {
+      frames[f] = frame_type((t * transfer_frames) + f);
+    }
+
+    auto write_result = co_await tinyalsa::async_write(reactor, writer, frames.data(), transfer_frames);
+
+    outcome.complete = outcome.complete && !write_result.failed() && (write_result.value == transfer_frames);
+  }
+
+  outcome.finished = true;
+}
+
+/// Reads frames from a PCM with several transfers,
+/// checking that they're numbered in order.
+task read_stream(tinyalsa::pcm_reactor& reactor, tinyalsa::interleaved_pcm_reader& reader, stream_outcome& outcome)
+{
+  std::vector<frame_type> frames(transfer_frames);
+
+  for (size_type t = 0; t < transfer_count; t++) {
+
+    auto read_result = co_await tinyalsa::async_read(reactor, reader, frames.data(), transfer_frames);
+
+    outcome.complete = outcome.complete && !read_result.failed() && (read_result.value == transfer_frames);
+
+    for (size_type f = 0; f < transfer_frames; f++) {
+      outcome.in_order = outcome.in_order && (frames[f] == frame_type((t * transfer_frames) + f));
+    }
+  }
+
+  outcome.finished = true;
+}
+
+/// Checks that every written frame reached its PCM in order.
+bool all_written_in_order(const tinyalsa::interleaved_pcm_writer& writer)
+{
+  const auto& frames = written[writer.get_file_descriptor()];
+
+  if (frames.size() != (transfer_frames * transfer_count)) {
+    return false;
+  }
+
+  for (size_type f = 0; f < frames.size(); f++) {
+    if (frames[f] != frame_type(f)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+} // namespace
+
+int main()
+{
+  // Real time, so that the transfers have to wait for the PCMs.
+  tinyalsa::fake_pcm_config fake_config;
+  fake_config.speed = 1.0;
+  tinyalsa::set_fake_pcm_config(fake_config);
+
+  recording_backend = tinyalsa::get_fake_backend();
+  recording_backend.ioctl = recording_ioctl;
+  tinyalsa::set_backend(recording_backend);
+
+  tinyalsa::pcm_config config;
+  config.channels = 1;
+  config.rate = 48000;
+  config.format = tinyalsa::sample_format::s32_le;
+  config.period_size = period_size;
+  config.period_count = period_count;
+
+  tinyalsa::interleaved_pcm_writer writers[stream_count];
+  tinyalsa::interleaved_pcm_reader readers[stream_count];
+
+  for (size_type i = 0; i < stream_count; i++) {
+    if (writers[i].open(0, 0, true).failed() || writers[i].setup(config).failed() || writers[i].prepare().failed()
+     || readers[i].open(0, 0, true).failed() || readers[i].setup(config).failed() || readers[i].prepare().failed()) {
+      check(false, "PCMs are set up");
+      return EXIT_FAILURE;
+    }
+  }
+
+  tinyalsa::pcm_reactor reactor;
+
+  stream_outcome write_outcomes[stream_count];
+  stream_outcome read_outcomes[stream_count];
+
+  for (size_type i = 0; i < stream_count; i++) {
+    write_stream(reactor, writers[i], write_outcomes[i]);
+    read_stream(reactor, readers[i], read_outcomes[i]);
+  }
+
+  check(reactor.pending() == (stream_count * 2), "every coroutine is suspended on the reactor");
+
+  auto run_result = reactor.run();
+
+  check(!run_result.failed() && (reactor.pending() == 0), "run returns once no wait is pending");
+
+  bool all_finished = true;
+  bool all_complete = true;
+  bool all_in_order = true;
+
+  for (size_type i = 0; i < stream_count; i++) {
+    all_finished = all_finished && write_outcomes[i].finished && read_outcomes[i].finished;
+    all_complete = all_complete && write_outcomes[i].complete && read_outcomes[i].complete;
+    all_in_order = all_in_order && read_outcomes[i].in_order && all_written_in_order(writers[i]);
+  }
+
+  check(all_finished, "every coroutine runs to the end");
+  check(all_complete, "partial transfers are resumed until they complete");
+  check(all_in_order, "frames are transferred in order across partial transfers");
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#else // __cpp_impl_coroutine
+
+int main()
+{
+  std::printf("SKIP: the compiler doesn't support coroutines\n");
+
+  return EXIT_SUCCESS;
+}
+
+#endif // __cpp_impl_coroutine
@@ -0,0 +1,349 @@
+#include <tinyalsa.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+using tinyalsa::size_type;
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// Gets the byte at a position of the synthetic stream.
+inline unsigned char pattern_at(size_type index)
+{
+  return (unsigned char) ((index * 31) + (index >> 8));
+}
+
+/// Produces a known byte pattern, as if it were captured by a device.
+class synthetic_reader final : public tinyalsa::interleaved_reader
+{
+  /// The number of bytes in one frame.
+  size_type frame_size;
+  /// The number of frames left to produce.
+  size_type frames_left;
+  /// The number of bytes produced so far.
+  size_type offset = 0;
+public:
+  synthetic_reader(size_type frame_size_, size_type frame_count)
+    : frame_size(frame_size_), frames_left(frame_count) { }
+
+  tinyalsa::generic_result<size_type> read_unformatted(void* frames, size_type frame_count) noexcept override
+  {
+    if (frame_count > frames_left) {
+      frame_count = frames_left;
+    }
+
+    auto* bytes = static_cast<unsigned char*>(frames);
+
+    for (size_type i = 0; i < (frame_count * frame_size); i++) {
+      bytes[i] = pattern_at(offset + i);
+    }
+
+    offset += frame_count * frame_size;
+
+    frames_left -= frame_count;
+
+    return { 0, frame_count };
+  }
+
+  bool done() const noexcept { return !frames_left; }
+};
+
+/// Checks that a buffer holds the synthetic stream.
+bool matches_pattern(const unsigned char* bytes, size_type size)
+{
+  for (size_type i = 0; i < size; i++) {
+    if (bytes[i] != pattern_at(i)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Gets the size of a file, or -1 if it can't be found.
+long file_size(const char* path)
+{
+  struct stat st;
+
+  return (::stat(path, &st) == 0) ? long(st.st_size) : -1;
+}
+
+/// Reads the first bytes of a file.
+bool read_head(const char* path, unsigned char* head, size_type size)
+{
+  auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+
+  auto count = ::read(fd, head, size);
+
+  ::close(fd);
+
+  return count == ssize_t(size);
+}
+
+/// Reads a little endian 32-bit integer.
+std::uint32_t get_le32(const unsigned char* in)
+{
+  return std::uint32_t(in[0]) | (std::uint32_t(in[1]) << 8) | (std::uint32_t(in[2]) << 16) | (std::uint32_t(in[3]) << 24);
+}
+
+/// Records the synthetic stream to a file and reads it back.
+///
+/// @param name Prefixes the description of each check.
+/// @param always_rf64 Whether or not the file is written as RF64.
+void check_round_trip(const char* path, const char* name, const tinyalsa::pcm_config& format,
+                      size_type frame_size, size_type frame_count, bool always_rf64)
+{
+  char description[256];
+
+  tinyalsa::capture_recorder_config config;
+  // A few small buffers, so that many of them are handed off.
+  config.buffer_size = 4096;
+  config.buffer_count = 3;
+  config.always_rf64 = always_rf64;
+
+  tinyalsa::capture_recorder recorder;
+
+  if (recorder.open(path, format, config).failed()) {
+    std::snprintf(description, sizeof(description), "%s: recorder opens", name);
+    check(false, description);
+    return;
+  }
+
+  synthetic_reader reader(frame_size, frame_count);
+
+  bool pumped = true;
+
+  while (pumped && !reader.done()) {
+
+    auto pump_result = recorder.pump(reader, 300);
+
+    if (pump_result.error == ENOBUFS) {
+      ::usleep(100);
+    } else {
+      pumped = !pump_result.failed();
+    }
+  }
+
+  auto stats = recorder.get_stats();
+
+  std::snprintf(description, sizeof(description), "%s: every frame is captured", name);
+  check(pumped && (stats.frames_captured == frame_count), description);
+
+  std::snprintf(description, sizeof(description), "%s: recorder closes", name);
+  check(!recorder.close().failed(), description);
+
+  auto data_size = frame_size * frame_count;
+
+  // The audio starts after the 4096 byte header and is padded to an even size.
+  std::snprintf(description, sizeof(description), "%s: file has the header, the frames and the pad byte", name);
+  check(file_size(path) == long(4096 + data_size + (data_size & 1)), description);
+
+  unsigned char head[4096];
+
+  if (!read_head(path, head, sizeof(head))) {
+    std::snprintf(description, sizeof(description), "%s: header is read", name);
+    check(false, description);
+    return;
+  }
+
+  if (always_rf64) {
+    std::snprintf(description, sizeof(description), "%s: header is RF64", name);
+    check((std::memcmp(head, "RF64", 4) == 0) && (std::memcmp(head + 12, "ds64", 4) == 0)
+          && (get_le32(head + 4) == 0xffffffff) && (get_le32(head + 4096 - 4) == 0xffffffff), description);
+  } else {
+    std::snprintf(description, sizeof(description), "%s: header is RIFF", name);
+    check((std::memcmp(head, "RIFF", 4) == 0) && (get_le32(head + 4) == (file_size(path) - 8))
+          && (get_le32(head + 4096 - 4) == data_size), description);
+  }
+
+  tinyalsa::file_pcm_reader file_reader;
+
+  if (file_reader.open(path).failed()) {
+    std::snprintf(description, sizeof(description), "%s: file reader opens", name);
+    check(false, description);
+    return;
+  }
+
+  auto file_config = file_reader.get_config();
+
+  std::snprintf(description, sizeof(description), "%s: file reader gets the format", name);
+  check((file_config.channels == format.channels) && (file_config.rate == format.rate)
+        && (file_config.format == format.format) && (file_reader.get_frame_count() == frame_count), description);
+
+  std::vector<unsigned char> frames((frame_count + 1) * frame_size);
+
+  auto read_result = file_reader.read_unformatted(frames.data(), frame_count + 1);
+
+  std::snprintf(description, sizeof(description), "%s: file reader gets the frames that were captured", name);
+  check(!read_result.failed() && (read_result.value == frame_count) && matches_pattern(frames.data(), data_size),
+        description);
+}
+
+/// Checks that the capture thread is told when the disk falls behind.
+///
+/// The file is a FIFO whose buffer only holds the header, so that
+/// the I/O thread blocks until the check reads from the other end.
+void check_stalls(const char* path)
+{
+  if (::mkfifo(path, 0600) < 0) {
+    check(false, "stalls: FIFO is created");
+    return;
+  }
+
+  auto fifo = ::open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fifo < 0) {
+    check(false, "stalls: FIFO is opened");
+    return;
+  }
+
+  ::fcntl(fifo, F_SETPIPE_SZ, 4096);
+
+  tinyalsa::pcm_config format;
+  format.channels = 2;
+  format.rate = 48000;
+  format.format = tinyalsa::sample_format::s16_le;
+
+  tinyalsa::capture_recorder_config config;
+  config.buffer_size = 4096;
+  config.buffer_count = 2;
+  // O_DIRECT would put the FIFO in packet mode.
+  config.direct_io = false;
+
+  constexpr size_type buffer_frames = 1024;
+
+  tinyalsa::capture_recorder recorder;
+
+  if (recorder.open(path, format, config).failed()) {
+    check(false, "stalls: recorder opens");
+    ::close(fifo);
+    return;
+  }
+
+  synthetic_reader reader(4, buffer_frames * 3);
+
+  auto first = recorder.pump(reader, buffer_frames);
+  auto second = recorder.pump(reader, buffer_frames);
+  auto third = recorder.pump(reader, buffer_frames);
+
+  auto stats = recorder.get_stats();
+
+  check(!first.failed() && !second.failed() && (third.error == ENOBUFS), "stalls: pump fails while all buffers are queued");
+  check((stats.stalls == 1) && (stats.queued_buffers == 2) && (stats.max_queued_buffers == 2),
+        "stalls: stall and queued buffers are counted");
+
+  // Drains the header and both buffers.
+  std::vector<unsigned char> drained(4096 * 3);
+
+  size_type drained_size = 0;
+
+  while (drained_size < drained.size()) {
+
+    pollfd pfd { fifo, POLLIN, 0 };
+
+    if (::poll(&pfd, 1, 1000) != 1) {
+      break;
+    }
+
+    auto count = ::read(fifo, drained.data() + drained_size, drained.size() - drained_size);
+    if (count <= 0) {
+      break;
+    }
+
+    drained_size += size_type(count);
+  }
+
+  check((drained_size == drained.size()) && matches_pattern(drained.data() + 4096, 4096 * 2),
+        "stalls: queued buffers are written once the disk catches up");
+
+  // The I/O thread marks the last buffer written right after writing it.
+  for (int i = 0; (i < 1000) && (recorder.get_stats().buffers_written < 2); i++) {
+    ::usleep(1000);
+  }
+
+  stats = recorder.get_stats();
+
+  check((stats.buffers_written == 2) && (stats.queued_buffers == 0) && (stats.bytes_written == 4096 * 2),
+        "stalls: written buffers are counted");
+
+  auto fourth = recorder.pump(reader, buffer_frames);
+
+  check(!fourth.failed() && (fourth.value == buffer_frames) && (recorder.get_stats().stalls == 1),
+        "stalls: pump succeeds again");
+
+  // The header of a FIFO can't be completed, which is reported.
+  check(recorder.close().failed(), "stalls: failure to complete the header is reported");
+
+  ::close(fifo);
+}
+
+} // namespace
+
+int main()
+{
+  char directory[] = "/tmp/recorder_check.XXXXXX";
+
+  if (!::mkdtemp(directory)) {
+    std::printf("Failed to create a directory.\n");
+    return EXIT_FAILURE;
+  }
+
+  char path[sizeof(directory) + 16];
+
+  std::snprintf(path, sizeof(path), "%s/riff.wav", directory);
+
+  tinyalsa::pcm_config stereo;
+  stereo.channels = 2;
+  stereo.rate = 48000;
+  stereo.format = tinyalsa::sample_format::s16_le;
+
+  // Spans several buffers and ends in a partial one.
+  check_round_trip(path, "riff", stereo, 4, 10000, false);
+
+  ::unlink(path);
+
+  std::snprintf(path, sizeof(path), "%s/rf64.wav", directory);
+
+  tinyalsa::pcm_config three_channels;
+  three_channels.channels = 3;
+  three_channels.rate = 44100;
+  three_channels.format = tinyalsa::sample_format::s24_3le;
+
+  // An odd number of bytes, so that the data chunk is padded.
+  check_round_trip(path, "rf64", three_channels, 9, 1001, true);
+
+  ::unlink(path);
+
+  std::snprintf(path, sizeof(path), "%s/fifo", directory);
+
+  check_stalls(path);
+
+  ::unlink(path);
+
+  ::rmdir(directory);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
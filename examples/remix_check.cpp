@@ -0,0 +1,347 @@
+#include <tinyalsa.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+using tinyalsa::conversion_isa;
+using tinyalsa::size_type;
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// Describes an instruction set to check against the scalar kernels.
+struct isa_info final
+{
+  conversion_isa isa;
+  const char* name;
+};
+
+const isa_info vector_isas[] {
+  { conversion_isa::sse2, "sse2" },
+  { conversion_isa::avx2, "avx2" },
+  { conversion_isa::neon, "neon" }
+};
+
+/// A signaling NaN. It's quieted by any arithmetic,
+/// so it's only passed on unchanged by a copy.
+constexpr std::uint32_t signaling_nan = 0x7f800001;
+
+/// Gets the bits of a sample.
+std::uint32_t bits_of(float sample)
+{
+  std::uint32_t bits = 0;
+  std::memcpy(&bits, &sample, sizeof(bits));
+  return bits;
+}
+
+/// Makes a sample from its bits.
+float from_bits(std::uint32_t bits)
+{
+  float sample = 0;
+  std::memcpy(&sample, &bits, sizeof(sample));
+  return sample;
+}
+
+/// The gains that the ramp starts from, with two outputs and three inputs.
+const float ramp_from[6] { 0.25f, -0.5f, 1.0f, 0.5f, 0.75f, -1.0f };
+
+/// The gains that the ramp ends on. One of them is zero,
+/// so that its input is dropped at the end of the ramp.
+const float ramp_to[6] { -1.0f, 0.5f, 0.25f, 0.0f, -0.75f, 0.5f };
+
+/// The number of frames that the gains are ramped over.
+constexpr size_type ramp_frames = 300;
+
+/// Makes a sample that has few enough bits for it to be multiplied by
+/// the gains of these checks, and summed, without being rounded.
+float exact_sample(size_type index)
+{
+  return float(int((index * 37) % 2048) - 1024) / 1024.0f;
+}
+
+/// Makes interleaved frames.
+std::vector<float> make_frames(size_type channels, size_type frame_count)
+{
+  std::vector<float> frames(channels * frame_count);
+
+  for (size_type i = 0; i < frames.size(); i++) {
+    frames[i] = exact_sample(i);
+  }
+
+  return frames;
+}
+
+/// Processes frames in blocks of uneven sizes, so that the kernels
+/// are left with remainders and the ramp ends in the middle of a block.
+void process_unevenly(tinyalsa::channel_remixer& remixer, const std::vector<float>& input, std::vector<float>& output,
+                      size_type input_channels, size_type output_channels)
+{
+  const size_type block_sizes[] { 37, 3, 130, 1, 64, 250 };
+
+  auto frame_count = input.size() / input_channels;
+
+  output.assign(output_channels * frame_count, 0.0f);
+
+  size_type done = 0;
+
+  for (size_type i = 0; done < frame_count; i++) {
+
+    auto block_size = std::min(block_sizes[i % 6], frame_count - done);
+
+    remixer.process(input.data() + (done * input_channels), output.data() + (done * output_channels), block_size);
+
+    done += block_size;
+  }
+}
+
+/// Remixes three channels into two, ramping every gain, with the kernels of an instruction set.
+///
+/// @return False if the instruction set is not supported.
+bool remix_ramp(conversion_isa isa, const std::vector<float>& input, std::vector<float>& output)
+{
+  if (tinyalsa::set_conversion_isa(isa).failed()) {
+    return false;
+  }
+
+  tinyalsa::channel_remixer remixer;
+  remixer.init(3, 2);
+  remixer.set_matrix(ramp_from);
+  remixer.set_matrix(ramp_to, ramp_frames);
+
+  process_unevenly(remixer, input, output, 3, 2);
+
+  return true;
+}
+
+/// Checks ramped gains with each instruction set against the scalar kernels.
+void check_ramp()
+{
+  constexpr size_type frame_count = 1000;
+
+  auto input = make_frames(3, frame_count);
+
+  std::vector<float> reference;
+
+  remix_ramp(conversion_isa::scalar, input, reference);
+
+  // The gains are ramped linearly from one matrix to the other.
+  bool ramped = true;
+
+  // The gains land exactly on the targets, which
+  // the samples are multiplied by without rounding.
+  bool landed = true;
+
+  for (size_type f = 0; f < frame_count; f++) {
+    for (size_type o = 0; o < 2; o++) {
+
+      float expected = 0;
+
+      for (size_type i = 0; i < 3; i++) {
+        auto index = (o * 3) + i;
+        auto t = std::min(float(f) / float(ramp_frames), 1.0f);
+        auto gain = (f < ramp_frames) ? (ramp_from[index] + ((ramp_to[index] - ramp_from[index]) * t)) : ramp_to[index];
+        expected += input[(f * 3) + i] * gain;
+      }
+
+      auto actual = reference[(f * 2) + o];
+
+      if (f < ramp_frames) {
+        ramped = ramped && (std::fabs(actual - expected) <= 1e-4f);
+      } else {
+        landed = landed && (actual == expected);
+      }
+    }
+  }
+
+  check(ramped, "scalar: gains are ramped linearly");
+  check(landed, "scalar: gains land exactly on the targets at the end of the ramp");
+
+  char description[256];
+
+  for (const auto& info : vector_isas) {
+
+    std::vector<float> output;
+
+    if (!remix_ramp(info.isa, input, output)) {
+      std::printf("SKIP: %s is not supported\n", info.name);
+      continue;
+    }
+
+    float max_error = 0;
+
+    bool same_after_ramp = true;
+
+    for (size_type s = 0; s < output.size(); s++) {
+      if (s < (ramp_frames * 2)) {
+        max_error = std::max(max_error, std::fabs(output[s] - reference[s]));
+      } else {
+        same_after_ramp = same_after_ramp && (output[s] == reference[s]);
+      }
+    }
+
+    // The vector kernels step the gain instead of computing it for every
+    // frame, and may fuse the multiply and add, so they're slightly off.
+    std::snprintf(description, sizeof(description), "%s: ramped gains match the scalar kernels (max error %g)",
+                  info.name, double(max_error));
+    check(max_error <= 1e-5f, description);
+
+    std::snprintf(description, sizeof(description), "%s: gains after the ramp match the scalar kernels exactly", info.name);
+    check(same_after_ramp, description);
+  }
+
+  tinyalsa::set_conversion_isa(conversion_isa::scalar);
+}
+
+/// Checks that only the gains that are not zero are applied.
+void check_sparse(conversion_isa isa, const char* name)
+{
+  char description[256];
+
+  if (tinyalsa::set_conversion_isa(isa).failed()) {
+    return;
+  }
+
+  constexpr size_type frame_count = 200;
+
+  // The second input channel is not used, so a NaN in it doesn't spread.
+  auto input = make_frames(4, frame_count);
+
+  for (size_type f = 0; f < frame_count; f++) {
+    input[(f * 4) + 1] = from_bits(signaling_nan);
+  }
+
+  const float gains[12] {
+    0.0f,  0.0f, 0.5f, 0.0f,
+    0.0f,  0.0f, 0.0f, 0.0f,
+    0.25f, 0.0f, 0.0f, -1.0f
+  };
+
+  tinyalsa::channel_remixer remixer;
+  remixer.init(4, 3);
+  remixer.set_matrix(gains);
+
+  // The output channel without gains is still written.
+  std::vector<float> output(frame_count * 3, 123.0f);
+
+  remixer.process(input.data(), output.data(), frame_count);
+
+  bool matched = true;
+
+  for (size_type f = 0; f < frame_count; f++) {
+    const auto* in = &input[f * 4];
+    const auto* out = &output[f * 3];
+    matched = matched && (out[0] == (in[2] * 0.5f)) && (out[1] == 0.0f) && (out[2] == ((in[0] * 0.25f) - in[3]));
+  }
+
+  std::snprintf(description, sizeof(description), "%s: sparse matrix skips unused inputs and clears empty outputs", name);
+  check(matched, description);
+
+  // Ramps the first gain to zero, after which the input it refers to isn't read.
+  remixer.set_gain(0, 2, 0.0f, 100);
+
+  for (size_type f = 0; f < frame_count; f++) {
+    input[(f * 4) + 2] = from_bits(signaling_nan);
+  }
+
+  remixer.process(input.data(), output.data(), 100);
+
+  std::vector<float> after(frame_count * 3, 123.0f);
+
+  remixer.process(input.data(), after.data(), frame_count);
+
+  matched = !remixer.is_ramping();
+
+  for (size_type f = 0; f < frame_count; f++) {
+    matched = matched && (after[(f * 3) + 0] == 0.0f);
+  }
+
+  std::snprintf(description, sizeof(description), "%s: gain ramped to zero is dropped at the end of the ramp", name);
+  check(matched, description);
+}
+
+/// Checks that the identity matrix is a copy, including when it's reached
+/// in the middle of a call. Only a copy keeps a signaling NaN as it is.
+void check_identity(conversion_isa isa, const char* name)
+{
+  char description[256];
+
+  if (tinyalsa::set_conversion_isa(isa).failed()) {
+    return;
+  }
+
+  constexpr size_type frame_count = 400;
+  constexpr size_type ramp_frames = 150;
+
+  auto input = make_frames(2, frame_count);
+
+  for (size_type s = 0; s < input.size(); s += 7) {
+    input[s] = from_bits(signaling_nan);
+  }
+
+  tinyalsa::channel_remixer remixer;
+  remixer.init(2, 2);
+
+  std::vector<float> output(input.size());
+
+  remixer.process(input.data(), output.data(), frame_count);
+
+  std::snprintf(description, sizeof(description), "%s: initial matrix copies the frames", name);
+  check(std::memcmp(input.data(), output.data(), input.size() * sizeof(float)) == 0, description);
+
+  const float half[4] { 0.5f, 0.0f, 0.0f, 0.5f };
+  const float identity[4] { 1.0f, 0.0f, 0.0f, 1.0f };
+
+  remixer.set_matrix(half);
+  remixer.set_matrix(identity, ramp_frames);
+
+  remixer.process(input.data(), output.data(), frame_count);
+
+  bool quieted = true;
+
+  for (size_type s = 0; s < (ramp_frames * 2); s += 7) {
+    quieted = quieted && (bits_of(output[s]) != signaling_nan) && std::isnan(output[s]);
+  }
+
+  std::snprintf(description, sizeof(description), "%s: frames in the ramp are mixed", name);
+  check(quieted, description);
+
+  auto tail_size = (frame_count - ramp_frames) * 2 * sizeof(float);
+
+  std::snprintf(description, sizeof(description), "%s: frames after the ramp are copied", name);
+  check(!remixer.is_ramping() && (std::memcmp(&input[ramp_frames * 2], &output[ramp_frames * 2], tail_size) == 0),
+        description);
+}
+
+} // namespace
+
+int main()
+{
+  check_ramp();
+
+  check_sparse(conversion_isa::scalar, "scalar");
+  check_identity(conversion_isa::scalar, "scalar");
+
+  for (const auto& info : vector_isas) {
+    check_sparse(info.isa, info.name);
+    check_identity(info.isa, info.name);
+  }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,255 @@
+#include <tinyalsa.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+/// The frequency of the test tone, in hertz.
+constexpr double tone_frequency = 997;
+
+/// The amplitude of the test tone.
+constexpr double tone_amplitude = 0.5;
+
+/// The number of seconds of audio to convert.
+constexpr std::size_t seconds = 10;
+
+/// The ratio of a circle's circumference to its diameter.
+constexpr double pi = 3.14159265358979323846;
+
+/// Generates a sine tone on every channel.
+std::vector<float> make_tone(std::size_t channels, std::size_t rate, double frequency)
+{
+  std::vector<float> frames(seconds * rate * channels);
+
+  for (std::size_t i = 0; i < (seconds * rate); i++) {
+    auto sample = float(tone_amplitude * std::sin((2 * pi * frequency * double(i)) / double(rate)));
+    for (std::size_t c = 0; c < channels; c++) {
+      frames[(i * channels) + c] = sample;
+    }
+  }
+
+  return frames;
+}
+
+/// Fits a sine of a frequency to the first channel, leaving
+/// out the frames at either end that the filter delay affects.
+///
+/// @param signal Receives the mean power of the fitted sine.
+///
+/// @return The mean power of what's left once the sine is removed.
+double fit_tone(const std::vector<float>& frames, std::size_t channels, std::size_t rate,
+                std::size_t skip, double frequency, double& signal)
+{
+  auto count = (frames.size() / channels) - (2 * skip);
+
+  auto w = (2 * pi * frequency) / double(rate);
+
+  double ss = 0, sc = 0, cc = 0, xs = 0, xc = 0;
+
+  for (std::size_t i = skip; i < (skip + count); i++) {
+    auto s = std::sin(w * double(i));
+    auto c = std::cos(w * double(i));
+    auto x = double(frames[i * channels]);
+    ss += s * s;
+    sc += s * c;
+    cc += c * c;
+    xs += x * s;
+    xc += x * c;
+  }
+
+  auto det = (ss * cc) - (sc * sc);
+  auto a = ((xs * cc) - (xc * sc)) / det;
+  auto b = ((xc * ss) - (xs * sc)) / det;
+
+  double residual = 0;
+
+  signal = 0;
+
+  for (std::size_t i = skip; i < (skip + count); i++) {
+    auto fit = (a * std::sin(w * double(i))) + (b * std::cos(w * double(i)));
+    auto error = double(frames[i * channels]) - fit;
+    signal += fit * fit;
+    residual += error * error;
+  }
+
+  signal /= double(count);
+
+  return residual / double(count);
+}
+
+/// Measures the THD+N of the first channel, by fitting a sine
+/// of the tone frequency to the output and measuring what's left.
+///
+/// @return The THD+N, in dB relative to the tone.
+double measure_thd_n(const std::vector<float>& frames, std::size_t channels, std::size_t rate, std::size_t skip)
+{
+  double signal = 0;
+
+  auto residual = fit_tone(frames, channels, rate, skip, tone_frequency, signal);
+
+  return 10 * std::log10(residual / signal);
+}
+
+/// Gets the frequency of the tone that alias rejection is measured with.
+///
+/// When downsampling, the tone is just above the Nyquist frequency
+/// of the output, so anything that comes out of it is an alias. When
+/// upsampling, it's just below the Nyquist frequency of the input,
+/// so that its image lands just below that of the output.
+double to_alias_frequency(std::size_t input_rate, std::size_t output_rate)
+{
+  if (output_rate < input_rate) {
+    return 0.5 * double(output_rate) * 1.05;
+  }
+
+  return 0.5 * double(input_rate) * 0.95;
+}
+
+/// Measures how far the aliases or images of a tone near the
+/// cutoff are below the tone, on the first channel.
+///
+/// @return The rejection, in dB relative to the input tone.
+double measure_rejection(const std::vector<float>& frames, std::size_t channels, std::size_t rate,
+                         std::size_t skip, double frequency)
+{
+  double power = 0;
+
+  if (frequency < (0.5 * double(rate))) {
+    // The tone passes, so only what's left of the fit is unwanted.
+    double signal = 0;
+    power = fit_tone(frames, channels, rate, skip, frequency, signal);
+  } else {
+    // The tone can't be represented, so everything that comes out is an alias.
+    auto count = (frames.size() / channels) - (2 * skip);
+    for (std::size_t i = skip; i < (skip + count); i++) {
+      power += double(frames[i * channels]) * double(frames[i * channels]);
+    }
+    power /= double(count);
+  }
+
+  return -10 * std::log10(power / (0.5 * tone_amplitude * tone_amplitude));
+}
+
+/// The limits that a quality preset must meet.
+struct quality_entry final
+{
+  tinyalsa::resampler_quality quality;
+  const char* name;
+  /// The highest THD+N allowed, in dB.
+  double max_thd_n;
+  /// The lowest alias rejection allowed, in dB.
+  double min_rejection;
+};
+
+const quality_entry qualities[] {
+  { tinyalsa::resampler_quality::low,    "low",    -65.0, 30.0 },
+  { tinyalsa::resampler_quality::medium, "medium", -85.0, 55.0 },
+  { tinyalsa::resampler_quality::high,   "high",  -110.0, 90.0 }
+};
+
+/// The output of one conversion.
+struct conversion final
+{
+  std::vector<float> frames;
+  /// The number of output frames affected by the filter delay.
+  std::size_t skip = 0;
+  /// The number of input frames converted per second.
+  double speed = 0;
+};
+
+/// Converts frames from one rate to another.
+///
+/// @return True on success, false on failure.
+bool convert(const std::vector<float>& input, std::size_t channels, std::size_t input_rate,
+             std::size_t output_rate, tinyalsa::resampler_quality quality, conversion& out)
+{
+  tinyalsa::resampler converter;
+
+  auto init_result = converter.init(channels, input_rate, output_rate, quality);
+  if (init_result.failed()) {
+    std::printf("Failed to initialize resampler: %s\n", init_result.error_description());
+    return false;
+  }
+
+  out.frames.resize(((seconds * output_rate) + 1024) * channels);
+
+  auto start = std::chrono::steady_clock::now();
+
+  auto counts = converter.process(input.data(), input.size() / channels, out.frames.data(), out.frames.size() / channels);
+
+  auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  out.frames.resize(counts.frames_written * channels);
+
+  out.skip = std::size_t(double(converter.get_latency()) * converter.get_ratio()) + 1;
+
+  out.speed = double(counts.frames_read) / elapsed;
+
+  return true;
+}
+
+} // namespace
+
+int main()
+{
+  const std::size_t rates[][2] {
+    { 48000, 44100 },
+    { 44100, 48000 },
+    { 48000, 16000 }
+  };
+
+  const std::size_t channels = 2;
+
+  int failures = 0;
+
+  std::printf("%-8s %-14s %10s %10s %16s\n", "quality", "rates", "THD+N", "alias", "frames/s");
+
+  for (const auto& rate : rates) {
+
+    auto tone = make_tone(channels, rate[0], tone_frequency);
+
+    auto alias_frequency = to_alias_frequency(rate[0], rate[1]);
+
+    auto alias_tone = make_tone(channels, rate[0], alias_frequency);
+
+    for (const auto& q : qualities) {
+
+      conversion tone_output;
+      conversion alias_output;
+
+      if (!convert(tone, channels, rate[0], rate[1], q.quality, tone_output)
+       || !convert(alias_tone, channels, rate[0], rate[1], q.quality, alias_output)) {
+        return EXIT_FAILURE;
+      }
+
+      auto thd_n = measure_thd_n(tone_output.frames, channels, rate[1], tone_output.skip);
+
+      auto rejection = measure_rejection(alias_output.frames, channels, rate[1], alias_output.skip, alias_frequency);
+
+      auto passed = (thd_n <= q.max_thd_n) && (rejection >= q.min_rejection);
+
+      std::printf("%-8s %6zu->%-6zu %7.1f dB %7.1f dB %16.0f %s\n",
+                  q.name,
+                  rate[0],
+                  rate[1],
+                  thd_n,
+                  rejection,
+                  tone_output.speed,
+                  passed ? "PASS" : "FAIL");
+
+      if (!passed) {
+        failures++;
+      }
+    }
+  }
+
+  if (failures) {
+    std::printf("%d conversions missed the limits of their quality.\n", failures);
+  }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+#include <tinyalsa.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// The number of periods read in each run.
+constexpr int period_total = 8;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// Indicates whether or not a file descriptor is readable.
+bool is_readable(int fd)
+{
+  pollfd pfd { fd, POLLIN, 0 };
+
+  return (::poll(&pfd, 1, 0) == 1) && (pfd.revents & POLLIN);
+}
+
+/// Gets the size of a file, or -1 if it can't be found.
+long file_size(const char* path)
+{
+  struct stat st;
+
+  return (::stat(path, &st) == 0) ? long(st.st_size) : -1;
+}
+
+/// Captures a few periods from the first device.
+///
+/// @param readable Counts the periods for which the file
+/// descriptor was readable right before the read.
+///
+/// @return True on success, false on failure.
+bool capture(int& readable)
+{
+  tinyalsa::pcm_config config;
+  config.rate = 48000;
+  config.period_size = 256;
+  config.period_count = 4;
+
+  tinyalsa::interleaved_pcm_reader reader;
+
+  if (reader.open(0, 0, true).failed()
+   || reader.setup(config).failed()
+   || reader.prepare().failed()
+   || reader.start().failed()) {
+    return false;
+  }
+
+  unsigned char frames[256 * 2 * 2];
+
+  readable = 0;
+
+  for (int i = 0; i < period_total; i++) {
+
+    readable += is_readable(reader.get_file_descriptor()) ? 1 : 0;
+
+    auto read_result = reader.read_unformatted(frames, 256);
+    if (read_result.failed() || (read_result.value != 256)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Set once the calling thread should stop.
+std::atomic<bool> done { false };
+
+/// Calls into the backend until told to stop.
+void* call_backend(void*)
+{
+  while (!done.load()) {
+    tinyalsa::get_backend().poll(nullptr, 0, 0);
+  }
+
+  return nullptr;
+}
+
+} // namespace
+
+int main()
+{
+  char path[] = "/tmp/trace_check.XXXXXX";
+
+  auto fd = ::mkstemp(path);
+  if (fd < 0) {
+    std::printf("Failed to create a trace file.\n");
+    return EXIT_FAILURE;
+  }
+
+  ::close(fd);
+
+  // The fake hardware keeps up instantly, so that
+  // the recording and the replay take the same path.
+  tinyalsa::fake_pcm_config fake_config;
+  fake_config.speed = 0;
+  tinyalsa::set_fake_pcm_config(fake_config);
+  tinyalsa::set_backend(tinyalsa::get_fake_backend());
+
+  int readable = 0;
+
+  if (tinyalsa::start_pcm_trace(path).failed()
+   || !capture(readable)
+   || tinyalsa::stop_pcm_trace().failed()) {
+    std::printf("Failed to record the trace.\n");
+    return EXIT_FAILURE;
+  }
+
+  if (tinyalsa::open_pcm_replay(path).failed()) {
+    std::printf("Failed to open the trace.\n");
+    return EXIT_FAILURE;
+  }
+
+  tinyalsa::set_backend(tinyalsa::get_replay_backend());
+
+  check(capture(readable), "trace replays");
+
+  check(readable == period_total, "replayed device is readable before each transfer");
+
+  tinyalsa::close_pcm_replay();
+
+  tinyalsa::set_backend(tinyalsa::get_fake_backend());
+
+  // Stopping a trace waits for the calls in progress,
+  // after which nothing is written to the file.
+  if (tinyalsa::start_pcm_trace(path).failed()) {
+    std::printf("Failed to start the trace.\n");
+    return EXIT_FAILURE;
+  }
+
+  pthread_t thread;
+
+  if (pthread_create(&thread, nullptr, call_backend, nullptr) != 0) {
+    std::printf("Failed to start a thread.\n");
+    return EXIT_FAILURE;
+  }
+
+  ::usleep(10000);
+
+  auto stopped = tinyalsa::stop_pcm_trace();
+
+  auto stopped_size = file_size(path);
+
+  ::usleep(10000);
+
+  done.store(true);
+
+  pthread_join(thread, nullptr);
+
+  check(!stopped.failed() && (stopped_size > 0) && (file_size(path) == stopped_size),
+        "trace is not written after it is stopped");
+
+  check(&tinyalsa::get_backend() == &tinyalsa::get_fake_backend(), "stopping a trace restores the backend");
+
+  ::unlink(path);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,242 @@
+#include <tinyalsa.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+
+#include <unistd.h>
+
+namespace {
+
+/// The number of checks that failed.
+int failures = 0;
+
+/// The number of frames in one period.
+constexpr tinyalsa::size_type period_size = 256;
+
+/// The number of periods in the buffer.
+constexpr tinyalsa::size_type period_count = 4;
+
+/// Reports the outcome of one check.
+void check(bool passed, const char* description)
+{
+  std::printf("%s: %s\n", passed ? "PASS" : "FAIL", description);
+
+  if (!passed) {
+    failures++;
+  }
+}
+
+/// Makes the fake devices opened from now on inject
+/// an xrun every time a number of frames is transferred.
+///
+/// @param speed How many times faster than real time the devices run.
+void inject_xruns(tinyalsa::size_type interval, double speed = 0)
+{
+  tinyalsa::fake_pcm_config config;
+  config.speed = speed;
+  config.xrun_interval = interval;
+  tinyalsa::set_fake_pcm_config(config);
+}
+
+/// Gets the configuration that every PCM is set up with.
+tinyalsa::pcm_config make_config()
+{
+  tinyalsa::pcm_config config;
+  config.rate = 48000;
+  config.period_size = period_size;
+  config.period_count = period_count;
+  return config;
+}
+
+/// Checks that PCMs report xruns to the caller by default.
+void check_report()
+{
+  inject_xruns(period_size);
+
+  tinyalsa::interleaved_pcm_reader reader;
+
+  check(reader.get_xrun_policy() == tinyalsa::xrun_policy::report, "xruns are reported by default");
+
+  if (reader.open(0, 0, true).failed() || reader.setup(make_config()).failed() || reader.prepare().failed()) {
+    check(false, "report: capture PCM is set up");
+    return;
+  }
+
+  unsigned char frames[period_size * 4];
+
+  auto first = reader.read_unformatted(frames, period_size);
+  auto second = reader.read_unformatted(frames, period_size);
+
+  auto counters = reader.get_xrun_counters();
+
+  check(!first.failed() && (second.error == EPIPE), "report: overrun is returned to the caller");
+  check((counters.overruns == 1) && (counters.recoveries == 0), "report: overrun is counted but not recovered");
+
+  auto recovered = reader.recover(second.error);
+
+  counters = reader.get_xrun_counters();
+
+  check(!recovered.failed() && (counters.recoveries == 1) && (counters.failed_recoveries == 0),
+        "report: recover counts the recovery");
+  check(counters.frames_lost > 0, "report: frames discarded by the recovery are counted as lost");
+
+  auto third = reader.read_unformatted(frames, period_size);
+  check(!third.failed() && (third.value == period_size), "report: capture continues after recovery");
+
+  reader.reset_xrun_counters();
+
+  counters = reader.get_xrun_counters();
+
+  check((counters.overruns == 0) && (counters.recoveries == 0) && (counters.frames_lost == 0),
+        "report: counters are reset");
+}
+
+/// Checks that write_all recovers from underruns
+/// and writes every frame, even though they're reported.
+void check_write_all()
+{
+  constexpr tinyalsa::size_type frame_count = 1000;
+
+  // Not a multiple of the period size, so that
+  // underruns interrupt the writes partway through.
+  inject_xruns(300);
+
+  tinyalsa::interleaved_pcm_writer writer;
+
+  if (writer.open(0, 0, true).failed() || writer.setup(make_config()).failed() || writer.prepare().failed()) {
+    check(false, "write all: playback PCM is set up");
+    return;
+  }
+
+  static unsigned char frames[frame_count * 4] {};
+
+  auto write_result = writer.write_all(frames, frame_count);
+
+  auto counters = writer.get_xrun_counters();
+
+  check(!write_result.failed() && (write_result.value == frame_count), "write all: every frame is written across underruns");
+  check((counters.underruns > 0) && (counters.recoveries == counters.underruns) && (counters.failed_recoveries == 0),
+        "write all: every underrun is counted and recovered");
+}
+
+/// Checks that overruns are recovered from during reads.
+void check_prepare()
+{
+  constexpr tinyalsa::size_type xrun_total = 4;
+
+  inject_xruns(period_size);
+
+  tinyalsa::interleaved_pcm_reader reader;
+
+  reader.set_xrun_policy(tinyalsa::xrun_policy::prepare);
+
+  if (reader.open(0, 0, true).failed() || reader.setup(make_config()).failed() || reader.prepare().failed()) {
+    check(false, "prepare: capture PCM is set up");
+    return;
+  }
+
+  unsigned char frames[period_size * 4];
+
+  bool all_read = true;
+
+  for (tinyalsa::size_type i = 0; i <= xrun_total; i++) {
+    auto read_result = reader.read_unformatted(frames, period_size);
+    all_read = all_read && !read_result.failed() && (read_result.value == period_size);
+  }
+
+  auto counters = reader.get_xrun_counters();
+
+  check(all_read, "prepare: reads continue across overruns");
+  check((counters.overruns == xrun_total) && (counters.recoveries == xrun_total) && (counters.failed_recoveries == 0),
+        "prepare: every overrun is counted and recovered");
+  check((counters.underruns == 0) && (counters.suspends == 0), "prepare: no other xrun is counted");
+}
+
+/// Checks that playback starts again right away
+/// after an underrun, when the buffer is prefilled.
+void check_prefill()
+{
+  inject_xruns(period_size * period_count * 2);
+
+  tinyalsa::interleaved_pcm_writer writer;
+
+  writer.set_xrun_policy(tinyalsa::xrun_policy::prefill_silence);
+
+  if (writer.open(0, 0, true).failed() || writer.setup(make_config()).failed() || writer.prepare().failed()) {
+    check(false, "prefill: playback PCM is set up");
+    return;
+  }
+
+  unsigned char frames[period_size * 4] {};
+
+  bool all_written = true;
+
+  for (int i = 0; i < 12; i++) {
+    auto write_result = writer.write_unformatted(frames, period_size);
+    all_written = all_written && !write_result.failed();
+  }
+
+  auto counters = writer.get_xrun_counters();
+
+  check(all_written, "prefill: writes continue across underruns");
+  check((counters.underruns > 0) && (counters.recoveries == counters.underruns) && (counters.failed_recoveries == 0),
+        "prefill: every underrun is counted and recovered");
+
+  auto status = writer.get_status();
+  check(!status.failed() && (status.unwrap().state == tinyalsa::pcm_state::running), "prefill: playback is running");
+}
+
+/// Checks that a memory mapped PCM is started
+/// again after being prefilled with silence.
+void check_mmap_prefill()
+{
+  // Real time, so that the buffer underruns by itself.
+  inject_xruns(0, 1.0);
+
+  tinyalsa::mmap_pcm_writer writer;
+
+  writer.set_xrun_policy(tinyalsa::xrun_policy::prefill_silence);
+
+  if (writer.open(0, 0, true).failed() || writer.setup(make_config()).failed() || writer.prepare().failed()) {
+    check(false, "mmap prefill: playback PCM is set up");
+    return;
+  }
+
+  auto region = writer.begin(period_size * period_count);
+  if (region.failed() || writer.commit(region.unwrap().frame_count).failed() || writer.start().failed()) {
+    check(false, "mmap prefill: playback PCM is started");
+    return;
+  }
+
+  // The buffer lasts about 21 milliseconds.
+  ::usleep(100000);
+
+  auto available = writer.available();
+
+  auto counters = writer.get_xrun_counters();
+
+  check(!available.failed() && (counters.underruns == 1) && (counters.recoveries == 1),
+        "mmap prefill: underrun is counted and recovered");
+
+  auto status = writer.get_status();
+  check(!status.failed() && (status.unwrap().state == tinyalsa::pcm_state::running),
+        "mmap prefill: playback is started again");
+  check(!status.failed() && (status.unwrap().appl_ptr >= (period_size * period_count / 2)),
+        "mmap prefill: silence is handed to the device");
+}
+
+} // namespace
+
+int main()
+{
+  tinyalsa::set_backend(tinyalsa::get_fake_backend());
+
+  check_report();
+  check_write_all();
+  check_prepare();
+  check_prefill();
+  check_mmap_prefill();
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,18 +1,36 @@
 #include <tinyalsa.hpp>
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
 #include <new>
 #include <type_traits>
 
-#include <dirent.h>
+#include <alloca.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
 #include <sound/asound.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
+#include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace tinyalsa {
 
 //================//
@@ -64,6 +82,19 @@ struct mask_ref final
     mask.bits[1] = 0;
     mask.bits[value >> 5] |= (1 << (value & 31));
   }
+  /// Indicates whether or not a value is set in a mask.
+  ///
+  /// @param hw_params The hardware parameters containing the mask.
+  /// @param value The value to check for.
+  ///
+  /// @return True if the value is set, false if it is not.
+  static constexpr bool test(const snd_pcm_hw_params& hw_params, value_type value) noexcept
+  {
+    static_assert(!out_of_range(), "Not a mask parameter.");
+
+    const auto& mask = hw_params.masks[param - SNDRV_PCM_HW_PARAM_FIRST_MASK];
+    return (mask.bits[value >> 5] & (1u << (value & 31))) != 0;
+  }
 };
 
 /// Used for initializing all the masks in a hardware parameter structure.
@@ -140,6 +171,40 @@ struct interval_ref final
 
     ref.max = std::numeric_limits<value_type>::max();
   }
+  /// Restricts the interval to a range of values.
+  ///
+  /// @param hw_params The hardware parameters that the interval resides in.
+  /// @param min The smallest value of the range.
+  /// @param max The largest value of the range.
+  static constexpr void set_range(snd_pcm_hw_params& hw_params, value_type min, value_type max) noexcept
+  {
+    static_assert(!out_of_range(), "Not an interval parameter.");
+
+    auto& ref = hw_params.intervals[name - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL];
+    ref.min = min;
+    ref.max = max;
+    ref.openmin = 0;
+    ref.openmax = 0;
+    ref.integer = 1;
+  }
+  /// Gets the smallest value of the interval.
+  /// Open interval bounds are taken into account.
+  static constexpr value_type get_min(const snd_pcm_hw_params& hw_params) noexcept
+  {
+    static_assert(!out_of_range(), "Not an interval parameter.");
+
+    const auto& ref = hw_params.intervals[name - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL];
+    return ref.openmin ? (ref.min + 1) : ref.min;
+  }
+  /// Gets the largest value of the interval.
+  /// Open interval bounds are taken into account.
+  static constexpr value_type get_max(const snd_pcm_hw_params& hw_params) noexcept
+  {
+    static_assert(!out_of_range(), "Not an interval parameter.");
+
+    const auto& ref = hw_params.intervals[name - SNDRV_PCM_HW_PARAM_FIRST_INTERVAL];
+    return ref.openmax ? (ref.max - 1) : ref.max;
+  }
 };
 
 /// This is used to initialize all the interval
@@ -252,12 +317,72 @@ tinyalsa::pcm_info to_tinyalsa_info(const snd_pcm_info& native_info) noexcept
   memcpy(out.name,    native_info.name,    std::min(sizeof(out.name),    sizeof(native_info.name)));
   memcpy(out.subname, native_info.subname, std::min(sizeof(out.subname), sizeof(native_info.subname)));
 
+  out.is_capture = (native_info.stream == SNDRV_PCM_STREAM_CAPTURE);
+
   out.class_   = to_tinyalsa_class(native_info.dev_class);
   out.subclass = to_tinyalsa_subclass(native_info.dev_subclass);
 
   return out;
 }
 
+/// Converts a native PCM state to a TinyALSA state.
+///
+/// @param native_state The state reported by the driver.
+pcm_state to_tinyalsa_state(snd_pcm_state_t native_state) noexcept
+{
+  switch (native_state) {
+    case SNDRV_PCM_STATE_OPEN:
+      return pcm_state::open;
+    case SNDRV_PCM_STATE_SETUP:
+      return pcm_state::setup;
+    case SNDRV_PCM_STATE_PREPARED:
+      return pcm_state::prepared;
+    case SNDRV_PCM_STATE_RUNNING:
+      return pcm_state::running;
+    case SNDRV_PCM_STATE_XRUN:
+      return pcm_state::xrun;
+    case SNDRV_PCM_STATE_DRAINING:
+      return pcm_state::draining;
+    case SNDRV_PCM_STATE_PAUSED:
+      return pcm_state::paused;
+    case SNDRV_PCM_STATE_SUSPENDED:
+      return pcm_state::suspended;
+    case SNDRV_PCM_STATE_DISCONNECTED:
+      return pcm_state::disconnected;
+  }
+
+  return pcm_state::disconnected;
+}
+
+/// Converts a timespec into nanoseconds.
+///
+/// @tparam timespec_type Either a timespec or one
+/// of the timespec types used by the driver.
+template <typename timespec_type>
+constexpr std::int64_t to_nanoseconds(const timespec_type& ts) noexcept
+{
+  return (std::int64_t(ts.tv_sec) * 1000000000) + std::int64_t(ts.tv_nsec);
+}
+
+tinyalsa::pcm_status to_tinyalsa_status(const snd_pcm_status& native_status, bool is_capture) noexcept
+{
+  tinyalsa::pcm_status out;
+
+  out.state             = to_tinyalsa_state(native_status.state);
+  out.is_capture        = is_capture;
+  out.hw_ptr            = native_status.hw_ptr;
+  out.appl_ptr          = native_status.appl_ptr;
+  out.avail             = native_status.avail;
+  out.avail_max         = native_status.avail_max;
+  out.delay             = native_status.delay;
+  out.trigger_timestamp = to_nanoseconds(native_status.trigger_tstamp);
+  out.timestamp         = to_nanoseconds(native_status.tstamp);
+  out.audio_timestamp   = to_nanoseconds(native_status.audio_tstamp);
+  out.driver_timestamp  = to_nanoseconds(native_status.driver_tstamp);
+
+  return out;
+}
+
 } // namespace
 
 //==================================//
@@ -355,6 +480,60 @@ constexpr int to_alsa_format(sample_format sf) noexcept
   return 0;
 }
 
+/// Gets the number of bits that a sample
+/// occupies in a frame, including any padding.
+constexpr size_type to_physical_bits(sample_format sf) noexcept
+{
+  switch (sf) {
+    case sample_format::s8:
+    case sample_format::u8:
+      return 8;
+
+    case sample_format::s16_le:
+    case sample_format::s16_be:
+    case sample_format::u16_le:
+    case sample_format::u16_be:
+      return 16;
+
+    case sample_format::s18_3le:
+    case sample_format::s18_3be:
+    case sample_format::s20_3le:
+    case sample_format::s20_3be:
+    case sample_format::s24_3le:
+    case sample_format::s24_3be:
+    case sample_format::u18_3le:
+    case sample_format::u18_3be:
+    case sample_format::u20_3le:
+    case sample_format::u20_3be:
+    case sample_format::u24_3le:
+    case sample_format::u24_3be:
+      return 24;
+
+    case sample_format::s24_le:
+    case sample_format::s24_be:
+    case sample_format::s32_le:
+    case sample_format::s32_be:
+    case sample_format::u24_le:
+    case sample_format::u24_be:
+    case sample_format::u32_le:
+    case sample_format::u32_be:
+      return 32;
+  }
+
+  /* unreachable */
+
+  return 0;
+}
+
+/// Gets the number of bytes in one frame.
+///
+/// @param config The configuration containing
+/// the sample format and channel count.
+constexpr size_type to_frame_size(const pcm_config& config) noexcept
+{
+  return (to_physical_bits(config.format) / 8) * config.channels;
+}
+
 /// Converts a sample access pattern
 /// to one that's recognized by the ALSA drivers.
 constexpr int to_alsa_access(sample_access access) noexcept
@@ -396,6 +575,36 @@ constexpr snd_pcm_hw_params to_alsa_hw_params(const pcm_config& config, sample_a
   return params;
 }
 
+/// Converts a timestamp type to the value recognized by the driver.
+constexpr int to_alsa_timestamp_type(pcm_timestamp_type type) noexcept
+{
+  switch (type) {
+    case pcm_timestamp_type::gettimeofday:
+      return SNDRV_PCM_TSTAMP_TYPE_GETTIMEOFDAY;
+    case pcm_timestamp_type::monotonic:
+      return SNDRV_PCM_TSTAMP_TYPE_MONOTONIC;
+    case pcm_timestamp_type::monotonic_raw:
+      return SNDRV_PCM_TSTAMP_TYPE_MONOTONIC_RAW;
+  }
+
+  return SNDRV_PCM_TSTAMP_TYPE_MONOTONIC_RAW;
+}
+
+/// Converts a timestamp type to the matching clock.
+constexpr clockid_t to_clock_id(pcm_timestamp_type type) noexcept
+{
+  switch (type) {
+    case pcm_timestamp_type::gettimeofday:
+      return CLOCK_REALTIME;
+    case pcm_timestamp_type::monotonic:
+      return CLOCK_MONOTONIC;
+    case pcm_timestamp_type::monotonic_raw:
+      return CLOCK_MONOTONIC_RAW;
+  }
+
+  return CLOCK_MONOTONIC_RAW;
+}
+
 /// Converts a PCM configuration into the relevant software parameters.
 ///
 /// @param config The PCM configuration to be converted.
@@ -428,11 +637,31 @@ constexpr snd_pcm_sw_params to_alsa_sw_params(const pcm_config& config, bool is_
   params.silence_size = 0;
   params.silence_threshold = config.silence_threshold;
 
+  if (config.timestamp_mode == pcm_timestamp_mode::enabled) {
+    params.tstamp_mode = SNDRV_PCM_TSTAMP_ENABLE;
+  } else {
+    params.tstamp_mode = SNDRV_PCM_TSTAMP_NONE;
+  }
+
+  // The driver ignores the timestamp type unless
+  // the protocol version is at least 2.0.12.
+  params.proto = SNDRV_PCM_VERSION;
+  params.tstamp_type = to_alsa_timestamp_type(config.timestamp_type);
+
   return params;
 }
 
 } // namespace
 
+std::int64_t get_timestamp(pcm_timestamp_type type) noexcept
+{
+  timespec ts {};
+
+  clock_gettime(to_clock_id(type), &ts);
+
+  return to_nanoseconds(ts);
+}
+
 const char* get_error_description(int error) noexcept
 {
   if (error == 0) {
@@ -442,521 +671,10220 @@ const char* get_error_description(int error) noexcept
   }
 }
 
-//=====================//
-// Section: POD Buffer //
-//=====================//
+//============================//
+// Section: Sample Conversion //
+//============================//
 
-/// A simple buffer for POD type data.
-///
-/// TODO : Check the impact of multiple instantiations
-/// on overall binary size.
-///
-/// @tparam element_type The type of the element
-/// stored in the buffer.
-template <typename element_type>
-struct pod_buffer final
+namespace {
+
+/// Describes how a sample is laid out in memory.
+struct sample_layout final
 {
-  /// The array of elements.
-  element_type* data = nullptr;
-  /// The number of elements in the buffer.
-  size_type size = 0;
-  /// Constructs an empty buffer.
-  constexpr pod_buffer() noexcept : data(nullptr), size(0) {}
-  /// Moves a buffer from one variable to another.
-  ///
-  /// @param other The variable to be moved.
-  inline constexpr pod_buffer(pod_buffer&& other) noexcept
-    : data(other.data),
-      size(other.size)
-  {
-    other.data = nullptr;
-    other.size = 0;
-  }
-  /// Releases memory allocated by the buffer.
-  ~pod_buffer()
+  /// The number of significant bits in the sample.
+  unsigned int bits = 16;
+  /// The number of bytes that the sample occupies.
+  unsigned int container = 2;
+  /// Whether or not the sample is signed.
+  bool is_signed = true;
+  /// Whether or not the sample is stored most significant byte first.
+  bool big_endian = false;
+  /// The number of bits between the most significant
+  /// bit of a left-justified sample and the least
+  /// significant bit of the sample.
+  constexpr unsigned int shift() const noexcept
   {
-    std::free(data);
-    data = nullptr;
-    size = 0;
+    return 32 - bits;
   }
-  /// Adds an element to the end of the buffer.
-  ///
-  /// @param e The element to add to the end of the buffer.
-  ///
-  /// @return True on success, false on failure.
-  bool emplace_back(element_type&& e) noexcept
+  /// The value that's exclusive or'd with a left-justified
+  /// sample to convert between signed and unsigned.
+  constexpr std::uint32_t sign_flip() const noexcept
   {
-    auto* tmp = (element_type*) std::realloc(data, (size + 1) * sizeof(element_type));
-    if (!tmp) {
-      return false;
-    }
-    data = tmp;
-    size++;
-    data[size - 1] = std::move(e);
-    return true;
+    return is_signed ? 0 : 0x80000000u;
   }
 };
 
-//=============================//
-// Section: Interleaved Reader //
-//=============================//
-
-result interleaved_pcm_reader::open(size_type card, size_type device, bool non_blocking) noexcept
-{
-  return pcm::open_capture_device(card, device, non_blocking);
-}
-
-generic_result<size_type> interleaved_pcm_reader::read_unformatted(void* frames, size_type frame_count) noexcept
+/// Gets the memory layout of a sample format.
+constexpr sample_layout to_layout(sample_format sf) noexcept
 {
-  snd_xferi transfer {
-    0 /* result */,
-    frames,
-    snd_pcm_uframes_t(frame_count),
-  };
-
-  auto err = ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_READI_FRAMES, &transfer);
-  if (err < 0) {
-    return { errno, 0 };
+  switch (sf) {
+    case sample_format::s8:      return sample_layout { 8, 1, true, false };
+    case sample_format::s16_le:  return sample_layout { 16, 2, true, false };
+    case sample_format::s16_be:  return sample_layout { 16, 2, true, true };
+    case sample_format::s18_3le: return sample_layout { 18, 3, true, false };
+    case sample_format::s18_3be: return sample_layout { 18, 3, true, true };
+    case sample_format::s20_3le: return sample_layout { 20, 3, true, false };
+    case sample_format::s20_3be: return sample_layout { 20, 3, true, true };
+    case sample_format::s24_3le: return sample_layout { 24, 3, true, false };
+    case sample_format::s24_3be: return sample_layout { 24, 3, true, true };
+    case sample_format::s24_le:  return sample_layout { 24, 4, true, false };
+    case sample_format::s24_be:  return sample_layout { 24, 4, true, true };
+    case sample_format::s32_le:  return sample_layout { 32, 4, true, false };
+    case sample_format::s32_be:  return sample_layout { 32, 4, true, true };
+    case sample_format::u8:      return sample_layout { 8, 1, false, false };
+    case sample_format::u16_le:  return sample_layout { 16, 2, false, false };
+    case sample_format::u16_be:  return sample_layout { 16, 2, false, true };
+    case sample_format::u18_3le: return sample_layout { 18, 3, false, false };
+    case sample_format::u18_3be: return sample_layout { 18, 3, false, true };
+    case sample_format::u20_3le: return sample_layout { 20, 3, false, false };
+    case sample_format::u20_3be: return sample_layout { 20, 3, false, true };
+    case sample_format::u24_3le: return sample_layout { 24, 3, false, false };
+    case sample_format::u24_3be: return sample_layout { 24, 3, false, true };
+    case sample_format::u24_le:  return sample_layout { 24, 4, false, false };
+    case sample_format::u24_be:  return sample_layout { 24, 4, false, true };
+    case sample_format::u32_le:  return sample_layout { 32, 4, false, false };
+    case sample_format::u32_be:  return sample_layout { 32, 4, false, true };
   }
 
-  return { 0, size_type(transfer.result) };
+  /* unreachable */
+
+  return sample_layout();
 }
 
-//==============//
-// Section: PCM //
-//==============//
+/// The scale used to convert left-justified
+/// integer samples to floating point samples.
+constexpr float int32_to_float_scale = 1.0f / 2147483648.0f;
 
-/// Contains all the implementation data for a PCM.
-class pcm_impl final
-{
-  friend pcm;
-  /// The file descriptor for the opened PCM.
-  int fd = invalid_fd();
-  /// Opens a PCM by a specified path.
-  ///
-  /// @param path The path of the PCM to open.
-  ///
-  /// @param non_blocking Whether or not the call to ::open
-  /// should block if the device is not available.
-  ///
-  /// @return On success, zero is returned.
-  /// On failure, a copy of errno is returned.
-  result open_by_path(const char* path, bool non_blocking) noexcept;
-};
+/// The scale used to convert floating point
+/// samples to left-justified integer samples.
+constexpr float float_to_int32_scale = 2147483648.0f;
 
-namespace {
+/// The number of samples converted at a time
+/// when a conversion requires an intermediate buffer.
+constexpr size_type conversion_block_size = 256;
 
-/// This function allocates an instance
-/// of the implementation data, if it is not null.
+/// Generates the next value of a dither noise generator.
 ///
-/// @param impl The current pointer to the implementation data.
-/// If this is null then a new one is allocated.
+/// @param state The state of the generator.
 ///
-/// @return A pointer to either an existing implementation
-/// data instance, a new implementation data instance, or
-/// in the case of a memory allocation failure a null pointer.
-pcm_impl* lazy_init(pcm_impl* impl) noexcept
+/// @return A uniformly distributed pseudo-random number.
+inline std::uint32_t next_dither_value(std::uint32_t& state) noexcept
 {
-  if (impl) {
-    return impl;
-  }
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
 
-  return new (std::nothrow) pcm_impl();
+/// Generates TPDF noise with a peak amplitude
+/// of one least significant bit of the destination format.
+///
+/// @param d The dither state to generate the noise with.
+/// @param shift The number of bits the sample is going to be shifted by.
+inline std::int32_t tpdf_noise(dither& d, unsigned int shift) noexcept
+{
+  auto a = next_dither_value(d.state) >> (32 - shift);
+  auto b = next_dither_value(d.state) >> (32 - shift);
+  return std::int32_t(a) - std::int32_t(b);
 }
 
-} // namespace
+/// Rounds a left-justified sample so that it may be shifted
+/// right without truncation. Saturates instead of overflowing.
+///
+/// @param value The sample to round.
+/// @param shift The number of bits that will be dropped.
+/// @param noise Dither noise to add to the sample, if any.
+inline std::int32_t round_sample(std::int32_t value, unsigned int shift, std::int32_t noise = 0) noexcept
+{
+  if (!shift) {
+    return value;
+  }
 
-pcm::pcm() noexcept : self(nullptr) { }
+  auto rounded = std::int64_t(value) + noise + (std::int64_t(1) << (shift - 1));
 
-pcm::pcm(pcm&& other) noexcept : self(other.self)
-{
-  other.self = nullptr;
+  rounded = std::min<std::int64_t>(rounded, std::numeric_limits<std::int32_t>::max());
+  rounded = std::max<std::int64_t>(rounded, std::numeric_limits<std::int32_t>::min());
+
+  return std::int32_t(rounded);
 }
 
-pcm::~pcm()
+/// Converts a floating point sample to
+/// a left-justified, saturated integer sample.
+inline std::int32_t float_to_int32(float sample) noexcept
 {
-  close();
-  delete self;
+  auto scaled = sample * float_to_int32_scale;
+
+  if (scaled >= float_to_int32_scale) {
+    return std::numeric_limits<std::int32_t>::max();
+  } else if (scaled < -float_to_int32_scale) {
+    return std::numeric_limits<std::int32_t>::min();
+  }
+
+  return std::int32_t(std::lrint(scaled));
 }
 
-int pcm::close() noexcept
+//====================================//
+// Section: Scalar Conversion Kernels //
+//====================================//
+
+/// Converts samples to left-justified integers, one sample at a time.
+///
+/// @tparam container The number of bytes in one sample.
+/// @tparam big_endian Whether or not the samples are big endian.
+template <unsigned int container, bool big_endian>
+void decode_scalar(const sample_layout& layout, const unsigned char* src, std::int32_t* dst, size_type count) noexcept
 {
-  if (!self) {
-    return 0;
+  auto shift = layout.shift();
+
+  auto flip = layout.sign_flip();
+
+  for (size_type i = 0; i < count; i++) {
+
+    std::uint32_t raw = 0;
+
+    for (unsigned int j = 0; j < container; j++) {
+      auto byte_shift = 8 * (big_endian ? (container - 1 - j) : j);
+      raw |= std::uint32_t(src[(i * container) + j]) << byte_shift;
+    }
+
+    dst[i] = std::int32_t((raw << shift) ^ flip);
   }
+}
 
-  if (self->fd != invalid_fd()) {
+/// Converts left-justified integer samples
+/// to a sample format, one sample at a time.
+///
+/// @tparam container The number of bytes in one sample.
+/// @tparam big_endian Whether or not the samples are big endian.
+template <unsigned int container, bool big_endian>
+void encode_scalar(const sample_layout& layout, const std::int32_t* src, unsigned char* dst, size_type count, dither* d) noexcept
+{
+  auto shift = layout.shift();
 
-    auto result = ::close(self->fd);
+  for (size_type i = 0; i < count; i++) {
 
-    self->fd = invalid_fd();
+    auto noise = (d && shift) ? tpdf_noise(*d, shift) : 0;
 
-    if (result == -1) {
-      return errno;
+    auto value = round_sample(src[i], shift, noise);
+
+    std::uint32_t raw = 0;
+
+    if (layout.is_signed) {
+      raw = std::uint32_t(value >> shift);
+    } else {
+      raw = (std::uint32_t(value) ^ 0x80000000u) >> shift;
+    }
+
+    for (unsigned int j = 0; j < container; j++) {
+      auto byte_shift = 8 * (big_endian ? (container - 1 - j) : j);
+      dst[(i * container) + j] = (unsigned char) (raw >> byte_shift);
     }
   }
+}
 
-  return 0;
+/// Selects the scalar decoder for a sample layout and runs it.
+void decode_any_scalar(const sample_layout& layout, const unsigned char* src, std::int32_t* dst, size_type count) noexcept
+{
+  switch (layout.container) {
+    case 1:
+      return decode_scalar<1, false>(layout, src, dst, count);
+    case 2:
+      return layout.big_endian ? decode_scalar<2, true>(layout, src, dst, count)
+                               : decode_scalar<2, false>(layout, src, dst, count);
+    case 3:
+      return layout.big_endian ? decode_scalar<3, true>(layout, src, dst, count)
+                               : decode_scalar<3, false>(layout, src, dst, count);
+    case 4:
+      return layout.big_endian ? decode_scalar<4, true>(layout, src, dst, count)
+                               : decode_scalar<4, false>(layout, src, dst, count);
+  }
 }
 
-int pcm::get_file_descriptor() const noexcept
+/// Selects the scalar encoder for a sample layout and runs it.
+void encode_any_scalar(const sample_layout& layout, const std::int32_t* src, unsigned char* dst, size_type count, dither* d) noexcept
 {
-  return self ? self->fd : invalid_fd();
+  switch (layout.container) {
+    case 1:
+      return encode_scalar<1, false>(layout, src, dst, count, d);
+    case 2:
+      return layout.big_endian ? encode_scalar<2, true>(layout, src, dst, count, d)
+                               : encode_scalar<2, false>(layout, src, dst, count, d);
+    case 3:
+      return layout.big_endian ? encode_scalar<3, true>(layout, src, dst, count, d)
+                               : encode_scalar<3, false>(layout, src, dst, count, d);
+    case 4:
+      return layout.big_endian ? encode_scalar<4, true>(layout, src, dst, count, d)
+                               : encode_scalar<4, false>(layout, src, dst, count, d);
+  }
 }
 
-bool pcm::is_open() const noexcept
+size_type int32_to_float_scalar(const std::int32_t* src, float* dst, size_type count) noexcept
 {
-  if (!self) {
-    return false;
+  for (size_type i = 0; i < count; i++) {
+    dst[i] = float(src[i]) * int32_to_float_scale;
   }
 
-  return self->fd != invalid_fd();
+  return count;
 }
 
-result pcm::prepare() noexcept
+size_type float_to_int32_scalar(const float* src, std::int32_t* dst, size_type count) noexcept
 {
-  if (!self) {
-    return ENOENT;
+  for (size_type i = 0; i < count; i++) {
+    dst[i] = float_to_int32(src[i]);
   }
 
-  auto err = ::ioctl(self->fd, SNDRV_PCM_IOCTL_PREPARE);
-  if (err < 0) {
-    return errno;
-  }
+  return count;
+}
 
-  return result();
+/// Each vector kernel converts as many samples as it can and returns
+/// the number of samples converted. The remainder is converted
+/// with the scalar kernels, which also serve as the reference
+/// implementation.
+size_type decode_none(const sample_layout&, const unsigned char*, std::int32_t*, size_type) noexcept
+{
+  return 0;
 }
 
-result pcm::setup(const pcm_config& config, sample_access access, bool is_capture) noexcept
+size_type encode_none(const sample_layout&, const std::int32_t*, unsigned char*, size_type) noexcept
 {
-  auto hw_params = to_alsa_hw_params(config, access);
+  return 0;
+}
 
-  auto err = ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_HW_PARAMS, &hw_params);
-  if (err < 0) {
-    return errno;
-  }
+//==================================//
+// Section: SSE2 Conversion Kernels //
+//==================================//
 
-  auto sw_params = to_alsa_sw_params(config, is_capture);
+#if defined(__SSE2__)
 
-  err = ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_SW_PARAMS, &sw_params);
-  if (err < 0) {
-    return errno;
-  }
+/// Swaps the bytes of each 16-bit lane.
+inline __m128i sse2_swap16(__m128i v) noexcept
+{
+  return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
 
-  return 0;
+/// Swaps the bytes of each 32-bit lane.
+inline __m128i sse2_swap32(__m128i v) noexcept
+{
+  v = _mm_shufflelo_epi16(v, 0xb1);
+  v = _mm_shufflehi_epi16(v, 0xb1);
+  return sse2_swap16(v);
 }
 
-result pcm::start() noexcept
+/// Rounds left-justified samples before they're shifted right.
+/// SSE2 has no 32-bit minimum, so the saturation is done with a compare.
+inline __m128i sse2_round(__m128i v, unsigned int shift) noexcept
 {
-  if (!self) {
-    return ENOENT;
-  }
+  auto half = _mm_set1_epi32(std::int32_t(1u << (shift - 1)));
+  auto limit = _mm_set1_epi32(std::numeric_limits<std::int32_t>::max() - std::int32_t(1u << (shift - 1)));
+  auto over = _mm_cmpgt_epi32(v, limit);
+  v = _mm_or_si128(_mm_and_si128(over, limit), _mm_andnot_si128(over, v));
+  return _mm_add_epi32(v, half);
+}
 
-  auto err = ::ioctl(self->fd, SNDRV_PCM_IOCTL_START);
-  if (err < 0) {
-    return errno;
+size_type decode_sse2(const sample_layout& layout, const unsigned char* src, std::int32_t* dst, size_type count) noexcept
+{
+  auto zero = _mm_setzero_si128();
+  auto flip = _mm_set1_epi32(std::int32_t(layout.sign_flip()));
+  auto shift = _mm_cvtsi32_si128(int(layout.shift()));
+
+  size_type i = 0;
+
+  switch (layout.container) {
+    case 1:
+      for (; (i + 16) <= count; i += 16) {
+        auto v = _mm_loadu_si128((const __m128i*) (src + i));
+        auto lo = _mm_unpacklo_epi8(zero, v);
+        auto hi = _mm_unpackhi_epi8(zero, v);
+        _mm_storeu_si128((__m128i*) (dst + i +  0), _mm_xor_si128(_mm_unpacklo_epi16(zero, lo), flip));
+        _mm_storeu_si128((__m128i*) (dst + i +  4), _mm_xor_si128(_mm_unpackhi_epi16(zero, lo), flip));
+        _mm_storeu_si128((__m128i*) (dst + i +  8), _mm_xor_si128(_mm_unpacklo_epi16(zero, hi), flip));
+        _mm_storeu_si128((__m128i*) (dst + i + 12), _mm_xor_si128(_mm_unpackhi_epi16(zero, hi), flip));
+      }
+      break;
+    case 2:
+      for (; (i + 8) <= count; i += 8) {
+        auto v = _mm_loadu_si128((const __m128i*) (src + (i * 2)));
+        if (layout.big_endian) {
+          v = sse2_swap16(v);
+        }
+        _mm_storeu_si128((__m128i*) (dst + i + 0), _mm_xor_si128(_mm_unpacklo_epi16(zero, v), flip));
+        _mm_storeu_si128((__m128i*) (dst + i + 4), _mm_xor_si128(_mm_unpackhi_epi16(zero, v), flip));
+      }
+      break;
+    case 4:
+      for (; (i + 4) <= count; i += 4) {
+        auto v = _mm_loadu_si128((const __m128i*) (src + (i * 4)));
+        if (layout.big_endian) {
+          v = sse2_swap32(v);
+        }
+        v = _mm_sll_epi32(v, shift);
+        _mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(v, flip));
+      }
+      break;
   }
 
-  return result();
+  return i;
 }
 
-result pcm::drop() noexcept
+size_type encode_sse2(const sample_layout& layout, const std::int32_t* src, unsigned char* dst, size_type count) noexcept
 {
-  if (!self) {
-    return ENOENT;
-  }
-
-  auto err = ::ioctl(self->fd, SNDRV_PCM_IOCTL_DROP);
-  if (err < 0) {
-    return errno;
+  auto shift = layout.shift();
+
+  auto shift_count = _mm_cvtsi32_si128(int(shift));
+
+  size_type i = 0;
+
+  switch (layout.container) {
+    case 1: {
+      auto flip = _mm_set1_epi8(layout.is_signed ? 0 : char(0x80));
+      for (; (i + 16) <= count; i += 16) {
+        auto a = _mm_srai_epi32(sse2_round(_mm_loadu_si128((const __m128i*) (src + i +  0)), shift), 24);
+        auto b = _mm_srai_epi32(sse2_round(_mm_loadu_si128((const __m128i*) (src + i +  4)), shift), 24);
+        auto c = _mm_srai_epi32(sse2_round(_mm_loadu_si128((const __m128i*) (src + i +  8)), shift), 24);
+        auto d = _mm_srai_epi32(sse2_round(_mm_loadu_si128((const __m128i*) (src + i + 12)), shift), 24);
+        auto v = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(v, flip));
+      }
+    } break;
+    case 2: {
+      auto flip = _mm_set1_epi16(layout.is_signed ? 0 : std::int16_t(0x8000));
+      for (; (i + 8) <= count; i += 8) {
+        auto a = _mm_srai_epi32(sse2_round(_mm_loadu_si128((const __m128i*) (src + i + 0)), shift), 16);
+        auto b = _mm_srai_epi32(sse2_round(_mm_loadu_si128((const __m128i*) (src + i + 4)), shift), 16);
+        auto v = _mm_xor_si128(_mm_packs_epi32(a, b), flip);
+        if (layout.big_endian) {
+          v = sse2_swap16(v);
+        }
+        _mm_storeu_si128((__m128i*) (dst + (i * 2)), v);
+      }
+    } break;
+    case 4: {
+      auto flip = _mm_set1_epi32(std::int32_t(layout.sign_flip()));
+      for (; (i + 4) <= count; i += 4) {
+        auto v = _mm_loadu_si128((const __m128i*) (src + i));
+        if (shift) {
+          v = sse2_round(v, shift);
+        }
+        if (layout.is_signed) {
+          v = _mm_sra_epi32(v, shift_count);
+        } else {
+          v = _mm_srl_epi32(_mm_xor_si128(v, flip), shift_count);
+        }
+        if (layout.big_endian) {
+          v = sse2_swap32(v);
+        }
+        _mm_storeu_si128((__m128i*) (dst + (i * 4)), v);
+      }
+    } break;
   }
 
-  return result();
+  return i;
 }
 
-generic_result<pcm_info> pcm::get_info() const noexcept
+size_type int32_to_float_sse2(const std::int32_t* src, float* dst, size_type count) noexcept
 {
-  using result_type = generic_result<pcm_info>;
-
-  if (!self) {
-    return result_type { ENOENT };
-  }
+  auto scale = _mm_set1_ps(int32_to_float_scale);
 
-  snd_pcm_info native_info;
+  size_type i = 0;
 
-  int err = ioctl(self->fd, SNDRV_PCM_IOCTL_INFO, &native_info);
-  if (err != 0) {
-    return result_type { errno };
+  for (; (i + 4) <= count; i += 4) {
+    auto v = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*) (src + i)));
+    _mm_storeu_ps(dst + i, _mm_mul_ps(v, scale));
   }
 
-  return result_type { 0, to_tinyalsa_info(native_info) };
+  return i;
 }
 
-result pcm::open_capture_device(size_type card, size_type device, bool non_blocking) noexcept
+size_type float_to_int32_sse2(const float* src, std::int32_t* dst, size_type count) noexcept
 {
-  self = lazy_init(self);
-  if (!self) {
-    return result { ENOMEM };
-  }
+  auto scale = _mm_set1_ps(float_to_int32_scale);
 
-  char path[256];
+  size_type i = 0;
 
-  snprintf(path, sizeof(path), "/dev/snd/pcmC%luD%luc",
-           (unsigned long) card,
-           (unsigned long) device);
+  for (; (i + 4) <= count; i += 4) {
+    auto v = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+    // Positive overflow converts to 0x80000000,
+    // which is turned into 0x7fffffff by the mask.
+    auto over = _mm_castps_si128(_mm_cmpge_ps(v, scale));
+    _mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(_mm_cvtps_epi32(v), over));
+  }
 
-  return self->open_by_path(path, non_blocking);
+  return i;
 }
 
-result pcm::open_playback_device(size_type card, size_type device, bool non_blocking) noexcept
+#endif // defined(__SSE2__)
+
+//==================================//
+// Section: AVX2 Conversion Kernels //
+//==================================//
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+/// Builds the byte shuffle that moves the bytes of
+/// four packed samples into the top of four 32-bit lanes.
+/// Both 128-bit halves of the result use the same shuffle.
+__attribute__((target("avx2"))) __m256i avx2_unpack_mask(const sample_layout& layout) noexcept
 {
-  self = lazy_init(self);
-  if (!self) {
-    return result { ENOMEM };
+  alignas(32) unsigned char mask[32];
+
+  auto c = layout.container;
+
+  for (unsigned int k = 0; k < 4; k++) {
+    for (unsigned int j = 0; j < 4; j++) {
+      unsigned char index = 0x80;
+      if (j >= (4 - c)) {
+        auto byte = j - (4 - c);
+        index = (unsigned char) ((c * k) + (layout.big_endian ? (c - 1 - byte) : byte));
+      }
+      mask[(k * 4) + j] = index;
+      mask[(k * 4) + j + 16] = index;
+    }
   }
 
-  char path[256];
+  return _mm256_load_si256((const __m256i*) mask);
+}
 
-  snprintf(path, sizeof(path), "/dev/snd/pcmC%luD%lup",
-           (unsigned long) card,
-           (unsigned long) device);
+/// Builds the byte shuffle that packs the low bytes
+/// of four 32-bit lanes into consecutive samples.
+__attribute__((target("avx2"))) __m256i avx2_pack_mask(const sample_layout& layout) noexcept
+{
+  alignas(32) unsigned char mask[32];
 
-  return self->open_by_path(path, non_blocking);
+  auto c = layout.container;
+
+  for (unsigned int i = 0; i < 16; i++) {
+    unsigned char index = 0x80;
+    if (i < (c * 4)) {
+      auto k = i / c;
+      auto byte = i % c;
+      index = (unsigned char) ((k * 4) + (layout.big_endian ? (c - 1 - byte) : byte));
+    }
+    mask[i] = index;
+    mask[i + 16] = index;
+  }
+
+  return _mm256_load_si256((const __m256i*) mask);
 }
 
-result pcm_impl::open_by_path(const char* path, bool non_blocking) noexcept
+/// Gets the 32-bit lane permutation that moves the bytes of the first
+/// four samples into the low half and the next four into the high half.
+__attribute__((target("avx2"))) __m256i avx2_unpack_permutation(unsigned int container) noexcept
 {
-  if (fd != invalid_fd()) {
-    ::close(fd);
+  switch (container) {
+    case 1:
+      return _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    case 2:
+      return _mm256_setr_epi32(0, 1, 0, 0, 2, 3, 2, 2);
+    case 3:
+      return _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 3);
   }
 
-  fd = ::open(path, non_blocking ? (O_RDWR | O_NONBLOCK) : O_RDWR);
-  if (fd < 0) {
-    fd = invalid_fd();
-    return result { errno };
-  } else {
-    return result { 0 };
-  }
+  return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
 }
 
-//===================//
-// Section: PCM list //
-//===================//
+/// Gets the 32-bit lane permutation that joins
+/// the packed samples of both halves.
+__attribute__((target("avx2"))) __m256i avx2_pack_permutation(unsigned int container) noexcept
+{
+  switch (container) {
+    case 1:
+      return _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+    case 2:
+      return _mm256_setr_epi32(0, 1, 4, 5, 0, 0, 0, 0);
+    case 3:
+      return _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 0, 0);
+  }
 
-namespace {
+  return _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+}
 
-/// A wrapper around a directory pointer
-/// that closes the directory when it goes out of scope.
-struct dir_wrapper final
+/// Converts eight samples of any layout at a time. Packed 3-byte
+/// samples are unpacked with the same permute and shuffle that's
+/// used for byte swapping the other layouts.
+__attribute__((target("avx2"))) size_type decode_avx2(const sample_layout& layout, const unsigned char* src, std::int32_t* dst, size_type count) noexcept
 {
-  /// A pointer to the opened directory.
-  DIR* ptr = nullptr;
-  /// Casts the wrapper to a directory pointer.
-  ///
-  /// @return The directory pointer.
-  inline operator DIR* () noexcept
-  {
-    return ptr;
-  }
-  /// Closes the directory if it was opened.
-  ~dir_wrapper()
-  {
-    if (ptr) {
-      closedir(ptr);
+  auto c = layout.container;
+  auto permutation = avx2_unpack_permutation(c);
+  auto mask = avx2_unpack_mask(layout);
+  auto shift = _mm_cvtsi32_si128(int((c * 8) - layout.bits));
+  auto flip = _mm256_set1_epi32(std::int32_t(layout.sign_flip()));
+
+  // 3-byte samples are loaded 32 bytes at a time, even
+  // though only 24 bytes are used, so the loop has to stop
+  // before reading past the end of the source buffer.
+  size_type load_size = (c == 3) ? 32 : (c * 8);
+
+  size_type i = 0;
+
+  for (; ((i + 8) <= count) && (((i * c) + load_size) <= (count * c)); i += 8) {
+
+    __m256i v;
+
+    switch (c) {
+      case 1:
+        v = _mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*) (src + i)));
+        break;
+      case 2:
+        v = _mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) (src + (i * 2))));
+        break;
+      default:
+        v = _mm256_loadu_si256((const __m256i*) (src + (i * c)));
+        break;
     }
-  }
-  /// Opens a directory.
-  ///
-  /// @param path The path of the directory to open.
-  ///
-  /// @return True on success, false on failure.
-  bool open(const char* path) noexcept
-  {
-    ptr = opendir(path);
-    return !!ptr;
-  }
-};
 
-/// Represents a PCM name that was parsed
-/// from a directory entry.
-struct parsed_name final
-{
-  /// Whether or not the name is valid.
-  bool valid = false;
-  /// The index of the card.
-  size_type card = 0;
-  /// The index of the device.
-  size_type device = 0;
-  /// Whether or not it's a capture PCM.
-  bool is_capture = false;
-  /// Constructs a new parsed name instance.
-  ///
-  /// @param name A pointer to the name to parse.
-  constexpr parsed_name(const char* name) noexcept
-  {
-    valid = parse(name);
-  }
-private:
-  /// Parses a name given to the constructor.
-  ///
-  /// @param name The filename to be parsed.
-  ///
-  /// @return True on a match, false on failure.
-  bool parse(const char* name) noexcept;
-  /// Indicates if a character is a decimal number or not.
-  ///
-  /// @return True if it is a decimal character, false otherwise.
-  static constexpr bool is_dec(char c) noexcept
-  {
-    return (c >= '0') && (c <= '9');
-  }
-  /// Parses a decimal number.
-  ///
-  /// @param c The character to convert into a decimal number.
-  ///
-  /// @return The resultant decimal number.
-  constexpr size_type to_dec(char c) noexcept
-  {
-    return size_type(c - '0');
+    v = _mm256_permutevar8x32_epi32(v, permutation);
+    v = _mm256_shuffle_epi8(v, mask);
+    v = _mm256_sll_epi32(v, shift);
+    v = _mm256_xor_si256(v, flip);
+
+    _mm256_storeu_si256((__m256i*) (dst + i), v);
   }
-};
 
-bool parsed_name::parse(const char* name) noexcept
+  return i;
+}
+
+__attribute__((target("avx2"))) size_type encode_avx2(const sample_layout& layout, const std::int32_t* src, unsigned char* dst, size_type count) noexcept
 {
-  auto name_length = strlen(name);
-  if (!name_length) {
-    return false;
-  }
+  auto c = layout.container;
+  auto shift = layout.shift();
+  auto shift_count = _mm_cvtsi32_si128(int(shift));
+  auto permutation = avx2_pack_permutation(c);
+  auto mask = avx2_pack_mask(layout);
+  auto flip = _mm256_set1_epi32(std::int32_t(layout.sign_flip()));
+  auto half = _mm256_set1_epi32(shift ? std::int32_t(1u << (shift - 1)) : 0);
+  auto limit = _mm256_set1_epi32(std::numeric_limits<std::int32_t>::max() - (shift ? std::int32_t(1u << (shift - 1)) : 0));
 
-  if ((name[0] != 'p')
-   || (name[1] != 'c')
-   || (name[2] != 'm')
-   || (name[3] != 'C')) {
-    return false;
-  }
+  size_type i = 0;
 
-  size_type d_pos = name_length;
+  for (; (i + 8) <= count; i += 8) {
 
-  for (size_type i = 4; i < name_length; i++) {
-    if (name[i] == 'D') {
-      d_pos = i;
-      break;
+    auto v = _mm256_loadu_si256((const __m256i*) (src + i));
+
+    v = _mm256_add_epi32(_mm256_min_epi32(v, limit), half);
+
+    if (layout.is_signed) {
+      v = _mm256_sra_epi32(v, shift_count);
+    } else {
+      v = _mm256_srl_epi32(_mm256_xor_si256(v, flip), shift_count);
     }
-  }
 
-  if (d_pos >= name_length) {
-    return false;
+    v = _mm256_shuffle_epi8(v, mask);
+    v = _mm256_permutevar8x32_epi32(v, permutation);
+
+    auto* out = dst + (i * c);
+
+    switch (c) {
+      case 1:
+        _mm_storel_epi64((__m128i*) out, _mm256_castsi256_si128(v));
+        break;
+      case 2:
+        _mm_storeu_si128((__m128i*) out, _mm256_castsi256_si128(v));
+        break;
+      case 3:
+        _mm_storeu_si128((__m128i*) out, _mm256_castsi256_si128(v));
+        _mm_storel_epi64((__m128i*) (out + 16), _mm256_extracti128_si256(v, 1));
+        break;
+      default:
+        _mm256_storeu_si256((__m256i*) out, v);
+        break;
+    }
   }
 
-  if (name[name_length - 1] == 'c') {
-    is_capture = true;
-  } else if (name[name_length - 1] == 'p') {
-    is_capture = false;
-  } else {
-    return false;
-  }
+  return i;
+}
 
-  device = 0;
-  card = 0;
+__attribute__((target("avx2"))) size_type int32_to_float_avx2(const std::int32_t* src, float* dst, size_type count) noexcept
+{
+  auto scale = _mm256_set1_ps(int32_to_float_scale);
 
-  for (size_type i = 4; i < d_pos; i++) {
-    if (!is_dec(name[i])) {
-      return false;
-    }
-    card *= 10;
-    card += to_dec(name[i]);
+  size_type i = 0;
+
+  for (; (i + 8) <= count; i += 8) {
+    auto v = _mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i*) (src + i)));
+    _mm256_storeu_ps(dst + i, _mm256_mul_ps(v, scale));
   }
 
-  for (size_type i = d_pos + 1; i < (name_length - 1); i++) {
-    if (!is_dec(name[i])) {
-      return false;
-    }
-    device *= 10;
-    device += to_dec(name[i]);
+  return i;
+}
+
+__attribute__((target("avx2"))) size_type float_to_int32_avx2(const float* src, std::int32_t* dst, size_type count) noexcept
+{
+  auto scale = _mm256_set1_ps(float_to_int32_scale);
+
+  size_type i = 0;
+
+  for (; (i + 8) <= count; i += 8) {
+    auto v = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+    auto over = _mm256_castps_si256(_mm256_cmp_ps(v, scale, _CMP_GE_OQ));
+    _mm256_storeu_si256((__m256i*) (dst + i), _mm256_xor_si256(_mm256_cvtps_epi32(v), over));
   }
 
-  return true;
+  return i;
 }
 
-} // namespace
+#endif // defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
 
-class pcm_list_impl final
-{
-  friend pcm_list;
-  /// The array of information instances.
-  pod_buffer<pcm_info> info_buffer;
-};
+//==================================//
+// Section: NEON Conversion Kernels //
+//==================================//
 
-pcm_list::pcm_list() noexcept : self(nullptr)
+#if defined(__aarch64__) && defined(__ARM_NEON) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+
+size_type decode_neon(const sample_layout& layout, const unsigned char* src, std::int32_t* dst, size_type count) noexcept
 {
-  self = new (std::nothrow) pcm_list_impl();
-  if (!self) {
-    return;
+  if (layout.big_endian) {
+    return 0;
   }
 
-  dir_wrapper snd_dir;
+  auto flip = vdupq_n_u32(layout.sign_flip());
 
-  if (!snd_dir.open("/dev/snd")) {
-    return;
-  }
+  auto zero = vdupq_n_u8(0);
 
-  dirent* entry = nullptr;
+  auto shift = vdupq_n_s32(std::int32_t((layout.container * 8) - layout.bits));
 
-  for (;;) {
+  size_type i = 0;
 
-    entry = readdir(snd_dir);
-    if (!entry) {
+  switch (layout.container) {
+    case 2:
+      for (; (i + 8) <= count; i += 8) {
+        auto v = vld1q_u16((const std::uint16_t*) (src + (i * 2)));
+        auto lo = vshll_n_u16(vget_low_u16(v), 16);
+        auto hi = vshll_high_n_u16(v, 16);
+        vst1q_s32(dst + i + 0, vreinterpretq_s32_u32(veorq_u32(lo, flip)));
+        vst1q_s32(dst + i + 4, vreinterpretq_s32_u32(veorq_u32(hi, flip)));
+      }
       break;
-    }
+    case 3:
+      // vld3 separates the low, middle and high bytes
+      // of 16 packed samples into three registers.
+      for (; (i + 16) <= count; i += 16) {
+        auto b = vld3q_u8(src + (i * 3));
+        auto low = vzipq_u8(zero, b.val[0]);
+        auto high = vzipq_u8(b.val[1], b.val[2]);
+        auto a = vzipq_u16(vreinterpretq_u16_u8(low.val[0]), vreinterpretq_u16_u8(high.val[0]));
+        auto c = vzipq_u16(vreinterpretq_u16_u8(low.val[1]), vreinterpretq_u16_u8(high.val[1]));
+        uint32x4_t v[4] = {
+          vreinterpretq_u32_u16(a.val[0]),
+          vreinterpretq_u32_u16(a.val[1]),
+          vreinterpretq_u32_u16(c.val[0]),
+          vreinterpretq_u32_u16(c.val[1])
+        };
+        for (unsigned int k = 0; k < 4; k++) {
+          auto out = veorq_u32(vshlq_u32(v[k], shift), flip);
+          vst1q_s32(dst + i + (k * 4), vreinterpretq_s32_u32(out));
+        }
+      }
+      break;
+    case 4:
+      for (; (i + 4) <= count; i += 4) {
+        auto v = vld1q_u32((const std::uint32_t*) (src + (i * 4)));
+        v = veorq_u32(vshlq_u32(v, shift), flip);
+        vst1q_s32(dst + i, vreinterpretq_s32_u32(v));
+      }
+      break;
+  }
 
-    parsed_name name(entry->d_name);
-    if (!name.valid) {
-      continue;
-    }
+  return i;
+}
+
+size_type encode_neon(const sample_layout& layout, const std::int32_t* src, unsigned char* dst, size_type count) noexcept
+{
+  if (layout.big_endian || (layout.container == 1) || (layout.container == 3)) {
+    return 0;
+  }
 
-    result open_result;
+  auto shift = layout.shift();
+  auto right_shift = vdupq_n_s32(-std::int32_t(shift));
+  auto flip = vdupq_n_u32(layout.sign_flip());
+  auto half = vdupq_n_s32(shift ? std::int32_t(1u << (shift - 1)) : 0);
+  auto limit = vdupq_n_s32(std::numeric_limits<std::int32_t>::max() - (shift ? std::int32_t(1u << (shift - 1)) : 0));
 
-    pcm p;
+  size_type i = 0;
 
-    if (name.is_capture) {
-      open_result = p.open_capture_device(name.card, name.device);
-    } else {
-      open_result = p.open_playback_device(name.card, name.device);
-    }
+  for (; (i + 4) <= count; i += 4) {
 
-    if (open_result.failed()) {
-      continue;
-    }
+    auto v = vaddq_s32(vminq_s32(vld1q_s32(src + i), limit), half);
 
-    auto info_result = p.get_info();
-    if (info_result.failed()) {
-      continue;
+    uint32x4_t raw;
+
+    if (layout.is_signed) {
+      raw = vreinterpretq_u32_s32(vshlq_s32(v, right_shift));
+    } else {
+      raw = vshlq_u32(veorq_u32(vreinterpretq_u32_s32(v), flip), right_shift);
     }
 
-    if (!self->info_buffer.emplace_back(info_result.unwrap())) {
-      break;
+    if (layout.container == 2) {
+      vst1_u16((std::uint16_t*) (dst + (i * 2)), vmovn_u32(raw));
+    } else {
+      vst1q_u32((std::uint32_t*) (dst + (i * 4)), raw);
     }
   }
+
+  return i;
 }
 
-pcm_list::pcm_list(pcm_list&& other) noexcept : self(other.self)
+size_type int32_to_float_neon(const std::int32_t* src, float* dst, size_type count) noexcept
 {
-  other.self = nullptr;
+  size_type i = 0;
+
+  for (; (i + 4) <= count; i += 4) {
+    auto v = vcvtq_f32_s32(vld1q_s32(src + i));
+    vst1q_f32(dst + i, vmulq_n_f32(v, int32_to_float_scale));
+  }
+
+  return i;
+}
+
+size_type float_to_int32_neon(const float* src, std::int32_t* dst, size_type count) noexcept
+{
+  size_type i = 0;
+
+  for (; (i + 4) <= count; i += 4) {
+    // vcvtnq rounds to nearest and saturates on overflow.
+    auto v = vmulq_n_f32(vld1q_f32(src + i), float_to_int32_scale);
+    vst1q_s32(dst + i, vcvtnq_s32_f32(v));
+  }
+
+  return i;
+}
+
+#endif // defined(__aarch64__) && defined(__ARM_NEON)
+
+//=================================//
+// Section: Conversion Dispatching //
+//=================================//
+
+/// Contains the conversion kernels of one instruction set.
+struct conversion_kernels final
+{
+  size_type (*decode)(const sample_layout&, const unsigned char*, std::int32_t*, size_type) = decode_none;
+  size_type (*encode)(const sample_layout&, const std::int32_t*, unsigned char*, size_type) = encode_none;
+  size_type (*int32_to_float)(const std::int32_t*, float*, size_type) = int32_to_float_scalar;
+  size_type (*float_to_int32)(const float*, std::int32_t*, size_type) = float_to_int32_scalar;
+};
+
+/// Gets the kernels of an instruction set.
+///
+/// @return The kernels, or null if the library was built without
+/// them or the CPU does not support the instruction set.
+const conversion_kernels* find_conversion_kernels(conversion_isa isa) noexcept
+{
+  switch (isa) {
+    case conversion_isa::scalar: {
+      static const conversion_kernels kernels;
+      return &kernels;
+    }
+    case conversion_isa::sse2:
+#if defined(__SSE2__)
+      {
+        static const conversion_kernels kernels {
+          decode_sse2, encode_sse2, int32_to_float_sse2, float_to_int32_sse2
+        };
+        return &kernels;
+      }
+#else
+      break;
+#endif
+    case conversion_isa::avx2:
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+      if (__builtin_cpu_supports("avx2")) {
+        static const conversion_kernels kernels {
+          decode_avx2, encode_avx2, int32_to_float_avx2, float_to_int32_avx2
+        };
+        return &kernels;
+      }
+#endif
+      break;
+    case conversion_isa::neon:
+#if defined(__aarch64__) && defined(__ARM_NEON) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+      {
+        static const conversion_kernels kernels {
+          decode_neon, encode_neon, int32_to_float_neon, float_to_int32_neon
+        };
+        return &kernels;
+      }
+#else
+      break;
+#endif
+  }
+
+  return nullptr;
+}
+
+/// Selects the fastest instruction set supported by the CPU.
+conversion_isa select_conversion_isa() noexcept
+{
+  const conversion_isa preferred[] {
+    conversion_isa::avx2,
+    conversion_isa::neon,
+    conversion_isa::sse2
+  };
+
+  for (auto isa : preferred) {
+    if (find_conversion_kernels(isa)) {
+      return isa;
+    }
+  }
+
+  return conversion_isa::scalar;
+}
+
+/// The instruction set that conversions are made with.
+/// The selection is made on first use.
+std::atomic<int> active_conversion_isa { -1 };
+
+/// Accesses the kernels of the instruction set in use.
+const conversion_kernels& get_conversion_kernels() noexcept
+{
+  return *find_conversion_kernels(get_conversion_isa());
+}
+
+} // namespace
+
+bool is_conversion_isa_supported(conversion_isa isa) noexcept
+{
+  return find_conversion_kernels(isa) != nullptr;
+}
+
+conversion_isa get_conversion_isa() noexcept
+{
+  auto isa = active_conversion_isa.load(std::memory_order_relaxed);
+  if (isa < 0) {
+    isa = int(select_conversion_isa());
+    active_conversion_isa.store(isa, std::memory_order_relaxed);
+  }
+
+  return conversion_isa(isa);
+}
+
+result set_conversion_isa(conversion_isa isa) noexcept
+{
+  if (!is_conversion_isa_supported(isa)) {
+    return ENOTSUP;
+  }
+
+  active_conversion_isa.store(int(isa), std::memory_order_relaxed);
+
+  return result();
+}
+
+void convert_to_int32(sample_format format, const void* samples, std::int32_t* out, size_type sample_count) noexcept
+{
+  auto layout = to_layout(format);
+
+  const auto* src = static_cast<const unsigned char*>(samples);
+
+  auto done = get_conversion_kernels().decode(layout, src, out, sample_count);
+
+  decode_any_scalar(layout, src + (done * layout.container), out + done, sample_count - done);
+}
+
+void convert_from_int32(const std::int32_t* samples, sample_format format, void* out, size_type sample_count, dither* d) noexcept
+{
+  auto layout = to_layout(format);
+
+  auto* dst = static_cast<unsigned char*>(out);
+
+  size_type done = 0;
+
+  // The vector kernels do not generate dither noise.
+  if (!d || !layout.shift()) {
+    done = get_conversion_kernels().encode(layout, samples, dst, sample_count);
+  }
+
+  encode_any_scalar(layout, samples + done, dst + (done * layout.container), sample_count - done, d);
+}
+
+void convert_to_float(sample_format format, const void* samples, float* out, size_type sample_count) noexcept
+{
+  const auto& kernels = get_conversion_kernels();
+
+  auto container = to_layout(format).container;
+
+  const auto* src = static_cast<const unsigned char*>(samples);
+
+  alignas(32) std::int32_t block[conversion_block_size];
+
+  for (size_type i = 0; i < sample_count; i += conversion_block_size) {
+
+    auto block_size = std::min(conversion_block_size, sample_count - i);
+
+    convert_to_int32(format, src + (i * container), block, block_size);
+
+    auto done = kernels.int32_to_float(block, out + i, block_size);
+
+    int32_to_float_scalar(block + done, out + i + done, block_size - done);
+  }
+}
+
+void convert_from_float(const float* samples, sample_format format, void* out, size_type sample_count, dither* d) noexcept
+{
+  const auto& kernels = get_conversion_kernels();
+
+  auto container = to_layout(format).container;
+
+  auto* dst = static_cast<unsigned char*>(out);
+
+  alignas(32) std::int32_t block[conversion_block_size];
+
+  for (size_type i = 0; i < sample_count; i += conversion_block_size) {
+
+    auto block_size = std::min(conversion_block_size, sample_count - i);
+
+    auto done = kernels.float_to_int32(samples + i, block, block_size);
+
+    float_to_int32_scalar(samples + i + done, block + done, block_size - done);
+
+    convert_from_int32(block, format, dst + (i * container), block_size, d);
+  }
+}
+
+//=====================//
+// Section: POD Buffer //
+//=====================//
+
+/// A simple buffer for POD type data.
+///
+/// TODO : Check the impact of multiple instantiations
+/// on overall binary size.
+///
+/// @tparam element_type The type of the element
+/// stored in the buffer.
+template <typename element_type>
+struct pod_buffer final
+{
+  /// The array of elements.
+  element_type* data = nullptr;
+  /// The number of elements in the buffer.
+  size_type size = 0;
+  /// Constructs an empty buffer.
+  constexpr pod_buffer() noexcept : data(nullptr), size(0) {}
+  /// Moves a buffer from one variable to another.
+  ///
+  /// @param other The variable to be moved.
+  inline constexpr pod_buffer(pod_buffer&& other) noexcept
+    : data(other.data),
+      size(other.size)
+  {
+    other.data = nullptr;
+    other.size = 0;
+  }
+  /// Releases memory allocated by the buffer.
+  ~pod_buffer()
+  {
+    std::free(data);
+    data = nullptr;
+    size = 0;
+  }
+  /// Adds an element to the end of the buffer.
+  ///
+  /// @param e The element to add to the end of the buffer.
+  ///
+  /// @return True on success, false on failure.
+  bool emplace_back(element_type&& e) noexcept
+  {
+    auto* tmp = (element_type*) std::realloc(data, (size + 1) * sizeof(element_type));
+    if (!tmp) {
+      return false;
+    }
+    data = tmp;
+    size++;
+    data[size - 1] = std::move(e);
+    return true;
+  }
+};
+
+//======================//
+// Section: I/O Backend //
+//======================//
+
+#ifdef TINYALSA_CXX_BACKENDS
+
+namespace {
+
+int native_open(const char* path, int flags)
+{
+  return ::open(path, flags);
+}
+
+int native_close(int fd)
+{
+  return ::close(fd);
+}
+
+int native_ioctl(int fd, unsigned long request, void* arg)
+{
+  return ::ioctl(fd, request, arg);
+}
+
+int native_poll(pollfd* fds, unsigned long count, int timeout_ms)
+{
+  return ::poll(fds, nfds_t(count), timeout_ms);
+}
+
+void* native_mmap(void* address, size_type length, int protection, int flags, int fd, long offset)
+{
+  return ::mmap(address, length, protection, flags, fd, off_t(offset));
+}
+
+int native_munmap(void* address, size_type length)
+{
+  return ::munmap(address, length);
+}
+
+const pcm_backend native_backend {
+  native_open,
+  native_close,
+  native_ioctl,
+  native_poll,
+  native_mmap,
+  native_munmap
+};
+
+/// The backend that all PCM operations go through.
+/// The tables are never modified, so swapping the pointer
+/// gives other threads either the old or the new table.
+std::atomic<const pcm_backend*> active_backend { &native_backend };
+
+/// Accesses the backend that all PCM operations go through.
+inline const pcm_backend& backend() noexcept
+{
+  return *active_backend.load(std::memory_order_acquire);
+}
+
+/// Opens a PCM device through the active backend.
+inline int pcm_open(const char* path, int flags) noexcept
+{
+  return backend().open(path, flags);
+}
+
+/// Closes a PCM device through the active backend.
+inline int pcm_close(int fd) noexcept
+{
+  return backend().close(fd);
+}
+
+/// Issues an ioctl through the active backend.
+inline int pcm_ioctl(int fd, unsigned long request, void* arg = nullptr) noexcept
+{
+  return backend().ioctl(fd, request, arg);
+}
+
+/// Polls PCM devices through the active backend.
+inline int pcm_poll(pollfd* fds, unsigned long count, int timeout_ms) noexcept
+{
+  return backend().poll(fds, count, timeout_ms);
+}
+
+/// Maps PCM data through the active backend.
+inline void* pcm_mmap(size_type length, int protection, int fd, long offset) noexcept
+{
+  return backend().mmap(nullptr, length, protection, MAP_SHARED, fd, offset);
+}
+
+/// Unmaps PCM data through the active backend.
+inline int pcm_munmap(void* address, size_type length) noexcept
+{
+  return backend().munmap(address, length);
+}
+
+} // namespace
+
+const pcm_backend& get_native_backend() noexcept
+{
+  return native_backend;
+}
+
+const pcm_backend& get_backend() noexcept
+{
+  return backend();
+}
+
+void set_backend(const pcm_backend& next) noexcept
+{
+  active_backend.store(&next, std::memory_order_release);
+}
+
+#else // TINYALSA_CXX_BACKENDS
+
+namespace {
+
+// Without backends, every operation is a direct system call.
+
+/// Opens a PCM device.
+inline int pcm_open(const char* path, int flags) noexcept
+{
+  return ::open(path, flags);
+}
+
+/// Closes a PCM device.
+inline int pcm_close(int fd) noexcept
+{
+  return ::close(fd);
+}
+
+/// Issues an ioctl to a PCM device.
+inline int pcm_ioctl(int fd, unsigned long request, void* arg = nullptr) noexcept
+{
+  return ::ioctl(fd, request, arg);
+}
+
+/// Polls PCM devices.
+inline int pcm_poll(pollfd* fds, unsigned long count, int timeout_ms) noexcept
+{
+  return ::poll(fds, nfds_t(count), timeout_ms);
+}
+
+/// Maps PCM data.
+inline void* pcm_mmap(size_type length, int protection, int fd, long offset) noexcept
+{
+  return ::mmap(nullptr, length, protection, MAP_SHARED, fd, off_t(offset));
+}
+
+/// Unmaps PCM data.
+inline int pcm_munmap(void* address, size_type length) noexcept
+{
+  return ::munmap(address, length);
+}
+
+} // namespace
+
+#endif // TINYALSA_CXX_BACKENDS
+
+//=============================//
+// Section: Interleaved Reader //
+//=============================//
+
+result interleaved_pcm_reader::open(size_type card, size_type device, bool non_blocking) noexcept
+{
+  return pcm::open_capture_device(card, device, non_blocking);
+}
+
+generic_result<size_type> interleaved_pcm_reader::read_unformatted(void* frames, size_type frame_count) noexcept
+{
+  snd_xferi transfer {
+    0 /* result */,
+    frames,
+    snd_pcm_uframes_t(frame_count),
+  };
+
+  auto err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_READI_FRAMES, &transfer);
+  if (err < 0) {
+
+    auto xrun_result = handle_xrun(errno);
+    if (xrun_result.failed()) {
+      return { xrun_result.error, 0 };
+    }
+
+    // The PCM was recovered, so the transfer is tried once more.
+    err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_READI_FRAMES, &transfer);
+    if (err < 0) {
+      return { errno, 0 };
+    }
+  }
+
+  return { 0, size_type(transfer.result) };
+}
+
+//=============================//
+// Section: Interleaved Writer //
+//=============================//
+
+result interleaved_pcm_writer::open(size_type card, size_type device, bool non_blocking) noexcept
+{
+  return pcm::open_playback_device(card, device, non_blocking);
+}
+
+generic_result<size_type> interleaved_pcm_writer::write_unformatted(const void* frames, size_type frame_count) noexcept
+{
+  snd_xferi transfer {
+    0 /* result */,
+    const_cast<void*>(frames),
+    snd_pcm_uframes_t(frame_count),
+  };
+
+  auto err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_WRITEI_FRAMES, &transfer);
+  if (err < 0) {
+
+    auto xrun_result = handle_xrun(errno);
+    if (xrun_result.failed()) {
+      return { xrun_result.error, 0 };
+    }
+
+    // The PCM was recovered, so the transfer is tried once more.
+    err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_WRITEI_FRAMES, &transfer);
+    if (err < 0) {
+      return { errno, 0 };
+    }
+  }
+
+  return { 0, size_type(transfer.result) };
+}
+
+generic_result<size_type> interleaved_pcm_writer::write_all(const void* frames, size_type frame_count) noexcept
+{
+  auto frame_size = get_frame_size();
+  if (!frame_size) {
+    return { EBADFD, 0 };
+  }
+
+  const auto* frame_ptr = static_cast<const unsigned char*>(frames);
+
+  size_type written = 0;
+
+  while (written < frame_count) {
+
+    auto write_result = write_unformatted(frame_ptr + (written * frame_size), frame_count - written);
+
+    if (!write_result.failed()) {
+      written += write_result.unwrap();
+      continue;
+    }
+
+    if (write_result.error == EAGAIN) {
+      auto wait_result = wait();
+      if (wait_result.failed() && (wait_result.error != EPIPE)) {
+        return { wait_result.error, written };
+      }
+    } else if ((write_result.error == EPIPE) || (write_result.error == ESTRPIPE)) {
+      // With the report policy, the xrun is handed back here
+      // instead of being recovered from by the transfer.
+      auto recover_result = recover(write_result.error);
+      if (recover_result.failed()) {
+        return { recover_result.error, written };
+      }
+    } else if (write_result.error != EINTR) {
+      return { write_result.error, written };
+    }
+  }
+
+  return { 0, written };
+}
+
+//=================================//
+// Section: Non-interleaved Reader //
+//=================================//
+
+result non_interleaved_pcm_reader::open(size_type card, size_type device, bool non_blocking) noexcept
+{
+  return pcm::open_capture_device(card, device, non_blocking);
+}
+
+generic_result<size_type> non_interleaved_pcm_reader::read_unformatted(void* const* channels, size_type frame_count) noexcept
+{
+  snd_xfern transfer {
+    0 /* result */,
+    const_cast<void**>(channels),
+    snd_pcm_uframes_t(frame_count),
+  };
+
+  auto err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_READN_FRAMES, &transfer);
+  if (err < 0) {
+
+    auto xrun_result = handle_xrun(errno);
+    if (xrun_result.failed()) {
+      return { xrun_result.error, 0 };
+    }
+
+    // The PCM was recovered, so the transfer is tried once more.
+    err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_READN_FRAMES, &transfer);
+    if (err < 0) {
+      return { errno, 0 };
+    }
+  }
+
+  return { 0, size_type(transfer.result) };
+}
+
+//=================================//
+// Section: Non-interleaved Writer //
+//=================================//
+
+result non_interleaved_pcm_writer::open(size_type card, size_type device, bool non_blocking) noexcept
+{
+  return pcm::open_playback_device(card, device, non_blocking);
+}
+
+generic_result<size_type> non_interleaved_pcm_writer::write_unformatted(const void* const* channels, size_type frame_count) noexcept
+{
+  snd_xfern transfer {
+    0 /* result */,
+    const_cast<void**>(channels),
+    snd_pcm_uframes_t(frame_count),
+  };
+
+  auto err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_WRITEN_FRAMES, &transfer);
+  if (err < 0) {
+
+    auto xrun_result = handle_xrun(errno);
+    if (xrun_result.failed()) {
+      return { xrun_result.error, 0 };
+    }
+
+    // The PCM was recovered, so the transfer is tried once more.
+    err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_WRITEN_FRAMES, &transfer);
+    if (err < 0) {
+      return { errno, 0 };
+    }
+  }
+
+  return { 0, size_type(transfer.result) };
+}
+
+//==============//
+// Section: PCM //
+//==============//
+
+/// Contains all the implementation data for a PCM.
+class pcm_impl final
+{
+  friend pcm;
+  friend mmap_pcm;
+  /// The file descriptor for the opened PCM.
+  int fd = invalid_fd();
+  /// The configuration applied by the last successful setup.
+  pcm_config config;
+  /// Whether or not a configuration has been applied.
+  bool is_setup = false;
+  /// Whether or not the PCM was set up as a capture device.
+  bool is_capture = false;
+  /// The access mode that the PCM was set up with.
+  sample_access access = sample_access::interleaved;
+  /// What to do when the PCM overruns, underruns or is suspended.
+  xrun_policy policy = xrun_policy::report;
+  /// Counts the overruns, underruns and suspensions.
+  xrun_counters counters;
+  /// Silent frames, made on the first recovery that fills
+  /// the buffer with silence. They're allocated, unless the
+  /// PCM has @ref pcm_impl::silence_storage.
+  unsigned char* silence = nullptr;
+  /// Points every channel at @ref pcm_impl::silence,
+  /// for non-interleaved PCMs.
+  void** silence_channels = nullptr;
+  /// The number of frames in @ref pcm_impl::silence.
+  size_type silence_frames = 0;
+  /// The memory given to @ref pcm::use_storage for the silence,
+  /// or null if the silence is allocated.
+  unsigned char* silence_storage = nullptr;
+  /// The value at which the hardware and
+  /// application pointers wrap back to zero.
+  snd_pcm_uframes_t boundary = 0;
+  /// The memory mapped audio buffer.
+  void* mmap_buffer = nullptr;
+  /// The size of the memory mapped audio buffer, in bytes.
+  size_type mmap_buffer_size = 0;
+  /// Points to either the memory mapped status page
+  /// or, if it could not be mapped, to @ref pcm_impl::sync_ptr.
+  snd_pcm_mmap_status* mmap_status = nullptr;
+  /// Points to either the memory mapped control page
+  /// or, if it could not be mapped, to @ref pcm_impl::sync_ptr.
+  snd_pcm_mmap_control* mmap_control = nullptr;
+  /// Whether or not the status and control data
+  /// is synchronized through @ref pcm_impl::sync_ptr.
+  bool uses_sync_ptr = false;
+  /// Holds the status and control data for
+  /// drivers that do not support mapping them.
+  snd_pcm_sync_ptr sync_ptr {};
+  /// The position found by the last call to @ref pcm::get_position.
+  pcm_position position;
+  /// Whether or not this was constructed in memory given
+  /// to @ref pcm::use_storage, rather than allocated.
+  bool in_storage = false;
+  /// Maps the audio buffer, status and control data.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result map() noexcept;
+  /// Unmaps anything mapped by @ref pcm_impl::map.
+  void unmap() noexcept;
+  /// Synchronizes the status and control data
+  /// with the driver, if they are not memory mapped.
+  ///
+  /// @param flags The SNDRV_PCM_SYNC_PTR_ flags to pass to the driver.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result sync(unsigned int flags) noexcept;
+  /// Maps the status and control data, or sets up
+  /// @ref pcm_impl::sync_ptr if they cannot be mapped.
+  /// Does nothing if they're already available.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result map_status() noexcept;
+  /// Calculates the number of frames that may be accessed
+  /// from the memory mapped buffer.
+  snd_pcm_uframes_t mmap_avail() const noexcept;
+  /// Accesses the memory mapped buffer as bytes.
+  unsigned char* mmap_buffer_bytes() noexcept
+  {
+    return static_cast<unsigned char*>(mmap_buffer);
+  }
+  /// Makes the silence buffers for the current
+  /// configuration, if they're missing.
+  ///
+  /// @return On success, zero is returned.
+  /// If the silence can't be allocated, or
+  /// doesn't fit in the storage, ENOMEM is returned.
+  result allocate_silence() noexcept;
+  /// Fills a prepared playback PCM with silence
+  /// up to its start threshold.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result prefill_silence() noexcept;
+  /// Releases the silence buffers, which
+  /// depend on the configuration.
+  void free_silence() noexcept
+  {
+    if (!silence_storage) {
+      std::free(silence);
+      std::free(silence_channels);
+    }
+    silence = nullptr;
+    silence_channels = nullptr;
+    silence_frames = 0;
+  }
+  /// Opens a PCM by a specified path.
+  ///
+  /// @param path The path of the PCM to open.
+  ///
+  /// @param non_blocking Whether or not the call to ::open
+  /// should block if the device is not available.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result open_by_path(const char* path, bool non_blocking) noexcept;
+public:
+  /// Releases the silence buffers.
+  ~pcm_impl()
+  {
+    free_silence();
+  }
+};
+
+static_assert(sizeof(pcm_impl) <= pcm_storage::size, "pcm_storage is too small for the PCM implementation data");
+
+static_assert(alignof(pcm_impl) <= alignof(pcm_storage), "pcm_storage is not aligned for the PCM implementation data");
+
+namespace {
+
+/// This function allocates an instance
+/// of the implementation data, if it is not null.
+///
+/// @param impl The current pointer to the implementation data.
+/// If this is null then a new one is allocated.
+///
+/// @return A pointer to either an existing implementation
+/// data instance, a new implementation data instance, or
+/// in the case of a memory allocation failure a null pointer.
+pcm_impl* lazy_init(pcm_impl* impl) noexcept
+{
+  if (impl) {
+    return impl;
+  }
+
+  return new (std::nothrow) pcm_impl();
+}
+
+} // namespace
+
+pcm::pcm() noexcept : self(nullptr) { }
+
+pcm::pcm(pcm&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+pcm::~pcm()
+{
+  close();
+
+  if (self && self->in_storage) {
+    self->~pcm_impl();
+  } else {
+    delete self;
+  }
+}
+
+result pcm::use_storage(pcm_storage& storage) noexcept
+{
+  if (self) {
+    return EBUSY;
+  }
+
+  self = new (storage.data) pcm_impl();
+  self->in_storage = true;
+  self->silence_storage = storage.silence;
+
+  return result();
+}
+
+int pcm::close() noexcept
+{
+  if (!self) {
+    return 0;
+  }
+
+  self->unmap();
+
+  self->is_setup = false;
+  self->position = pcm_position();
+
+  if (self->fd != invalid_fd()) {
+
+    auto result = pcm_close(self->fd);
+
+    self->fd = invalid_fd();
+
+    if (result == -1) {
+      return errno;
+    }
+  }
+
+  return 0;
+}
+
+int pcm::get_file_descriptor() const noexcept
+{
+  return self ? self->fd : invalid_fd();
+}
+
+bool pcm::is_open() const noexcept
+{
+  if (!self) {
+    return false;
+  }
+
+  return self->fd != invalid_fd();
+}
+
+result pcm::prepare() noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  auto err = pcm_ioctl(self->fd, SNDRV_PCM_IOCTL_PREPARE);
+  if (err < 0) {
+    return errno;
+  }
+
+  return result();
+}
+
+result pcm::setup(const pcm_config& config, sample_access access, bool is_capture) noexcept
+{
+  auto hw_params = to_alsa_hw_params(config, access);
+
+  auto err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_HW_PARAMS, &hw_params);
+  if (err < 0) {
+    return errno;
+  }
+
+  auto sw_params = to_alsa_sw_params(config, is_capture);
+
+  err = pcm_ioctl(get_file_descriptor(), SNDRV_PCM_IOCTL_SW_PARAMS, &sw_params);
+  if (err < 0) {
+    return errno;
+  }
+
+  self->config = config;
+  self->is_setup = true;
+  self->is_capture = is_capture;
+  self->position = pcm_position();
+  self->access = access;
+  self->boundary = sw_params.boundary;
+  self->free_silence();
+
+  // The silence is made now, so that a configuration whose
+  // silence doesn't fit in the storage fails to be set up
+  // rather than failing to recover.
+  if (self->silence_storage && !is_capture) {
+    return self->allocate_silence();
+  }
+
+  return 0;
+}
+
+namespace {
+
+/// Asks the driver to refine a set of hardware parameters.
+///
+/// @param fd The file descriptor of the PCM.
+/// @param params The parameters to refine.
+///
+/// @return On success, zero is returned.
+/// On failure, a copy of errno is returned.
+int refine(int fd, snd_pcm_hw_params& params) noexcept
+{
+  params.rmask = ~0U;
+  params.cmask = 0;
+
+  auto err = pcm_ioctl(fd, SNDRV_PCM_IOCTL_HW_REFINE, &params);
+  if (err < 0) {
+    return errno;
+  }
+
+  return 0;
+}
+
+/// Narrows an interval to the supported value
+/// that's closest to a desired value.
+///
+/// @tparam name The name of the interval to narrow.
+///
+/// @param fd The file descriptor of the PCM.
+/// @param params The parameters containing the interval.
+/// These should already be refined.
+/// @param desired The value that should be used, if possible.
+///
+/// @return On success, zero is returned.
+/// On failure, an errno value is returned.
+template <parameter_name name>
+int refine_nearest(int fd, snd_pcm_hw_params& params, size_type desired) noexcept
+{
+  using ref = interval_ref<name>;
+
+  using value_type = typename ref::value_type;
+
+  auto min = ref::get_min(params);
+  auto max = ref::get_max(params);
+
+  auto value = value_type(std::min(std::max(desired, size_type(min)), size_type(max)));
+
+  auto exact = params;
+  ref::set(exact, value);
+  if (refine(fd, exact) == 0) {
+    params = exact;
+    return 0;
+  }
+
+  // The range may contain holes (such as a list of rates),
+  // so the driver is asked for the nearest supported value
+  // on either side of the desired one.
+
+  auto above = params;
+  ref::set_range(above, value, max);
+  auto above_err = refine(fd, above);
+
+  auto below = params;
+  ref::set_range(below, min, value);
+  auto below_err = refine(fd, below);
+
+  if (above_err && below_err) {
+    return above_err;
+  }
+
+  auto above_value = ref::get_min(above);
+  auto below_value = ref::get_max(below);
+
+  if (below_err || (!above_err && ((above_value - value) < (value - below_value)))) {
+    ref::set(above, above_value);
+    params = above;
+  } else {
+    ref::set(below, below_value);
+    params = below;
+  }
+
+  return refine(fd, params);
+}
+
+/// Initializes hardware parameters that are
+/// restricted to one kind of sample access.
+snd_pcm_hw_params init_access_hw_parameters(sample_access access) noexcept
+{
+  auto params = init_hw_parameters();
+
+  mask_ref<SNDRV_PCM_HW_PARAM_ACCESS>::set(params, to_alsa_access(access));
+
+  return params;
+}
+
+/// The number of sample formats in the sample format enumeration.
+constexpr unsigned int sample_format_count = unsigned(sample_format::u32_be) + 1;
+
+} // namespace
+
+generic_result<pcm_capabilities> pcm::get_capabilities(sample_access access) const noexcept
+{
+  using result_type = generic_result<pcm_capabilities>;
+
+  if (!self) {
+    return result_type { ENOENT };
+  }
+
+  auto params = init_access_hw_parameters(access);
+
+  auto err = refine(self->fd, params);
+  if (err) {
+    return result_type { err };
+  }
+
+  pcm_capabilities caps;
+
+  caps.channels.min     = interval_ref<SNDRV_PCM_HW_PARAM_CHANNELS>::get_min(params);
+  caps.channels.max     = interval_ref<SNDRV_PCM_HW_PARAM_CHANNELS>::get_max(params);
+  caps.rate.min         = interval_ref<SNDRV_PCM_HW_PARAM_RATE>::get_min(params);
+  caps.rate.max         = interval_ref<SNDRV_PCM_HW_PARAM_RATE>::get_max(params);
+  caps.period_size.min  = interval_ref<SNDRV_PCM_HW_PARAM_PERIOD_SIZE>::get_min(params);
+  caps.period_size.max  = interval_ref<SNDRV_PCM_HW_PARAM_PERIOD_SIZE>::get_max(params);
+  caps.period_count.min = interval_ref<SNDRV_PCM_HW_PARAM_PERIODS>::get_min(params);
+  caps.period_count.max = interval_ref<SNDRV_PCM_HW_PARAM_PERIODS>::get_max(params);
+  caps.buffer_size.min  = interval_ref<SNDRV_PCM_HW_PARAM_BUFFER_SIZE>::get_min(params);
+  caps.buffer_size.max  = interval_ref<SNDRV_PCM_HW_PARAM_BUFFER_SIZE>::get_max(params);
+
+  for (unsigned int i = 0; i < sample_format_count; i++) {
+    auto alsa_format = to_alsa_format(sample_format(i));
+    if (mask_ref<SNDRV_PCM_HW_PARAM_FORMAT>::test(params, alsa_format)) {
+      caps.formats |= std::uint32_t(1) << i;
+    }
+  }
+
+  return result_type { 0, caps };
+}
+
+generic_result<pcm_config> pcm::get_nearest_config(const pcm_config& config, sample_access access) const noexcept
+{
+  using result_type = generic_result<pcm_config>;
+
+  if (!self) {
+    return result_type { ENOENT };
+  }
+
+  // The common case is that the whole configuration
+  // is supported, which only takes one refinement.
+
+  auto exact = to_alsa_hw_params(config, access);
+  if (refine(self->fd, exact) == 0) {
+    return result_type { 0, config };
+  }
+
+  auto params = init_access_hw_parameters(access);
+
+  auto err = refine(self->fd, params);
+  if (err) {
+    return result_type { err };
+  }
+
+  // Choose the supported format that's closest in width,
+  // preferring formats with the same signedness.
+
+  auto format = config.format;
+
+  if (!mask_ref<SNDRV_PCM_HW_PARAM_FORMAT>::test(params, to_alsa_format(format))) {
+
+    auto desired_bits = to_physical_bits(config.format);
+    auto desired_signed = to_layout(config.format).is_signed;
+
+    size_type best_score = std::numeric_limits<size_type>::max();
+
+    for (unsigned int i = 0; i < sample_format_count; i++) {
+
+      auto candidate = sample_format(i);
+
+      if (!mask_ref<SNDRV_PCM_HW_PARAM_FORMAT>::test(params, to_alsa_format(candidate))) {
+        continue;
+      }
+
+      auto bits = to_physical_bits(candidate);
+
+      auto score = size_type((bits > desired_bits) ? (bits - desired_bits) : (desired_bits - bits)) * 2;
+      score += (to_layout(candidate).is_signed == desired_signed) ? 0 : 1;
+
+      if (score < best_score) {
+        best_score = score;
+        format = candidate;
+      }
+    }
+
+    if (best_score == std::numeric_limits<size_type>::max()) {
+      return result_type { EINVAL };
+    }
+  }
+
+  mask_ref<SNDRV_PCM_HW_PARAM_FORMAT>::set(params, to_alsa_format(format));
+
+  err = refine(self->fd, params);
+  if (err) {
+    return result_type { err };
+  }
+
+  err = refine_nearest<SNDRV_PCM_HW_PARAM_CHANNELS>(self->fd, params, config.channels);
+  if (err) {
+    return result_type { err };
+  }
+
+  err = refine_nearest<SNDRV_PCM_HW_PARAM_RATE>(self->fd, params, config.rate);
+  if (err) {
+    return result_type { err };
+  }
+
+  err = refine_nearest<SNDRV_PCM_HW_PARAM_PERIOD_SIZE>(self->fd, params, config.period_size);
+  if (err) {
+    return result_type { err };
+  }
+
+  err = refine_nearest<SNDRV_PCM_HW_PARAM_PERIODS>(self->fd, params, config.period_count);
+  if (err) {
+    return result_type { err };
+  }
+
+  auto nearest = config;
+  nearest.format       = format;
+  nearest.channels     = interval_ref<SNDRV_PCM_HW_PARAM_CHANNELS>::get_min(params);
+  nearest.rate         = interval_ref<SNDRV_PCM_HW_PARAM_RATE>::get_min(params);
+  nearest.period_size  = interval_ref<SNDRV_PCM_HW_PARAM_PERIOD_SIZE>::get_min(params);
+  nearest.period_count = interval_ref<SNDRV_PCM_HW_PARAM_PERIODS>::get_min(params);
+
+  return result_type { 0, nearest };
+}
+
+result pcm::start() noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  auto err = pcm_ioctl(self->fd, SNDRV_PCM_IOCTL_START);
+  if (err < 0) {
+    return errno;
+  }
+
+  return result();
+}
+
+result pcm::drop() noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  auto err = pcm_ioctl(self->fd, SNDRV_PCM_IOCTL_DROP);
+  if (err < 0) {
+    return errno;
+  }
+
+  return result();
+}
+
+size_type pcm::get_frame_size() const noexcept
+{
+  if (!self || !self->is_setup) {
+    return 0;
+  }
+
+  return to_frame_size(self->config);
+}
+
+result pcm::wait(int timeout_ms) noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  pollfd pfd { self->fd, POLLIN | POLLOUT | POLLERR | POLLNVAL, 0 };
+
+  for (;;) {
+
+    auto err = pcm_poll(&pfd, 1, timeout_ms);
+    if (err < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    } else if (err == 0) {
+      return ETIMEDOUT;
+    }
+
+    break;
+  }
+
+  if (pfd.revents & POLLNVAL) {
+    return EBADF;
+  } else if (pfd.revents & POLLERR) {
+    return EPIPE;
+  }
+
+  return result();
+}
+
+generic_result<pcm_info> pcm::get_info() const noexcept
+{
+  using result_type = generic_result<pcm_info>;
+
+  if (!self) {
+    return result_type { ENOENT };
+  }
+
+  snd_pcm_info native_info;
+
+  int err = pcm_ioctl(self->fd, SNDRV_PCM_IOCTL_INFO, &native_info);
+  if (err != 0) {
+    return result_type { errno };
+  }
+
+  return result_type { 0, to_tinyalsa_info(native_info) };
+}
+
+generic_result<pcm_status> pcm::get_status() const noexcept
+{
+  using result_type = generic_result<pcm_status>;
+
+  if (!self) {
+    return result_type { ENOENT };
+  }
+
+  snd_pcm_status native_status {};
+
+  // Asks for the audio timestamp to come from the link
+  // clock of the device. Drivers that don't have one
+  // fall back to deriving it from the hardware position.
+  native_status.audio_tstamp_data = SNDRV_PCM_AUDIO_TSTAMP_TYPE_LINK;
+
+  if (pcm_ioctl(self->fd, SNDRV_PCM_IOCTL_STATUS_EXT, &native_status) < 0) {
+
+    if ((errno != ENOTTY) && (errno != EINVAL)) {
+      return result_type { errno };
+    }
+
+    // Kernels older than 4.0 don't support the extended query.
+    native_status = snd_pcm_status {};
+
+    if (pcm_ioctl(self->fd, SNDRV_PCM_IOCTL_STATUS, &native_status) < 0) {
+      return result_type { errno };
+    }
+  }
+
+  return result_type { 0, to_tinyalsa_status(native_status, self->is_capture) };
+}
+
+generic_result<std::int64_t> pcm::get_delay() const noexcept
+{
+  using result_type = generic_result<std::int64_t>;
+
+  if (!self) {
+    return result_type { ENOENT, 0 };
+  }
+
+  snd_pcm_sframes_t delay = 0;
+
+  if (pcm_ioctl(self->fd, SNDRV_PCM_IOCTL_DELAY, &delay) < 0) {
+    return result_type { errno, 0 };
+  }
+
+  return result_type { 0, std::int64_t(delay) };
+}
+
+result pcm::open_capture_device(size_type card, size_type device, bool non_blocking) noexcept
+{
+  self = lazy_init(self);
+  if (!self) {
+    return result { ENOMEM };
+  }
+
+  char path[256];
+
+  snprintf(path, sizeof(path), "/dev/snd/pcmC%luD%luc",
+           (unsigned long) card,
+           (unsigned long) device);
+
+  return self->open_by_path(path, non_blocking);
+}
+
+result pcm::open_playback_device(size_type card, size_type device, bool non_blocking) noexcept
+{
+  self = lazy_init(self);
+  if (!self) {
+    return result { ENOMEM };
+  }
+
+  char path[256];
+
+  snprintf(path, sizeof(path), "/dev/snd/pcmC%luD%lup",
+           (unsigned long) card,
+           (unsigned long) device);
+
+  return self->open_by_path(path, non_blocking);
+}
+
+result pcm_impl::open_by_path(const char* path, bool non_blocking) noexcept
+{
+  if (fd != invalid_fd()) {
+    pcm_close(fd);
+  }
+
+  fd = pcm_open(path, non_blocking ? (O_RDWR | O_NONBLOCK) : O_RDWR);
+  if (fd < 0) {
+    fd = invalid_fd();
+    return result { errno };
+  } else {
+    return result { 0 };
+  }
+}
+
+//============================//
+// Section: Memory Mapped PCM //
+//============================//
+
+result pcm_impl::map() noexcept
+{
+  unmap();
+
+  mmap_buffer_size = config.period_size * config.period_count * to_frame_size(config);
+
+  auto* buffer = pcm_mmap(mmap_buffer_size, PROT_READ | PROT_WRITE,
+                          fd, SNDRV_PCM_MMAP_OFFSET_DATA);
+  if (buffer == MAP_FAILED) {
+    mmap_buffer_size = 0;
+    return errno;
+  }
+
+  mmap_buffer = buffer;
+
+  auto status_result = map_status();
+  if (status_result.failed()) {
+    unmap();
+    return status_result;
+  }
+
+  mmap_control->avail_min = config.period_size;
+
+  auto sync_result = sync(0);
+  if (sync_result.failed()) {
+    unmap();
+  }
+
+  return sync_result;
+}
+
+result pcm_impl::map_status() noexcept
+{
+  if (mmap_status) {
+    return result();
+  }
+
+  auto page_size = size_type(sysconf(_SC_PAGESIZE));
+
+  auto* status = pcm_mmap(page_size, PROT_READ,
+                          fd, SNDRV_PCM_MMAP_OFFSET_STATUS);
+
+  auto* control = pcm_mmap(page_size, PROT_READ | PROT_WRITE,
+                           fd, SNDRV_PCM_MMAP_OFFSET_CONTROL);
+
+  if ((status != MAP_FAILED) && (control != MAP_FAILED)) {
+    mmap_status = (snd_pcm_mmap_status*) status;
+    mmap_control = (snd_pcm_mmap_control*) control;
+    return result();
+  }
+
+  // Some drivers (or architectures) do not allow the
+  // status and control data to be mapped, in which
+  // case it has to be synchronized with an ioctl.
+
+  if (status != MAP_FAILED) {
+    pcm_munmap(status, page_size);
+  }
+
+  if (control != MAP_FAILED) {
+    pcm_munmap(control, page_size);
+  }
+
+  sync_ptr = snd_pcm_sync_ptr {};
+  mmap_status = &sync_ptr.s.status;
+  mmap_control = &sync_ptr.c.control;
+  uses_sync_ptr = true;
+
+  // Fetches the application pointer and wake up threshold,
+  // so that the zeroed copies here are not sent to the driver.
+  auto sync_result = sync(SNDRV_PCM_SYNC_PTR_APPL | SNDRV_PCM_SYNC_PTR_AVAIL_MIN);
+  if (sync_result.failed()) {
+    mmap_status = nullptr;
+    mmap_control = nullptr;
+    uses_sync_ptr = false;
+    return sync_result;
+  }
+
+  return result();
+}
+
+void pcm_impl::unmap() noexcept
+{
+  if (mmap_buffer) {
+    pcm_munmap(mmap_buffer, mmap_buffer_size);
+    mmap_buffer = nullptr;
+    mmap_buffer_size = 0;
+  }
+
+  if (!uses_sync_ptr) {
+
+    auto page_size = size_type(sysconf(_SC_PAGESIZE));
+
+    if (mmap_status) {
+      pcm_munmap(mmap_status, page_size);
+    }
+
+    if (mmap_control) {
+      pcm_munmap(mmap_control, page_size);
+    }
+  }
+
+  mmap_status = nullptr;
+  mmap_control = nullptr;
+  uses_sync_ptr = false;
+}
+
+result pcm_impl::sync(unsigned int flags) noexcept
+{
+  if (!uses_sync_ptr) {
+    return result();
+  }
+
+  sync_ptr.flags = flags;
+
+  auto err = pcm_ioctl(fd, SNDRV_PCM_IOCTL_SYNC_PTR, &sync_ptr);
+  if (err < 0) {
+    return errno;
+  }
+
+  return result();
+}
+
+snd_pcm_uframes_t pcm_impl::mmap_avail() const noexcept
+{
+  auto buffer_size = snd_pcm_sframes_t(config.period_size * config.period_count);
+
+  auto hw_ptr = snd_pcm_sframes_t(mmap_status->hw_ptr);
+
+  auto appl_ptr = snd_pcm_sframes_t(mmap_control->appl_ptr);
+
+  snd_pcm_sframes_t avail = 0;
+
+  if (is_capture) {
+    avail = hw_ptr - appl_ptr;
+    if (avail < 0) {
+      avail += boundary;
+    }
+  } else {
+    avail = hw_ptr + buffer_size - appl_ptr;
+    if (avail < 0) {
+      avail += boundary;
+    } else if (snd_pcm_uframes_t(avail) >= boundary) {
+      avail -= boundary;
+    }
+  }
+
+  return snd_pcm_uframes_t(avail);
+}
+
+namespace {
+
+/// Checks the state of a memory mapped PCM
+/// for conditions that prevent access to the buffer.
+///
+/// @param state The state reported by the status data.
+///
+/// @return Zero if the buffer may be accessed,
+/// an errno value otherwise.
+constexpr int check_mmap_state(snd_pcm_state_t state) noexcept
+{
+  switch (state) {
+    case SNDRV_PCM_STATE_XRUN:
+      return EPIPE;
+    case SNDRV_PCM_STATE_SUSPENDED:
+      return ESTRPIPE;
+    case SNDRV_PCM_STATE_DISCONNECTED:
+      return ENODEV;
+    default:
+      break;
+  }
+
+  return 0;
+}
+
+} // namespace
+
+mmap_pcm::~mmap_pcm() { }
+
+result mmap_pcm::setup(const pcm_config& config, bool is_capture) noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  self->unmap();
+
+  auto access = sample_access::mmap_interleaved;
+
+  auto setup_result = pcm::setup(config, access, is_capture);
+  if (setup_result.failed()) {
+    return setup_result;
+  }
+
+  return self->map();
+}
+
+generic_result<size_type> mmap_pcm::available() noexcept
+{
+  using result_type = generic_result<size_type>;
+
+  if (!self) {
+    return result_type { ENOENT };
+  } else if (!self->mmap_buffer) {
+    return result_type { EBADFD };
+  }
+
+  auto sync_result = self->sync(SNDRV_PCM_SYNC_PTR_HWSYNC);
+  if (sync_result.failed()) {
+    return result_type { sync_result.error };
+  }
+
+  auto err = check_mmap_state(self->mmap_status->state);
+  if (err) {
+
+    auto xrun_result = handle_xrun(err);
+    if (xrun_result.failed()) {
+      return result_type { xrun_result.error };
+    }
+
+    sync_result = self->sync(SNDRV_PCM_SYNC_PTR_APPL | SNDRV_PCM_SYNC_PTR_AVAIL_MIN);
+    if (sync_result.failed()) {
+      return result_type { sync_result.error };
+    }
+
+    err = check_mmap_state(self->mmap_status->state);
+    if (err) {
+      return result_type { err };
+    }
+  }
+
+  return result_type { 0, size_type(self->mmap_avail()) };
+}
+
+generic_result<mmap_region> mmap_pcm::begin(size_type frame_count) noexcept
+{
+  using result_type = generic_result<mmap_region>;
+
+  auto avail_result = available();
+  if (avail_result.failed()) {
+    return result_type { avail_result.error };
+  }
+
+  auto buffer_size = self->config.period_size * self->config.period_count;
+
+  auto offset = size_type(self->mmap_control->appl_ptr % buffer_size);
+
+  frame_count = std::min(frame_count, avail_result.unwrap());
+  frame_count = std::min(frame_count, buffer_size - offset);
+
+  mmap_region region;
+  region.frames = ((unsigned char*) self->mmap_buffer) + (offset * to_frame_size(self->config));
+  region.frame_count = frame_count;
+
+  return result_type { 0, region };
+}
+
+result mmap_pcm::commit(size_type frame_count) noexcept
+{
+  if (!self) {
+    return ENOENT;
+  } else if (!self->mmap_buffer) {
+    return EBADFD;
+  } else if (frame_count > self->mmap_avail()) {
+    return EINVAL;
+  }
+
+  auto appl_ptr = self->mmap_control->appl_ptr + frame_count;
+  if (appl_ptr >= self->boundary) {
+    appl_ptr -= self->boundary;
+  }
+
+  self->mmap_control->appl_ptr = appl_ptr;
+
+  return self->sync(0);
+}
+
+mmap_pcm_reader::~mmap_pcm_reader() { }
+
+result mmap_pcm_reader::open(size_type card, size_type device, bool non_blocking) noexcept
+{
+  return pcm::open_capture_device(card, device, non_blocking);
+}
+
+mmap_pcm_writer::~mmap_pcm_writer() { }
+
+result mmap_pcm_writer::open(size_type card, size_type device, bool non_blocking) noexcept
+{
+  return pcm::open_playback_device(card, device, non_blocking);
+}
+
+//=======================//
+// Section: PCM Position //
+//=======================//
+
+namespace {
+
+/// Tells the processor that the thread is spinning,
+/// which saves power and yields to a sibling hyperthread.
+inline void cpu_relax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield" ::: "memory");
+#endif
+}
+
+/// Calculates the number of milliseconds left until a deadline.
+///
+/// @param deadline The deadline, on the monotonic clock.
+/// A negative deadline never expires.
+///
+/// @return The number of milliseconds left, rounded up.
+/// If the deadline is infinite, -1 is returned.
+int remaining_ms(std::int64_t deadline) noexcept
+{
+  if (deadline < 0) {
+    return -1;
+  }
+
+  auto remaining = deadline - get_timestamp(pcm_timestamp_type::monotonic);
+  if (remaining <= 0) {
+    return 0;
+  }
+
+  return int((remaining + 999999) / 1000000);
+}
+
+} // namespace
+
+generic_result<pcm_position> pcm::get_position(bool hardware_sync) noexcept
+{
+  using result_type = generic_result<pcm_position>;
+
+  if (!self) {
+    return result_type { ENOENT };
+  } else if (!self->is_setup) {
+    return result_type { EBADFD };
+  }
+
+  auto map_result = self->map_status();
+  if (map_result.failed()) {
+    return result_type { map_result.error };
+  }
+
+  if (self->uses_sync_ptr) {
+
+    // The application pointer and wake up threshold are
+    // fetched rather than sent, since the ones here may be stale.
+    unsigned int flags = SNDRV_PCM_SYNC_PTR_APPL | SNDRV_PCM_SYNC_PTR_AVAIL_MIN;
+
+    if (hardware_sync) {
+      flags |= SNDRV_PCM_SYNC_PTR_HWSYNC;
+    }
+
+    auto sync_result = self->sync(flags);
+    if (sync_result.failed()) {
+      return result_type { sync_result.error };
+    }
+
+  } else if (hardware_sync) {
+    if (pcm_ioctl(self->fd, SNDRV_PCM_IOCTL_HWSYNC) < 0) {
+      return result_type { errno };
+    }
+  }
+
+  pcm_position position;
+  position.state = to_tinyalsa_state(self->mmap_status->state);
+  position.hw_ptr = self->mmap_status->hw_ptr;
+  position.appl_ptr = self->mmap_control->appl_ptr;
+  position.avail = self->mmap_avail();
+  position.timestamp = to_nanoseconds(self->mmap_status->tstamp);
+
+  self->position = position;
+
+  return result_type { 0, position };
+}
+
+pcm_position pcm::get_cached_position() const noexcept
+{
+  return self ? self->position : pcm_position();
+}
+
+result pcm::wait_hybrid(int timeout_ms, size_type spin_us) noexcept
+{
+  if (!self) {
+    return ENOENT;
+  } else if (!self->is_setup) {
+    return EBADFD;
+  }
+
+  std::int64_t deadline = -1;
+
+  if (timeout_ms >= 0) {
+    deadline = get_timestamp(pcm_timestamp_type::monotonic) + (std::int64_t(timeout_ms) * 1000000);
+  }
+
+  auto period_size = self->config.period_size;
+
+  auto rate = std::max(self->config.rate, size_type(1));
+
+  for (;;) {
+
+    // Without a hardware sync, the position only moves on period
+    // interrupts, so spinning on it would not end any earlier.
+    auto position_result = get_position(true);
+    if (position_result.failed()) {
+      return position_result.error;
+    }
+
+    auto position = position_result.unwrap();
+
+    if (position.state == pcm_state::xrun) {
+      return EPIPE;
+    } else if (position.state == pcm_state::suspended) {
+      return ESTRPIPE;
+    } else if (position.state == pcm_state::disconnected) {
+      return ENODEV;
+    }
+
+    if (position.avail >= period_size) {
+      return result();
+    }
+
+    auto time_left = remaining_ms(deadline);
+    if (time_left == 0) {
+      return ETIMEDOUT;
+    }
+
+    // The position only moves while the stream runs,
+    // so there's nothing to predict or spin on otherwise.
+    if (position.state != pcm_state::running) {
+      return wait(time_left);
+    }
+
+    auto expected_us = ((period_size - position.avail) * 1000000) / rate;
+
+    if (expected_us > spin_us) {
+
+      // Sleeps until the spinning should start. If the
+      // period completes first, poll() returns early.
+      auto sleep_ms = int((expected_us - spin_us) / 1000);
+
+      if ((time_left > 0) && (sleep_ms > time_left)) {
+        sleep_ms = time_left;
+      }
+
+      if (sleep_ms > 0) {
+
+        pollfd pfd { self->fd, POLLIN | POLLOUT | POLLERR | POLLNVAL, 0 };
+
+        auto err = pcm_poll(&pfd, 1, sleep_ms);
+        if ((err < 0) && (errno != EINTR)) {
+          return errno;
+        } else if ((err > 0) && (pfd.revents & POLLNVAL)) {
+          return EBADF;
+        }
+
+        continue;
+      }
+    }
+
+    cpu_relax();
+  }
+}
+
+//========================//
+// Section: Xrun Recovery //
+//========================//
+
+namespace {
+
+/// The number of times a suspended PCM is asked
+/// to resume, about a millisecond apart, before
+/// it is prepared instead.
+constexpr int max_resume_attempts = 10;
+
+} // namespace
+
+result pcm_impl::allocate_silence() noexcept
+{
+  if (silence) {
+    return result();
+  }
+
+  auto frame_size = to_frame_size(config);
+
+  auto channels = std::max(config.channels, size_type(1));
+
+  auto sample_size = frame_size / channels;
+
+  auto is_non_interleaved = (access == sample_access::non_interleaved);
+
+  // Each channel of a non-interleaved PCM reads from the same
+  // samples, so only one channel's worth of them is needed.
+  auto stride = is_non_interleaved ? sample_size : frame_size;
+
+  if (silence_storage) {
+
+    // The channel pointers come first, followed by the samples.
+    auto pointers_size = is_non_interleaved ? (channels * sizeof(void*)) : 0;
+
+    if ((pointers_size + stride) > pcm_storage::silence_size) {
+      return ENOMEM;
+    }
+
+    if (is_non_interleaved) {
+      silence_channels = reinterpret_cast<void**>(silence_storage);
+    }
+
+    silence = silence_storage + pointers_size;
+    silence_frames = (pcm_storage::silence_size - pointers_size) / stride;
+
+  } else {
+
+    silence = (unsigned char*) std::malloc(config.period_size * stride);
+    if (!silence) {
+      return ENOMEM;
+    }
+
+    if (is_non_interleaved) {
+      silence_channels = (void**) std::malloc(channels * sizeof(void*));
+      if (!silence_channels) {
+        free_silence();
+        return ENOMEM;
+      }
+    }
+
+    silence_frames = config.period_size;
+  }
+
+  std::int32_t zero = 0;
+
+  convert_from_int32(&zero, config.format, silence, 1);
+
+  for (size_type i = sample_size; i < (silence_frames * stride); i++) {
+    silence[i] = silence[i % sample_size];
+  }
+
+  // Every channel reads from the same silent buffer.
+  if (is_non_interleaved) {
+    for (size_type i = 0; i < channels; i++) {
+      silence_channels[i] = silence;
+    }
+  }
+
+  return result();
+}
+
+result pcm_impl::prefill_silence() noexcept
+{
+  auto silence_result = allocate_silence();
+  if (silence_result.failed()) {
+    return silence_result;
+  }
+
+  auto sample_size = to_frame_size(config) / std::max(config.channels, size_type(1));
+
+  auto buffer_size = config.period_size * config.period_count;
+
+  // Writing up to the start threshold makes the stream start again.
+  auto start_threshold = size_type(to_alsa_sw_params(config, false).start_threshold);
+
+  auto frame_count = std::min(start_threshold, buffer_size);
+
+  if (mmap_buffer) {
+
+    // Every sample is the same, so the layout of the buffer does not matter.
+    for (size_type i = 0; i < mmap_buffer_size; i++) {
+      mmap_buffer_bytes()[i] = silence[i % sample_size];
+    }
+
+    auto appl_ptr = mmap_control->appl_ptr + frame_count;
+    if (appl_ptr >= boundary) {
+      appl_ptr -= boundary;
+    }
+
+    mmap_control->appl_ptr = appl_ptr;
+
+    if (uses_sync_ptr) {
+      auto sync_result = sync(SNDRV_PCM_SYNC_PTR_AVAIL_MIN);
+      if (sync_result.failed()) {
+        return sync_result;
+      }
+    } else {
+      // The driver only reads a mapped control page when it's told
+      // to, so the new position is handed to it explicitly.
+      snd_pcm_sync_ptr update {};
+      update.flags = SNDRV_PCM_SYNC_PTR_AVAIL_MIN;
+      update.c.control.appl_ptr = appl_ptr;
+      if (pcm_ioctl(fd, SNDRV_PCM_IOCTL_SYNC_PTR, &update) < 0) {
+        return errno;
+      }
+    }
+
+    // Moving the application pointer does not start the
+    // stream like a write does, so it is started here
+    // once the start threshold is reached.
+    if (frame_count >= start_threshold) {
+      if (pcm_ioctl(fd, SNDRV_PCM_IOCTL_START) < 0) {
+        return errno;
+      }
+    }
+
+    return result();
+  }
+
+  while (frame_count > 0) {
+
+    auto chunk = snd_pcm_uframes_t(std::min(frame_count, silence_frames));
+
+    int err = 0;
+
+    if (access == sample_access::non_interleaved) {
+      snd_xfern transfer { 0, silence_channels, chunk };
+      err = pcm_ioctl(fd, SNDRV_PCM_IOCTL_WRITEN_FRAMES, &transfer);
+      chunk = snd_pcm_uframes_t(transfer.result);
+    } else {
+      snd_xferi transfer { 0, silence, chunk };
+      err = pcm_ioctl(fd, SNDRV_PCM_IOCTL_WRITEI_FRAMES, &transfer);
+      chunk = snd_pcm_uframes_t(transfer.result);
+    }
+
+    if (err < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN) {
+        // The buffer is full, so it started anyway.
+        break;
+      }
+      return errno;
+    }
+
+    frame_count -= std::min(frame_count, size_type(chunk));
+  }
+
+  return result();
+}
+
+result pcm::set_xrun_policy(xrun_policy policy) noexcept
+{
+  self = lazy_init(self);
+  if (!self) {
+    return ENOMEM;
+  }
+
+  self->policy = policy;
+
+  return result();
+}
+
+xrun_policy pcm::get_xrun_policy() const noexcept
+{
+  return self ? self->policy : xrun_policy::report;
+}
+
+xrun_counters pcm::get_xrun_counters() const noexcept
+{
+  return self ? self->counters : xrun_counters();
+}
+
+void pcm::reset_xrun_counters() noexcept
+{
+  if (self) {
+    self->counters = xrun_counters();
+  }
+}
+
+result pcm::handle_xrun(int error) noexcept
+{
+  if (!self) {
+    return error;
+  }
+
+  if (error == EPIPE) {
+    if (self->is_capture) {
+      self->counters.overruns++;
+    } else {
+      self->counters.underruns++;
+    }
+  } else if (error == ESTRPIPE) {
+    self->counters.suspends++;
+  } else {
+    return error;
+  }
+
+  if (self->policy == xrun_policy::report) {
+    return error;
+  }
+
+  return recover(error);
+}
+
+result pcm::recover(int error) noexcept
+{
+  if (!self || ((error != EPIPE) && (error != ESTRPIPE))) {
+    return error;
+  }
+
+  auto clock = self->config.timestamp_type;
+
+  auto begin_time = get_timestamp(clock);
+
+  // Captured frames still in the buffer are discarded by
+  // the recovery, and nothing is captured or played from
+  // the time the stream stopped until it is started again.
+  size_type frames_lost = 0;
+
+  std::int64_t stop_time = 0;
+
+  auto status_result = get_status();
+  if (!status_result.failed()) {
+    auto status = status_result.unwrap();
+    if (self->is_capture) {
+      frames_lost = std::min(status.avail, self->config.period_size * self->config.period_count);
+    }
+    stop_time = status.trigger_timestamp;
+  }
+
+  result recover_result;
+
+  if (error == ESTRPIPE) {
+
+    // Resuming is not instant, and not every driver supports it.
+    // Rather than waiting for it indefinitely, the PCM is prepared
+    // instead, which the kernel does once the card is powered up.
+    for (int attempts = 0; attempts < max_resume_attempts; attempts++) {
+      if (pcm_ioctl(self->fd, SNDRV_PCM_IOCTL_RESUME) == 0) {
+        recover_result = result();
+        break;
+      }
+      recover_result = result(errno);
+      if (errno != EAGAIN) {
+        break;
+      }
+      ::poll(nullptr, 0, 1);
+    }
+  }
+
+  if ((error == EPIPE) || recover_result.failed()) {
+
+    recover_result = prepare();
+
+    // Preparing moves the application pointer, so a
+    // copy of it kept for the driver has to be refreshed.
+    if (!recover_result.failed() && self->mmap_status) {
+      recover_result = self->sync(SNDRV_PCM_SYNC_PTR_APPL | SNDRV_PCM_SYNC_PTR_AVAIL_MIN);
+    }
+
+    if (!recover_result.failed()) {
+      if (self->is_capture) {
+        recover_result = start();
+      } else if (self->policy == xrun_policy::prefill_silence) {
+        recover_result = self->prefill_silence();
+      }
+    }
+  }
+
+  auto end_time = get_timestamp(clock);
+
+  auto recovery_time = end_time - begin_time;
+
+  if ((stop_time > 0) && (end_time > stop_time)) {
+    frames_lost += size_type(((end_time - stop_time) * std::int64_t(self->config.rate)) / 1000000000);
+  }
+
+  auto& counters = self->counters;
+
+  if (recover_result.failed()) {
+    counters.failed_recoveries++;
+  } else {
+    counters.recoveries++;
+  }
+
+  counters.frames_lost += frames_lost;
+  counters.recovery_time += recovery_time;
+  counters.max_recovery_time = std::max(counters.max_recovery_time, recovery_time);
+
+  return recover_result;
+}
+
+//=====================//
+// Section: Frame Ring //
+//=====================//
+
+/// Contains the implementation data of a frame ring.
+/// The producer and consumer indices are kept
+/// on separate cache lines, so that the two threads
+/// do not invalidate each other's caches.
+class frame_ring_impl final
+{
+  friend frame_ring;
+  /// The size of a cache line, used to separate
+  /// data written by the producer and consumer.
+  static constexpr size_type cache_line_size = 64;
+  /// The frames of the ring.
+  unsigned char* buffer = nullptr;
+  /// The number of frames in the ring.
+  size_type capacity = 0;
+  /// The number of bytes in one frame.
+  size_type frame_size = 0;
+  /// Used to wake the consumer.
+  int event_fd = invalid_fd();
+  /// Keeps the data above off the producer's cache line.
+  unsigned char producer_padding[cache_line_size];
+  /// The total number of frames written.
+  std::atomic<size_type> write_index { 0 };
+  /// The producer's last known value of the read index.
+  size_type cached_read_index = 0;
+  /// Keeps the producer's data off of the consumer's cache line.
+  unsigned char consumer_padding[cache_line_size];
+  /// The total number of frames read.
+  std::atomic<size_type> read_index { 0 };
+  /// The consumer's last known value of the write index.
+  size_type cached_write_index = 0;
+  /// Set while the consumer is blocked on the event file descriptor.
+  std::atomic<bool> consumer_waiting { false };
+  /// Keeps the consumer's data off of the next cache line.
+  unsigned char tail_padding[cache_line_size];
+public:
+  /// Releases the ring buffer and event file descriptor.
+  ~frame_ring_impl()
+  {
+    std::free(buffer);
+    if (event_fd != invalid_fd()) {
+      ::close(event_fd);
+    }
+  }
+  /// Gets a pointer to the frame at a ring index.
+  inline unsigned char* frame_at(size_type index) noexcept
+  {
+    return buffer + ((index & (capacity - 1)) * frame_size);
+  }
+};
+
+frame_ring::frame_ring() noexcept : self(nullptr) { }
+
+frame_ring::frame_ring(frame_ring&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+frame_ring::~frame_ring()
+{
+  delete self;
+}
+
+result frame_ring::allocate(size_type frame_capacity, size_type frame_size) noexcept
+{
+  if (!frame_capacity || !frame_size) {
+    return EINVAL;
+  }
+
+  size_type capacity = 1;
+
+  while (capacity < frame_capacity) {
+    capacity <<= 1;
+  }
+
+  delete self;
+
+  self = new (std::nothrow) frame_ring_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  void* buffer = nullptr;
+
+  auto err = ::posix_memalign(&buffer, frame_ring_impl::cache_line_size, capacity * frame_size);
+  if (err != 0) {
+    delete self;
+    self = nullptr;
+    return err;
+  }
+
+  self->buffer = static_cast<unsigned char*>(buffer);
+  self->capacity = capacity;
+  self->frame_size = frame_size;
+
+  self->event_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (self->event_fd < 0) {
+    err = errno;
+    self->event_fd = invalid_fd();
+    delete self;
+    self = nullptr;
+    return err;
+  }
+
+  return result();
+}
+
+size_type frame_ring::capacity() const noexcept
+{
+  return self ? self->capacity : 0;
+}
+
+size_type frame_ring::frame_size() const noexcept
+{
+  return self ? self->frame_size : 0;
+}
+
+int frame_ring::get_file_descriptor() const noexcept
+{
+  return self ? self->event_fd : invalid_fd();
+}
+
+size_type frame_ring::writable() noexcept
+{
+  if (!self) {
+    return 0;
+  }
+
+  auto write_index = self->write_index.load(std::memory_order_relaxed);
+
+  auto space = self->capacity - (write_index - self->cached_read_index);
+  if (space == 0) {
+    self->cached_read_index = self->read_index.load(std::memory_order_acquire);
+    space = self->capacity - (write_index - self->cached_read_index);
+  }
+
+  return space;
+}
+
+ring_region frame_ring::begin_write(size_type frame_count) noexcept
+{
+  ring_region region;
+
+  if (!self) {
+    return region;
+  }
+
+  auto space = writable();
+  if (space < frame_count) {
+    // The cached index may be stale.
+    self->cached_read_index = self->read_index.load(std::memory_order_acquire);
+    space = writable();
+  }
+
+  if (!space) {
+    return region;
+  }
+
+  auto write_index = self->write_index.load(std::memory_order_relaxed);
+
+  auto offset = write_index & (self->capacity - 1);
+
+  region.frames = self->frame_at(write_index);
+  region.frame_count = std::min(std::min(frame_count, space), self->capacity - offset);
+
+  return region;
+}
+
+void frame_ring::commit_write(size_type frame_count) noexcept
+{
+  if (!self) {
+    return;
+  }
+
+  auto write_index = self->write_index.load(std::memory_order_relaxed);
+
+  self->write_index.store(write_index + frame_count, std::memory_order_seq_cst);
+
+  // Pairs with the store to consumer_waiting in wait_readable(),
+  // so that either the consumer sees the new frames or
+  // the producer sees that the consumer is waiting.
+  if (self->consumer_waiting.load(std::memory_order_seq_cst)) {
+    std::uint64_t value = 1;
+    auto err = ::write(self->event_fd, &value, sizeof(value));
+    (void) err;
+  }
+}
+
+size_type frame_ring::write(const void* frames, size_type frame_count) noexcept
+{
+  const auto* src = static_cast<const unsigned char*>(frames);
+
+  size_type written = 0;
+
+  // At most two regions are needed, when the write wraps around.
+  for (int i = 0; (i < 2) && (written < frame_count); i++) {
+
+    auto region = begin_write(frame_count - written);
+    if (!region.frame_count) {
+      break;
+    }
+
+    memcpy(region.frames, src + (written * self->frame_size), region.frame_count * self->frame_size);
+
+    commit_write(region.frame_count);
+
+    written += region.frame_count;
+  }
+
+  return written;
+}
+
+size_type frame_ring::readable() noexcept
+{
+  if (!self) {
+    return 0;
+  }
+
+  auto read_index = self->read_index.load(std::memory_order_relaxed);
+
+  auto count = self->cached_write_index - read_index;
+  if (count == 0) {
+    self->cached_write_index = self->write_index.load(std::memory_order_acquire);
+    count = self->cached_write_index - read_index;
+  }
+
+  return count;
+}
+
+ring_region frame_ring::begin_read(size_type frame_count) noexcept
+{
+  ring_region region;
+
+  if (!self) {
+    return region;
+  }
+
+  auto count = readable();
+  if (count < frame_count) {
+    // The cached index may be stale.
+    self->cached_write_index = self->write_index.load(std::memory_order_acquire);
+    count = readable();
+  }
+
+  if (!count) {
+    return region;
+  }
+
+  auto read_index = self->read_index.load(std::memory_order_relaxed);
+
+  auto offset = read_index & (self->capacity - 1);
+
+  region.frames = self->frame_at(read_index);
+  region.frame_count = std::min(std::min(frame_count, count), self->capacity - offset);
+
+  return region;
+}
+
+void frame_ring::commit_read(size_type frame_count) noexcept
+{
+  if (!self) {
+    return;
+  }
+
+  auto read_index = self->read_index.load(std::memory_order_relaxed);
+
+  self->read_index.store(read_index + frame_count, std::memory_order_release);
+}
+
+size_type frame_ring::read(void* frames, size_type frame_count) noexcept
+{
+  auto* dst = static_cast<unsigned char*>(frames);
+
+  size_type read_count = 0;
+
+  for (int i = 0; (i < 2) && (read_count < frame_count); i++) {
+
+    auto region = begin_read(frame_count - read_count);
+    if (!region.frame_count) {
+      break;
+    }
+
+    memcpy(dst + (read_count * self->frame_size), region.frames, region.frame_count * self->frame_size);
+
+    commit_read(region.frame_count);
+
+    read_count += region.frame_count;
+  }
+
+  return read_count;
+}
+
+result frame_ring::wait_readable(size_type frame_count, int timeout_ms) noexcept
+{
+  if (!self) {
+    return ENOENT;
+  } else if (frame_count > self->capacity) {
+    return EINVAL;
+  }
+
+  for (;;) {
+
+    auto read_index = self->read_index.load(std::memory_order_relaxed);
+
+    self->cached_write_index = self->write_index.load(std::memory_order_acquire);
+
+    if ((self->cached_write_index - read_index) >= frame_count) {
+      return result();
+    }
+
+    self->consumer_waiting.store(true, std::memory_order_seq_cst);
+
+    // Check again, in case the producer committed
+    // frames before it could see the waiting flag.
+    self->cached_write_index = self->write_index.load(std::memory_order_seq_cst);
+
+    if ((self->cached_write_index - read_index) >= frame_count) {
+      self->consumer_waiting.store(false, std::memory_order_relaxed);
+      return result();
+    }
+
+    pollfd pfd { self->event_fd, POLLIN, 0 };
+
+    auto err = ::poll(&pfd, 1, timeout_ms);
+
+    self->consumer_waiting.store(false, std::memory_order_relaxed);
+
+    if (err < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return errno;
+    } else if (err == 0) {
+      return ETIMEDOUT;
+    }
+
+    std::uint64_t value = 0;
+
+    err = ::read(self->event_fd, &value, sizeof(value));
+    (void) err;
+  }
+}
+
+generic_result<size_type> pump_capture(interleaved_reader& reader, frame_ring& ring, size_type frame_count) noexcept
+{
+  size_type total = 0;
+
+  for (int i = 0; (i < 2) && (total < frame_count); i++) {
+
+    auto region = ring.begin_write(frame_count - total);
+    if (!region.frame_count) {
+      if (!total) {
+        return { ENOBUFS, 0 };
+      }
+      break;
+    }
+
+    auto read_result = reader.read_unformatted(region.frames, region.frame_count);
+    if (read_result.failed()) {
+      return { read_result.error, total };
+    }
+
+    auto read_count = read_result.unwrap();
+
+    ring.commit_write(read_count);
+
+    total += read_count;
+
+    if (read_count < region.frame_count) {
+      break;
+    }
+  }
+
+  return { 0, total };
+}
+
+//=====================//
+// Section: Frame Pool //
+//=====================//
+
+namespace {
+
+/// The size of a huge page, which the
+/// pool is rounded up to when using them.
+constexpr size_type huge_page_size = 2 * 1024 * 1024;
+
+/// Marks the end of the free list.
+constexpr std::uint32_t no_buffer = 0xffffffff;
+
+/// Packs the top of the free list with a tag that changes
+/// on every update, so that a buffer taken and given back
+/// between a load and a compare-exchange is detected.
+constexpr std::uint64_t make_head(std::uint32_t index, std::uint32_t tag) noexcept
+{
+  return (std::uint64_t(tag) << 32) | index;
+}
+
+} // namespace
+
+/// Contains the implementation data of a frame pool.
+class frame_pool_impl final
+{
+  friend frame_pool;
+  /// The memory of all the buffers.
+  unsigned char* memory = nullptr;
+  /// The number of bytes mapped.
+  size_type memory_size = 0;
+  /// The number of bytes between two buffers.
+  size_type stride = 0;
+  /// The number of bytes of frames in a buffer.
+  size_type size = 0;
+  /// The number of frames in a buffer.
+  size_type frames = 0;
+  /// The number of buffers.
+  size_type count = 0;
+  /// The buffer after each one in the free list.
+  std::atomic<std::uint32_t>* next = nullptr;
+  /// The first buffer of the free list and its tag.
+  std::atomic<std::uint64_t> head { make_head(no_buffer, 0) };
+  /// Whether or not the memory is locked.
+  bool locked = false;
+  /// Whether or not the memory is backed by huge pages.
+  bool huge = false;
+public:
+  /// Unmaps the buffers.
+  ~frame_pool_impl()
+  {
+    if (memory) {
+      ::munmap(memory, memory_size);
+    }
+    delete [] next;
+  }
+  /// Pushes a buffer onto the free list.
+  void push(std::uint32_t index) noexcept
+  {
+    auto old_head = head.load(std::memory_order_relaxed);
+
+    for (;;) {
+
+      next[index].store(std::uint32_t(old_head), std::memory_order_relaxed);
+
+      auto new_head = make_head(index, std::uint32_t(old_head >> 32) + 1);
+
+      if (head.compare_exchange_weak(old_head, new_head, std::memory_order_release, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+  }
+  /// Pops a buffer off of the free list.
+  ///
+  /// @return The index of the buffer, or @ref no_buffer if there are none.
+  std::uint32_t pop() noexcept
+  {
+    auto old_head = head.load(std::memory_order_acquire);
+
+    for (;;) {
+
+      auto index = std::uint32_t(old_head);
+      if (index == no_buffer) {
+        return no_buffer;
+      }
+
+      auto new_head = make_head(next[index].load(std::memory_order_relaxed), std::uint32_t(old_head >> 32) + 1);
+
+      if (head.compare_exchange_weak(old_head, new_head, std::memory_order_acquire, std::memory_order_acquire)) {
+        return index;
+      }
+    }
+  }
+};
+
+frame_pool::frame_pool() noexcept : self(nullptr) { }
+
+frame_pool::frame_pool(frame_pool&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+frame_pool::~frame_pool()
+{
+  delete self;
+}
+
+result frame_pool::allocate(const pcm_config& config, const frame_pool_config& pool_config) noexcept
+{
+  auto count = pool_config.buffer_count ? pool_config.buffer_count : (config.period_count * 2);
+
+  auto size = config.period_size * (to_physical_bits(config.format) / 8) * config.channels;
+
+  if (!count || !size || (count >= no_buffer)) {
+    return EINVAL;
+  }
+
+  delete self;
+
+  self = new (std::nothrow) frame_pool_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  self->size = size;
+  self->frames = config.period_size;
+  self->stride = ((size + alignment - 1) / alignment) * alignment;
+  self->count = count;
+
+  self->next = new (std::nothrow) std::atomic<std::uint32_t>[count];
+  if (!self->next) {
+    delete self;
+    self = nullptr;
+    return ENOMEM;
+  }
+
+  auto length = self->stride * count;
+
+  void* memory = MAP_FAILED;
+
+  // The pages are faulted in by the kernel as they are mapped.
+  int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE;
+
+  if (pool_config.huge_pages) {
+    auto huge_length = ((length + huge_page_size - 1) / huge_page_size) * huge_page_size;
+    memory = ::mmap(nullptr, huge_length, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+    if (memory != MAP_FAILED) {
+      length = huge_length;
+      self->huge = true;
+    }
+  }
+
+  if (memory == MAP_FAILED) {
+    memory = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, flags, -1, 0);
+  }
+
+  if (memory == MAP_FAILED) {
+    auto err = errno;
+    delete self;
+    self = nullptr;
+    return err;
+  }
+
+  self->memory = static_cast<unsigned char*>(memory);
+  self->memory_size = length;
+
+  if (pool_config.lock_memory) {
+    self->locked = (::mlock(memory, length) == 0);
+  }
+
+  // Each page is written to, in case the kernel
+  // did not populate the mapping as writable.
+  auto page_size = size_type(sysconf(_SC_PAGESIZE));
+
+  for (size_type offset = 0; offset < length; offset += page_size) {
+    static_cast<volatile unsigned char*>(memory)[offset] = 0;
+  }
+
+  for (size_type i = count; i > 0; i--) {
+    self->push(std::uint32_t(i - 1));
+  }
+
+  return result();
+}
+
+void* frame_pool::acquire() noexcept
+{
+  if (!self) {
+    return nullptr;
+  }
+
+  auto index = self->pop();
+  if (index == no_buffer) {
+    return nullptr;
+  }
+
+  return self->memory + (index * self->stride);
+}
+
+void frame_pool::release(void* buffer) noexcept
+{
+  if (!self || !buffer) {
+    return;
+  }
+
+  auto offset = size_type(static_cast<unsigned char*>(buffer) - self->memory);
+
+  self->push(std::uint32_t(offset / self->stride));
+}
+
+size_type frame_pool::buffer_size() const noexcept
+{
+  return self ? self->size : 0;
+}
+
+size_type frame_pool::frame_count() const noexcept
+{
+  return self ? self->frames : 0;
+}
+
+size_type frame_pool::capacity() const noexcept
+{
+  return self ? self->count : 0;
+}
+
+bool frame_pool::is_locked() const noexcept
+{
+  return self && self->locked;
+}
+
+bool frame_pool::uses_huge_pages() const noexcept
+{
+  return self && self->huge;
+}
+
+//===========================//
+// Section: Real-time Worker //
+//===========================//
+
+namespace {
+
+/// The number of bits of each value kept by the histogram.
+/// Values below twice this many are kept exactly.
+constexpr unsigned int histogram_sub_bits = 6;
+
+/// The number of exact buckets, at the start of the histogram.
+constexpr std::uint64_t histogram_sub_count = std::uint64_t(1) << histogram_sub_bits;
+
+/// The number of buckets for each power of two above the exact ones.
+constexpr std::uint64_t histogram_half_count = histogram_sub_count / 2;
+
+/// The number of buckets, enough to hold any positive 64-bit value.
+constexpr size_type histogram_bucket_count = histogram_sub_count + ((63 - histogram_sub_bits) * histogram_half_count);
+
+/// Gets the bucket that a value is counted in.
+size_type to_histogram_bucket(std::uint64_t value) noexcept
+{
+  if (value < histogram_sub_count) {
+    return size_type(value);
+  }
+
+  auto shift = std::uint64_t(63 - __builtin_clzll(value)) - (histogram_sub_bits - 1);
+
+  return size_type(histogram_sub_count + ((shift - 1) * histogram_half_count) + ((value >> shift) - histogram_half_count));
+}
+
+/// Gets the highest value that is counted in a bucket.
+std::uint64_t from_histogram_bucket(size_type bucket) noexcept
+{
+  if (bucket < histogram_sub_count) {
+    return bucket;
+  }
+
+  auto shift = ((bucket - histogram_sub_count) / histogram_half_count) + 1;
+
+  auto sub = ((bucket - histogram_sub_count) % histogram_half_count) + histogram_half_count;
+
+  return ((sub + 1) << shift) - 1;
+}
+
+/// The number of bytes of stack that are not prefaulted, which
+/// leaves room for the frames of the thread and of the handler.
+constexpr size_type stack_prefault_headroom = 16 * 1024;
+
+/// Touches a number of bytes below the current stack frame,
+/// so that the pages are mapped before they are needed.
+__attribute__((noinline)) void prefault_stack(size_type size) noexcept
+{
+  if (!size) {
+    return;
+  }
+
+  auto* stack = static_cast<volatile unsigned char*>(alloca(size));
+
+  auto page_size = size_type(sysconf(_SC_PAGESIZE));
+
+  for (size_type offset = 0; offset < size; offset += page_size) {
+    stack[offset] = 0;
+  }
+}
+
+} // namespace
+
+/// Contains the implementation data of a latency histogram.
+class latency_histogram_impl final
+{
+  friend latency_histogram;
+  /// The number of values in each bucket.
+  std::atomic<std::uint64_t> buckets[histogram_bucket_count] {};
+  /// The number of values recorded.
+  std::atomic<std::uint64_t> count { 0 };
+  /// The sum of the values recorded.
+  std::atomic<std::uint64_t> sum { 0 };
+  /// The largest value recorded.
+  std::atomic<std::int64_t> max { 0 };
+};
+
+latency_histogram::latency_histogram() noexcept : self(nullptr) { }
+
+latency_histogram::latency_histogram(latency_histogram&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+latency_histogram::~latency_histogram()
+{
+  delete self;
+}
+
+result latency_histogram::allocate() noexcept
+{
+  if (self) {
+    reset();
+    return result();
+  }
+
+  self = new (std::nothrow) latency_histogram_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  return result();
+}
+
+bool latency_histogram::is_allocated() const noexcept
+{
+  return self != nullptr;
+}
+
+void latency_histogram::record(std::int64_t value) noexcept
+{
+  if (!self) {
+    return;
+  }
+
+  value = std::max(value, std::int64_t(0));
+
+  self->buckets[to_histogram_bucket(std::uint64_t(value))].fetch_add(1, std::memory_order_relaxed);
+
+  self->count.fetch_add(1, std::memory_order_relaxed);
+
+  self->sum.fetch_add(std::uint64_t(value), std::memory_order_relaxed);
+
+  auto max = self->max.load(std::memory_order_relaxed);
+
+  while ((value > max) && !self->max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+  }
+}
+
+size_type latency_histogram::size() const noexcept
+{
+  return self ? size_type(self->count.load(std::memory_order_relaxed)) : 0;
+}
+
+std::int64_t latency_histogram::get_max() const noexcept
+{
+  return self ? self->max.load(std::memory_order_relaxed) : 0;
+}
+
+std::int64_t latency_histogram::get_mean() const noexcept
+{
+  if (!self) {
+    return 0;
+  }
+
+  auto count = self->count.load(std::memory_order_relaxed);
+
+  return count ? std::int64_t(self->sum.load(std::memory_order_relaxed) / count) : 0;
+}
+
+std::int64_t latency_histogram::get_percentile(double percentile) const noexcept
+{
+  if (!self) {
+    return 0;
+  }
+
+  // The buckets are counted up front, rather than using the
+  // value count, since values may be recorded while reading.
+  std::uint64_t total = 0;
+
+  for (const auto& bucket : self->buckets) {
+    total += bucket.load(std::memory_order_relaxed);
+  }
+
+  if (!total) {
+    return 0;
+  }
+
+  percentile = std::min(std::max(percentile, 0.0), 100.0);
+
+  auto rank = std::uint64_t(std::ceil((percentile / 100.0) * double(total)));
+
+  rank = std::max(rank, std::uint64_t(1));
+
+  std::uint64_t seen = 0;
+
+  for (size_type i = 0; i < histogram_bucket_count; i++) {
+    seen += self->buckets[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return std::min(std::int64_t(from_histogram_bucket(i)), get_max());
+    }
+  }
+
+  return get_max();
+}
+
+void latency_histogram::reset() noexcept
+{
+  if (!self) {
+    return;
+  }
+
+  for (auto& bucket : self->buckets) {
+    bucket.store(0, std::memory_order_relaxed);
+  }
+
+  self->count.store(0, std::memory_order_relaxed);
+  self->sum.store(0, std::memory_order_relaxed);
+  self->max.store(0, std::memory_order_relaxed);
+}
+
+/// Contains the implementation data of a real-time worker.
+class rt_worker_impl final
+{
+  friend rt_worker;
+  /// The handler of each period.
+  rt_period_handler* handler = nullptr;
+  /// The setup of the thread.
+  rt_worker_config config;
+  /// The number of bytes of stack to prefault,
+  /// limited to what fits in the stack.
+  size_type prefault_size = 0;
+  /// Whether or not mlockall succeeded.
+  bool memory_locked = false;
+  /// The thread that runs the periods.
+  pthread_t thread {};
+  /// Whether or not the thread was started.
+  bool thread_started = false;
+  /// Set to ask the thread to stop.
+  std::atomic<bool> stopping { false };
+  /// Whether or not the thread is running periods.
+  std::atomic<bool> running { false };
+  /// The number of periods that were skipped.
+  std::atomic<size_type> overruns { 0 };
+  /// The lateness of each wake up.
+  latency_histogram lateness;
+  /// The duration of each period.
+  latency_histogram duration;
+  /// Sleeps until a time on the monotonic clock.
+  static void sleep_until(std::int64_t deadline) noexcept
+  {
+    timespec ts {};
+    ts.tv_sec = time_t(deadline / 1000000000);
+    ts.tv_nsec = long(deadline % 1000000000);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+  }
+  /// Runs periods until the worker is stopped
+  /// or the handler asks to stop.
+  static void* run(void* arg) noexcept
+  {
+    auto* self = static_cast<rt_worker_impl*>(arg);
+
+    prefault_stack(self->prefault_size);
+
+    auto period = self->config.period_ns;
+
+    auto deadline = get_timestamp(pcm_timestamp_type::monotonic) + period;
+
+    while (!self->stopping.load(std::memory_order_acquire)) {
+
+      if (period > 0) {
+        sleep_until(deadline);
+      }
+
+      auto wake_time = get_timestamp(pcm_timestamp_type::monotonic);
+
+      if (period > 0) {
+        self->lateness.record(wake_time - deadline);
+      }
+
+      auto keep_running = self->handler->on_period();
+
+      auto end_time = get_timestamp(pcm_timestamp_type::monotonic);
+
+      self->duration.record(end_time - wake_time);
+
+      if (!keep_running) {
+        break;
+      }
+
+      if (period > 0) {
+
+        deadline += period;
+
+        // Periods that are already over are skipped, rather
+        // than being run back to back to catch up.
+        if (deadline <= end_time) {
+          auto missed = ((end_time - deadline) / period) + 1;
+          deadline += missed * period;
+          self->overruns.fetch_add(size_type(missed), std::memory_order_relaxed);
+        }
+      }
+    }
+
+    self->running.store(false, std::memory_order_release);
+
+    return nullptr;
+  }
+};
+
+rt_worker::rt_worker() noexcept : self(nullptr) { }
+
+rt_worker::rt_worker(rt_worker&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+rt_worker::~rt_worker()
+{
+  stop();
+  delete self;
+}
+
+result rt_worker::start(rt_period_handler& handler, const rt_worker_config& config) noexcept
+{
+  if (self && self->thread_started) {
+    return EBUSY;
+  }
+
+  if (!self) {
+    self = new (std::nothrow) rt_worker_impl();
+    if (!self) {
+      return ENOMEM;
+    }
+  }
+
+  // Allocated here rather than on construction,
+  // so that the failure can be reported.
+  if (self->lateness.allocate().failed() || self->duration.allocate().failed()) {
+    return ENOMEM;
+  }
+
+  // Like the frame pool, the thread runs without locked
+  // memory if the limit on locked memory is too low.
+  self->memory_locked = config.lock_memory && (::mlockall(MCL_CURRENT | MCL_FUTURE) == 0);
+
+  pthread_attr_t attr;
+
+  auto err = pthread_attr_init(&attr);
+  if (err != 0) {
+    return err;
+  }
+
+  if (config.stack_size) {
+    err = pthread_attr_setstacksize(&attr, config.stack_size);
+  }
+
+  size_type stack_size = 0;
+
+  if (!err) {
+    err = pthread_attr_getstacksize(&attr, &stack_size);
+  }
+
+  if (!err && (config.priority > 0)) {
+
+    sched_param param {};
+    param.sched_priority = config.priority;
+
+    err = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+
+    if (!err) {
+      err = pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    }
+
+    if (!err) {
+      err = pthread_attr_setschedparam(&attr, &param);
+    }
+  }
+
+  if (!err && (config.cpu >= 0)) {
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(config.cpu, &cpus);
+
+    err = pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+  }
+
+  if (err) {
+    pthread_attr_destroy(&attr);
+    return err;
+  }
+
+  self->handler = &handler;
+  self->config = config;
+  self->prefault_size = (stack_size > stack_prefault_headroom)
+                      ? std::min(config.stack_prefault, stack_size - stack_prefault_headroom)
+                      : 0;
+  self->stopping.store(false, std::memory_order_relaxed);
+  self->running.store(true, std::memory_order_relaxed);
+
+  err = pthread_create(&self->thread, &attr, rt_worker_impl::run, self);
+
+  pthread_attr_destroy(&attr);
+
+  if (err != 0) {
+    self->running.store(false, std::memory_order_relaxed);
+    return err;
+  }
+
+  self->thread_started = true;
+
+  return result();
+}
+
+void rt_worker::stop() noexcept
+{
+  if (!self || !self->thread_started) {
+    return;
+  }
+
+  self->stopping.store(true, std::memory_order_release);
+
+  pthread_join(self->thread, nullptr);
+
+  self->thread_started = false;
+}
+
+bool rt_worker::is_running() const noexcept
+{
+  return self && self->running.load(std::memory_order_acquire);
+}
+
+bool rt_worker::is_memory_locked() const noexcept
+{
+  return self && self->memory_locked;
+}
+
+size_type rt_worker::get_overruns() const noexcept
+{
+  return self ? self->overruns.load(std::memory_order_relaxed) : 0;
+}
+
+const latency_histogram& rt_worker::get_lateness() const noexcept
+{
+  static const latency_histogram empty;
+
+  return self ? self->lateness : empty;
+}
+
+const latency_histogram& rt_worker::get_duration() const noexcept
+{
+  static const latency_histogram empty;
+
+  return self ? self->duration : empty;
+}
+
+//===========================//
+// Section: Capture Recorder //
+//===========================//
+
+namespace {
+
+/// The alignment of the buffers and of the audio data in the file.
+/// This is the largest logical block size of common disks,
+/// as required for O_DIRECT.
+constexpr size_type disk_block_size = 4096;
+
+/// The size of the WAV header. The data starts right after it,
+/// so that writes of the data remain aligned to disk blocks.
+constexpr size_type wav_header_size = disk_block_size;
+
+/// The largest size that a RIFF chunk may have.
+/// Anything larger is written as RF64.
+constexpr std::uint64_t riff_size_max = 0xffffffff;
+
+/// The GUID of the PCM sub-format, in an extensible WAV format chunk.
+constexpr unsigned char wav_pcm_subformat[16] {
+  0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+  0x80, 0x00, 0x00, 0xaa, 0x00, 0x38, 0x9b, 0x71
+};
+
+/// Writes a little endian integer into a header.
+template <typename int_type>
+void put_le(unsigned char* out, int_type value) noexcept
+{
+  for (size_type i = 0; i < sizeof(int_type); i++) {
+    out[i] = (unsigned char) ((std::uint64_t(value) >> (i * 8)) & 0xff);
+  }
+}
+
+/// Writes a chunk ID into a header.
+void put_id(unsigned char* out, const char* id) noexcept
+{
+  memcpy(out, id, 4);
+}
+
+/// Gets the number of valid bits of a sample format that WAV
+/// stores without conversion, or zero if there isn't one.
+constexpr size_type to_wav_bits(sample_format sf) noexcept
+{
+  switch (sf) {
+    case sample_format::u8:
+      return 8;
+    case sample_format::s16_le:
+      return 16;
+    case sample_format::s24_3le:
+      return 24;
+    case sample_format::s32_le:
+      return 32;
+    default:
+      break;
+  }
+
+  return 0;
+}
+
+/// Fills in a WAV header.
+///
+/// The header always has room for the RF64 size chunk. When the
+/// file is small enough, it's left as a JUNK chunk that readers
+/// skip, and the rest of the header is padded with another one.
+///
+/// @param header The header to fill in. Its size is @ref wav_header_size.
+/// @param format The channels, rate and format of the frames.
+/// @param data_size The number of audio bytes in the file.
+/// @param always_rf64 Whether or not to write RF64 even if the file is small.
+void make_wav_header(unsigned char* header, const pcm_config& format, std::uint64_t data_size, bool always_rf64) noexcept
+{
+  memset(header, 0, wav_header_size);
+
+  auto bits = to_wav_bits(format.format);
+  auto block_align = (bits / 8) * format.channels;
+  auto extensible = (bits > 16) || (format.channels > 2);
+
+  std::uint64_t riff_size = wav_header_size - 8 + data_size + (data_size & 1);
+
+  bool is_rf64 = always_rf64 || (riff_size > riff_size_max);
+
+  put_id(header, is_rf64 ? "RF64" : "RIFF");
+  put_le(header + 4, std::uint32_t(is_rf64 ? riff_size_max : riff_size));
+  put_id(header + 8, "WAVE");
+
+  put_id(header + 12, is_rf64 ? "ds64" : "JUNK");
+  put_le(header + 16, std::uint32_t(28));
+
+  if (is_rf64) {
+    put_le(header + 20, riff_size);
+    put_le(header + 28, data_size);
+    put_le(header + 36, std::uint64_t(data_size / block_align));
+  }
+
+  auto* fmt = header + 48;
+
+  std::uint32_t fmt_size = extensible ? 40 : 16;
+
+  put_id(fmt, "fmt ");
+  put_le(fmt + 4, fmt_size);
+  put_le(fmt + 8, std::uint16_t(extensible ? 0xfffe : 1));
+  put_le(fmt + 10, std::uint16_t(format.channels));
+  put_le(fmt + 12, std::uint32_t(format.rate));
+  put_le(fmt + 16, std::uint32_t(format.rate * block_align));
+  put_le(fmt + 20, std::uint16_t(block_align));
+  put_le(fmt + 22, std::uint16_t(bits));
+
+  if (extensible) {
+    // The valid bits, an unspecified channel mask and the sub-format.
+    put_le(fmt + 24, std::uint16_t(22));
+    put_le(fmt + 26, std::uint16_t(bits));
+    put_le(fmt + 28, std::uint32_t(0));
+    memcpy(fmt + 32, wav_pcm_subformat, sizeof(wav_pcm_subformat));
+  }
+
+  auto* junk = fmt + 8 + fmt_size;
+
+  auto* data = header + wav_header_size - 8;
+
+  put_id(junk, "JUNK");
+  put_le(junk + 4, std::uint32_t(data - (junk + 8)));
+
+  put_id(data, "data");
+  put_le(data + 4, std::uint32_t(is_rf64 ? riff_size_max : data_size));
+}
+
+/// Gets the greatest common divisor of two sizes.
+size_type gcd(size_type a, size_type b) noexcept
+{
+  while (b) {
+    auto r = a % b;
+    a = b;
+    b = r;
+  }
+
+  return a;
+}
+
+} // namespace
+
+/// Contains the implementation data of a capture recorder.
+///
+/// The buffers are used in order. The capture thread fills the
+/// buffer at @ref capture_recorder_impl::filled and the I/O thread
+/// writes the one at @ref capture_recorder_impl::written, so that
+/// the counters are the only data the two threads share.
+class capture_recorder_impl final
+{
+  friend capture_recorder;
+  /// The file being written.
+  int fd = invalid_fd();
+  /// Whether or not the file is written with O_DIRECT.
+  std::atomic<bool> direct_io { false };
+  /// The channels, rate and format of the frames.
+  pcm_config format;
+  /// Whether or not the header is always RF64.
+  bool always_rf64 = false;
+  /// The number of bytes in one frame.
+  size_type frame_size = 0;
+  /// The number of frames in one buffer.
+  size_type buffer_frames = 0;
+  /// The number of bytes in one buffer.
+  size_type buffer_size = 0;
+  /// The number of buffers.
+  size_type buffer_count = 0;
+  /// The memory of all the buffers.
+  unsigned char* buffers = nullptr;
+  /// The number of bytes used in each buffer.
+  size_type* lengths = nullptr;
+  /// The number of frames in the buffer being filled.
+  size_type fill_frames = 0;
+  /// The total number of buffers passed to the I/O thread.
+  std::atomic<size_type> filled { 0 };
+  /// The total number of buffers written by the I/O thread.
+  std::atomic<size_type> written { 0 };
+  /// Set when the I/O thread should exit, once all buffers are written.
+  std::atomic<bool> closing { false };
+  /// The errno value of the first failed write.
+  std::atomic<int> error { 0 };
+  /// Used to wake the I/O thread.
+  int event_fd = invalid_fd();
+  /// The I/O thread.
+  pthread_t thread;
+  /// Whether or not the I/O thread was started.
+  bool thread_started = false;
+  /// The statistics, which are read from any thread.
+  std::atomic<size_type> frames_captured { 0 };
+  std::atomic<std::uint64_t> bytes_written { 0 };
+  std::atomic<size_type> max_queued_buffers { 0 };
+  std::atomic<size_type> stalls { 0 };
+  std::atomic<std::int64_t> max_write_time { 0 };
+public:
+  /// Releases the buffers and file descriptors.
+  ~capture_recorder_impl()
+  {
+    std::free(buffers);
+    delete [] lengths;
+    if (event_fd != invalid_fd()) {
+      ::close(event_fd);
+    }
+    if (fd != invalid_fd()) {
+      ::close(fd);
+    }
+  }
+  /// Gets a pointer to a buffer.
+  inline unsigned char* buffer_at(size_type index) noexcept
+  {
+    return buffers + ((index % buffer_count) * buffer_size);
+  }
+  /// Stops using O_DIRECT, for writes that are not
+  /// aligned or that the file system rejected.
+  void disable_direct_io() noexcept
+  {
+    auto flags = fcntl(fd, F_GETFL);
+    if (flags >= 0) {
+      fcntl(fd, F_SETFL, flags & ~O_DIRECT);
+    }
+    direct_io.store(false, std::memory_order_relaxed);
+  }
+  /// Writes data at the end of the file.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  int write_data(const unsigned char* data, size_type size) noexcept
+  {
+    if (direct_io.load(std::memory_order_relaxed) && (size % disk_block_size)) {
+      disable_direct_io();
+    }
+
+    while (size) {
+
+      auto count = ::write(fd, data, size);
+      if (count < 0) {
+        if (errno == EINTR) {
+          continue;
+        } else if ((errno == EINVAL) && direct_io.load(std::memory_order_relaxed)) {
+          disable_direct_io();
+          continue;
+        }
+        return errno;
+      }
+
+      data += count;
+      size -= size_type(count);
+    }
+
+    return 0;
+  }
+  /// Passes the buffer being filled to the I/O thread.
+  void hand_off() noexcept
+  {
+    auto index = filled.load(std::memory_order_relaxed);
+
+    lengths[index % buffer_count] = fill_frames * frame_size;
+
+    fill_frames = 0;
+
+    filled.store(index + 1, std::memory_order_release);
+
+    auto queued = (index + 1) - written.load(std::memory_order_acquire);
+    if (queued > max_queued_buffers.load(std::memory_order_relaxed)) {
+      max_queued_buffers.store(queued, std::memory_order_relaxed);
+    }
+
+    std::uint64_t value = 1;
+
+    auto err = ::write(event_fd, &value, sizeof(value));
+    (void) err;
+  }
+  /// Writes buffers as they are filled, until the recorder is closed.
+  static void* run(void* arg) noexcept
+  {
+    auto* self = static_cast<capture_recorder_impl*>(arg);
+
+    for (;;) {
+
+      auto index = self->written.load(std::memory_order_relaxed);
+
+      if (index == self->filled.load(std::memory_order_acquire)) {
+
+        if (self->closing.load(std::memory_order_acquire)) {
+          // Buffers handed off before closing are still written.
+          if (index == self->filled.load(std::memory_order_acquire)) {
+            break;
+          }
+          continue;
+        }
+
+        std::uint64_t value = 0;
+
+        auto err = ::read(self->event_fd, &value, sizeof(value));
+        (void) err;
+        continue;
+      }
+
+      auto size = self->lengths[index % self->buffer_count];
+
+      auto start_time = get_timestamp(pcm_timestamp_type::monotonic);
+
+      // After a failure, the buffers are dropped so the capture thread
+      // does not stall. The error is reported on the next pump.
+      if (!self->error.load(std::memory_order_relaxed)) {
+        auto err = self->write_data(self->buffer_at(index), size);
+        if (err) {
+          self->error.store(err, std::memory_order_relaxed);
+        } else {
+          self->bytes_written.fetch_add(size, std::memory_order_relaxed);
+        }
+      }
+
+      auto write_time = get_timestamp(pcm_timestamp_type::monotonic) - start_time;
+
+      if (write_time > self->max_write_time.load(std::memory_order_relaxed)) {
+        self->max_write_time.store(write_time, std::memory_order_relaxed);
+      }
+
+      self->written.store(index + 1, std::memory_order_release);
+    }
+
+    return nullptr;
+  }
+};
+
+capture_recorder::capture_recorder() noexcept : self(nullptr) { }
+
+capture_recorder::capture_recorder(capture_recorder&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+capture_recorder::~capture_recorder()
+{
+  close();
+}
+
+result capture_recorder::open(const char* path, const pcm_config& format, const capture_recorder_config& config) noexcept
+{
+  close();
+
+  if (!to_wav_bits(format.format) || !format.channels || !format.rate || !config.buffer_count) {
+    return EINVAL;
+  }
+
+  self = new (std::nothrow) capture_recorder_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  self->format = format;
+  self->always_rf64 = config.always_rf64;
+  self->frame_size = (to_wav_bits(format.format) / 8) * format.channels;
+
+  // A buffer holds whole frames and is a whole number of blocks.
+  auto unit = (self->frame_size / gcd(self->frame_size, disk_block_size)) * disk_block_size;
+
+  self->buffer_size = std::max((config.buffer_size + unit - 1) / unit, size_type(1)) * unit;
+  self->buffer_frames = self->buffer_size / self->frame_size;
+  self->buffer_count = config.buffer_count;
+
+  void* buffers = nullptr;
+
+  auto err = ::posix_memalign(&buffers, disk_block_size, self->buffer_size * self->buffer_count);
+  if (err != 0) {
+    close();
+    return err;
+  }
+
+  self->buffers = static_cast<unsigned char*>(buffers);
+
+  self->lengths = new (std::nothrow) size_type[self->buffer_count];
+  if (!self->lengths) {
+    close();
+    return ENOMEM;
+  }
+
+  int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+
+  if (config.direct_io) {
+    self->fd = ::open(path, flags | O_DIRECT, 0644);
+    self->direct_io = (self->fd >= 0);
+  }
+
+  // Not every file system supports O_DIRECT.
+  if (self->fd < 0) {
+    self->fd = ::open(path, flags, 0644);
+  }
+
+  if (self->fd < 0) {
+    err = errno;
+    self->fd = invalid_fd();
+    close();
+    return err;
+  }
+
+  self->event_fd = ::eventfd(0, EFD_CLOEXEC);
+  if (self->event_fd < 0) {
+    err = errno;
+    self->event_fd = invalid_fd();
+    close();
+    return err;
+  }
+
+  // The header is written through the first buffer, which is aligned.
+  // It's completed when the recorder is closed.
+  make_wav_header(self->buffers, format, 0, self->always_rf64);
+
+  err = self->write_data(self->buffers, wav_header_size);
+  if (err) {
+    close();
+    return err;
+  }
+
+  err = pthread_create(&self->thread, nullptr, capture_recorder_impl::run, self);
+  if (err != 0) {
+    close();
+    return err;
+  }
+
+  self->thread_started = true;
+
+  return result();
+}
+
+generic_result<size_type> capture_recorder::pump(interleaved_reader& reader, size_type frame_count) noexcept
+{
+  if (!self) {
+    return { EBADF, 0 };
+  }
+
+  auto err = self->error.load(std::memory_order_relaxed);
+  if (err) {
+    return { err, 0 };
+  }
+
+  auto index = self->filled.load(std::memory_order_relaxed);
+
+  if ((index - self->written.load(std::memory_order_acquire)) >= self->buffer_count) {
+    self->stalls.fetch_add(1, std::memory_order_relaxed);
+    return { ENOBUFS, 0 };
+  }
+
+  auto* frames = self->buffer_at(index) + (self->fill_frames * self->frame_size);
+
+  auto read_result = reader.read_unformatted(frames, std::min(frame_count, self->buffer_frames - self->fill_frames));
+
+  self->fill_frames += read_result.value;
+
+  self->frames_captured.fetch_add(read_result.value, std::memory_order_relaxed);
+
+  if (self->fill_frames == self->buffer_frames) {
+    self->hand_off();
+  }
+
+  return read_result;
+}
+
+result capture_recorder::close() noexcept
+{
+  if (!self) {
+    return result();
+  }
+
+  int err = 0;
+
+  if (self->thread_started) {
+
+    if (self->fill_frames) {
+      self->hand_off();
+    }
+
+    self->closing.store(true, std::memory_order_release);
+
+    std::uint64_t value = 1;
+
+    auto wake_result = ::write(self->event_fd, &value, sizeof(value));
+    (void) wake_result;
+
+    pthread_join(self->thread, nullptr);
+
+    err = self->error.load(std::memory_order_relaxed);
+
+    auto data_size = self->bytes_written.load(std::memory_order_relaxed);
+
+    // The header and the pad byte are not aligned.
+    self->disable_direct_io();
+
+    if (!err && (data_size & 1)) {
+      const unsigned char pad = 0;
+      err = self->write_data(&pad, 1);
+    }
+
+    if (!err) {
+      make_wav_header(self->buffers, self->format, data_size, self->always_rf64);
+      if (pwrite(self->fd, self->buffers, wav_header_size, 0) != ssize_t(wav_header_size)) {
+        err = errno ? errno : EIO;
+      }
+    }
+
+    if ((fdatasync(self->fd) < 0) && !err) {
+      err = errno;
+    }
+  }
+
+  if ((self->fd != invalid_fd()) && (::close(self->fd) < 0) && !err) {
+    err = errno;
+  }
+
+  self->fd = invalid_fd();
+
+  delete self;
+
+  self = nullptr;
+
+  return err;
+}
+
+bool capture_recorder::is_open() const noexcept
+{
+  return self != nullptr;
+}
+
+capture_recorder_stats capture_recorder::get_stats() const noexcept
+{
+  capture_recorder_stats stats;
+
+  if (!self) {
+    return stats;
+  }
+
+  auto written = self->written.load(std::memory_order_acquire);
+
+  stats.frames_captured = self->frames_captured.load(std::memory_order_relaxed);
+  stats.bytes_written = self->bytes_written.load(std::memory_order_relaxed);
+  stats.buffers_written = written;
+  stats.queued_buffers = self->filled.load(std::memory_order_acquire) - written;
+  stats.max_queued_buffers = self->max_queued_buffers.load(std::memory_order_relaxed);
+  stats.stalls = self->stalls.load(std::memory_order_relaxed);
+  stats.max_write_time = self->max_write_time.load(std::memory_order_relaxed);
+  stats.direct_io = self->direct_io.load(std::memory_order_relaxed);
+
+  return stats;
+}
+
+//======================//
+// Section: File Reader //
+//======================//
+
+namespace {
+
+/// Reads a little endian integer from a header.
+template <typename int_type>
+int_type get_le(const unsigned char* in) noexcept
+{
+  std::uint64_t value = 0;
+
+  for (size_type i = 0; i < sizeof(int_type); i++) {
+    value |= std::uint64_t(in[i]) << (i * 8);
+  }
+
+  return int_type(value);
+}
+
+/// Gets the sample format of a WAV sample size, if there is one.
+///
+/// @return True if the sample size is supported, false otherwise.
+bool from_wav_bits(size_type bits, sample_format& format) noexcept
+{
+  switch (bits) {
+    case 8:
+      format = sample_format::u8;
+      return true;
+    case 16:
+      format = sample_format::s16_le;
+      return true;
+    case 24:
+      format = sample_format::s24_3le;
+      return true;
+    case 32:
+      format = sample_format::s32_le;
+      return true;
+    default:
+      break;
+  }
+
+  return false;
+}
+
+} // namespace
+
+/// Contains the implementation data of a file reader.
+class file_pcm_reader_impl final
+{
+  friend file_pcm_reader;
+  /// The mapped file.
+  const unsigned char* file = nullptr;
+  /// The size of the mapped file.
+  size_type file_size = 0;
+  /// The first frame in the file.
+  const unsigned char* data = nullptr;
+  /// The number of frames in the file.
+  size_type frame_count = 0;
+  /// The number of bytes in one frame.
+  size_type frame_size = 0;
+  /// The channels, rate and format of the frames.
+  pcm_config config;
+  /// The index of the next frame to read.
+  size_type position = 0;
+  /// Whether or not reads are paced to the rate of the file.
+  bool real_time = false;
+  /// When the frame at @ref file_pcm_reader_impl::start_position
+  /// was read, or zero if the clock has not started.
+  std::int64_t start_time = 0;
+  /// The position that the clock was started at.
+  size_type start_position = 0;
+public:
+  /// Unmaps the file.
+  ~file_pcm_reader_impl()
+  {
+    if (file) {
+      ::munmap(const_cast<unsigned char*>(file), file_size);
+    }
+  }
+  /// Finds the format and data chunks of the file.
+  ///
+  /// @return True if the file is a supported WAV file, false otherwise.
+  bool parse() noexcept
+  {
+    if ((file_size < 12) || (memcmp(file + 8, "WAVE", 4) != 0)) {
+      return false;
+    }
+
+    bool is_rf64 = (memcmp(file, "RF64", 4) == 0);
+
+    if (!is_rf64 && (memcmp(file, "RIFF", 4) != 0)) {
+      return false;
+    }
+
+    std::uint64_t rf64_data_size = 0;
+
+    size_type offset = 12;
+
+    while ((offset + 8) <= file_size) {
+
+      const auto* chunk = file + offset;
+
+      std::uint64_t chunk_size = get_le<std::uint32_t>(chunk + 4);
+
+      auto available = file_size - (offset + 8);
+
+      if ((memcmp(chunk, "ds64", 4) == 0) && (chunk_size >= 24) && (available >= 24)) {
+        rf64_data_size = get_le<std::uint64_t>(chunk + 16);
+      } else if ((memcmp(chunk, "fmt ", 4) == 0) && (chunk_size >= 16) && (available >= 16)) {
+
+        auto tag = get_le<std::uint16_t>(chunk + 8);
+
+        // The sub-format of an extensible format is
+        // stored after the common fields.
+        if ((tag == 0xfffe) && (chunk_size >= 40) && (available >= 40)) {
+          if (memcmp(chunk + 32, wav_pcm_subformat, sizeof(wav_pcm_subformat)) == 0) {
+            tag = 1;
+          }
+        }
+
+        config.channels = get_le<std::uint16_t>(chunk + 10);
+        config.rate = get_le<std::uint32_t>(chunk + 12);
+        frame_size = get_le<std::uint16_t>(chunk + 20);
+
+        if ((tag != 1) || !config.channels || !config.rate || (frame_size % config.channels)) {
+          return false;
+        } else if (!from_wav_bits((frame_size / config.channels) * 8, config.format)) {
+          return false;
+        }
+
+      } else if ((memcmp(chunk, "data", 4) == 0) && frame_size) {
+
+        if (is_rf64 && (chunk_size == riff_size_max)) {
+          chunk_size = rf64_data_size;
+        }
+
+        // Files that were never completed have a size
+        // that is zero or the largest RIFF size.
+        if ((chunk_size > available) || !chunk_size) {
+          chunk_size = available;
+        }
+
+        data = chunk + 8;
+        frame_count = size_type(chunk_size / frame_size);
+        return true;
+      }
+
+      offset += size_type(8 + chunk_size + (chunk_size & 1));
+    }
+
+    return false;
+  }
+  /// Blocks until a number of frames would have been captured.
+  void pace(size_type count) noexcept
+  {
+    if (!start_time) {
+      start_time = get_timestamp(pcm_timestamp_type::monotonic);
+      start_position = position;
+    }
+
+    auto frames = (position + count) - start_position;
+
+    auto deadline = start_time + std::int64_t((double(frames) * 1e9) / double(config.rate));
+
+    timespec ts {};
+    ts.tv_sec = time_t(deadline / 1000000000);
+    ts.tv_nsec = long(deadline % 1000000000);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+  }
+};
+
+file_pcm_reader::file_pcm_reader() noexcept : self(nullptr) { }
+
+file_pcm_reader::file_pcm_reader(file_pcm_reader&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+file_pcm_reader::~file_pcm_reader()
+{
+  close();
+}
+
+result file_pcm_reader::open(const char* path, bool real_time) noexcept
+{
+  close();
+
+  auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return errno;
+  }
+
+  auto size = lseek(fd, 0, SEEK_END);
+  if (size < 0) {
+    auto err = errno;
+    ::close(fd);
+    return err;
+  } else if (size == 0) {
+    ::close(fd);
+    return EPROTO;
+  }
+
+  auto* memory = ::mmap(nullptr, size_type(size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+  auto err = errno;
+
+  // The mapping keeps the file open.
+  ::close(fd);
+
+  if (memory == MAP_FAILED) {
+    return err;
+  }
+
+  ::madvise(memory, size_type(size), MADV_SEQUENTIAL);
+
+  self = new (std::nothrow) file_pcm_reader_impl();
+  if (!self) {
+    ::munmap(memory, size_type(size));
+    return ENOMEM;
+  }
+
+  self->file = static_cast<const unsigned char*>(memory);
+  self->file_size = size_type(size);
+  self->real_time = real_time;
+
+  if (!self->parse()) {
+    close();
+    return EPROTO;
+  }
+
+  return result();
+}
+
+void file_pcm_reader::close() noexcept
+{
+  delete self;
+  self = nullptr;
+}
+
+bool file_pcm_reader::is_open() const noexcept
+{
+  return self != nullptr;
+}
+
+pcm_config file_pcm_reader::get_config() const noexcept
+{
+  return self ? self->config : pcm_config();
+}
+
+size_type file_pcm_reader::get_frame_count() const noexcept
+{
+  return self ? self->frame_count : 0;
+}
+
+size_type file_pcm_reader::get_position() const noexcept
+{
+  return self ? self->position : 0;
+}
+
+result file_pcm_reader::seek(size_type frame) noexcept
+{
+  if (!self) {
+    return EBADF;
+  } else if (frame > self->frame_count) {
+    return EINVAL;
+  }
+
+  self->position = frame;
+  self->start_time = 0;
+
+  return result();
+}
+
+generic_result<size_type> file_pcm_reader::read_unformatted(void* frames, size_type frame_count) noexcept
+{
+  if (!self) {
+    return { EBADF, 0 };
+  }
+
+  auto count = std::min(frame_count, self->frame_count - self->position);
+  if (!count) {
+    return { frame_count ? ENODATA : 0, 0 };
+  }
+
+  if (self->real_time) {
+    self->pace(count);
+  }
+
+  memcpy(frames, self->data + (self->position * self->frame_size), count * self->frame_size);
+
+  self->position += count;
+
+  return { 0, count };
+}
+
+//====================//
+// Section: Resampler //
+//====================//
+
+namespace {
+
+/// The number of taps is always a multiple of this,
+/// so that the kernels don't need a scalar tail.
+constexpr size_type resampler_tap_multiple = 8;
+
+/// The alignment of the coefficients, for vector loads.
+constexpr size_type resampler_alignment = 32;
+
+/// The number of input frames the history can hold, past the filter taps.
+constexpr size_type resampler_history_frames = 1024;
+
+/// The number of frames converted at a time by
+/// the resampling readers and writers.
+constexpr size_type resampler_block_frames = 256;
+
+/// Describes the filter used for a quality preset.
+struct resampler_preset final
+{
+  /// The number of taps, when not downsampling.
+  size_type taps;
+  /// The number of phases between two input frames.
+  size_type phases;
+  /// The cutoff, relative to the Nyquist frequency of the lower rate.
+  double rolloff;
+  /// The beta parameter of the Kaiser window.
+  double beta;
+};
+
+/// Gets the filter of a quality preset.
+constexpr resampler_preset to_preset(resampler_quality quality) noexcept
+{
+  switch (quality) {
+    case resampler_quality::low:
+      return resampler_preset { 16, 64, 0.85, 6.0 };
+    case resampler_quality::medium:
+      break;
+    case resampler_quality::high:
+      return resampler_preset { 64, 512, 0.94, 10.0 };
+  }
+
+  return resampler_preset { 32, 256, 0.90, 8.0 };
+}
+
+/// The ratio of a circle's circumference to its diameter.
+constexpr double pi = 3.14159265358979323846;
+
+/// Computes the zeroth order modified Bessel function of the first kind.
+double bessel_i0(double x) noexcept
+{
+  double sum = 1;
+  double term = 1;
+
+  for (int k = 1; k < 64; k++) {
+    term *= (x / (2 * k)) * (x / (2 * k));
+    sum += term;
+    if (term < (sum * 1e-17)) {
+      break;
+    }
+  }
+
+  return sum;
+}
+
+float dot_scalar(const float* a, const float* b, size_type n) noexcept
+{
+  float sum = 0;
+
+  for (size_type i = 0; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+
+  return sum;
+}
+
+void interpolate_scalar(const float* a, const float* b, float t, float* out, size_type n) noexcept
+{
+  for (size_type i = 0; i < n; i++) {
+    out[i] = a[i] + (t * (b[i] - a[i]));
+  }
+}
+
+#if defined(__SSE2__)
+
+float dot_sse2(const float* a, const float* b, size_type n) noexcept
+{
+  auto sum0 = _mm_setzero_ps();
+  auto sum1 = _mm_setzero_ps();
+
+  for (size_type i = 0; i < n; i += 8) {
+    sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_load_ps(a + i), _mm_loadu_ps(b + i)));
+    sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_load_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+  }
+
+  auto sum = _mm_add_ps(sum0, sum1);
+
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+  return _mm_cvtss_f32(sum);
+}
+
+void interpolate_sse2(const float* a, const float* b, float t, float* out, size_type n) noexcept
+{
+  auto vt = _mm_set1_ps(t);
+
+  for (size_type i = 0; i < n; i += 4) {
+    auto va = _mm_load_ps(a + i);
+    auto vb = _mm_load_ps(b + i);
+    _mm_store_ps(out + i, _mm_add_ps(va, _mm_mul_ps(vt, _mm_sub_ps(vb, va))));
+  }
+}
+
+#endif /* defined(__SSE2__) */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+__attribute__((target("avx2,fma"))) float dot_avx2(const float* a, const float* b, size_type n) noexcept
+{
+  auto sum0 = _mm256_setzero_ps();
+  auto sum1 = _mm256_setzero_ps();
+
+  size_type i = 0;
+
+  for (; (i + 16) <= n; i += 16) {
+    sum0 = _mm256_fmadd_ps(_mm256_load_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+    sum1 = _mm256_fmadd_ps(_mm256_load_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), sum1);
+  }
+
+  if (i < n) {
+    sum0 = _mm256_fmadd_ps(_mm256_load_ps(a + i), _mm256_loadu_ps(b + i), sum0);
+  }
+
+  auto sum256 = _mm256_add_ps(sum0, sum1);
+
+  auto sum = _mm_add_ps(_mm256_castps256_ps128(sum256), _mm256_extractf128_ps(sum256, 1));
+
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+
+  return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma"))) void interpolate_avx2(const float* a, const float* b, float t, float* out, size_type n) noexcept
+{
+  auto vt = _mm256_set1_ps(t);
+
+  for (size_type i = 0; i < n; i += 8) {
+    auto va = _mm256_load_ps(a + i);
+    auto vb = _mm256_load_ps(b + i);
+    _mm256_store_ps(out + i, _mm256_fmadd_ps(vt, _mm256_sub_ps(vb, va), va));
+  }
+}
+
+#endif /* defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) */
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+
+float dot_neon(const float* a, const float* b, size_type n) noexcept
+{
+  auto sum0 = vdupq_n_f32(0);
+  auto sum1 = vdupq_n_f32(0);
+
+  for (size_type i = 0; i < n; i += 8) {
+    sum0 = vfmaq_f32(sum0, vld1q_f32(a + i), vld1q_f32(b + i));
+    sum1 = vfmaq_f32(sum1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+
+  return vaddvq_f32(vaddq_f32(sum0, sum1));
+}
+
+void interpolate_neon(const float* a, const float* b, float t, float* out, size_type n) noexcept
+{
+  for (size_type i = 0; i < n; i += 4) {
+    auto va = vld1q_f32(a + i);
+    auto vb = vld1q_f32(b + i);
+    vst1q_f32(out + i, vfmaq_n_f32(va, vsubq_f32(vb, va), t));
+  }
+}
+
+#endif /* defined(__aarch64__) && defined(__ARM_NEON) */
+
+/// Contains the resampler kernels chosen for the host CPU.
+/// The lengths passed to them are multiples of @ref resampler_tap_multiple
+/// and the first array of each is aligned to @ref resampler_alignment.
+struct resampler_kernels final
+{
+  float (*dot)(const float*, const float*, size_type) = dot_scalar;
+  void (*interpolate)(const float*, const float*, float, float*, size_type) = interpolate_scalar;
+};
+
+/// Selects the fastest kernels supported by the CPU.
+resampler_kernels select_resampler_kernels() noexcept
+{
+  resampler_kernels kernels;
+
+#if defined(__SSE2__)
+  kernels.dot = dot_sse2;
+  kernels.interpolate = interpolate_sse2;
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    kernels.dot = dot_avx2;
+    kernels.interpolate = interpolate_avx2;
+  }
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+  kernels.dot = dot_neon;
+  kernels.interpolate = interpolate_neon;
+#endif
+
+  return kernels;
+}
+
+/// Accesses the kernels chosen for the host CPU.
+/// The selection is only made once.
+const resampler_kernels& get_resampler_kernels() noexcept
+{
+  static const resampler_kernels kernels = select_resampler_kernels();
+  return kernels;
+}
+
+/// Allocates an aligned array of floats.
+///
+/// @return The array, or null if the allocation failed.
+float* allocate_floats(size_type count) noexcept
+{
+  void* memory = nullptr;
+
+  if (::posix_memalign(&memory, resampler_alignment, std::max(count, size_type(1)) * sizeof(float)) != 0) {
+    return nullptr;
+  }
+
+  return static_cast<float*>(memory);
+}
+
+} // namespace
+
+/// Contains the implementation data of a resampler.
+///
+/// The history of each channel is kept in its own row,
+/// so that the filter taps are applied to contiguous samples.
+/// The position of the next output frame is kept as a fractional
+/// index into the history, and frames that are no longer needed
+/// are only discarded once the history is full.
+class resampler_impl final
+{
+  friend resampler;
+  /// The number of channels in a frame.
+  size_type channels = 0;
+  /// The number of filter taps, which is also the stride of a phase.
+  size_type taps = 0;
+  /// The number of phases between two input frames.
+  size_type phases = 0;
+  /// The coefficients of each phase, with one extra
+  /// phase so that the last one can be interpolated.
+  float* coefficients = nullptr;
+  /// The coefficients interpolated for the current output frame.
+  float* scratch = nullptr;
+  /// The history of each channel.
+  float* history = nullptr;
+  /// The number of frames in a history row.
+  size_type history_capacity = 0;
+  /// The number of frames in the history.
+  size_type history_size = 0;
+  /// The position of the next output frame in the history.
+  double position = 0;
+  /// The number of input frames per output frame.
+  double step = 1;
+public:
+  /// Releases the filter and history.
+  ~resampler_impl()
+  {
+    std::free(coefficients);
+    std::free(scratch);
+    std::free(history);
+  }
+  /// Designs the filter.
+  ///
+  /// @param cutoff The cutoff, in cycles per input frame.
+  /// @param beta The beta parameter of the Kaiser window.
+  void design(double cutoff, double beta) noexcept
+  {
+    auto half = double(taps / 2);
+
+    auto i0_beta = bessel_i0(beta);
+
+    for (size_type p = 0; p <= phases; p++) {
+
+      auto* phase = coefficients + (p * taps);
+
+      double sum = 0;
+
+      for (size_type j = 0; j < taps; j++) {
+
+        auto u = (double(p) / double(phases)) + (half - 1) - double(j);
+
+        auto x = 2 * cutoff * u;
+
+        auto sinc = (x == 0) ? 1.0 : (std::sin(pi * x) / (pi * x));
+
+        auto w = u / half;
+
+        auto window = (std::fabs(w) >= 1) ? 0.0 : (bessel_i0(beta * std::sqrt(1 - (w * w))) / i0_beta);
+
+        phase[j] = float(sinc * window);
+
+        sum += phase[j];
+      }
+
+      // Each phase is normalized to a gain of one.
+      for (size_type j = 0; j < taps; j++) {
+        phase[j] = float(phase[j] / sum);
+      }
+    }
+  }
+  /// Discards the history and starts over.
+  void reset() noexcept
+  {
+    memset(history, 0, channels * history_capacity * sizeof(float));
+
+    // The first input frame is placed in the middle of the
+    // filter, with zeros for the frames that came before it.
+    history_size = (taps / 2) - 1;
+    position = double(history_size);
+  }
+  /// Discards the frames before a history index.
+  void discard(size_type count) noexcept
+  {
+    count = std::min(count, history_size);
+
+    for (size_type c = 0; c < channels; c++) {
+      auto* row = history + (c * history_capacity);
+      memmove(row, row + count, (history_size - count) * sizeof(float));
+    }
+
+    history_size -= count;
+    position -= double(count);
+  }
+  /// Appends interleaved frames to the history.
+  ///
+  /// @return The number of frames appended.
+  size_type append(const float* frames, size_type frame_count) noexcept
+  {
+    frame_count = std::min(frame_count, history_capacity - history_size);
+
+    for (size_type c = 0; c < channels; c++) {
+
+      auto* row = history + (c * history_capacity) + history_size;
+
+      for (size_type i = 0; i < frame_count; i++) {
+        row[i] = frames[(i * channels) + c];
+      }
+    }
+
+    history_size += frame_count;
+
+    return frame_count;
+  }
+};
+
+resampler::resampler() noexcept : self(nullptr) { }
+
+resampler::resampler(resampler&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+resampler::~resampler()
+{
+  delete self;
+}
+
+result resampler::init(size_type channels, size_type input_rate, size_type output_rate, resampler_quality quality) noexcept
+{
+  if (!channels || !input_rate || !output_rate) {
+    return EINVAL;
+  }
+
+  delete self;
+
+  self = new (std::nothrow) resampler_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  auto preset = to_preset(quality);
+
+  auto ratio = double(output_rate) / double(input_rate);
+
+  // When downsampling, the filter is widened to keep
+  // the same number of zero crossings below the cutoff.
+  auto taps = size_type(std::ceil(double(preset.taps) / std::min(ratio, 1.0)));
+
+  taps = ((taps + resampler_tap_multiple - 1) / resampler_tap_multiple) * resampler_tap_multiple;
+
+  self->channels = channels;
+  self->taps = taps;
+  self->phases = preset.phases;
+  self->step = 1 / ratio;
+  self->history_capacity = taps + resampler_history_frames;
+
+  self->coefficients = allocate_floats((self->phases + 1) * taps);
+  self->scratch = allocate_floats(taps);
+  self->history = allocate_floats(channels * self->history_capacity);
+
+  if (!self->coefficients || !self->scratch || !self->history) {
+    delete self;
+    self = nullptr;
+    return ENOMEM;
+  }
+
+  self->design(0.5 * std::min(ratio, 1.0) * preset.rolloff, preset.beta);
+
+  self->reset();
+
+  return result();
+}
+
+result resampler::set_ratio(double ratio) noexcept
+{
+  if (!self) {
+    return EBADF;
+  } else if (!(ratio > 0)) {
+    return EINVAL;
+  }
+
+  self->step = 1 / ratio;
+
+  return result();
+}
+
+double resampler::get_ratio() const noexcept
+{
+  return self ? (1 / self->step) : 0;
+}
+
+size_type resampler::get_latency() const noexcept
+{
+  return self ? (self->taps / 2) : 0;
+}
+
+void resampler::reset() noexcept
+{
+  if (self) {
+    self->reset();
+  }
+}
+
+resample_result resampler::process(const float* input, size_type input_frames, float* output, size_type output_frames) noexcept
+{
+  resample_result counts;
+
+  if (!self) {
+    return counts;
+  }
+
+  const auto& kernels = get_resampler_kernels();
+
+  auto channels = self->channels;
+  auto taps = self->taps;
+  auto phases = double(self->phases);
+
+  while (counts.frames_written < output_frames) {
+
+    auto index = size_type(self->position);
+
+    // The first history frame under the filter.
+    auto first = index + 1 - (taps / 2);
+
+    if ((first + taps) > self->history_size) {
+
+      if (counts.frames_read == input_frames) {
+        break;
+      }
+
+      if (self->history_size == self->history_capacity) {
+        self->discard(first);
+      }
+
+      counts.frames_read += self->append(input + (counts.frames_read * channels), input_frames - counts.frames_read);
+
+      continue;
+    }
+
+    auto phase = (self->position - double(index)) * phases;
+
+    auto p = size_type(phase);
+
+    const auto* coefficients = self->coefficients + (p * taps);
+
+    kernels.interpolate(coefficients, coefficients + taps, float(phase - double(p)), self->scratch, taps);
+
+    auto* frame = output + (counts.frames_written * channels);
+
+    for (size_type c = 0; c < channels; c++) {
+      frame[c] = kernels.dot(self->scratch, self->history + (c * self->history_capacity) + first, taps);
+    }
+
+    counts.frames_written++;
+
+    self->position += self->step;
+  }
+
+  return counts;
+}
+
+/// Contains the buffers shared by the resampling readers and writers.
+struct resampling_stage final
+{
+  /// The resampler.
+  resampler converter;
+  /// The channels, rate and format of the device side.
+  pcm_config config;
+  /// The number of bytes in one frame.
+  size_type frame_size = 0;
+  /// Frames in the format of the device.
+  unsigned char* raw = nullptr;
+  /// Frames before they're resampled.
+  float* input = nullptr;
+  /// Frames after they're resampled.
+  float* output = nullptr;
+  /// Releases the buffers.
+  ~resampling_stage()
+  {
+    std::free(raw);
+    std::free(input);
+    std::free(output);
+  }
+  /// Initializes the resampler and allocates the buffers.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result init(const pcm_config& device_config, size_type input_rate, size_type output_rate, resampler_quality quality) noexcept
+  {
+    config = device_config;
+    frame_size = (to_physical_bits(config.format) / 8) * config.channels;
+
+    auto err = converter.init(config.channels, input_rate, output_rate, quality);
+    if (err.failed()) {
+      return err;
+    }
+
+    auto samples = resampler_block_frames * config.channels;
+
+    raw = static_cast<unsigned char*>(std::malloc(resampler_block_frames * frame_size));
+    input = allocate_floats(samples);
+    output = allocate_floats(samples);
+
+    if (!raw || !input || !output) {
+      return ENOMEM;
+    }
+
+    return result();
+  }
+};
+
+/// Contains the implementation data of a resampling reader.
+class resampling_reader_impl final
+{
+  friend resampling_reader;
+  /// The reader that frames are read from.
+  interleaved_reader* source = nullptr;
+  /// The resampler and its buffers.
+  resampling_stage stage;
+  /// The index of the next frame in the input buffer to resample.
+  size_type input_offset = 0;
+  /// The number of frames in the input buffer.
+  size_type input_size = 0;
+};
+
+resampling_reader::resampling_reader() noexcept : self(nullptr) { }
+
+resampling_reader::resampling_reader(resampling_reader&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+resampling_reader::~resampling_reader()
+{
+  delete self;
+}
+
+result resampling_reader::open(interleaved_reader& source, const pcm_config& source_config, size_type rate, resampler_quality quality) noexcept
+{
+  delete self;
+
+  self = new (std::nothrow) resampling_reader_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  auto err = self->stage.init(source_config, source_config.rate, rate, quality);
+  if (err.failed()) {
+    delete self;
+    self = nullptr;
+    return err;
+  }
+
+  self->source = &source;
+
+  return result();
+}
+
+resampler& resampling_reader::get_resampler() noexcept
+{
+  return self->stage.converter;
+}
+
+generic_result<size_type> resampling_reader::read_unformatted(void* frames, size_type frame_count) noexcept
+{
+  if (!self) {
+    return { EBADF, 0 };
+  }
+
+  auto& stage = self->stage;
+
+  auto channels = stage.config.channels;
+
+  auto* out = static_cast<unsigned char*>(frames);
+
+  size_type done = 0;
+
+  while (done < frame_count) {
+
+    if (self->input_offset == self->input_size) {
+
+      auto read_result = self->source->read_unformatted(stage.raw, resampler_block_frames);
+      if (read_result.failed()) {
+        return { done ? 0 : read_result.error, done };
+      } else if (!read_result.value) {
+        break;
+      }
+
+      convert_to_float(stage.config.format, stage.raw, stage.input, read_result.value * channels);
+
+      self->input_offset = 0;
+      self->input_size = read_result.value;
+    }
+
+    auto counts = stage.converter.process(stage.input + (self->input_offset * channels),
+                                          self->input_size - self->input_offset,
+                                          stage.output,
+                                          std::min(frame_count - done, resampler_block_frames));
+
+    self->input_offset += counts.frames_read;
+
+    convert_from_float(stage.output, stage.config.format, out + (done * stage.frame_size), counts.frames_written * channels);
+
+    done += counts.frames_written;
+  }
+
+  return { 0, done };
+}
+
+/// Contains the implementation data of a resampling writer.
+class resampling_writer_impl final
+{
+  friend resampling_writer;
+  /// The writer that frames are written to.
+  interleaved_writer* sink = nullptr;
+  /// The resampler and its buffers.
+  resampling_stage stage;
+  /// Writes all the frames in the output buffer to the sink.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, the errno value of the sink is returned.
+  result flush(size_type frame_count) noexcept
+  {
+    convert_from_float(stage.output, stage.config.format, stage.raw, frame_count * stage.config.channels);
+
+    size_type written = 0;
+
+    while (written < frame_count) {
+      auto write_result = sink->write_unformatted(stage.raw + (written * stage.frame_size), frame_count - written);
+      if (write_result.failed()) {
+        return write_result.error;
+      }
+      written += write_result.value;
+    }
+
+    return result();
+  }
+};
+
+resampling_writer::resampling_writer() noexcept : self(nullptr) { }
+
+resampling_writer::resampling_writer(resampling_writer&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+resampling_writer::~resampling_writer()
+{
+  delete self;
+}
+
+result resampling_writer::open(interleaved_writer& sink, const pcm_config& sink_config, size_type rate, resampler_quality quality) noexcept
+{
+  delete self;
+
+  self = new (std::nothrow) resampling_writer_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  auto err = self->stage.init(sink_config, rate, sink_config.rate, quality);
+  if (err.failed()) {
+    delete self;
+    self = nullptr;
+    return err;
+  }
+
+  self->sink = &sink;
+
+  return result();
+}
+
+resampler& resampling_writer::get_resampler() noexcept
+{
+  return self->stage.converter;
+}
+
+generic_result<size_type> resampling_writer::write_unformatted(const void* frames, size_type frame_count) noexcept
+{
+  if (!self) {
+    return { EBADF, 0 };
+  }
+
+  auto& stage = self->stage;
+
+  auto channels = stage.config.channels;
+
+  const auto* in = static_cast<const unsigned char*>(frames);
+
+  size_type done = 0;
+
+  while (done < frame_count) {
+
+    auto block_size = std::min(frame_count - done, resampler_block_frames);
+
+    convert_to_float(stage.config.format, in + (done * stage.frame_size), stage.input, block_size * channels);
+
+    size_type offset = 0;
+
+    // The output buffer may fill up before the
+    // input is consumed, when upsampling.
+    for (;;) {
+
+      auto counts = stage.converter.process(stage.input + (offset * channels), block_size - offset, stage.output, resampler_block_frames);
+
+      offset += counts.frames_read;
+
+      if (counts.frames_written) {
+        auto err = self->flush(counts.frames_written);
+        if (err.failed()) {
+          return { err.error, done };
+        }
+      }
+
+      if ((offset == block_size) && (counts.frames_written < resampler_block_frames)) {
+        break;
+      }
+    }
+
+    done += block_size;
+  }
+
+  return { 0, done };
+}
+
+//==========================//
+// Section: Channel Remixer //
+//==========================//
+
+namespace {
+
+/// The number of frames mixed at a time. The channels of a
+/// block are kept in planes, so that each gain is applied to
+/// consecutive samples.
+constexpr size_type remix_block_frames = 64;
+
+void remix_scale_scalar(const float* in, float gain, float step, float* out, size_type n) noexcept
+{
+  for (size_type i = 0; i < n; i++) {
+    out[i] = in[i] * (gain + (float(i) * step));
+  }
+}
+
+void remix_add_scalar(const float* in, float gain, float step, float* out, size_type n) noexcept
+{
+  for (size_type i = 0; i < n; i++) {
+    out[i] += in[i] * (gain + (float(i) * step));
+  }
+}
+
+#if defined(__SSE2__)
+
+size_type remix_scale_sse2(const float* in, float gain, float step, float* out, size_type n) noexcept
+{
+  auto g = _mm_add_ps(_mm_set1_ps(gain), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(0, 1, 2, 3)));
+  auto dg = _mm_set1_ps(step * 4);
+
+  size_type i = 0;
+
+  for (; (i + 4) <= n; i += 4) {
+    _mm_store_ps(out + i, _mm_mul_ps(_mm_load_ps(in + i), g));
+    g = _mm_add_ps(g, dg);
+  }
+
+  return i;
+}
+
+size_type remix_add_sse2(const float* in, float gain, float step, float* out, size_type n) noexcept
+{
+  auto g = _mm_add_ps(_mm_set1_ps(gain), _mm_mul_ps(_mm_set1_ps(step), _mm_setr_ps(0, 1, 2, 3)));
+  auto dg = _mm_set1_ps(step * 4);
+
+  size_type i = 0;
+
+  for (; (i + 4) <= n; i += 4) {
+    _mm_store_ps(out + i, _mm_add_ps(_mm_load_ps(out + i), _mm_mul_ps(_mm_load_ps(in + i), g)));
+    g = _mm_add_ps(g, dg);
+  }
+
+  return i;
+}
+
+#endif /* defined(__SSE2__) */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+__attribute__((target("avx2,fma"))) size_type remix_scale_avx2(const float* in, float gain, float step, float* out, size_type n) noexcept
+{
+  auto g = _mm256_fmadd_ps(_mm256_set1_ps(step), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(gain));
+  auto dg = _mm256_set1_ps(step * 8);
+
+  size_type i = 0;
+
+  for (; (i + 8) <= n; i += 8) {
+    _mm256_store_ps(out + i, _mm256_mul_ps(_mm256_load_ps(in + i), g));
+    g = _mm256_add_ps(g, dg);
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2,fma"))) size_type remix_add_avx2(const float* in, float gain, float step, float* out, size_type n) noexcept
+{
+  auto g = _mm256_fmadd_ps(_mm256_set1_ps(step), _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(gain));
+  auto dg = _mm256_set1_ps(step * 8);
+
+  size_type i = 0;
+
+  for (; (i + 8) <= n; i += 8) {
+    _mm256_store_ps(out + i, _mm256_fmadd_ps(_mm256_load_ps(in + i), g, _mm256_load_ps(out + i)));
+    g = _mm256_add_ps(g, dg);
+  }
+
+  return i;
+}
+
+#endif /* defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) */
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+
+size_type remix_scale_neon(const float* in, float gain, float step, float* out, size_type n) noexcept
+{
+  const float offsets[4] { 0, 1, 2, 3 };
+
+  auto g = vfmaq_n_f32(vdupq_n_f32(gain), vld1q_f32(offsets), step);
+  auto dg = vdupq_n_f32(step * 4);
+
+  size_type i = 0;
+
+  for (; (i + 4) <= n; i += 4) {
+    vst1q_f32(out + i, vmulq_f32(vld1q_f32(in + i), g));
+    g = vaddq_f32(g, dg);
+  }
+
+  return i;
+}
+
+size_type remix_add_neon(const float* in, float gain, float step, float* out, size_type n) noexcept
+{
+  const float offsets[4] { 0, 1, 2, 3 };
+
+  auto g = vfmaq_n_f32(vdupq_n_f32(gain), vld1q_f32(offsets), step);
+  auto dg = vdupq_n_f32(step * 4);
+
+  size_type i = 0;
+
+  for (; (i + 4) <= n; i += 4) {
+    vst1q_f32(out + i, vfmaq_f32(vld1q_f32(out + i), vld1q_f32(in + i), g));
+    g = vaddq_f32(g, dg);
+  }
+
+  return i;
+}
+
+#endif /* defined(__aarch64__) && defined(__ARM_NEON) */
+
+size_type remix_none(const float*, float, float, float*, size_type) noexcept
+{
+  return 0;
+}
+
+/// Contains the remix kernels of one instruction set.
+///
+/// Each kernel applies a gain that changes by a step on every
+/// frame, which is zero unless the gain is ramping. The kernels
+/// return the number of samples they processed, and the rest are
+/// left to the scalar kernels. The planes passed to them are aligned.
+struct remix_kernels final
+{
+  /// Writes a plane multiplied by a gain.
+  size_type (*scale)(const float*, float, float, float*, size_type) = remix_none;
+  /// Adds a plane multiplied by a gain.
+  size_type (*add)(const float*, float, float, float*, size_type) = remix_none;
+};
+
+/// Gets the remix kernels of an instruction set.
+///
+/// @return The kernels, or null if the library was built without
+/// them or the CPU does not support the instruction set.
+const remix_kernels* find_remix_kernels(conversion_isa isa) noexcept
+{
+  switch (isa) {
+    case conversion_isa::scalar: {
+      static const remix_kernels kernels;
+      return &kernels;
+    }
+    case conversion_isa::sse2:
+#if defined(__SSE2__)
+      {
+        static const remix_kernels kernels { remix_scale_sse2, remix_add_sse2 };
+        return &kernels;
+      }
+#else
+      break;
+#endif
+    case conversion_isa::avx2:
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+      if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        static const remix_kernels kernels { remix_scale_avx2, remix_add_avx2 };
+        return &kernels;
+      }
+#endif
+      break;
+    case conversion_isa::neon:
+#if defined(__aarch64__) && defined(__ARM_NEON)
+      {
+        static const remix_kernels kernels { remix_scale_neon, remix_add_neon };
+        return &kernels;
+      }
+#else
+      break;
+#endif
+  }
+
+  return nullptr;
+}
+
+/// Accesses the kernels of the instruction set that conversions
+/// are made with, so that they may be checked against the scalar
+/// ones. The AVX2 kernels need FMA as well, and the SSE2 kernels
+/// are used on CPUs without it.
+const remix_kernels& get_remix_kernels() noexcept
+{
+  const auto* kernels = find_remix_kernels(get_conversion_isa());
+
+  if (!kernels) {
+    kernels = find_remix_kernels(conversion_isa::sse2);
+  }
+
+  if (!kernels) {
+    kernels = find_remix_kernels(conversion_isa::scalar);
+  }
+
+  return *kernels;
+}
+
+} // namespace
+
+/// Contains the implementation data of a channel remixer.
+///
+/// All the memory is allocated when the remixer is initialized,
+/// so that the gains may be changed from a real-time thread.
+class channel_remixer_impl final
+{
+  friend channel_remixer;
+  /// The number of channels in an input frame.
+  size_type input_channels = 0;
+  /// The number of channels in an output frame.
+  size_type output_channels = 0;
+  /// The current gains.
+  float* gains = nullptr;
+  /// The gains at the end of the ramp.
+  float* targets = nullptr;
+  /// How much each gain changes per frame while ramping.
+  float* steps = nullptr;
+  /// The input channels of the gains that are applied, row by row.
+  size_type* entries = nullptr;
+  /// The index of the first entry of each row, plus one for the end.
+  size_type* rows = nullptr;
+  /// Whether or not each input channel is read.
+  bool* used = nullptr;
+  /// The planes of the input channels in a block.
+  float* input_planes = nullptr;
+  /// The planes of the output channels in a block.
+  float* output_planes = nullptr;
+  /// Interleaved input frames, when converting from a sample format.
+  float* input_frames = nullptr;
+  /// Interleaved output frames, when converting to a sample format.
+  float* output_frames = nullptr;
+  /// The number of frames left in the ramp.
+  size_type ramp_frames = 0;
+  /// Whether or not the matrix copies the frames unchanged.
+  bool is_identity = false;
+public:
+  /// Releases the matrix and buffers.
+  ~channel_remixer_impl()
+  {
+    std::free(gains);
+    std::free(targets);
+    std::free(steps);
+    std::free(entries);
+    std::free(rows);
+    std::free(used);
+    std::free(input_planes);
+    std::free(output_planes);
+    std::free(input_frames);
+    std::free(output_frames);
+  }
+  /// Finds the gains that need to be applied. This is
+  /// done whenever the matrix changes or a ramp completes.
+  void analyze() noexcept
+  {
+    size_type count = 0;
+
+    bool identity = (input_channels == output_channels) && !ramp_frames;
+
+    for (size_type i = 0; i < input_channels; i++) {
+      used[i] = false;
+    }
+
+    for (size_type o = 0; o < output_channels; o++) {
+
+      rows[o] = count;
+
+      for (size_type i = 0; i < input_channels; i++) {
+
+        auto index = (o * input_channels) + i;
+
+        if ((gains[index] != 0) || (targets[index] != 0)) {
+          entries[count++] = i;
+          used[i] = true;
+        }
+
+        if (gains[index] != ((o == i) ? 1.0f : 0.0f)) {
+          identity = false;
+        }
+      }
+    }
+
+    rows[output_channels] = count;
+
+    is_identity = identity;
+  }
+  /// Starts ramping every gain to its target.
+  void start_ramp(size_type frame_count) noexcept
+  {
+    auto size = input_channels * output_channels;
+
+    if (!frame_count) {
+      for (size_type i = 0; i < size; i++) {
+        gains[i] = targets[i];
+        steps[i] = 0;
+      }
+    } else {
+      for (size_type i = 0; i < size; i++) {
+        steps[i] = (targets[i] - gains[i]) / float(frame_count);
+      }
+    }
+
+    ramp_frames = frame_count;
+
+    analyze();
+  }
+  /// Moves the ramp forward by a number of frames.
+  void advance_ramp(size_type frame_count) noexcept
+  {
+    auto size = input_channels * output_channels;
+
+    ramp_frames -= frame_count;
+
+    if (!ramp_frames) {
+      start_ramp(0);
+      return;
+    }
+
+    for (size_type i = 0; i < size; i++) {
+      gains[i] += steps[i] * float(frame_count);
+    }
+  }
+  /// Mixes one block of frames.
+  void mix(const float* input, float* output, size_type frame_count) noexcept
+  {
+    const auto& kernels = get_remix_kernels();
+
+    for (size_type i = 0; i < input_channels; i++) {
+
+      if (!used[i]) {
+        continue;
+      }
+
+      auto* plane = input_planes + (i * remix_block_frames);
+
+      for (size_type f = 0; f < frame_count; f++) {
+        plane[f] = input[(f * input_channels) + i];
+      }
+    }
+
+    for (size_type o = 0; o < output_channels; o++) {
+
+      auto* plane = output_planes + (o * remix_block_frames);
+
+      if (rows[o] == rows[o + 1]) {
+        memset(plane, 0, frame_count * sizeof(float));
+      }
+
+      for (auto e = rows[o]; e < rows[o + 1]; e++) {
+
+        auto i = entries[e];
+
+        auto index = (o * input_channels) + i;
+
+        const auto* in = input_planes + (i * remix_block_frames);
+
+        auto gain = gains[index];
+        auto step = steps[index];
+
+        if (e == rows[o]) {
+          auto done = kernels.scale(in, gain, step, plane, frame_count);
+          remix_scale_scalar(in + done, gain + (float(done) * step), step, plane + done, frame_count - done);
+        } else {
+          auto done = kernels.add(in, gain, step, plane, frame_count);
+          remix_add_scalar(in + done, gain + (float(done) * step), step, plane + done, frame_count - done);
+        }
+      }
+    }
+
+    for (size_type o = 0; o < output_channels; o++) {
+
+      const auto* plane = output_planes + (o * remix_block_frames);
+
+      for (size_type f = 0; f < frame_count; f++) {
+        output[(f * output_channels) + o] = plane[f];
+      }
+    }
+  }
+};
+
+channel_remixer::channel_remixer() noexcept : self(nullptr) { }
+
+channel_remixer::channel_remixer(channel_remixer&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+channel_remixer::~channel_remixer()
+{
+  delete self;
+}
+
+result channel_remixer::init(size_type input_channels, size_type output_channels) noexcept
+{
+  if (!input_channels || !output_channels) {
+    return EINVAL;
+  }
+
+  delete self;
+
+  self = new (std::nothrow) channel_remixer_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  auto size = input_channels * output_channels;
+
+  self->input_channels = input_channels;
+  self->output_channels = output_channels;
+  self->gains = allocate_floats(size);
+  self->targets = allocate_floats(size);
+  self->steps = allocate_floats(size);
+  self->entries = static_cast<size_type*>(std::malloc(size * sizeof(size_type)));
+  self->rows = static_cast<size_type*>(std::malloc((output_channels + 1) * sizeof(size_type)));
+  self->used = static_cast<bool*>(std::malloc(input_channels * sizeof(bool)));
+  self->input_planes = allocate_floats(input_channels * remix_block_frames);
+  self->output_planes = allocate_floats(output_channels * remix_block_frames);
+  self->input_frames = allocate_floats(input_channels * remix_block_frames);
+  self->output_frames = allocate_floats(output_channels * remix_block_frames);
+
+  if (!self->gains || !self->targets || !self->steps || !self->entries || !self->rows || !self->used
+   || !self->input_planes || !self->output_planes || !self->input_frames || !self->output_frames) {
+    delete self;
+    self = nullptr;
+    return ENOMEM;
+  }
+
+  for (size_type o = 0; o < output_channels; o++) {
+    for (size_type i = 0; i < input_channels; i++) {
+      self->targets[(o * input_channels) + i] = (o == i) ? 1.0f : 0.0f;
+    }
+  }
+
+  self->start_ramp(0);
+
+  return result();
+}
+
+result channel_remixer::set_matrix(const float* gains, size_type ramp_frames) noexcept
+{
+  if (!self) {
+    return EBADF;
+  }
+
+  memcpy(self->targets, gains, self->input_channels * self->output_channels * sizeof(float));
+
+  self->start_ramp(ramp_frames);
+
+  return result();
+}
+
+result channel_remixer::set_gain(size_type output_channel, size_type input_channel, float gain, size_type ramp_frames) noexcept
+{
+  if (!self) {
+    return EBADF;
+  } else if ((output_channel >= self->output_channels) || (input_channel >= self->input_channels)) {
+    return EINVAL;
+  }
+
+  self->targets[(output_channel * self->input_channels) + input_channel] = gain;
+
+  self->start_ramp(ramp_frames);
+
+  return result();
+}
+
+bool channel_remixer::is_ramping() const noexcept
+{
+  return self && (self->ramp_frames > 0);
+}
+
+void channel_remixer::process(const float* input, float* output, size_type frame_count) noexcept
+{
+  if (!self) {
+    return;
+  }
+
+  if (self->is_identity) {
+    memcpy(output, input, frame_count * self->input_channels * sizeof(float));
+    return;
+  }
+
+  size_type done = 0;
+
+  while (done < frame_count) {
+
+    auto block_size = std::min(frame_count - done, remix_block_frames);
+
+    // Blocks end where the ramp does, so that the
+    // gains after it are applied without a step.
+    if (self->ramp_frames) {
+      block_size = std::min(block_size, self->ramp_frames);
+    }
+
+    self->mix(input + (done * self->input_channels), output + (done * self->output_channels), block_size);
+
+    if (self->ramp_frames) {
+
+      self->advance_ramp(block_size);
+
+      if (self->is_identity) {
+        done += block_size;
+        memcpy(output + (done * self->output_channels), input + (done * self->input_channels), (frame_count - done) * self->input_channels * sizeof(float));
+        return;
+      }
+    }
+
+    done += block_size;
+  }
+}
+
+void channel_remixer::process(sample_format format, const void* input, void* output, size_type frame_count, dither* d) noexcept
+{
+  if (!self) {
+    return;
+  }
+
+  auto sample_size = to_physical_bits(format) / 8;
+
+  const auto* in = static_cast<const unsigned char*>(input);
+
+  auto* out = static_cast<unsigned char*>(output);
+
+  auto input_frame_size = sample_size * self->input_channels;
+  auto output_frame_size = sample_size * self->output_channels;
+
+  for (size_type done = 0; done < frame_count; done += remix_block_frames) {
+
+    auto block_size = std::min(frame_count - done, remix_block_frames);
+
+    convert_to_float(format, in + (done * input_frame_size), self->input_frames, block_size * self->input_channels);
+
+    process(self->input_frames, self->output_frames, block_size);
+
+    convert_from_float(self->output_frames, format, out + (done * output_frame_size), block_size * self->output_channels, d);
+  }
+}
+
+//=========================//
+// Section: Software Mixer //
+//=========================//
+
+namespace {
+
+size_type mix_s16_none(std::int16_t*, const std::int16_t*, size_type) noexcept
+{
+  return 0;
+}
+
+size_type mix_s32_none(std::int32_t*, const std::int32_t*, size_type) noexcept
+{
+  return 0;
+}
+
+void mix_s16_scalar(std::int16_t* acc, const std::int16_t* src, size_type n) noexcept
+{
+  for (size_type i = 0; i < n; i++) {
+    auto sum = std::int32_t(acc[i]) + std::int32_t(src[i]);
+    acc[i] = std::int16_t(std::min(std::max(sum, std::int32_t(-32768)), std::int32_t(32767)));
+  }
+}
+
+void mix_s32_scalar(std::int32_t* acc, const std::int32_t* src, size_type n) noexcept
+{
+  for (size_type i = 0; i < n; i++) {
+    auto sum = std::int64_t(acc[i]) + std::int64_t(src[i]);
+    sum = std::min(std::max(sum, std::int64_t(std::numeric_limits<std::int32_t>::min())),
+                   std::int64_t(std::numeric_limits<std::int32_t>::max()));
+    acc[i] = std::int32_t(sum);
+  }
+}
+
+#if defined(__SSE2__)
+
+size_type mix_s16_sse2(std::int16_t* acc, const std::int16_t* src, size_type n) noexcept
+{
+  size_type i = 0;
+
+  for (; (i + 8) <= n; i += 8) {
+    auto a = _mm_loadu_si128((const __m128i*) (acc + i));
+    auto b = _mm_loadu_si128((const __m128i*) (src + i));
+    _mm_storeu_si128((__m128i*) (acc + i), _mm_adds_epi16(a, b));
+  }
+
+  return i;
+}
+
+/// Adds 32-bit integers, saturating the lanes that overflow.
+/// A lane overflows when both operands have a sign that the sum doesn't.
+inline __m128i adds_epi32_sse2(__m128i a, __m128i b) noexcept
+{
+  auto sum = _mm_add_epi32(a, b);
+  auto overflow = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(a, sum), _mm_xor_si128(b, sum)), 31);
+  auto saturated = _mm_xor_si128(_mm_srai_epi32(a, 31), _mm_set1_epi32(0x7fffffff));
+  return _mm_or_si128(_mm_and_si128(overflow, saturated), _mm_andnot_si128(overflow, sum));
+}
+
+size_type mix_s32_sse2(std::int32_t* acc, const std::int32_t* src, size_type n) noexcept
+{
+  size_type i = 0;
+
+  for (; (i + 4) <= n; i += 4) {
+    auto a = _mm_loadu_si128((const __m128i*) (acc + i));
+    auto b = _mm_loadu_si128((const __m128i*) (src + i));
+    _mm_storeu_si128((__m128i*) (acc + i), adds_epi32_sse2(a, b));
+  }
+
+  return i;
+}
+
+#endif /* defined(__SSE2__) */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+__attribute__((target("avx2"))) size_type mix_s16_avx2(std::int16_t* acc, const std::int16_t* src, size_type n) noexcept
+{
+  size_type i = 0;
+
+  for (; (i + 16) <= n; i += 16) {
+    auto a = _mm256_loadu_si256((const __m256i*) (acc + i));
+    auto b = _mm256_loadu_si256((const __m256i*) (src + i));
+    _mm256_storeu_si256((__m256i*) (acc + i), _mm256_adds_epi16(a, b));
+  }
+
+  return i;
+}
+
+__attribute__((target("avx2"))) size_type mix_s32_avx2(std::int32_t* acc, const std::int32_t* src, size_type n) noexcept
+{
+  size_type i = 0;
+
+  auto max = _mm256_set1_epi32(0x7fffffff);
+
+  for (; (i + 8) <= n; i += 8) {
+    auto a = _mm256_loadu_si256((const __m256i*) (acc + i));
+    auto b = _mm256_loadu_si256((const __m256i*) (src + i));
+    auto sum = _mm256_add_epi32(a, b);
+    auto overflow = _mm256_and_si256(_mm256_xor_si256(a, sum), _mm256_xor_si256(b, sum));
+    auto saturated = _mm256_xor_si256(_mm256_srai_epi32(a, 31), max);
+    _mm256_storeu_si256((__m256i*) (acc + i), _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(sum),
+                                                                                  _mm256_castsi256_ps(saturated),
+                                                                                  _mm256_castsi256_ps(overflow))));
+  }
+
+  return i;
+}
+
+#endif /* defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) */
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+
+size_type mix_s16_neon(std::int16_t* acc, const std::int16_t* src, size_type n) noexcept
+{
+  size_type i = 0;
+
+  for (; (i + 8) <= n; i += 8) {
+    vst1q_s16(acc + i, vqaddq_s16(vld1q_s16(acc + i), vld1q_s16(src + i)));
+  }
+
+  return i;
+}
+
+size_type mix_s32_neon(std::int32_t* acc, const std::int32_t* src, size_type n) noexcept
+{
+  size_type i = 0;
+
+  for (; (i + 4) <= n; i += 4) {
+    vst1q_s32(acc + i, vqaddq_s32(vld1q_s32(acc + i), vld1q_s32(src + i)));
+  }
+
+  return i;
+}
+
+#endif /* defined(__aarch64__) && defined(__ARM_NEON) */
+
+/// Contains the mixing kernels chosen for the host CPU.
+/// They return the number of samples they summed and the
+/// rest are left to the scalar kernels. Neither pointer needs to be
+/// aligned, since the frames of a client that wrap around its ring
+/// are summed into the middle of the period.
+struct mix_kernels final
+{
+  size_type (*mix_s16)(std::int16_t*, const std::int16_t*, size_type) = mix_s16_none;
+  size_type (*mix_s32)(std::int32_t*, const std::int32_t*, size_type) = mix_s32_none;
+};
+
+/// Selects the fastest kernels supported by the CPU.
+mix_kernels select_mix_kernels() noexcept
+{
+  mix_kernels kernels;
+
+#if defined(__SSE2__)
+  kernels.mix_s16 = mix_s16_sse2;
+  kernels.mix_s32 = mix_s32_sse2;
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  if (__builtin_cpu_supports("avx2")) {
+    kernels.mix_s16 = mix_s16_avx2;
+    kernels.mix_s32 = mix_s32_avx2;
+  }
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+  kernels.mix_s16 = mix_s16_neon;
+  kernels.mix_s32 = mix_s32_neon;
+#endif
+
+  return kernels;
+}
+
+/// Accesses the kernels chosen for the host CPU.
+/// The selection is only made once.
+const mix_kernels& get_mix_kernels() noexcept
+{
+  static const mix_kernels kernels = select_mix_kernels();
+  return kernels;
+}
+
+/// The states of a mixer client slot.
+enum mixer_slot_state : int
+{
+  /// The slot may be taken by a new client.
+  slot_free,
+  /// A client is allocating its ring.
+  slot_adding,
+  /// The client is mixed.
+  slot_active,
+  /// The client was removed and the mixer has not yet let go of it.
+  slot_closing
+};
+
+/// A client of a software mixer.
+struct mixer_slot final
+{
+  /// The state of the slot. The client owns the ring while
+  /// adding, and the mixer reads from it while active or closing.
+  std::atomic<int> state { slot_free };
+  /// The frames written by the client.
+  frame_ring ring;
+  /// The number of periods the client was late for.
+  std::atomic<size_type> underruns { 0 };
+};
+
+/// The alignment of the mixing buffers, which suits the vector kernels.
+constexpr size_type mix_alignment = 32;
+
+/// Allocates a buffer of samples for the mixing kernels.
+///
+/// @param buffer Receives the buffer on success.
+/// @param count The number of samples in the buffer.
+///
+/// @return On success, zero is returned.
+/// On failure, an errno value is returned.
+template <typename sample_type>
+int allocate_mix_buffer(sample_type*& buffer, size_type count) noexcept
+{
+  void* memory = nullptr;
+
+  auto err = ::posix_memalign(&memory, mix_alignment, count * sizeof(sample_type));
+  if (err == 0) {
+    buffer = static_cast<sample_type*>(memory);
+  }
+
+  return err;
+}
+
+} // namespace
+
+/// Contains the implementation data of a software mixer.
+class software_mixer_impl final
+{
+  friend software_mixer;
+  /// The playback PCM.
+  interleaved_pcm_writer output;
+  /// The configuration of the PCM.
+  pcm_config config;
+  /// The number of bytes in one frame.
+  size_type frame_size = 0;
+  /// The number of samples in one period.
+  size_type period_samples = 0;
+  /// The client slots.
+  mixer_slot* slots = nullptr;
+  /// The number of client slots.
+  size_type slot_count = 0;
+  /// Whether or not the samples are summed as they are, instead of as 32-bit integers.
+  bool native_s16 = false;
+  /// The period being mixed, when summed as they are.
+  /// This is the only buffer used in that case.
+  std::int16_t* mix16 = nullptr;
+  /// The period being mixed, when summed as 32-bit integers.
+  std::int32_t* mix32 = nullptr;
+  /// The frames of one client, converted to 32-bit integers.
+  std::int32_t* decoded = nullptr;
+  /// The period in the format of the PCM, when summed as 32-bit integers.
+  unsigned char* frames = nullptr;
+public:
+  /// Releases the clients and buffers.
+  ~software_mixer_impl()
+  {
+    delete [] slots;
+    std::free(mix16);
+    std::free(mix32);
+    std::free(decoded);
+    std::free(frames);
+  }
+  /// Sums frames of a client into the period.
+  ///
+  /// @param src The frames of the client.
+  /// @param offset The index of the first sample in the period.
+  /// @param samples The number of samples to sum.
+  void mix(const void* src, size_type offset, size_type samples) noexcept
+  {
+    const auto& kernels = get_mix_kernels();
+
+    if (native_s16) {
+      const auto* in = static_cast<const std::int16_t*>(src);
+      auto* acc = mix16 + offset;
+      auto done = kernels.mix_s16(acc, in, samples);
+      mix_s16_scalar(acc + done, in + done, samples - done);
+      return;
+    }
+
+    convert_to_int32(config.format, src, decoded, samples);
+
+    auto* acc = mix32 + offset;
+
+    auto done = kernels.mix_s32(acc, decoded, samples);
+
+    mix_s32_scalar(acc + done, decoded + done, samples - done);
+  }
+  /// Mixes one period from every client.
+  ///
+  /// @return The number of clients that frames were mixed from.
+  size_type mix_period() noexcept
+  {
+    if (native_s16) {
+      memset(mix16, 0, period_samples * sizeof(std::int16_t));
+    } else {
+      memset(mix32, 0, period_samples * sizeof(std::int32_t));
+    }
+
+    size_type mixed = 0;
+
+    for (size_type i = 0; i < slot_count; i++) {
+
+      auto& slot = slots[i];
+
+      auto state = slot.state.load(std::memory_order_acquire);
+
+      if (state == slot_closing) {
+        slot.state.store(slot_free, std::memory_order_release);
+        continue;
+      } else if (state != slot_active) {
+        continue;
+      }
+
+      size_type frames_mixed = 0;
+
+      // The frames may wrap around the end of the ring.
+      for (int part = 0; (part < 2) && (frames_mixed < config.period_size); part++) {
+
+        auto region = slot.ring.begin_read(config.period_size - frames_mixed);
+        if (!region.frame_count) {
+          break;
+        }
+
+        mix(region.frames, frames_mixed * config.channels, region.frame_count * config.channels);
+
+        slot.ring.commit_read(region.frame_count);
+
+        frames_mixed += region.frame_count;
+      }
+
+      if (frames_mixed < config.period_size) {
+        slot.underruns.fetch_add(1, std::memory_order_relaxed);
+      }
+
+      if (frames_mixed) {
+        mixed++;
+      }
+    }
+
+    return mixed;
+  }
+  /// Gets the period in the format of the PCM.
+  const void* get_period() noexcept
+  {
+    if (native_s16) {
+      return mix16;
+    }
+
+    convert_from_int32(mix32, config.format, frames, period_samples);
+
+    return frames;
+  }
+};
+
+software_mixer::software_mixer() noexcept : self(nullptr) { }
+
+software_mixer::software_mixer(software_mixer&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+software_mixer::~software_mixer()
+{
+  close();
+}
+
+result software_mixer::open(size_type card, size_type device, const pcm_config& config, size_type max_clients) noexcept
+{
+  close();
+
+  if (!max_clients || !config.period_size || !config.channels) {
+    return EINVAL;
+  }
+
+  self = new (std::nothrow) software_mixer_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  self->config = config;
+  self->frame_size = (to_physical_bits(config.format) / 8) * config.channels;
+  self->period_samples = config.period_size * config.channels;
+  self->native_s16 = (config.format == sample_format::s16_le) && !host_is_big_endian();
+  self->slots = new (std::nothrow) mixer_slot[max_clients];
+  self->slot_count = max_clients;
+
+  if (!self->slots) {
+    close();
+    return ENOMEM;
+  }
+
+  // Samples summed as they are need nothing but the period
+  // being mixed, which is also what's written to the PCM.
+  if (self->native_s16) {
+
+    auto alloc_err = allocate_mix_buffer(self->mix16, self->period_samples);
+    if (alloc_err != 0) {
+      close();
+      return alloc_err;
+    }
+
+  } else {
+
+    auto alloc_err = allocate_mix_buffer(self->mix32, self->period_samples);
+
+    if (alloc_err == 0) {
+      alloc_err = allocate_mix_buffer(self->decoded, self->period_samples);
+    }
+
+    if (alloc_err != 0) {
+      close();
+      return alloc_err;
+    }
+
+    self->frames = static_cast<unsigned char*>(std::malloc(config.period_size * self->frame_size));
+    if (!self->frames) {
+      close();
+      return ENOMEM;
+    }
+  }
+
+  auto err = self->output.open(card, device);
+  if (err.failed()) {
+    close();
+    return err;
+  }
+
+  err = self->output.setup(config);
+  if (err.failed()) {
+    close();
+    return err;
+  }
+
+  err = self->output.prepare();
+  if (err.failed()) {
+    close();
+    return err;
+  }
+
+  return result();
+}
+
+void software_mixer::close() noexcept
+{
+  delete self;
+  self = nullptr;
+}
+
+interleaved_pcm_writer& software_mixer::get_pcm() noexcept
+{
+  return self->output;
+}
+
+generic_result<size_type> software_mixer::add_client(size_type ring_frames) noexcept
+{
+  using result_type = generic_result<size_type>;
+
+  if (!self) {
+    return result_type { EBADF, 0 };
+  }
+
+  if (!ring_frames) {
+    ring_frames = self->config.period_size * self->config.period_count;
+  }
+
+  for (size_type i = 0; i < self->slot_count; i++) {
+
+    auto& slot = self->slots[i];
+
+    int expected = slot_free;
+
+    if (!slot.state.compare_exchange_strong(expected, slot_adding, std::memory_order_acquire)) {
+      continue;
+    }
+
+    auto err = slot.ring.allocate(ring_frames, self->frame_size);
+    if (err.failed()) {
+      slot.state.store(slot_free, std::memory_order_release);
+      return result_type { err.error, 0 };
+    }
+
+    slot.underruns.store(0, std::memory_order_relaxed);
+
+    slot.state.store(slot_active, std::memory_order_release);
+
+    return result_type { 0, i };
+  }
+
+  return result_type { EBUSY, 0 };
+}
+
+result software_mixer::remove_client(size_type client) noexcept
+{
+  if (!self) {
+    return EBADF;
+  } else if (client >= self->slot_count) {
+    return EINVAL;
+  }
+
+  int expected = slot_active;
+
+  if (!self->slots[client].state.compare_exchange_strong(expected, slot_closing, std::memory_order_release)) {
+    return EINVAL;
+  }
+
+  return result();
+}
+
+size_type software_mixer::writable(size_type client) noexcept
+{
+  if (!self || (client >= self->slot_count)) {
+    return 0;
+  }
+
+  auto& slot = self->slots[client];
+
+  if (slot.state.load(std::memory_order_acquire) != slot_active) {
+    return 0;
+  }
+
+  return slot.ring.writable();
+}
+
+size_type software_mixer::write(size_type client, const void* frames, size_type frame_count) noexcept
+{
+  if (!self || (client >= self->slot_count)) {
+    return 0;
+  }
+
+  auto& slot = self->slots[client];
+
+  if (slot.state.load(std::memory_order_acquire) != slot_active) {
+    return 0;
+  }
+
+  return slot.ring.write(frames, frame_count);
+}
+
+size_type software_mixer::get_underruns(size_type client) const noexcept
+{
+  if (!self || (client >= self->slot_count)) {
+    return 0;
+  }
+
+  return self->slots[client].underruns.load(std::memory_order_relaxed);
+}
+
+generic_result<size_type> software_mixer::run_once(int timeout_ms) noexcept
+{
+  using result_type = generic_result<size_type>;
+
+  if (!self) {
+    return result_type { EBADF, 0 };
+  }
+
+  auto err = self->output.wait(timeout_ms);
+  if (err.error == EPIPE) {
+    err = self->output.recover(EPIPE);
+  }
+
+  if (err.failed()) {
+    return result_type { err.error, 0 };
+  }
+
+  auto mixed = self->mix_period();
+
+  const auto* period = static_cast<const unsigned char*>(self->get_period());
+
+  size_type written = 0;
+
+  while (written < self->config.period_size) {
+
+    auto write_result = self->output.write_unformatted(period + (written * self->frame_size), self->config.period_size - written);
+    if (write_result.failed()) {
+      return result_type { write_result.error, mixed };
+    }
+
+    written += write_result.value;
+  }
+
+  return result_type { 0, mixed };
+}
+
+//=========================//
+// Section: PCM Event Loop //
+//=========================//
+
+namespace {
+
+/// Associates a PCM registered with an
+/// event loop with the handler of its events.
+struct pcm_registration final
+{
+  /// The registered PCM.
+  pcm* pcm_ptr = nullptr;
+  /// The handler of the PCM events.
+  pcm_event_handler* handler = nullptr;
+  /// Set when the PCM is removed while
+  /// events are being dispatched.
+  bool removed = false;
+};
+
+} // namespace
+
+/// Contains the implementation data of a PCM event loop.
+class pcm_event_loop_impl final
+{
+  friend pcm_event_loop;
+  /// The maximum number of events taken
+  /// from the epoll instance in one call.
+  static constexpr int max_events = 64;
+  /// The epoll file descriptor.
+  int epoll_fd = invalid_fd();
+  /// The registered PCMs.
+  pod_buffer<pcm_registration*> registrations;
+  /// Whether or not events are being dispatched.
+  /// Registrations removed while this is set are
+  /// released at the end of the dispatch.
+  bool dispatching = false;
+  /// Releases registrations that were removed during a dispatch.
+  void release_removed() noexcept;
+public:
+  /// Releases the registrations and the epoll instance.
+  ~pcm_event_loop_impl()
+  {
+    for (size_type i = 0; i < registrations.size; i++) {
+      delete registrations.data[i];
+    }
+
+    if (epoll_fd != invalid_fd()) {
+      ::close(epoll_fd);
+    }
+  }
+};
+
+void pcm_event_loop_impl::release_removed() noexcept
+{
+  size_type i = 0;
+
+  while (i < registrations.size) {
+    if (registrations.data[i]->removed) {
+      delete registrations.data[i];
+      registrations.data[i] = registrations.data[registrations.size - 1];
+      registrations.size--;
+    } else {
+      i++;
+    }
+  }
+}
+
+pcm_event_loop::pcm_event_loop() noexcept : self(nullptr) { }
+
+pcm_event_loop::pcm_event_loop(pcm_event_loop&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+pcm_event_loop::~pcm_event_loop()
+{
+  delete self;
+}
+
+result pcm_event_loop::add(pcm& p, pcm_event_handler& handler) noexcept
+{
+  if (!p.is_open()) {
+    return EBADF;
+  }
+
+  if (!self) {
+
+    self = new (std::nothrow) pcm_event_loop_impl();
+    if (!self) {
+      return ENOMEM;
+    }
+
+    self->epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (self->epoll_fd < 0) {
+      auto err = errno;
+      delete self;
+      self = nullptr;
+      return err;
+    }
+  }
+
+  auto* registration = new (std::nothrow) pcm_registration();
+  if (!registration) {
+    return ENOMEM;
+  }
+
+  registration->pcm_ptr = &p;
+  registration->handler = &handler;
+
+  if (!self->registrations.emplace_back(std::move(registration))) {
+    delete registration;
+    return ENOMEM;
+  }
+
+  epoll_event event {};
+  event.events = EPOLLIN | EPOLLOUT | EPOLLERR;
+  event.data.ptr = registration;
+
+  auto err = ::epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, p.get_file_descriptor(), &event);
+  if (err < 0) {
+    auto error = errno;
+    self->registrations.size--;
+    delete registration;
+    return error;
+  }
+
+  return result();
+}
+
+result pcm_event_loop::remove(pcm& p) noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  for (size_type i = 0; i < self->registrations.size; i++) {
+
+    auto* registration = self->registrations.data[i];
+
+    if ((registration->pcm_ptr != &p) || registration->removed) {
+      continue;
+    }
+
+    ::epoll_ctl(self->epoll_fd, EPOLL_CTL_DEL, p.get_file_descriptor(), nullptr);
+
+    registration->removed = true;
+
+    if (!self->dispatching) {
+      self->release_removed();
+    }
+
+    return result();
+  }
+
+  return ENOENT;
+}
+
+size_type pcm_event_loop::size() const noexcept
+{
+  if (!self) {
+    return 0;
+  }
+
+  size_type count = 0;
+
+  for (size_type i = 0; i < self->registrations.size; i++) {
+    count += self->registrations.data[i]->removed ? 0 : 1;
+  }
+
+  return count;
+}
+
+generic_result<size_type> pcm_event_loop::run_once(int timeout_ms) noexcept
+{
+  if (!self) {
+    return { ENOENT, 0 };
+  }
+
+  epoll_event events[pcm_event_loop_impl::max_events];
+
+  size_type dispatched = 0;
+
+  // Level triggered PCMs that remain ready are reported
+  // again, so the number of calls is limited to what's
+  // needed to see each registered PCM once.
+  auto max_rounds = (self->registrations.size / pcm_event_loop_impl::max_events) + 1;
+
+  self->dispatching = true;
+
+  for (size_type round = 0; round < max_rounds; round++) {
+
+    auto count = ::epoll_wait(self->epoll_fd, events, pcm_event_loop_impl::max_events, timeout_ms);
+    if (count < 0) {
+      if (errno == EINTR) {
+        round--;
+        continue;
+      }
+      auto err = errno;
+      self->dispatching = false;
+      self->release_removed();
+      return { err, dispatched };
+    }
+
+    for (int i = 0; i < count; i++) {
+
+      auto* registration = static_cast<pcm_registration*>(events[i].data.ptr);
+      if (registration->removed) {
+        continue;
+      }
+
+      auto& p = *registration->pcm_ptr;
+
+      if (events[i].events & EPOLLERR) {
+        registration->handler->on_xrun(p);
+      } else if (events[i].events & EPOLLIN) {
+        registration->handler->on_read_ready(p);
+      } else if (events[i].events & EPOLLOUT) {
+        registration->handler->on_write_ready(p);
+      }
+
+      dispatched++;
+    }
+
+    // If the event array was filled, there may be more ready
+    // PCMs. They're picked up without waiting, as part of this batch.
+    if (count < pcm_event_loop_impl::max_events) {
+      break;
+    }
+
+    timeout_ms = 0;
+  }
+
+  self->dispatching = false;
+
+  self->release_removed();
+
+  return { 0, dispatched };
+}
+
+int pcm_event_loop::get_file_descriptor() const noexcept
+{
+  return self ? self->epoll_fd : invalid_fd();
+}
+
+//======================//
+// Section: PCM Reactor //
+//======================//
+
+/// Contains the implementation data of a PCM reactor.
+class pcm_reactor_impl final
+{
+  friend pcm_reactor;
+  /// The maximum number of events taken
+  /// from the epoll instance in one call.
+  static constexpr int max_events = 64;
+  /// The epoll file descriptor.
+  int epoll_fd = invalid_fd();
+  /// The number of waits not yet notified.
+  std::atomic<size_type> pending { 0 };
+public:
+  /// Releases the epoll instance.
+  ~pcm_reactor_impl()
+  {
+    if (epoll_fd != invalid_fd()) {
+      ::close(epoll_fd);
+    }
+  }
+};
+
+pcm_reactor::pcm_reactor() noexcept : self(nullptr)
+{
+  // The epoll instance is made up front, rather than on the
+  // first wait, since waits may come from several threads.
+  self = new (std::nothrow) pcm_reactor_impl();
+  if (!self) {
+    return;
+  }
+
+  self->epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  if (self->epoll_fd < 0) {
+    self->epoll_fd = invalid_fd();
+    delete self;
+    self = nullptr;
+  }
+}
+
+pcm_reactor::pcm_reactor(pcm_reactor&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+pcm_reactor::~pcm_reactor()
+{
+  delete self;
+}
+
+result pcm_reactor::wait(int fd, pcm_waiter& waiter) noexcept
+{
+  if (!self) {
+    return ENOMEM;
+  }
+
+  if (fd < 0) {
+    return EBADF;
+  }
+
+  // Each PCM transfers frames in one direction only,
+  // so both directions are waited on, like in the event loop.
+  epoll_event event {};
+  event.events = EPOLLIN | EPOLLOUT | EPOLLONESHOT;
+  event.data.ptr = &waiter;
+
+  // Counted first, so that the reactor doesn't
+  // run out of waits while this one is added.
+  self->pending.fetch_add(1, std::memory_order_relaxed);
+
+  // The file descriptor stays in the epoll instance after its first
+  // wait, disabled by EPOLLONESHOT, so later waits only re-arm it.
+  auto err = ::epoll_ctl(self->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+  if ((err < 0) && (errno == ENOENT)) {
+    err = ::epoll_ctl(self->epoll_fd, EPOLL_CTL_ADD, fd, &event);
+  }
+
+  if (err < 0) {
+    auto error = errno;
+    self->pending.fetch_sub(1, std::memory_order_relaxed);
+    return error;
+  }
+
+  return result();
+}
+
+generic_result<size_type> pcm_reactor::run_once(int timeout_ms) noexcept
+{
+  if (!self) {
+    return { ENOMEM, 0 };
+  }
+
+  epoll_event events[pcm_reactor_impl::max_events];
+
+  int count = 0;
+
+  for (;;) {
+    count = ::epoll_wait(self->epoll_fd, events, pcm_reactor_impl::max_events, timeout_ms);
+    if (count >= 0) {
+      break;
+    } else if (errno != EINTR) {
+      return { errno, 0 };
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    // The wait is over before the waiter
+    // is notified, since it may wait again.
+    self->pending.fetch_sub(1, std::memory_order_relaxed);
+    static_cast<pcm_waiter*>(events[i].data.ptr)->on_ready();
+  }
+
+  return { 0, size_type(count) };
+}
+
+result pcm_reactor::run() noexcept
+{
+  while (pending() > 0) {
+    auto run_result = run_once();
+    if (run_result.failed()) {
+      return run_result.error;
+    }
+  }
+
+  return result();
+}
+
+size_type pcm_reactor::pending() const noexcept
+{
+  return self ? self->pending.load(std::memory_order_relaxed) : 0;
+}
+
+int pcm_reactor::get_file_descriptor() const noexcept
+{
+  return self ? self->epoll_fd : invalid_fd();
+}
+
+//====================//
+// Section: PCM Group //
+//====================//
+
+class pcm_group_impl final
+{
+  friend pcm_group;
+  /// The PCMs in the group.
+  pod_buffer<pcm*> members;
+  /// Whether or not the members are linked in the kernel.
+  bool linked = true;
+  /// The start skew measured by the last start.
+  std::int64_t start_skew = 0;
+  /// Removes every member from the kernel group.
+  void unlink_all() noexcept
+  {
+    for (size_type i = 0; i < members.size; i++) {
+      pcm_ioctl(members.data[i]->get_file_descriptor(), SNDRV_PCM_IOCTL_UNLINK);
+    }
+  }
+  /// Waits on a timer and then starts
+  /// every member as quickly as possible.
+  result timed_start(size_type lead_time_us) noexcept;
+};
+
+result pcm_group_impl::timed_start(size_type lead_time_us) noexcept
+{
+  auto timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+
+  if (timer_fd >= 0) {
+
+    auto deadline = get_timestamp(pcm_timestamp_type::monotonic) + std::int64_t(lead_time_us * 1000);
+
+    itimerspec timer_spec {};
+    timer_spec.it_value.tv_sec = time_t(deadline / 1000000000);
+    timer_spec.it_value.tv_nsec = long(deadline % 1000000000);
+
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &timer_spec, nullptr) == 0) {
+
+      std::uint64_t expirations = 0;
+
+      while ((::read(timer_fd, &expirations, sizeof(expirations)) < 0) && (errno == EINTR)) {
+      }
+    }
+
+    ::close(timer_fd);
+  }
+
+  // If the timer could not be used, the members
+  // are still started as close together as possible.
+
+  result start_result;
+
+  for (size_type i = 0; i < members.size; i++) {
+    auto member_result = members.data[i]->start();
+    if (member_result.failed() && !start_result.failed()) {
+      start_result = member_result;
+    }
+  }
+
+  return start_result;
+}
+
+pcm_group::pcm_group() noexcept : self(new (std::nothrow) pcm_group_impl()) { }
+
+pcm_group::pcm_group(pcm_group&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+pcm_group::~pcm_group()
+{
+  if (self) {
+    if (self->linked && (self->members.size > 1)) {
+      self->unlink_all();
+    }
+    delete self;
+  }
+}
+
+result pcm_group::add(pcm& p) noexcept
+{
+  if (!self) {
+    return ENOMEM;
+  } else if (p.get_file_descriptor() == invalid_fd()) {
+    return EBADF;
+  }
+
+  for (size_type i = 0; i < self->members.size; i++) {
+    if (self->members.data[i] == &p) {
+      return EEXIST;
+    }
+  }
+
+  auto* member = &p;
+
+  if (!self->members.emplace_back(std::move(member))) {
+    return ENOMEM;
+  }
+
+  if (self->linked && (self->members.size > 1)) {
+
+    auto first_fd = self->members.data[0]->get_file_descriptor();
+
+    if (pcm_ioctl(first_fd, SNDRV_PCM_IOCTL_LINK, reinterpret_cast<void*>(std::intptr_t(p.get_file_descriptor()))) < 0) {
+      // Drivers on different clocks, or ones that don't
+      // support linking at all, end up here.
+      self->unlink_all();
+      self->linked = false;
+    }
+  }
+
+  return result();
+}
+
+result pcm_group::remove(pcm& p) noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  auto* begin = self->members.data;
+  auto* end = begin + self->members.size;
+  auto* pos = std::find(begin, end, &p);
+  if (pos == end) {
+    return ENOENT;
+  }
+
+  if (self->linked && (self->members.size > 1)) {
+    pcm_ioctl(p.get_file_descriptor(), SNDRV_PCM_IOCTL_UNLINK);
+  }
+
+  std::copy(pos + 1, end, pos);
+
+  self->members.size--;
+
+  if (self->members.size == 0) {
+    self->linked = true;
+  }
+
+  return result();
+}
+
+size_type pcm_group::size() const noexcept
+{
+  return self ? self->members.size : 0;
+}
+
+bool pcm_group::is_linked() const noexcept
+{
+  return self && self->linked && (self->members.size > 1);
+}
+
+result pcm_group::prepare() noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  if (is_linked()) {
+    return self->members.data[0]->prepare();
+  }
+
+  for (size_type i = 0; i < self->members.size; i++) {
+    auto prepare_result = self->members.data[i]->prepare();
+    if (prepare_result.failed()) {
+      return prepare_result;
+    }
+  }
+
+  return result();
+}
+
+result pcm_group::start(size_type lead_time_us) noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  result start_result;
+
+  if (is_linked()) {
+    start_result = self->members.data[0]->start();
+  } else {
+    start_result = self->timed_start(lead_time_us);
+  }
+
+  if (start_result.failed()) {
+    return start_result;
+  }
+
+  std::int64_t earliest = std::numeric_limits<std::int64_t>::max();
+  std::int64_t latest = std::numeric_limits<std::int64_t>::min();
+
+  for (size_type i = 0; i < self->members.size; i++) {
+    auto status_result = self->members.data[i]->get_status();
+    if (!status_result.failed()) {
+      auto trigger_timestamp = status_result.value.trigger_timestamp;
+      earliest = std::min(earliest, trigger_timestamp);
+      latest = std::max(latest, trigger_timestamp);
+    }
+  }
+
+  self->start_skew = (latest >= earliest) ? (latest - earliest) : 0;
+
+  return result();
+}
+
+result pcm_group::drop() noexcept
+{
+  if (!self) {
+    return ENOENT;
+  }
+
+  if (is_linked()) {
+    return self->members.data[0]->drop();
+  }
+
+  result drop_result;
+
+  // Every member is stopped, even if one of them fails.
+  for (size_type i = 0; i < self->members.size; i++) {
+    auto member_result = self->members.data[i]->drop();
+    if (member_result.failed() && !drop_result.failed()) {
+      drop_result = member_result;
+    }
+  }
+
+  return drop_result;
+}
+
+std::int64_t pcm_group::get_start_skew() const noexcept
+{
+  return self ? self->start_skew : 0;
+}
+
+//==========================//
+// Section: Latency Tracker //
+//==========================//
+
+namespace {
+
+/// Keeps the most recent values of a measurement
+/// in sorted order, so that percentiles are cheap.
+struct rolling_window final
+{
+  /// The values in the order they were added,
+  /// used to find the value to drop next.
+  std::int64_t* history = nullptr;
+  /// The same values, in ascending order.
+  std::int64_t* sorted = nullptr;
+  /// The maximum number of values.
+  size_type capacity = 0;
+  /// The current number of values.
+  size_type size = 0;
+  /// The index in the history of the oldest value.
+  size_type oldest = 0;
+  /// Releases the memory of the window.
+  ~rolling_window()
+  {
+    std::free(history);
+    std::free(sorted);
+  }
+  /// Allocates memory for the window.
+  ///
+  /// @return True on success, false on failure.
+  bool allocate(size_type max_size) noexcept
+  {
+    history = (std::int64_t*) std::malloc(max_size * sizeof(std::int64_t));
+    sorted = (std::int64_t*) std::malloc(max_size * sizeof(std::int64_t));
+    if (!history || !sorted) {
+      return false;
+    }
+    capacity = max_size;
+    return true;
+  }
+  /// Adds a value, dropping the oldest one if the window is full.
+  void push(std::int64_t value) noexcept
+  {
+    if (!capacity) {
+      return;
+    }
+
+    auto* end = sorted + size;
+
+    if (size == capacity) {
+
+      auto dropped = history[oldest];
+
+      auto* pos = std::lower_bound(sorted, end, dropped);
+
+      memmove(pos, pos + 1, size_type(end - (pos + 1)) * sizeof(std::int64_t));
+
+      history[oldest] = value;
+
+      oldest = (oldest + 1) % capacity;
+
+      end--;
+
+    } else {
+      history[(oldest + size) % capacity] = value;
+      size++;
+    }
+
+    auto* pos = std::upper_bound(sorted, end, value);
+
+    memmove(pos + 1, pos, size_type(end - pos) * sizeof(std::int64_t));
+
+    *pos = value;
+  }
+  /// Gets a percentile of the values, using the nearest rank.
+  ///
+  /// @param percentile The percentile, from 0 to 100.
+  std::int64_t get_percentile(double percentile) const noexcept
+  {
+    if (!size) {
+      return 0;
+    }
+
+    percentile = std::min(std::max(percentile, 0.0), 100.0);
+
+    auto rank = size_type(std::ceil((percentile / 100.0) * double(size)));
+
+    return sorted[(rank > 0) ? (rank - 1) : 0];
+  }
+};
+
+} // namespace
+
+class latency_tracker_impl final
+{
+  friend latency_tracker;
+  /// The clock that the stream timestamps are taken from.
+  pcm_timestamp_type clock = pcm_timestamp_type::monotonic_raw;
+  /// The buffer fill of each record, in frames.
+  rolling_window fill;
+  /// The latency of each record, in nanoseconds.
+  rolling_window latency;
+};
+
+latency_tracker::latency_tracker(size_type window, pcm_timestamp_type clock) noexcept : self(nullptr)
+{
+  self = new (std::nothrow) latency_tracker_impl();
+  if (!self) {
+    return;
+  }
+
+  self->clock = clock;
+
+  if (!self->fill.allocate(window) || !self->latency.allocate(window)) {
+    delete self;
+    self = nullptr;
+  }
+}
+
+latency_tracker::latency_tracker(latency_tracker&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+latency_tracker::~latency_tracker()
+{
+  delete self;
+}
+
+void latency_tracker::record(const pcm_status& status, size_type rate) noexcept
+{
+  if (self) {
+    record(status, rate, get_timestamp(self->clock));
+  }
+}
+
+void latency_tracker::record(const pcm_status& status, size_type rate, std::int64_t now) noexcept
+{
+  if (!self || !rate) {
+    return;
+  }
+
+  auto latency = (status.delay * 1000000000) / std::int64_t(rate);
+
+  // The delay was measured at the time of the timestamp,
+  // so the time since then is accounted for. Without a
+  // timestamp, the delay alone is the best estimate.
+  if (status.timestamp && (now > status.timestamp)) {
+    if (status.is_capture) {
+      latency += now - status.timestamp;
+    } else {
+      latency -= now - status.timestamp;
+    }
+  }
+
+  self->fill.push(status.delay);
+  self->latency.push(std::max(latency, std::int64_t(0)));
+}
+
+size_type latency_tracker::size() const noexcept
+{
+  return self ? self->fill.size : 0;
+}
+
+void latency_tracker::reset() noexcept
+{
+  if (self) {
+    self->fill.size = 0;
+    self->fill.oldest = 0;
+    self->latency.size = 0;
+    self->latency.oldest = 0;
+  }
+}
+
+std::int64_t latency_tracker::get_fill_percentile(double percentile) const noexcept
+{
+  return self ? self->fill.get_percentile(percentile) : 0;
+}
+
+std::int64_t latency_tracker::get_latency_percentile(double percentile) const noexcept
+{
+  return self ? self->latency.get_percentile(percentile) : 0;
+}
+
+//===================//
+// Section: PCM list //
+//===================//
+
+namespace {
+
+/// Represents a PCM name that was parsed
+/// from a directory entry.
+struct parsed_name final
+{
+  /// Whether or not the name is valid.
+  bool valid = false;
+  /// The index of the card.
+  size_type card = 0;
+  /// The index of the device.
+  size_type device = 0;
+  /// Whether or not it's a capture PCM.
+  bool is_capture = false;
+  /// Constructs a new parsed name instance.
+  ///
+  /// @param name A pointer to the name to parse.
+  parsed_name(const char* name) noexcept
+  {
+    valid = parse(name);
+  }
+private:
+  /// Parses a name given to the constructor.
+  ///
+  /// @param name The filename to be parsed.
+  ///
+  /// @return True on a match, false on failure.
+  bool parse(const char* name) noexcept;
+  /// Indicates if a character is a decimal number or not.
+  ///
+  /// @return True if it is a decimal character, false otherwise.
+  static constexpr bool is_dec(char c) noexcept
+  {
+    return (c >= '0') && (c <= '9');
+  }
+  /// Parses a decimal number.
+  ///
+  /// @param c The character to convert into a decimal number.
+  ///
+  /// @return The resultant decimal number.
+  constexpr size_type to_dec(char c) noexcept
+  {
+    return size_type(c - '0');
+  }
+};
+
+bool parsed_name::parse(const char* name) noexcept
+{
+  auto name_length = strlen(name);
+  if (!name_length) {
+    return false;
+  }
+
+  if ((name[0] != 'p')
+   || (name[1] != 'c')
+   || (name[2] != 'm')
+   || (name[3] != 'C')) {
+    return false;
+  }
+
+  size_type d_pos = name_length;
+
+  for (size_type i = 4; i < name_length; i++) {
+    if (name[i] == 'D') {
+      d_pos = i;
+      break;
+    }
+  }
+
+  if (d_pos >= name_length) {
+    return false;
+  }
+
+  if (name[name_length - 1] == 'c') {
+    is_capture = true;
+  } else if (name[name_length - 1] == 'p') {
+    is_capture = false;
+  } else {
+    return false;
+  }
+
+  device = 0;
+  card = 0;
+
+  for (size_type i = 4; i < d_pos; i++) {
+    if (!is_dec(name[i])) {
+      return false;
+    }
+    card *= 10;
+    card += to_dec(name[i]);
+  }
+
+  for (size_type i = d_pos + 1; i < (name_length - 1); i++) {
+    if (!is_dec(name[i])) {
+      return false;
+    }
+    device *= 10;
+    device += to_dec(name[i]);
+  }
+
+  return true;
+}
+
+} // namespace
+
+namespace {
+
+/// Parses the name of a control device (such as "controlC0").
+///
+/// @param name The name of the directory entry.
+/// @param card Receives the card number on success.
+///
+/// @return True if the name is a control device, false otherwise.
+bool parse_control_name(const char* name, size_type& card) noexcept
+{
+  if (strncmp(name, "controlC", 8) != 0) {
+    return false;
+  }
+
+  name += 8;
+
+  if (!*name) {
+    return false;
+  }
+
+  card = 0;
+
+  for (; *name; name++) {
+    if ((*name < '0') || (*name > '9')) {
+      return false;
+    }
+    card = (card * 10) + size_type(*name - '0');
+  }
+
+  return true;
+}
+
+/// The number of card slots probed for control devices.
+/// This is the same limit that alsa-lib uses.
+constexpr size_type max_cards = 32;
+
+/// Used to enumerate the PCMs of one card.
+/// Each card is enumerated on its own thread.
+struct card_enumeration final
+{
+  /// The file descriptor of the control device of the card.
+  int fd = invalid_fd();
+  /// The card number, used for sorting.
+  size_type card = 0;
+  /// The PCMs found on the card.
+  pod_buffer<pcm_info> info_buffer;
+  /// The thread enumerating the card.
+  pthread_t thread;
+  /// Whether or not the thread was started.
+  bool thread_started = false;
+};
+
+/// Queries every subdevice of one stream of a PCM
+/// through the control device of its card.
+///
+/// @param ctl_fd The file descriptor of the control device.
+/// @param device The PCM device number.
+/// @param stream Either SNDRV_PCM_STREAM_PLAYBACK or SNDRV_PCM_STREAM_CAPTURE.
+/// @param info_buffer The buffer to add the subdevices to.
+///
+/// @return False if memory ran out, true otherwise.
+/// A stream that does not exist is not an error.
+bool query_pcm_stream(int ctl_fd, int device, int stream, pod_buffer<pcm_info>& info_buffer) noexcept
+{
+  snd_pcm_info native_info {};
+  native_info.device = unsigned(device);
+  native_info.stream = stream;
+  native_info.subdevice = 0;
+
+  if (pcm_ioctl(ctl_fd, SNDRV_CTL_IOCTL_PCM_INFO, &native_info) < 0) {
+    // The device does not have this stream.
+    return true;
+  }
+
+  auto subdevices_count = native_info.subdevices_count;
+
+  for (unsigned int subdevice = 0; subdevice < subdevices_count; subdevice++) {
+
+    if (subdevice > 0) {
+      native_info.device = unsigned(device);
+      native_info.stream = stream;
+      native_info.subdevice = subdevice;
+      if (pcm_ioctl(ctl_fd, SNDRV_CTL_IOCTL_PCM_INFO, &native_info) < 0) {
+        continue;
+      }
+    }
+
+    if (!info_buffer.emplace_back(to_tinyalsa_info(native_info))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/// Queries every subdevice of every PCM on a card.
+///
+/// @param ctl_fd The file descriptor of the control device of the card.
+/// @param info_buffer The buffer to add the subdevices to.
+void query_card(int ctl_fd, pod_buffer<pcm_info>& info_buffer) noexcept
+{
+  int device = -1;
+
+  for (;;) {
+
+    if (pcm_ioctl(ctl_fd, SNDRV_CTL_IOCTL_PCM_NEXT_DEVICE, &device) < 0) {
+      break;
+    } else if (device < 0) {
+      break;
+    }
+
+    if (!query_pcm_stream(ctl_fd, device, SNDRV_PCM_STREAM_PLAYBACK, info_buffer)
+     || !query_pcm_stream(ctl_fd, device, SNDRV_PCM_STREAM_CAPTURE, info_buffer)) {
+      break;
+    }
+  }
+}
+
+/// Enumerates every subdevice of every PCM on a card
+/// through its control device. Unlike opening the PCM
+/// devices, this works even if they're in use.
+/// The control device is closed when done.
+///
+/// @param arg A pointer to a @ref card_enumeration instance.
+void* enumerate_card(void* arg) noexcept
+{
+  auto& enumeration = *static_cast<card_enumeration*>(arg);
+
+  query_card(enumeration.fd, enumeration.info_buffer);
+
+  pcm_close(enumeration.fd);
+
+  enumeration.fd = invalid_fd();
+
+  return nullptr;
+}
+
+/// Enumerates the PCMs of every card in a device root.
+/// The cards are enumerated in parallel.
+///
+/// @note The cards are found by opening their control devices
+/// instead of listing the directory, so that enumeration goes
+/// through the I/O backend like every other device access.
+///
+/// @param device_root The directory containing the sound devices.
+/// @param info_buffer The buffer to add the PCMs to.
+void enumerate_cards(const char* device_root, pod_buffer<pcm_info>& info_buffer) noexcept
+{
+  pod_buffer<card_enumeration*> cards;
+
+  for (size_type card = 0; card < max_cards; card++) {
+
+    char path[256];
+
+    if (size_type(snprintf(path, sizeof(path), "%s/controlC%lu", device_root, (unsigned long) card)) >= sizeof(path)) {
+      break;
+    }
+
+    auto fd = pcm_open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      continue;
+    }
+
+    auto* enumeration = new (std::nothrow) card_enumeration();
+    if (!enumeration) {
+      pcm_close(fd);
+      break;
+    }
+
+    enumeration->fd = fd;
+    enumeration->card = card;
+
+    if (!cards.emplace_back(std::move(enumeration))) {
+      pcm_close(fd);
+      delete enumeration;
+      break;
+    }
+  }
+
+  // With only one card, there's nothing to gain from another thread.
+  for (size_type i = 0; (i < cards.size) && (cards.size > 1); i++) {
+    auto* card = cards.data[i];
+    card->thread_started = (pthread_create(&card->thread, nullptr, enumerate_card, card) == 0);
+  }
+
+  for (size_type i = 0; i < cards.size; i++) {
+    auto* card = cards.data[i];
+    if (card->thread_started) {
+      pthread_join(card->thread, nullptr);
+    } else {
+      enumerate_card(card);
+    }
+  }
+
+  for (size_type i = 0; i < cards.size; i++) {
+
+    auto* card = cards.data[i];
+
+    for (size_type j = 0; j < card->info_buffer.size; j++) {
+      if (!info_buffer.emplace_back(std::move(card->info_buffer.data[j]))) {
+        break;
+      }
+    }
+
+    delete card;
+  }
+}
+
+} // namespace
+
+class pcm_list_impl final
+{
+  friend pcm_list;
+  /// The directory containing the sound devices.
+  char device_root[256];
+  /// Whether or not the devices have been enumerated.
+  bool enumerated = false;
+  /// The array of information instances.
+  pod_buffer<pcm_info> info_buffer;
+  /// Enumerates the PCMs of every card in the device root.
+  void enumerate() noexcept
+  {
+    enumerated = true;
+    enumerate_cards(device_root, info_buffer);
+  }
+};
+
+pcm_list::pcm_list(const char* device_root) noexcept : self(nullptr)
+{
+  self = new (std::nothrow) pcm_list_impl();
+  if (!self) {
+    return;
+  }
+
+  snprintf(self->device_root, sizeof(self->device_root), "%s", device_root);
+}
+
+pcm_list::pcm_list(pcm_list&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
 }
 
 pcm_list::~pcm_list()
 {
-  delete self;
+  delete self;
+}
+
+const pcm_info* pcm_list::data() const noexcept
+{
+  if (!self) {
+    return nullptr;
+  }
+
+  if (!self->enumerated) {
+    self->enumerate();
+  }
+
+  return self->info_buffer.data;
+}
+
+size_type pcm_list::size() const noexcept
+{
+  if (!self) {
+    return 0;
+  }
+
+  if (!self->enumerated) {
+    self->enumerate();
+  }
+
+  return self->info_buffer.size;
+}
+
+//=======================//
+// Section: PCM Registry //
+//=======================//
+
+class pcm_snapshot_data final
+{
+  friend pcm_snapshot;
+  friend pcm_registry;
+  friend pcm_registry_impl;
+  /// The number of snapshots and registries referencing the data.
+  std::atomic<size_type> references { 1 };
+  /// The PCMs in the snapshot.
+  pod_buffer<pcm_info> entries;
+  /// Adds a reference to the data.
+  void acquire() noexcept
+  {
+    references.fetch_add(1, std::memory_order_relaxed);
+  }
+  /// Removes a reference to the data,
+  /// deleting it if it was the last one.
+  void release() noexcept
+  {
+    if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+};
+
+pcm_snapshot::pcm_snapshot(const pcm_snapshot& other) noexcept : self(other.self)
+{
+  if (self) {
+    self->acquire();
+  }
+}
+
+pcm_snapshot::pcm_snapshot(pcm_snapshot&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+pcm_snapshot::~pcm_snapshot()
+{
+  if (self) {
+    self->release();
+  }
+}
+
+pcm_snapshot& pcm_snapshot::operator = (pcm_snapshot other) noexcept
+{
+  std::swap(self, other.self);
+  return *this;
+}
+
+size_type pcm_snapshot::size() const noexcept
+{
+  return self ? self->entries.size : 0;
+}
+
+const pcm_info* pcm_snapshot::data() const noexcept
+{
+  return self ? self->entries.data : nullptr;
+}
+
+namespace {
+
+/// Orders PCM entries the same way that @ref pcm_list does.
+///
+/// @return True if @p a comes before @p b.
+bool pcm_info_less(const pcm_info& a, const pcm_info& b) noexcept
+{
+  if (a.card != b.card) {
+    return a.card < b.card;
+  } else if (a.device != b.device) {
+    return a.device < b.device;
+  } else if (a.is_capture != b.is_capture) {
+    return !a.is_capture;
+  } else {
+    return a.subdevice < b.subdevice;
+  }
+}
+
+/// Indicates whether or not two PCM descriptions are the same.
+bool pcm_info_equal(const pcm_info& a, const pcm_info& b) noexcept
+{
+  return (a.card == b.card)
+      && (a.device == b.device)
+      && (a.subdevice == b.subdevice)
+      && (a.is_capture == b.is_capture)
+      && (a.class_ == b.class_)
+      && (a.subclass == b.subclass)
+      && (strncmp(a.id, b.id, sizeof(a.id)) == 0)
+      && (strncmp(a.name, b.name, sizeof(a.name)) == 0)
+      && (strncmp(a.subname, b.subname, sizeof(a.subname)) == 0)
+      && (a.subdevices_count == b.subdevices_count)
+      && (a.subdevices_available == b.subdevices_available);
+}
+
+} // namespace
+
+class pcm_registry_impl final
+{
+  friend pcm_registry;
+  /// The directory containing the sound devices.
+  char device_root[256];
+  /// The inotify instance watching the device root.
+  int fd = invalid_fd();
+  /// The snapshot given to readers.
+  std::atomic<pcm_snapshot_data*> current { nullptr };
+  /// Selects which reader counter new readers enter.
+  std::atomic<unsigned int> epoch { 0 };
+  /// The number of readers in the middle of taking
+  /// a snapshot, split by the epoch they entered in.
+  std::atomic<size_type> readers[2] { { 0 }, { 0 } };
+  /// Takes a reference to the current snapshot.
+  pcm_snapshot_data* acquire() noexcept;
+  /// Replaces the current snapshot and releases the
+  /// previous one once no reader can still be taking it.
+  ///
+  /// @param next The snapshot to publish. May be null.
+  void publish(pcm_snapshot_data* next) noexcept;
+  /// Waits until every reader that entered
+  /// before this call has left.
+  void synchronize() noexcept;
+  /// Removes the entries matching a predicate.
+  ///
+  /// @return The number of entries that were removed.
+  template <typename predicate>
+  static size_type remove_if(pod_buffer<pcm_info>& entries, predicate pred) noexcept;
+  /// Replaces the entries matching a predicate with freshly
+  /// queried ones, unless they are the same already.
+  ///
+  /// @return Whether or not the entries changed.
+  template <typename predicate>
+  static bool replace_if(pod_buffer<pcm_info>& entries, pod_buffer<pcm_info>& fresh, predicate pred) noexcept;
+  /// Queries one stream of a PCM through the control device of its card.
+  void query_pcm_stream(size_type card, size_type device, bool is_capture, pod_buffer<pcm_info>& entries) noexcept;
+  /// Queries every PCM of a card through its control device.
+  void query_card(size_type card, pod_buffer<pcm_info>& entries) noexcept;
+  /// Applies one inotify event to a working copy of the entries.
+  ///
+  /// @return Whether or not the event changed the entries.
+  bool apply(const inotify_event& event, pod_buffer<pcm_info>& entries) noexcept;
+  /// Opens the control device of a card.
+  ///
+  /// @return The file descriptor of the control device,
+  /// or @ref invalid_fd on failure.
+  int open_control(size_type card) noexcept;
+public:
+  /// Releases the current snapshot and the inotify instance.
+  ~pcm_registry_impl()
+  {
+    publish(nullptr);
+    if (fd != invalid_fd()) {
+      ::close(fd);
+    }
+  }
+};
+
+pcm_snapshot_data* pcm_registry_impl::acquire() noexcept
+{
+  auto& counter = readers[epoch.load(std::memory_order_relaxed) & 1];
+
+  counter.fetch_add(1, std::memory_order_seq_cst);
+
+  auto* data = current.load(std::memory_order_seq_cst);
+  if (data) {
+    data->acquire();
+  }
+
+  counter.fetch_sub(1, std::memory_order_release);
+
+  return data;
+}
+
+void pcm_registry_impl::publish(pcm_snapshot_data* next) noexcept
+{
+  auto* previous = current.exchange(next, std::memory_order_seq_cst);
+  if (!previous) {
+    return;
+  }
+
+  synchronize();
+
+  previous->release();
+}
+
+void pcm_registry_impl::synchronize() noexcept
+{
+  // Each flip sends new readers to the other counter,
+  // so that waiting on the old one cannot be starved.
+  // Two flips cover readers that loaded a stale epoch.
+  for (int i = 0; i < 2; i++) {
+
+    auto old_epoch = epoch.fetch_add(1, std::memory_order_seq_cst);
+
+    auto& counter = readers[old_epoch & 1];
+
+    // Sequentially consistent, so that a reader either is counted
+    // here or enters after the swap and loads the new snapshot.
+    // An acquire load could see a count from before the swap.
+    while (counter.load(std::memory_order_seq_cst) != 0) {
+      sched_yield();
+    }
+  }
+}
+
+template <typename predicate>
+size_type pcm_registry_impl::remove_if(pod_buffer<pcm_info>& entries, predicate pred) noexcept
+{
+  auto* last = std::remove_if(entries.data, entries.data + entries.size, pred);
+
+  auto removed = size_type((entries.data + entries.size) - last);
+
+  entries.size -= removed;
+
+  return removed;
+}
+
+template <typename predicate>
+bool pcm_registry_impl::replace_if(pod_buffer<pcm_info>& entries, pod_buffer<pcm_info>& fresh, predicate pred) noexcept
+{
+  size_type matched = 0;
+
+  bool same = true;
+
+  for (size_type i = 0; same && (i < entries.size); i++) {
+
+    if (!pred(entries.data[i])) {
+      continue;
+    }
+
+    matched++;
+
+    same = std::any_of(fresh.data, fresh.data + fresh.size, [&entries, i](const pcm_info& info) {
+      return pcm_info_equal(info, entries.data[i]);
+    });
+  }
+
+  // Attribute changes are frequent and usually leave the
+  // PCMs as they were, in which case nothing is published.
+  if (same && (matched == fresh.size)) {
+    return false;
+  }
+
+  remove_if(entries, pred);
+
+  for (size_type i = 0; i < fresh.size; i++) {
+    if (!entries.emplace_back(std::move(fresh.data[i]))) {
+      break;
+    }
+  }
+
+  return true;
+}
+
+int pcm_registry_impl::open_control(size_type card) noexcept
+{
+  char path[288];
+
+  if (size_type(snprintf(path, sizeof(path), "%s/controlC%lu", device_root, (unsigned long) card)) >= sizeof(path)) {
+    return invalid_fd();
+  }
+
+  return pcm_open(path, O_RDONLY | O_CLOEXEC);
+}
+
+void pcm_registry_impl::query_pcm_stream(size_type card, size_type device, bool is_capture, pod_buffer<pcm_info>& entries) noexcept
+{
+  auto ctl_fd = open_control(card);
+  if (ctl_fd < 0) {
+    return;
+  }
+
+  auto stream = is_capture ? SNDRV_PCM_STREAM_CAPTURE : SNDRV_PCM_STREAM_PLAYBACK;
+
+  tinyalsa::query_pcm_stream(ctl_fd, int(device), stream, entries);
+
+  pcm_close(ctl_fd);
+}
+
+void pcm_registry_impl::query_card(size_type card, pod_buffer<pcm_info>& entries) noexcept
+{
+  auto ctl_fd = open_control(card);
+  if (ctl_fd < 0) {
+    return;
+  }
+
+  tinyalsa::query_card(ctl_fd, entries);
+
+  pcm_close(ctl_fd);
+}
+
+bool pcm_registry_impl::apply(const inotify_event& event, pod_buffer<pcm_info>& entries) noexcept
+{
+  if (!event.len) {
+    return false;
+  }
+
+  // Permissions usually change right after the node is
+  // created, which is when the query is likely to succeed.
+  auto added = (event.mask & (IN_CREATE | IN_MOVED_TO | IN_ATTRIB)) != 0;
+
+  pod_buffer<pcm_info> fresh;
+
+  size_type card = 0;
+
+  parsed_name name(event.name);
+
+  if (name.valid) {
+
+    if (added) {
+      query_pcm_stream(name.card, name.device, name.is_capture, fresh);
+    }
+
+    return replace_if(entries, fresh, [&name](const pcm_info& info) {
+      return (info.card == name.card)
+          && (info.device == name.device)
+          && (info.is_capture == name.is_capture);
+    });
+
+  } else if (parse_control_name(event.name, card)) {
+
+    if (added) {
+      query_card(card, fresh);
+    }
+
+    return replace_if(entries, fresh, [card](const pcm_info& info) {
+      return info.card == card;
+    });
+  }
+
+  return false;
+}
+
+pcm_registry::pcm_registry() noexcept : self(nullptr) { }
+
+pcm_registry::pcm_registry(pcm_registry&& other) noexcept : self(other.self)
+{
+  other.self = nullptr;
+}
+
+pcm_registry::~pcm_registry()
+{
+  delete self;
+}
+
+result pcm_registry::open(const char* device_root) noexcept
+{
+  close();
+
+  self = new (std::nothrow) pcm_registry_impl();
+  if (!self) {
+    return ENOMEM;
+  }
+
+  if (size_type(snprintf(self->device_root, sizeof(self->device_root), "%s", device_root)) >= sizeof(self->device_root)) {
+    close();
+    return ENAMETOOLONG;
+  }
+
+  self->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (self->fd < 0) {
+    auto err = errno;
+    close();
+    return err;
+  }
+
+  // The watch is added before enumerating, so that devices
+  // added during the enumeration are not missed.
+  uint32_t mask = IN_CREATE | IN_DELETE | IN_ATTRIB | IN_MOVED_TO | IN_MOVED_FROM;
+
+  if (inotify_add_watch(self->fd, self->device_root, mask) < 0) {
+    auto err = errno;
+    close();
+    return err;
+  }
+
+  auto* data = new (std::nothrow) pcm_snapshot_data();
+  if (!data) {
+    close();
+    return ENOMEM;
+  }
+
+  enumerate_cards(self->device_root, data->entries);
+
+  self->publish(data);
+
+  return result();
+}
+
+void pcm_registry::close() noexcept
+{
+  delete self;
+  self = nullptr;
+}
+
+pcm_snapshot pcm_registry::snapshot() const noexcept
+{
+  if (!self) {
+    return pcm_snapshot();
+  }
+
+  return pcm_snapshot(self->acquire());
+}
+
+generic_result<size_type> pcm_registry::update(int timeout_ms) noexcept
+{
+  using result_type = generic_result<size_type>;
+
+  if (!self) {
+    return result_type { ENOENT, 0 };
+  }
+
+  if (timeout_ms != 0) {
+
+    pollfd pfd { self->fd, POLLIN, 0 };
+
+    for (;;) {
+
+      auto err = ::poll(&pfd, 1, timeout_ms);
+      if (err < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+        return result_type { errno, 0 };
+      } else if (err == 0) {
+        return result_type { 0, 0 };
+      }
+
+      break;
+    }
+  }
+
+  // Only the updating thread replaces the current
+  // snapshot, so it can be read without a reader count.
+  auto* previous = self->current.load(std::memory_order_relaxed);
+
+  pcm_snapshot_data* next = nullptr;
+
+  size_type changes = 0;
+
+  alignas(inotify_event) char buffer[4096];
+
+  for (;;) {
+
+    auto size = ::read(self->fd, buffer, sizeof(buffer));
+    if (size < 0) {
+      if (errno == EINTR) {
+        continue;
+      } else if (errno == EAGAIN) {
+        break;
+      }
+      if (next) {
+        next->release();
+      }
+      return result_type { errno, 0 };
+    } else if (size == 0) {
+      break;
+    }
+
+    // All events of one update are applied to a
+    // single copy, which is published at the end.
+    if (!next) {
+
+      next = new (std::nothrow) pcm_snapshot_data();
+      if (!next) {
+        return result_type { ENOMEM, 0 };
+      }
+
+      auto previous_size = previous ? previous->entries.size : 0;
+
+      if (previous_size > 0) {
+
+        next->entries.data = (pcm_info*) std::malloc(previous_size * sizeof(pcm_info));
+        if (!next->entries.data) {
+          next->release();
+          return result_type { ENOMEM, 0 };
+        }
+
+        memcpy(next->entries.data, previous->entries.data, previous_size * sizeof(pcm_info));
+
+        next->entries.size = previous_size;
+      }
+    }
+
+    for (ssize_t offset = 0; offset < size; ) {
+
+      const auto& event = *reinterpret_cast<const inotify_event*>(buffer + offset);
+
+      offset += ssize_t(sizeof(inotify_event) + event.len);
+
+      if (event.mask & IN_Q_OVERFLOW) {
+        // Some events were lost, so start over.
+        next->entries.size = 0;
+        enumerate_cards(self->device_root, next->entries);
+        changes++;
+      } else if (self->apply(event, next->entries)) {
+        changes++;
+      }
+    }
+  }
+
+  if (!changes) {
+    if (next) {
+      next->release();
+    }
+    return result_type { 0, 0 };
+  }
+
+  std::sort(next->entries.data, next->entries.data + next->entries.size, pcm_info_less);
+
+  self->publish(next);
+
+  return result_type { 0, changes };
+}
+
+int pcm_registry::get_file_descriptor() const noexcept
+{
+  return self ? self->fd : invalid_fd();
+}
+
+#ifdef TINYALSA_CXX_BACKENDS
+
+//======================//
+// Section: Fake Device //
+//======================//
+
+namespace {
+
+/// The largest file descriptor that a fake device may have.
+constexpr int max_fake_fd = 1024;
+
+/// The state of one emulated PCM device.
+///
+/// The positions are kept as frame totals that never wrap,
+/// and are reduced by the boundary only when reported.
+struct fake_pcm final
+{
+  /// The timer that makes the file descriptor readable once per period.
+  int fd = invalid_fd();
+  /// The configuration the device was opened with.
+  fake_pcm_config config;
+  /// The card number, from the path.
+  size_type card = 0;
+  /// The device number, from the path.
+  size_type device = 0;
+  /// Whether or not it's a capture device.
+  bool is_capture = false;
+  /// Whether or not it emulates the control device of a card.
+  bool is_control = false;
+  /// Whether or not transfers may block.
+  bool non_blocking = false;
+  /// The state reported to the library.
+  snd_pcm_state_t state = SNDRV_PCM_STATE_OPEN;
+  /// The negotiated access type.
+  int access = SNDRV_PCM_ACCESS_RW_INTERLEAVED;
+  /// The negotiated number of channels.
+  size_type channels = 0;
+  /// The negotiated frame rate.
+  size_type rate = 0;
+  /// The negotiated period size, in frames.
+  size_type period_size = 0;
+  /// The buffer size, in frames.
+  size_type buffer_size = 0;
+  /// The size of one sample, in bytes.
+  size_type sample_size = 0;
+  /// The audio buffer.
+  unsigned char* buffer = nullptr;
+  /// The number of bytes mapped for the audio buffer.
+  size_type buffer_bytes = 0;
+  /// The software parameters.
+  snd_pcm_uframes_t avail_min = 1;
+  snd_pcm_uframes_t start_threshold = 1;
+  snd_pcm_uframes_t stop_threshold = 0;
+  snd_pcm_uframes_t boundary = 0;
+  /// The clock that timestamps are taken from.
+  pcm_timestamp_type clock = pcm_timestamp_type::gettimeofday;
+  /// The total number of frames moved by the hardware.
+  std::uint64_t hw_total = 0;
+  /// The total number of frames moved by the application.
+  std::uint64_t appl_total = 0;
+  /// The hardware position when the device was started.
+  std::uint64_t start_hw_total = 0;
+  /// When the device was started.
+  std::int64_t start_time = 0;
+  /// When the device was last started or stopped.
+  std::int64_t trigger_time = 0;
+  /// The frames transferred since the last injected xrun.
+  size_type frames_since_xrun = 0;
+  /// Gets the current time of the clock of the device.
+  std::int64_t now() const noexcept
+  {
+    return get_timestamp(clock);
+  }
+  /// Gets the number of frames that may be transferred.
+  size_type avail() const noexcept
+  {
+    if (is_capture) {
+      return size_type(std::min(hw_total - appl_total, std::uint64_t(buffer_size)));
+    } else {
+      return size_type((hw_total + buffer_size) - appl_total);
+    }
+  }
+  /// Gets the frames between the two positions, as the delay.
+  snd_pcm_sframes_t delay() const noexcept
+  {
+    if (is_capture) {
+      return snd_pcm_sframes_t(hw_total - appl_total);
+    } else {
+      return snd_pcm_sframes_t(appl_total - hw_total);
+    }
+  }
+  /// Converts a frame count to nanoseconds of emulated time.
+  std::int64_t frames_to_ns(std::uint64_t frames) const noexcept
+  {
+    return std::int64_t((double(frames) * 1e9) / (double(rate) * config.speed));
+  }
+  /// Moves the hardware position up to the current time,
+  /// stopping the device if it overran or underran.
+  void update() noexcept;
+  /// Starts the device.
+  int start() noexcept;
+  /// Stops the device in a given state.
+  void stop(snd_pcm_state_t next_state) noexcept;
+  /// Arms or disarms the period timer.
+  void arm_timer(bool enable) noexcept;
+  /// Transfers frames between the application and the buffer.
+  ///
+  /// @param frames The interleaved frames, or null.
+  /// @param channels The non-interleaved channels, or null.
+  /// @param frame_count The number of frames to transfer.
+  ///
+  /// @return The number of frames transferred, or a negative errno value.
+  snd_pcm_sframes_t transfer(void* frames, void** channel_buffers, size_type frame_count) noexcept;
+  /// Copies frames at the application position.
+  void copy(void* frames, void** channel_buffers, size_type offset, size_type frame_count) noexcept;
+  /// Handles @ref SNDRV_PCM_IOCTL_HW_REFINE and @ref SNDRV_PCM_IOCTL_HW_PARAMS.
+  int refine(snd_pcm_hw_params& params, bool apply) noexcept;
+  /// Fills a status structure.
+  void get_status(snd_pcm_status& status) noexcept;
+  /// Handles an ioctl.
+  int ioctl(unsigned long request, void* arg) noexcept;
+  /// Handles an ioctl made to the control device of a card.
+  int control_ioctl(unsigned long request, void* arg) noexcept;
+  /// Describes one stream of a fake PCM.
+  ///
+  /// @param info Receives the description.
+  /// @param pcm_device The device number.
+  /// @param capture Whether or not it's the capture stream.
+  void get_info(snd_pcm_info& info, size_type pcm_device, bool capture) const noexcept
+  {
+    info = snd_pcm_info {};
+    info.card = int(card);
+    info.device = unsigned(pcm_device);
+    info.stream = capture ? SNDRV_PCM_STREAM_CAPTURE : SNDRV_PCM_STREAM_PLAYBACK;
+    info.dev_class = SNDRV_PCM_CLASS_GENERIC;
+    info.subdevices_count = 1;
+    snprintf((char*) info.id, sizeof(info.id), "fake");
+    snprintf((char*) info.name, sizeof(info.name), "Fake PCM");
+    snprintf((char*) info.subname, sizeof(info.subname), "subdevice #0");
+  }
+  /// Releases the audio buffer.
+  void free_buffer() noexcept
+  {
+    if (buffer) {
+      ::munmap(buffer, buffer_bytes);
+      buffer = nullptr;
+      buffer_bytes = 0;
+    }
+  }
+};
+
+/// The configuration given to new fake devices.
+fake_pcm_config next_fake_config;
+
+/// The fake devices, indexed by file descriptor.
+std::atomic<fake_pcm*> fake_devices[max_fake_fd] {};
+
+/// Finds the fake device of a file descriptor.
+///
+/// @return The fake device, or null if the
+/// file descriptor does not belong to one.
+fake_pcm* find_fake(int fd) noexcept
+{
+  if ((fd < 0) || (fd >= max_fake_fd)) {
+    return nullptr;
+  }
+
+  return fake_devices[fd].load(std::memory_order_acquire);
+}
+
+/// Converts a number of nanoseconds to a timespec.
+template <typename timespec_type>
+void to_timespec(std::int64_t ns, timespec_type& ts) noexcept
+{
+  ts.tv_sec = decltype(ts.tv_sec)(ns / 1000000000);
+  ts.tv_nsec = decltype(ts.tv_nsec)(ns % 1000000000);
+}
+
+/// Converts a timestamp type from the driver to a TinyALSA one.
+pcm_timestamp_type to_tinyalsa_timestamp_type(unsigned int type) noexcept
+{
+  switch (type) {
+    case SNDRV_PCM_TSTAMP_TYPE_MONOTONIC:
+      return pcm_timestamp_type::monotonic;
+    case SNDRV_PCM_TSTAMP_TYPE_MONOTONIC_RAW:
+      return pcm_timestamp_type::monotonic_raw;
+    default:
+      break;
+  }
+
+  return pcm_timestamp_type::gettimeofday;
+}
+
+/// Narrows an interval to a supported range.
+///
+/// @return False if the interval becomes empty.
+template <parameter_name name>
+bool refine_interval(snd_pcm_hw_params& params, size_type min, size_type max) noexcept
+{
+  using value_type = typename interval_ref<name>::value_type;
+
+  auto lo = std::max(size_type(interval_ref<name>::get_min(params)), min);
+  auto hi = std::min(size_type(interval_ref<name>::get_max(params)), max);
+  if (lo > hi) {
+    return false;
+  }
+
+  interval_ref<name>::set_range(params, value_type(lo), value_type(hi));
+
+  return true;
+}
+
+/// Narrows a mask to the supported bits.
+///
+/// @return False if the mask becomes empty.
+template <parameter_name name>
+bool refine_mask(snd_pcm_hw_params& params, const std::uint32_t (&supported)[2]) noexcept
+{
+  auto& mask = params.masks[name - SNDRV_PCM_HW_PARAM_FIRST_MASK];
+
+  mask.bits[0] &= supported[0];
+  mask.bits[1] &= supported[1];
+
+  for (size_type i = 2; i < (sizeof(mask.bits) / sizeof(mask.bits[0])); i++) {
+    mask.bits[i] = 0;
+  }
+
+  return (mask.bits[0] | mask.bits[1]) != 0;
+}
+
+/// Gets the lowest bit that is set in a mask.
+template <parameter_name name>
+unsigned int first_mask_bit(const snd_pcm_hw_params& params) noexcept
+{
+  const auto& mask = params.masks[name - SNDRV_PCM_HW_PARAM_FIRST_MASK];
+
+  for (unsigned int i = 0; i < 64; i++) {
+    if (mask.bits[i >> 5] & (1u << (i & 31))) {
+      return i;
+    }
+  }
+
+  return 0;
+}
+
+void fake_pcm::update() noexcept
+{
+  if (state != SNDRV_PCM_STATE_RUNNING) {
+    return;
+  }
+
+  // The emulated hardware keeps up with the application instantly.
+  if (config.speed <= 0) {
+    hw_total = is_capture ? (appl_total + buffer_size) : appl_total;
+    return;
+  }
+
+  auto elapsed = double(now() - start_time) * config.speed;
+
+  auto target = start_hw_total + std::uint64_t((elapsed * double(rate)) / 1e9);
+
+  // The position at which the stop threshold is reached.
+  std::uint64_t xrun_total = appl_total + stop_threshold;
+  if (!is_capture) {
+    xrun_total = (xrun_total > buffer_size) ? (xrun_total - buffer_size) : 0;
+  }
+
+  if ((stop_threshold < boundary) && (target >= xrun_total)) {
+    hw_total = std::max(hw_total, xrun_total);
+    stop(SNDRV_PCM_STATE_XRUN);
+    trigger_time = start_time + frames_to_ns(xrun_total - start_hw_total);
+    return;
+  }
+
+  hw_total = std::max(hw_total, target);
+}
+
+int fake_pcm::start() noexcept
+{
+  if (state != SNDRV_PCM_STATE_PREPARED) {
+    return -EBADFD;
+  }
+
+  state = SNDRV_PCM_STATE_RUNNING;
+  start_time = now();
+  start_hw_total = hw_total;
+  trigger_time = start_time;
+
+  arm_timer(true);
+
+  return 0;
+}
+
+void fake_pcm::stop(snd_pcm_state_t next_state) noexcept
+{
+  state = next_state;
+  trigger_time = now();
+  arm_timer(false);
+}
+
+void fake_pcm::arm_timer(bool enable) noexcept
+{
+  itimerspec timer_spec {};
+
+  if (enable && (config.speed > 0)) {
+    to_timespec(std::max(frames_to_ns(period_size), std::int64_t(1)), timer_spec.it_value);
+    timer_spec.it_interval = timer_spec.it_value;
+  } else if (enable) {
+    // Always readable, since the hardware is never behind.
+    timer_spec.it_value.tv_nsec = 1;
+  }
+
+  timerfd_settime(fd, 0, &timer_spec, nullptr);
+
+  if (!enable) {
+    std::uint64_t expirations = 0;
+    while (::read(fd, &expirations, sizeof(expirations)) > 0) {
+    }
+  }
+}
+
+void fake_pcm::copy(void* frames, void** channel_buffers, size_type offset, size_type frame_count) noexcept
+{
+  auto frame_size = sample_size * channels;
+
+  bool interleaved_buffer = (access == SNDRV_PCM_ACCESS_RW_INTERLEAVED)
+                         || (access == SNDRV_PCM_ACCESS_MMAP_INTERLEAVED);
+
+  for (size_type i = 0; i < frame_count; i++) {
+
+    auto position = (size_type(appl_total) + i) % buffer_size;
+
+    for (size_type c = 0; c < channels; c++) {
+
+      unsigned char* sample = nullptr;
+
+      if (interleaved_buffer) {
+        sample = buffer + (position * frame_size) + (c * sample_size);
+      } else {
+        sample = buffer + (((c * buffer_size) + position) * sample_size);
+      }
+
+      unsigned char* user = nullptr;
+
+      if (frames) {
+        user = static_cast<unsigned char*>(frames) + ((offset + i) * frame_size) + (c * sample_size);
+      } else {
+        user = static_cast<unsigned char*>(channel_buffers[c]) + ((offset + i) * sample_size);
+      }
+
+      if (is_capture) {
+        memcpy(user, sample, sample_size);
+      } else {
+        memcpy(sample, user, sample_size);
+      }
+    }
+  }
+}
+
+snd_pcm_sframes_t fake_pcm::transfer(void* frames, void** channel_buffers, size_type frame_count) noexcept
+{
+  switch (state) {
+    case SNDRV_PCM_STATE_XRUN:
+      return -EPIPE;
+    case SNDRV_PCM_STATE_SUSPENDED:
+      return -ESTRPIPE;
+    case SNDRV_PCM_STATE_PREPARED:
+    case SNDRV_PCM_STATE_RUNNING:
+      break;
+    default:
+      return -EBADFD;
+  }
+
+  if (is_capture && (state == SNDRV_PCM_STATE_PREPARED) && (frame_count >= start_threshold)) {
+    start();
+  }
+
+  size_type done = 0;
+
+  while (done < frame_count) {
+
+    update();
+
+    if (state == SNDRV_PCM_STATE_XRUN) {
+      break;
+    }
+
+    auto available = avail();
+
+    if (!available) {
+
+      if (non_blocking || (state != SNDRV_PCM_STATE_RUNNING)) {
+        break;
+      }
+
+      // Sleeps until enough frames are expected to be available.
+      auto needed = std::min(frame_count - done, size_type(avail_min));
+
+      timespec ts {};
+      to_timespec(frames_to_ns(needed), ts);
+      nanosleep(&ts, nullptr);
+      continue;
+    }
+
+    auto chunk = std::min(available, frame_count - done);
+
+    if (config.xrun_interval) {
+      chunk = std::min(chunk, config.xrun_interval - frames_since_xrun);
+    }
+
+    copy(frames, channel_buffers, done, chunk);
+
+    appl_total += chunk;
+    done += chunk;
+
+    if (!is_capture && (state == SNDRV_PCM_STATE_PREPARED) && ((appl_total - hw_total) >= start_threshold)) {
+      start();
+    }
+
+    if (config.xrun_interval) {
+      frames_since_xrun += chunk;
+      if (frames_since_xrun >= config.xrun_interval) {
+        frames_since_xrun = 0;
+        stop(SNDRV_PCM_STATE_XRUN);
+        break;
+      }
+    }
+  }
+
+  // Clears the timer until the next period, if there's
+  // not enough data for the file descriptor to be ready.
+  if ((state == SNDRV_PCM_STATE_RUNNING) && (config.speed > 0) && (avail() < avail_min)) {
+    std::uint64_t expirations = 0;
+    while (::read(fd, &expirations, sizeof(expirations)) > 0) {
+    }
+  }
+
+  if (done > 0) {
+    return snd_pcm_sframes_t(done);
+  } else if (state == SNDRV_PCM_STATE_XRUN) {
+    return -EPIPE;
+  } else {
+    return -EAGAIN;
+  }
+}
+
+int fake_pcm::refine(snd_pcm_hw_params& params, bool apply) noexcept
+{
+  std::uint32_t formats[2] { 0, 0 };
+
+  for (unsigned int i = 0; i < sample_format_count; i++) {
+    if (config.formats & (std::uint32_t(1) << i)) {
+      auto alsa_format = unsigned(to_alsa_format(sample_format(i)));
+      formats[alsa_format >> 5] |= 1u << (alsa_format & 31);
+    }
+  }
+
+  const std::uint32_t accesses[2] {
+    (1u << SNDRV_PCM_ACCESS_RW_INTERLEAVED)
+  | (1u << SNDRV_PCM_ACCESS_RW_NONINTERLEAVED)
+  | (1u << SNDRV_PCM_ACCESS_MMAP_INTERLEAVED)
+  | (1u << SNDRV_PCM_ACCESS_MMAP_NONINTERLEAVED),
+    0
+  };
+
+  bool valid = refine_mask<SNDRV_PCM_HW_PARAM_FORMAT>(params, formats)
+            && refine_mask<SNDRV_PCM_HW_PARAM_ACCESS>(params, accesses)
+            && refine_interval<SNDRV_PCM_HW_PARAM_CHANNELS>(params, config.channels.min, config.channels.max)
+            && refine_interval<SNDRV_PCM_HW_PARAM_RATE>(params, config.rate.min, config.rate.max)
+            && refine_interval<SNDRV_PCM_HW_PARAM_PERIOD_SIZE>(params, config.period_size.min, config.period_size.max)
+            && refine_interval<SNDRV_PCM_HW_PARAM_PERIODS>(params, config.period_count.min, config.period_count.max);
+  if (!valid) {
+    return -EINVAL;
+  }
+
+  using period_size_ref = interval_ref<SNDRV_PCM_HW_PARAM_PERIOD_SIZE>;
+  using periods_ref = interval_ref<SNDRV_PCM_HW_PARAM_PERIODS>;
+
+  auto buffer_min = size_type(period_size_ref::get_min(params)) * periods_ref::get_min(params);
+  auto buffer_max = size_type(period_size_ref::get_max(params)) * periods_ref::get_max(params);
+
+  if (!refine_interval<SNDRV_PCM_HW_PARAM_BUFFER_SIZE>(params, buffer_min, buffer_max)) {
+    return -EINVAL;
+  }
+
+  params.rmask = 0;
+  params.info = SNDRV_PCM_INFO_MMAP
+              | SNDRV_PCM_INFO_MMAP_VALID
+              | SNDRV_PCM_INFO_INTERLEAVED
+              | SNDRV_PCM_INFO_NONINTERLEAVED;
+
+  if (!apply) {
+    return 0;
+  }
+
+  // Like the kernel, the smallest value of each parameter is chosen.
+
+  auto format = first_mask_bit<SNDRV_PCM_HW_PARAM_FORMAT>(params);
+
+  size_type physical_bits = 0;
+
+  for (unsigned int i = 0; i < sample_format_count; i++) {
+    if (unsigned(to_alsa_format(sample_format(i))) == format) {
+      physical_bits = to_physical_bits(sample_format(i));
+      break;
+    }
+  }
+
+  if (!physical_bits) {
+    return -EINVAL;
+  }
+
+  access = int(first_mask_bit<SNDRV_PCM_HW_PARAM_ACCESS>(params));
+  channels = interval_ref<SNDRV_PCM_HW_PARAM_CHANNELS>::get_min(params);
+  rate = interval_ref<SNDRV_PCM_HW_PARAM_RATE>::get_min(params);
+  period_size = period_size_ref::get_min(params);
+  buffer_size = period_size * periods_ref::get_min(params);
+  sample_size = physical_bits / 8;
+
+  mask_ref<SNDRV_PCM_HW_PARAM_FORMAT>::set(params, format);
+  mask_ref<SNDRV_PCM_HW_PARAM_ACCESS>::set(params, unsigned(access));
+  interval_ref<SNDRV_PCM_HW_PARAM_CHANNELS>::set(params, unsigned(channels));
+  interval_ref<SNDRV_PCM_HW_PARAM_RATE>::set(params, unsigned(rate));
+  interval_ref<SNDRV_PCM_HW_PARAM_PERIOD_SIZE>::set(params, unsigned(period_size));
+  interval_ref<SNDRV_PCM_HW_PARAM_PERIODS>::set(params, unsigned(buffer_size / period_size));
+  interval_ref<SNDRV_PCM_HW_PARAM_BUFFER_SIZE>::set(params, unsigned(buffer_size));
+  interval_ref<SNDRV_PCM_HW_PARAM_SAMPLE_BITS>::set(params, unsigned(physical_bits));
+  interval_ref<SNDRV_PCM_HW_PARAM_FRAME_BITS>::set(params, unsigned(physical_bits * channels));
+
+  params.msbits = unsigned(physical_bits);
+  params.rate_num = unsigned(rate);
+  params.rate_den = 1;
+
+  free_buffer();
+
+  auto page_size = size_type(sysconf(_SC_PAGESIZE));
+
+  auto bytes = buffer_size * channels * sample_size;
+
+  bytes = ((bytes + page_size - 1) / page_size) * page_size;
+
+  auto* memory = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (memory == MAP_FAILED) {
+    return -ENOMEM;
+  }
+
+  buffer = static_cast<unsigned char*>(memory);
+  buffer_bytes = bytes;
+
+  boundary = buffer_size;
+  while ((boundary * 2) <= (snd_pcm_uframes_t(std::numeric_limits<long>::max()) - buffer_size)) {
+    boundary *= 2;
+  }
+
+  avail_min = period_size;
+  start_threshold = 1;
+  stop_threshold = buffer_size;
+  hw_total = 0;
+  appl_total = 0;
+  state = SNDRV_PCM_STATE_SETUP;
+
+  return 0;
+}
+
+void fake_pcm::get_status(snd_pcm_status& status) noexcept
+{
+  update();
+
+  auto current_time = now();
+
+  status.state = state;
+  status.appl_ptr = snd_pcm_uframes_t(appl_total % boundary);
+  status.hw_ptr = snd_pcm_uframes_t(hw_total % boundary);
+  status.delay = delay();
+  status.avail = avail();
+  status.avail_max = status.avail;
+
+  to_timespec(trigger_time, status.trigger_tstamp);
+  to_timespec(current_time, status.tstamp);
+  to_timespec(current_time, status.driver_tstamp);
+  to_timespec(std::int64_t((double(hw_total) * 1e9) / double(rate)), status.audio_tstamp);
+}
+
+int fake_pcm::ioctl(unsigned long request, void* arg) noexcept
+{
+  if (is_control) {
+    return control_ioctl(request, arg);
+  }
+
+  bool is_setup = (state != SNDRV_PCM_STATE_OPEN);
+
+  switch (request) {
+
+    case SNDRV_PCM_IOCTL_PVERSION:
+      *static_cast<int*>(arg) = SNDRV_PCM_VERSION;
+      return 0;
+
+    case SNDRV_PCM_IOCTL_INFO:
+      get_info(*static_cast<snd_pcm_info*>(arg), device, is_capture);
+      return 0;
+
+    case SNDRV_PCM_IOCTL_HW_REFINE:
+      return refine(*static_cast<snd_pcm_hw_params*>(arg), false);
+
+    case SNDRV_PCM_IOCTL_HW_PARAMS:
+      if ((state != SNDRV_PCM_STATE_OPEN)
+       && (state != SNDRV_PCM_STATE_SETUP)
+       && (state != SNDRV_PCM_STATE_PREPARED)) {
+        return -EBADFD;
+      }
+      return refine(*static_cast<snd_pcm_hw_params*>(arg), true);
+
+    case SNDRV_PCM_IOCTL_HW_FREE:
+      free_buffer();
+      state = SNDRV_PCM_STATE_OPEN;
+      return 0;
+
+    case SNDRV_PCM_IOCTL_SW_PARAMS: {
+      if (!is_setup) {
+        return -EBADFD;
+      }
+      auto& params = *static_cast<snd_pcm_sw_params*>(arg);
+      avail_min = std::max(params.avail_min, snd_pcm_uframes_t(1));
+      start_threshold = params.start_threshold;
+      stop_threshold = params.stop_threshold;
+      if (params.proto >= SNDRV_PROTOCOL_VERSION(2, 0, 12)) {
+        clock = to_tinyalsa_timestamp_type(params.tstamp_type);
+      }
+      params.boundary = boundary;
+      return 0;
+    }
+
+    case SNDRV_PCM_IOCTL_TTSTAMP:
+      clock = to_tinyalsa_timestamp_type(unsigned(*static_cast<int*>(arg)));
+      return 0;
+
+    case SNDRV_PCM_IOCTL_STATUS:
+    case SNDRV_PCM_IOCTL_STATUS_EXT:
+      if (!is_setup) {
+        return -EBADFD;
+      }
+      get_status(*static_cast<snd_pcm_status*>(arg));
+      return 0;
+
+    case SNDRV_PCM_IOCTL_DELAY:
+      update();
+      if (state == SNDRV_PCM_STATE_XRUN) {
+        return -EPIPE;
+      } else if (!is_setup) {
+        return -EBADFD;
+      }
+      *static_cast<snd_pcm_sframes_t*>(arg) = delay();
+      return 0;
+
+    case SNDRV_PCM_IOCTL_HWSYNC:
+      update();
+      if (state == SNDRV_PCM_STATE_XRUN) {
+        return -EPIPE;
+      }
+      return is_setup ? 0 : -EBADFD;
+
+    case SNDRV_PCM_IOCTL_SYNC_PTR: {
+      if (!is_setup) {
+        return -EBADFD;
+      }
+      auto& sync_ptr = *static_cast<snd_pcm_sync_ptr*>(arg);
+      if (!(sync_ptr.flags & SNDRV_PCM_SYNC_PTR_APPL)) {
+        auto reported = appl_total % boundary;
+        appl_total += (sync_ptr.c.control.appl_ptr + boundary - reported) % boundary;
+      }
+      if (!(sync_ptr.flags & SNDRV_PCM_SYNC_PTR_AVAIL_MIN)) {
+        avail_min = std::max(sync_ptr.c.control.avail_min, snd_pcm_uframes_t(1));
+      }
+      update();
+      sync_ptr.s.status.state = state;
+      sync_ptr.s.status.hw_ptr = snd_pcm_uframes_t(hw_total % boundary);
+      sync_ptr.s.status.suspended_state = SNDRV_PCM_STATE_OPEN;
+      to_timespec(now(), sync_ptr.s.status.tstamp);
+      to_timespec(std::int64_t((double(hw_total) * 1e9) / double(rate)), sync_ptr.s.status.audio_tstamp);
+      sync_ptr.c.control.appl_ptr = snd_pcm_uframes_t(appl_total % boundary);
+      sync_ptr.c.control.avail_min = avail_min;
+      return 0;
+    }
+
+    case SNDRV_PCM_IOCTL_PREPARE:
+      if (!is_setup || (state == SNDRV_PCM_STATE_DISCONNECTED)) {
+        return -EBADFD;
+      } else if (state == SNDRV_PCM_STATE_RUNNING) {
+        return -EBUSY;
+      }
+      arm_timer(false);
+      state = SNDRV_PCM_STATE_PREPARED;
+      hw_total = 0;
+      appl_total = 0;
+      return 0;
+
+    case SNDRV_PCM_IOCTL_START:
+      return start();
+
+    case SNDRV_PCM_IOCTL_DROP:
+    case SNDRV_PCM_IOCTL_DRAIN:
+      if (!is_setup) {
+        return -EBADFD;
+      }
+      stop(SNDRV_PCM_STATE_SETUP);
+      return 0;
+
+    case SNDRV_PCM_IOCTL_RESUME:
+      return -ENOSYS;
+
+    case SNDRV_PCM_IOCTL_LINK:
+      return -EINVAL;
+
+    case SNDRV_PCM_IOCTL_UNLINK:
+      return -EALREADY;
+
+    case SNDRV_PCM_IOCTL_READI_FRAMES:
+    case SNDRV_PCM_IOCTL_WRITEI_FRAMES: {
+      if ((request == SNDRV_PCM_IOCTL_READI_FRAMES) != is_capture) {
+        return -EINVAL;
+      } else if (access != SNDRV_PCM_ACCESS_RW_INTERLEAVED) {
+        return -EINVAL;
+      }
+      auto& xfer = *static_cast<snd_xferi*>(arg);
+      auto frames = transfer(xfer.buf, nullptr, size_type(xfer.frames));
+      if (frames < 0) {
+        return int(frames);
+      }
+      xfer.result = frames;
+      return 0;
+    }
+
+    case SNDRV_PCM_IOCTL_READN_FRAMES:
+    case SNDRV_PCM_IOCTL_WRITEN_FRAMES: {
+      if ((request == SNDRV_PCM_IOCTL_READN_FRAMES) != is_capture) {
+        return -EINVAL;
+      } else if (access != SNDRV_PCM_ACCESS_RW_NONINTERLEAVED) {
+        return -EINVAL;
+      }
+      auto& xfer = *static_cast<snd_xfern*>(arg);
+      auto frames = transfer(nullptr, xfer.bufs, size_type(xfer.frames));
+      if (frames < 0) {
+        return int(frames);
+      }
+      xfer.result = frames;
+      return 0;
+    }
+
+    default:
+      break;
+  }
+
+  return -ENOTTY;
+}
+
+int fake_pcm::control_ioctl(unsigned long request, void* arg) noexcept
+{
+  switch (request) {
+
+    case SNDRV_CTL_IOCTL_PVERSION:
+      *static_cast<int*>(arg) = SNDRV_CTL_VERSION;
+      return 0;
+
+    case SNDRV_CTL_IOCTL_CARD_INFO: {
+      auto& info = *static_cast<snd_ctl_card_info*>(arg);
+      info = snd_ctl_card_info {};
+      info.card = int(card);
+      snprintf((char*) info.id, sizeof(info.id), "Fake");
+      snprintf((char*) info.driver, sizeof(info.driver), "fake");
+      snprintf((char*) info.name, sizeof(info.name), "Fake Card");
+      snprintf((char*) info.longname, sizeof(info.longname), "Fake Card %lu", (unsigned long) card);
+      return 0;
+    }
+
+    case SNDRV_CTL_IOCTL_PCM_NEXT_DEVICE: {
+      auto& next = *static_cast<int*>(arg);
+      next = ((next + 1) < int(config.devices)) ? (next + 1) : -1;
+      return 0;
+    }
+
+    case SNDRV_CTL_IOCTL_PCM_INFO: {
+      auto& info = *static_cast<snd_pcm_info*>(arg);
+      if ((info.device >= config.devices) || (info.subdevice != 0)) {
+        return -ENXIO;
+      }
+      get_info(info, info.device, info.stream == SNDRV_PCM_STREAM_CAPTURE);
+      return 0;
+    }
+
+    case SNDRV_CTL_IOCTL_PCM_PREFER_SUBDEVICE:
+      return 0;
+
+    default:
+      break;
+  }
+
+  return -ENOTTY;
+}
+
+int fake_open(const char* path, int flags)
+{
+  const auto* name = strrchr(path, '/');
+
+  name = name ? (name + 1) : path;
+
+  size_type control_card = 0;
+
+  bool is_control = parse_control_name(name, control_card);
+
+  parsed_name parsed(name);
+
+  if (is_control) {
+    if (control_card >= next_fake_config.cards) {
+      errno = ENOENT;
+      return -1;
+    }
+  } else if (!parsed.valid) {
+    errno = ENOENT;
+    return -1;
+  }
+
+  auto* device = new (std::nothrow) fake_pcm();
+  if (!device) {
+    errno = ENOMEM;
+    return -1;
+  }
+
+  device->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (device->fd < 0) {
+    auto err = errno;
+    delete device;
+    errno = err;
+    return -1;
+  } else if (device->fd >= max_fake_fd) {
+    ::close(device->fd);
+    delete device;
+    errno = EMFILE;
+    return -1;
+  }
+
+  device->config = next_fake_config;
+  device->is_control = is_control;
+  device->card = is_control ? control_card : parsed.card;
+  device->device = parsed.device;
+  device->is_capture = parsed.is_capture;
+  device->non_blocking = (flags & O_NONBLOCK) != 0;
+
+  fake_devices[device->fd].store(device, std::memory_order_release);
+
+  return device->fd;
+}
+
+int fake_close(int fd)
+{
+  auto* device = find_fake(fd);
+  if (!device) {
+    return ::close(fd);
+  }
+
+  fake_devices[fd].store(nullptr, std::memory_order_release);
+
+  device->free_buffer();
+
+  delete device;
+
+  return ::close(fd);
+}
+
+int fake_ioctl(int fd, unsigned long request, void* arg)
+{
+  auto* device = find_fake(fd);
+  if (!device) {
+    return ::ioctl(fd, request, arg);
+  }
+
+  auto err = device->ioctl(request, arg);
+  if (err < 0) {
+    errno = -err;
+    return -1;
+  }
+
+  return err;
+}
+
+/// Sets the revents of the fake devices among a set of polled
+/// file descriptors. The native ones are left as they are.
+///
+/// @param has_native Set if there are native file descriptors.
+/// @param next_ready Receives the delay, in nanoseconds, until the
+/// next fake device is expected to be ready, or -1 if none is.
+///
+/// @return The number of fake devices that are ready.
+int poll_fake_devices(pollfd* fds, unsigned long count, bool& has_native, std::int64_t& next_ready) noexcept
+{
+  int ready = 0;
+
+  has_native = false;
+
+  next_ready = -1;
+
+  for (unsigned long i = 0; i < count; i++) {
+
+    auto* device = find_fake(fds[i].fd);
+    if (!device) {
+      has_native = has_native || (fds[i].fd >= 0);
+      continue;
+    }
+
+    device->update();
+
+    short revents = 0;
+
+    if (device->state == SNDRV_PCM_STATE_XRUN) {
+      revents = POLLERR;
+    } else if ((device->state == SNDRV_PCM_STATE_RUNNING) || (device->state == SNDRV_PCM_STATE_PREPARED)) {
+      auto available = device->avail();
+      if (available >= device->avail_min) {
+        revents = device->is_capture ? POLLIN : POLLOUT;
+      } else if ((device->state == SNDRV_PCM_STATE_RUNNING) && (device->config.speed > 0)) {
+        auto delay = device->frames_to_ns(device->avail_min - available);
+        next_ready = (next_ready < 0) ? delay : std::min(next_ready, delay);
+      }
+    }
+
+    fds[i].revents = short(revents & (fds[i].events | POLLERR));
+
+    if (fds[i].revents) {
+      ready++;
+    }
+  }
+
+  return ready;
+}
+
+int fake_poll(pollfd* fds, unsigned long count, int timeout_ms)
+{
+  auto deadline = get_timestamp(pcm_timestamp_type::monotonic) + (std::int64_t(timeout_ms) * 1000000);
+
+  for (;;) {
+
+    bool has_native = false;
+
+    // The delay until the next fake device is expected to be ready.
+    std::int64_t next_ready = -1;
+
+    auto ready = poll_fake_devices(fds, count, has_native, next_ready);
+
+    int wait_ms = 0;
+
+    if (!ready && (timeout_ms != 0)) {
+
+      std::int64_t wait_ns = -1;
+
+      if (timeout_ms > 0) {
+        wait_ns = std::max(deadline - get_timestamp(pcm_timestamp_type::monotonic), std::int64_t(0));
+      }
+
+      if (next_ready >= 0) {
+        wait_ns = (wait_ns < 0) ? next_ready : std::min(wait_ns, next_ready);
+      }
+
+      if (wait_ns == 0) {
+        return 0;
+      } else if (!has_native) {
+        if (wait_ns < 0) {
+          // None of the fake devices is running, so none of them
+          // can become ready. This returns as if the wait timed
+          // out, rather than blocking the caller forever.
+          return 0;
+        }
+        timespec ts {};
+        to_timespec(wait_ns, ts);
+        nanosleep(&ts, nullptr);
+        continue;
+      }
+
+      wait_ms = (wait_ns < 0) ? -1 : int((wait_ns + 999999) / 1000000);
+    }
+
+    if (!has_native) {
+      return ready;
+    }
+
+    // The native file descriptors are polled with the fake ones
+    // hidden, since poll() ignores negative file descriptors.
+    for (unsigned long i = 0; i < count; i++) {
+      if (find_fake(fds[i].fd)) {
+        fds[i].fd = ~fds[i].fd;
+      }
+    }
+
+    auto native_ready = ::poll(fds, nfds_t(count), wait_ms);
+
+    auto err = errno;
+
+    for (unsigned long i = 0; i < count; i++) {
+      if ((fds[i].fd < 0) && find_fake(~fds[i].fd)) {
+        fds[i].fd = ~fds[i].fd;
+      }
+    }
+
+    if (native_ready < 0) {
+      errno = err;
+      return -1;
+    }
+
+    if ((native_ready > 0) || (wait_ms == 0)) {
+      // The revents of the fake devices were cleared by poll(),
+      // so they're set again. Some may have become ready since.
+      return poll_fake_devices(fds, count, has_native, next_ready) + native_ready;
+    }
+
+    // Either a fake device is expected to be ready by now
+    // or the timeout expired, which the next pass finds out.
+  }
+}
+
+void* fake_mmap(void* address, size_type length, int protection, int flags, int fd, long offset)
+{
+  auto* device = find_fake(fd);
+  if (!device) {
+    return ::mmap(address, length, protection, flags, fd, off_t(offset));
+  }
+
+  // Only the buffer can be mapped, which makes the
+  // library fall back to SNDRV_PCM_IOCTL_SYNC_PTR.
+  if ((offset != SNDRV_PCM_MMAP_OFFSET_DATA) || !device->buffer || (length > device->buffer_bytes)) {
+    errno = ENXIO;
+    return MAP_FAILED;
+  }
+
+  return device->buffer;
+}
+
+int fake_munmap(void* address, size_type length)
+{
+  for (int fd = 0; fd < max_fake_fd; fd++) {
+    auto* device = find_fake(fd);
+    if (device && (device->buffer == address)) {
+      // The buffer belongs to the device until it's closed.
+      return 0;
+    }
+  }
+
+  return ::munmap(address, length);
+}
+
+const pcm_backend fake_backend {
+  fake_open,
+  fake_close,
+  fake_ioctl,
+  fake_poll,
+  fake_mmap,
+  fake_munmap
+};
+
+} // namespace
+
+const pcm_backend& get_fake_backend() noexcept
+{
+  return fake_backend;
+}
+
+void set_fake_pcm_config(const fake_pcm_config& config) noexcept
+{
+  next_fake_config = config;
+}
+
+//================//
+// Section: Trace //
+//================//
+
+namespace {
+
+/// Identifies a trace file.
+constexpr char trace_magic[8] { 'T', 'A', 'C', 'X', 'T', 'R', 'C', '\0' };
+
+/// The version of the trace file format.
+constexpr std::uint32_t trace_version = 1;
+
+/// The header at the start of a trace file.
+struct trace_header final
+{
+  /// Equal to @ref trace_magic.
+  char magic[8];
+  /// Equal to @ref trace_version.
+  std::uint32_t version;
+  /// The size of one record, without its data.
+  std::uint32_t record_size;
+  /// The monotonic time that the trace was started at, in nanoseconds.
+  std::int64_t start_time;
+};
+
+/// Identifies the backend function that a record is for.
+enum class trace_kind : std::uint32_t
+{
+  open,
+  close,
+  ioctl,
+  poll,
+  mmap,
+  munmap
+};
+
+/// One call made to the backend. The data that the call
+/// returned follows the record and is padded to 8 bytes.
+struct trace_record final
+{
+  /// The function that was called.
+  trace_kind kind;
+  /// The file descriptor that the call was made on.
+  std::int32_t fd;
+  /// The ioctl request or the flags passed to open.
+  std::uint32_t request;
+  /// The value that was returned. Zero for a successful mmap.
+  std::int32_t result;
+  /// The value of errno, if the call failed.
+  std::int32_t error;
+  /// The number of bytes of data following the record.
+  std::uint32_t size;
+  /// When the call was made, relative to the start of the trace.
+  std::int64_t time;
+  /// How long the call took, in nanoseconds.
+  std::int64_t duration;
+  /// The frames requested by a transfer, the length of
+  /// a mapping or the number of file descriptors polled.
+  std::uint64_t count;
+  /// The frames moved by a transfer or the offset of a mapping.
+  std::int64_t value;
+};
+
+static_assert(sizeof(trace_record) == 56, "The trace format depends on the record size.");
+
+/// Pads a size to the alignment of the records.
+constexpr size_type trace_pad(size_type size) noexcept
+{
+  return (size + 7) & ~size_type(7);
+}
+
+/// Indicates whether or not an ioctl moves frames.
+constexpr bool is_transfer(unsigned long request) noexcept
+{
+  return (request == SNDRV_PCM_IOCTL_READI_FRAMES)
+      || (request == SNDRV_PCM_IOCTL_WRITEI_FRAMES)
+      || (request == SNDRV_PCM_IOCTL_READN_FRAMES)
+      || (request == SNDRV_PCM_IOCTL_WRITEN_FRAMES);
+}
+
+/// Gets the number of bytes that an ioctl returns through its argument.
+///
+/// The data of transfers is left out, since it has pointers into the
+/// application and the frame counts are kept in the record instead.
+/// The argument of SNDRV_PCM_IOCTL_LINK is a file descriptor and not
+/// a pointer.
+size_type ioctl_output_size(unsigned long request, const void* arg) noexcept
+{
+  if (!arg || is_transfer(request) || (request == SNDRV_PCM_IOCTL_LINK)) {
+    return 0;
+  } else if (!(_IOC_DIR(request) & _IOC_READ)) {
+    return 0;
+  }
+
+  return _IOC_SIZE(request);
+}
+
+/// The state of the trace recorder.
+struct trace_recorder final
+{
+  /// Serializes the records of calls made from different threads.
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  /// The trace file.
+  int fd = invalid_fd();
+  /// The backend that the calls are forwarded to.
+  const pcm_backend* backend = &native_backend;
+  /// Whether or not calls are being recorded.
+  std::atomic<bool> recording { false };
+  /// The number of calls to the trace backend in progress.
+  std::atomic<size_type> in_flight { 0 };
+  /// When the trace was started.
+  std::int64_t start_time = 0;
+  /// The first error that occurred while writing to the file.
+  int error = 0;
+  /// The records that have not been written yet.
+  unsigned char buffer[65536];
+  /// The number of bytes in the buffer.
+  size_type buffer_size = 0;
+  /// Writes data to the trace file.
+  void write_file(const void* data, size_type size) noexcept
+  {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+
+    while (size && !error) {
+      auto written = ::write(fd, bytes, size);
+      if (written < 0) {
+        if (errno != EINTR) {
+          error = errno;
+        }
+        continue;
+      }
+      bytes += written;
+      size -= size_type(written);
+    }
+  }
+  /// Writes the buffered records to the trace file.
+  void flush() noexcept
+  {
+    write_file(buffer, buffer_size);
+    buffer_size = 0;
+  }
+  /// Adds a record and its data to the trace.
+  ///
+  /// @param record The record to add. Its size is assigned here.
+  /// @param data The data returned by the call, if any.
+  /// @param data_size The number of bytes of data.
+  void add(trace_record& record, const void* data, size_type data_size) noexcept
+  {
+    // The trace may have been stopped during the call.
+    if (!recording.load(std::memory_order_seq_cst)) {
+      return;
+    }
+
+    record.time -= start_time;
+    record.size = std::uint32_t(trace_pad(data_size));
+
+    auto total = sizeof(record) + record.size;
+
+    pthread_mutex_lock(&mutex);
+
+    if ((buffer_size + total) > sizeof(buffer)) {
+      flush();
+    }
+
+    if (total > sizeof(buffer)) {
+      const unsigned char padding[8] {};
+      write_file(&record, sizeof(record));
+      write_file(data, data_size);
+      write_file(padding, record.size - data_size);
+    } else {
+      memcpy(buffer + buffer_size, &record, sizeof(record));
+      if (data_size) {
+        memcpy(buffer + buffer_size + sizeof(record), data, data_size);
+      }
+      memset(buffer + buffer_size + sizeof(record) + data_size, 0, record.size - data_size);
+      buffer_size += total;
+    }
+
+    pthread_mutex_unlock(&mutex);
+  }
+};
+
+trace_recorder recorder;
+
+/// Marks a call to the trace backend as in progress, so
+/// that the trace file is not closed in the middle of it.
+struct trace_call final
+{
+  trace_call() noexcept
+  {
+    recorder.in_flight.fetch_add(1, std::memory_order_seq_cst);
+  }
+  ~trace_call()
+  {
+    recorder.in_flight.fetch_sub(1, std::memory_order_release);
+  }
+};
+
+/// Starts a record of a call to the backend.
+trace_record begin_record(trace_kind kind, int fd) noexcept
+{
+  trace_record record {};
+  record.kind = kind;
+  record.fd = fd;
+  record.time = get_timestamp(pcm_timestamp_type::monotonic);
+  return record;
 }
 
-const pcm_info* pcm_list::data() const noexcept
+/// Completes a record with the result of a call.
+void end_record(trace_record& record, int result) noexcept
 {
-  return self ? self->info_buffer.data : nullptr;
+  record.result = result;
+  record.error = (result < 0) ? errno : 0;
+  record.duration = get_timestamp(pcm_timestamp_type::monotonic) - record.time;
 }
 
-size_type pcm_list::size() const noexcept
+int trace_open(const char* path, int flags)
+{
+  trace_call call;
+
+  auto record = begin_record(trace_kind::open, invalid_fd());
+  record.request = std::uint32_t(flags);
+
+  auto fd = recorder.backend->open(path, flags);
+
+  end_record(record, fd);
+
+  auto err = errno;
+
+  recorder.add(record, path, strlen(path) + 1);
+
+  errno = err;
+
+  return fd;
+}
+
+int trace_close(int fd)
+{
+  trace_call call;
+
+  auto record = begin_record(trace_kind::close, fd);
+
+  auto result = recorder.backend->close(fd);
+
+  end_record(record, result);
+
+  auto err = errno;
+
+  recorder.add(record, nullptr, 0);
+
+  errno = err;
+
+  return result;
+}
+
+int trace_ioctl(int fd, unsigned long request, void* arg)
+{
+  trace_call call;
+
+  auto record = begin_record(trace_kind::ioctl, fd);
+  record.request = std::uint32_t(request);
+
+  if ((request == SNDRV_PCM_IOCTL_READI_FRAMES) || (request == SNDRV_PCM_IOCTL_WRITEI_FRAMES)) {
+    record.count = static_cast<snd_xferi*>(arg)->frames;
+  } else if ((request == SNDRV_PCM_IOCTL_READN_FRAMES) || (request == SNDRV_PCM_IOCTL_WRITEN_FRAMES)) {
+    record.count = static_cast<snd_xfern*>(arg)->frames;
+  }
+
+  auto result = recorder.backend->ioctl(fd, request, arg);
+
+  end_record(record, result);
+
+  auto err = errno;
+
+  if ((request == SNDRV_PCM_IOCTL_READI_FRAMES) || (request == SNDRV_PCM_IOCTL_WRITEI_FRAMES)) {
+    record.value = static_cast<snd_xferi*>(arg)->result;
+  } else if ((request == SNDRV_PCM_IOCTL_READN_FRAMES) || (request == SNDRV_PCM_IOCTL_WRITEN_FRAMES)) {
+    record.value = static_cast<snd_xfern*>(arg)->result;
+  }
+
+  // Failed calls may leave the argument half written,
+  // so the data is only kept for successful ones.
+  auto output_size = (result < 0) ? 0 : ioctl_output_size(request, arg);
+
+  recorder.add(record, arg, output_size);
+
+  errno = err;
+
+  return result;
+}
+
+int trace_poll(pollfd* fds, unsigned long count, int timeout_ms)
+{
+  trace_call call;
+
+  auto record = begin_record(trace_kind::poll, (count > 0) ? fds[0].fd : invalid_fd());
+  record.count = count;
+
+  auto result = recorder.backend->poll(fds, count, timeout_ms);
+
+  end_record(record, result);
+
+  auto err = errno;
+
+  recorder.add(record, fds, (result < 0) ? 0 : (count * sizeof(pollfd)));
+
+  errno = err;
+
+  return result;
+}
+
+void* trace_mmap(void* address, size_type length, int protection, int flags, int fd, long offset)
+{
+  trace_call call;
+
+  auto record = begin_record(trace_kind::mmap, fd);
+  record.count = length;
+  record.value = offset;
+
+  void* memory = MAP_FAILED;
+
+  // Without the status and control data mapped, the library
+  // synchronizes positions with an ioctl that can be traced.
+  if (offset == SNDRV_PCM_MMAP_OFFSET_DATA) {
+    memory = recorder.backend->mmap(address, length, protection, flags, fd, offset);
+  } else {
+    errno = ENXIO;
+  }
+
+  end_record(record, (memory == MAP_FAILED) ? -1 : 0);
+
+  auto err = errno;
+
+  recorder.add(record, nullptr, 0);
+
+  errno = err;
+
+  return memory;
+}
+
+int trace_munmap(void* address, size_type length)
+{
+  trace_call call;
+
+  auto record = begin_record(trace_kind::munmap, invalid_fd());
+  record.count = length;
+
+  auto result = recorder.backend->munmap(address, length);
+
+  end_record(record, result);
+
+  auto err = errno;
+
+  recorder.add(record, nullptr, 0);
+
+  errno = err;
+
+  return result;
+}
+
+const pcm_backend trace_backend {
+  trace_open,
+  trace_close,
+  trace_ioctl,
+  trace_poll,
+  trace_mmap,
+  trace_munmap
+};
+
+/// The largest recorded file descriptor that a
+/// replayed device may be waited on with.
+constexpr int max_replay_fd = 1024;
+
+/// The state of the trace being replayed.
+struct trace_replayer final
+{
+  /// Serializes the calls made from different threads.
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  /// The mapped trace file.
+  const unsigned char* data = nullptr;
+  /// The size of the trace file.
+  size_type size = 0;
+  /// The offset of the next record.
+  size_type offset = 0;
+  /// The replay options.
+  pcm_replay_config config;
+  /// When the replay was started.
+  std::int64_t start_time = 0;
+  /// The file descriptors standing in for the devices,
+  /// indexed by the file descriptors that were recorded.
+  int fds[max_replay_fd];
+  /// The stand-in file descriptor that is currently readable.
+  int ready_fd = invalid_fd();
+  /// Makes the stand-in file descriptor of the next record
+  /// readable if that record is a successful transfer, so that
+  /// waiting on it with epoll returns when the recorded call could
+  /// be made. The one made readable before is drained.
+  void signal_next() noexcept
+  {
+    int next_fd = invalid_fd();
+
+    if ((offset + sizeof(trace_record)) <= size) {
+      const auto* record = reinterpret_cast<const trace_record*>(data + offset);
+      if ((record->kind == trace_kind::ioctl)
+       && is_transfer(record->request)
+       && (record->result >= 0)
+       && (record->fd >= 0)
+       && (record->fd < max_replay_fd)) {
+        next_fd = fds[record->fd];
+      }
+    }
+
+    if (next_fd == ready_fd) {
+      return;
+    }
+
+    std::uint64_t value = 1;
+
+    if (ready_fd != invalid_fd()) {
+      auto err = ::read(ready_fd, &value, sizeof(value));
+      (void) err;
+    }
+
+    if (next_fd != invalid_fd()) {
+      value = 1;
+      auto err = ::write(next_fd, &value, sizeof(value));
+      (void) err;
+    }
+
+    ready_fd = next_fd;
+  }
+  /// Gets the next record, if it is for a given call.
+  ///
+  /// @param kind The function that was called.
+  /// @param request The ioctl request or open flags, if any.
+  /// @param payload Assigned the data that follows the record.
+  ///
+  /// @return The record, or null with errno assigned
+  /// if the call does not match the trace.
+  const trace_record* next(trace_kind kind, std::uint32_t request, const unsigned char*& payload) noexcept
+  {
+    if ((offset + sizeof(trace_record)) > size) {
+      errno = ENODATA;
+      return nullptr;
+    }
+
+    const auto* record = reinterpret_cast<const trace_record*>(data + offset);
+
+    if ((record->kind != kind) || (record->request != request)) {
+      errno = EPROTO;
+      return nullptr;
+    } else if ((offset + sizeof(trace_record) + record->size) > size) {
+      errno = ENODATA;
+      return nullptr;
+    }
+
+    payload = data + offset + sizeof(trace_record);
+
+    offset += sizeof(trace_record) + record->size;
+
+    signal_next();
+
+    return record;
+  }
+  /// Waits until the recorded call returned, scaled by the replay speed.
+  void wait(const trace_record& record) noexcept
+  {
+    if (config.speed <= 0) {
+      return;
+    }
+
+    auto deadline = start_time + std::int64_t(double(record.time + record.duration) / config.speed);
+
+    timespec ts {};
+    ts.tv_sec = time_t(deadline / 1000000000);
+    ts.tv_nsec = long(deadline % 1000000000);
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+  }
+  /// Returns the result of a record, assigning errno if it failed.
+  int finish(const trace_record& record) noexcept
+  {
+    wait(record);
+
+    if (record.result < 0) {
+      errno = record.error;
+    }
+
+    return record.result;
+  }
+};
+
+trace_replayer replayer;
+
+/// Gets the next record of the replay.
+///
+/// @return The record, or null if the call does not match.
+const trace_record* next_replay(trace_kind kind, std::uint32_t request, const unsigned char*& payload) noexcept
+{
+  pthread_mutex_lock(&replayer.mutex);
+
+  auto* record = replayer.next(kind, request, payload);
+
+  auto err = errno;
+
+  pthread_mutex_unlock(&replayer.mutex);
+
+  errno = err;
+
+  return record;
+}
+
+int replay_open(const char*, int flags)
+{
+  const unsigned char* payload = nullptr;
+
+  const auto* record = next_replay(trace_kind::open, std::uint32_t(flags), payload);
+  if (!record) {
+    return -1;
+  } else if (record->result < 0) {
+    return replayer.finish(*record);
+  }
+
+  replayer.wait(*record);
+
+  // A real file descriptor stands in for the device, so that
+  // it is unique and may be added to an epoll instance.
+  auto fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  if (fd < 0) {
+    return -1;
+  }
+
+  pthread_mutex_lock(&replayer.mutex);
+
+  if (record->result < max_replay_fd) {
+    replayer.fds[record->result] = fd;
+    replayer.signal_next();
+  }
+
+  pthread_mutex_unlock(&replayer.mutex);
+
+  return fd;
+}
+
+int replay_close(int fd)
+{
+  const unsigned char* payload = nullptr;
+
+  pthread_mutex_lock(&replayer.mutex);
+
+  for (auto& stand_in : replayer.fds) {
+    if (stand_in == fd) {
+      stand_in = invalid_fd();
+    }
+  }
+
+  if (replayer.ready_fd == fd) {
+    replayer.ready_fd = invalid_fd();
+  }
+
+  pthread_mutex_unlock(&replayer.mutex);
+
+  const auto* record = next_replay(trace_kind::close, 0, payload);
+
+  ::close(fd);
+
+  return record ? replayer.finish(*record) : -1;
+}
+
+int replay_ioctl(int, unsigned long request, void* arg)
+{
+  const unsigned char* payload = nullptr;
+
+  const auto* record = next_replay(trace_kind::ioctl, std::uint32_t(request), payload);
+  if (!record) {
+    return -1;
+  }
+
+  if ((request == SNDRV_PCM_IOCTL_READI_FRAMES) || (request == SNDRV_PCM_IOCTL_WRITEI_FRAMES)) {
+    static_cast<snd_xferi*>(arg)->result = snd_pcm_sframes_t(record->value);
+  } else if ((request == SNDRV_PCM_IOCTL_READN_FRAMES) || (request == SNDRV_PCM_IOCTL_WRITEN_FRAMES)) {
+    static_cast<snd_xfern*>(arg)->result = snd_pcm_sframes_t(record->value);
+  } else if (record->size) {
+    auto output_size = ioctl_output_size(request, arg);
+    if (trace_pad(output_size) != record->size) {
+      errno = EPROTO;
+      return -1;
+    }
+    memcpy(arg, payload, output_size);
+  }
+
+  return replayer.finish(*record);
+}
+
+int replay_poll(pollfd* fds, unsigned long count, int)
+{
+  const unsigned char* payload = nullptr;
+
+  const auto* record = next_replay(trace_kind::poll, 0, payload);
+  if (!record) {
+    return -1;
+  } else if (record->count != count) {
+    errno = EPROTO;
+    return -1;
+  }
+
+  if (record->size) {
+    const auto* recorded = reinterpret_cast<const pollfd*>(payload);
+    for (unsigned long i = 0; i < count; i++) {
+      fds[i].revents = recorded[i].revents;
+    }
+  }
+
+  return replayer.finish(*record);
+}
+
+void* replay_mmap(void*, size_type length, int, int, int, long offset)
+{
+  const unsigned char* payload = nullptr;
+
+  const auto* record = next_replay(trace_kind::mmap, 0, payload);
+  if (!record) {
+    return MAP_FAILED;
+  } else if ((record->count != length) || (record->value != offset)) {
+    errno = EPROTO;
+    return MAP_FAILED;
+  } else if (record->result < 0) {
+    replayer.finish(*record);
+    return MAP_FAILED;
+  }
+
+  replayer.wait(*record);
+
+  return ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+}
+
+int replay_munmap(void* address, size_type length)
+{
+  const unsigned char* payload = nullptr;
+
+  const auto* record = next_replay(trace_kind::munmap, 0, payload);
+
+  ::munmap(address, length);
+
+  return record ? replayer.finish(*record) : -1;
+}
+
+const pcm_backend replay_backend {
+  replay_open,
+  replay_close,
+  replay_ioctl,
+  replay_poll,
+  replay_mmap,
+  replay_munmap
+};
+
+} // namespace
+
+result start_pcm_trace(const char* path) noexcept
+{
+  if (recorder.fd != invalid_fd()) {
+    return EBUSY;
+  }
+
+  auto fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return errno;
+  }
+
+  recorder.fd = fd;
+  recorder.error = 0;
+  recorder.buffer_size = 0;
+  recorder.backend = &get_backend();
+  recorder.start_time = get_timestamp(pcm_timestamp_type::monotonic);
+
+  trace_header header {};
+  memcpy(header.magic, trace_magic, sizeof(trace_magic));
+  header.version = trace_version;
+  header.record_size = sizeof(trace_record);
+  header.start_time = recorder.start_time;
+
+  recorder.write_file(&header, sizeof(header));
+
+  if (recorder.error) {
+    auto err = recorder.error;
+    ::close(recorder.fd);
+    recorder.fd = invalid_fd();
+    return err;
+  }
+
+  recorder.recording.store(true, std::memory_order_seq_cst);
+
+  set_backend(trace_backend);
+
+  return result();
+}
+
+result stop_pcm_trace() noexcept
+{
+  if (recorder.fd == invalid_fd()) {
+    return result();
+  }
+
+  set_backend(*recorder.backend);
+
+  // Calls that were already in the trace backend may still
+  // add records, so they are waited for before closing the file.
+  recorder.recording.store(false, std::memory_order_seq_cst);
+
+  while (recorder.in_flight.load(std::memory_order_seq_cst) != 0) {
+    sched_yield();
+  }
+
+  pthread_mutex_lock(&recorder.mutex);
+
+  recorder.flush();
+
+  pthread_mutex_unlock(&recorder.mutex);
+
+  auto err = recorder.error;
+
+  if ((::close(recorder.fd) < 0) && !err) {
+    err = errno;
+  }
+
+  recorder.fd = invalid_fd();
+
+  return err;
+}
+
+result open_pcm_replay(const char* path, const pcm_replay_config& config) noexcept
+{
+  close_pcm_replay();
+
+  auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return errno;
+  }
+
+  auto size = lseek(fd, 0, SEEK_END);
+  if (size < 0) {
+    auto err = errno;
+    ::close(fd);
+    return err;
+  } else if (size_type(size) < sizeof(trace_header)) {
+    ::close(fd);
+    return EPROTO;
+  }
+
+  auto* memory = ::mmap(nullptr, size_type(size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+  auto err = errno;
+
+  ::close(fd);
+
+  if (memory == MAP_FAILED) {
+    return err;
+  }
+
+  const auto* header = static_cast<const trace_header*>(memory);
+
+  if ((memcmp(header->magic, trace_magic, sizeof(trace_magic)) != 0)
+   || (header->version != trace_version)
+   || (header->record_size != sizeof(trace_record))) {
+    ::munmap(memory, size_type(size));
+    return EPROTO;
+  }
+
+  replayer.data = static_cast<const unsigned char*>(memory);
+  replayer.size = size_type(size);
+  replayer.offset = sizeof(trace_header);
+  replayer.config = config;
+  replayer.start_time = get_timestamp(pcm_timestamp_type::monotonic);
+  replayer.ready_fd = invalid_fd();
+
+  std::fill(replayer.fds, replayer.fds + max_replay_fd, invalid_fd());
+
+  return result();
+}
+
+void close_pcm_replay() noexcept
+{
+  if (replayer.data) {
+    ::munmap(const_cast<unsigned char*>(replayer.data), replayer.size);
+    replayer.data = nullptr;
+    replayer.size = 0;
+    replayer.offset = 0;
+    replayer.ready_fd = invalid_fd();
+    std::fill(replayer.fds, replayer.fds + max_replay_fd, invalid_fd());
+  }
+}
+
+const pcm_backend& get_replay_backend() noexcept
 {
-  return self ? self->info_buffer.size : 0;
+  return replay_backend;
 }
 
+#endif // TINYALSA_CXX_BACKENDS
+
 } // namespace tinyalsa
@@ -1,9 +1,18 @@
 #ifndef TINYALSA_CXX_TINYALSA_HPP
 #define TINYALSA_CXX_TINYALSA_HPP
 
+#include <type_traits>
 #include <utility>
 
 #include <cstddef>
+#include <cstdint>
+
+#ifdef __cpp_impl_coroutine
+#include <cerrno>
+#include <coroutine>
+#endif
+
+struct pollfd;
 
 namespace tinyalsa {
 
@@ -155,12 +164,391 @@ enum class sample_format
 template <sample_format sf>
 struct sample_traits final { };
 
-template <>
-struct sample_traits<sample_format::s8> final
+/// Indicates whether or not the host stores
+/// the most significant byte of a word first.
+inline constexpr bool host_is_big_endian() noexcept
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  return true;
+#else
+  return false;
+#endif
+}
+
+/// Holds a sample that occupies three bytes.
+/// The bytes are kept in the order that they
+/// appear in the audio buffer.
+struct packed_sample final
+{
+  /// The bytes of the sample.
+  unsigned char bytes[3];
+};
+
+/// Used to access the raw bits of a sample container.
+///
+/// @tparam container The number of bytes that a sample occupies.
+/// @tparam big_endian Whether or not the sample is stored
+/// with the most significant byte first.
+template <size_type container, bool big_endian>
+struct sample_storage final { };
+
+template <bool big_endian>
+struct sample_storage<1, big_endian> final
+{
+  /// The type that occupies exactly one sample.
+  using type = std::uint8_t;
+  /// Reads the raw bits of a sample.
+  static constexpr std::uint32_t load(type s) noexcept
+  {
+    return s;
+  }
+  /// Writes the raw bits of a sample.
+  static constexpr type store(std::uint32_t raw) noexcept
+  {
+    return type(raw);
+  }
+};
+
+template <bool big_endian>
+struct sample_storage<2, big_endian> final
+{
+  /// The type that occupies exactly one sample.
+  using type = std::uint16_t;
+  /// Reads the raw bits of a sample.
+  static constexpr std::uint32_t load(type s) noexcept
+  {
+    return (big_endian == host_is_big_endian()) ? s : std::uint32_t(((s & 0xff) << 8) | (s >> 8));
+  }
+  /// Writes the raw bits of a sample.
+  static constexpr type store(std::uint32_t raw) noexcept
+  {
+    return type(load(type(raw)));
+  }
+};
+
+template <bool big_endian>
+struct sample_storage<3, big_endian> final
+{
+  /// The type that occupies exactly one sample.
+  using type = packed_sample;
+  /// Reads the raw bits of a sample.
+  static constexpr std::uint32_t load(const type& s) noexcept
+  {
+    return big_endian ? ((std::uint32_t(s.bytes[0]) << 16) | (std::uint32_t(s.bytes[1]) << 8) | s.bytes[2])
+                      : ((std::uint32_t(s.bytes[2]) << 16) | (std::uint32_t(s.bytes[1]) << 8) | s.bytes[0]);
+  }
+  /// Writes the raw bits of a sample.
+  static constexpr type store(std::uint32_t raw) noexcept
+  {
+    return big_endian ? type { { (unsigned char) (raw >> 16), (unsigned char) (raw >> 8), (unsigned char) raw } }
+                      : type { { (unsigned char) raw, (unsigned char) (raw >> 8), (unsigned char) (raw >> 16) } };
+  }
+};
+
+template <bool big_endian>
+struct sample_storage<4, big_endian> final
+{
+  /// The type that occupies exactly one sample.
+  using type = std::uint32_t;
+  /// Reads the raw bits of a sample.
+  static constexpr std::uint32_t load(type s) noexcept
+  {
+    return (big_endian == host_is_big_endian())
+      ? s
+      : ((s & 0xff) << 24) | ((s & 0xff00) << 8) | ((s >> 8) & 0xff00) | (s >> 24);
+  }
+  /// Writes the raw bits of a sample.
+  static constexpr type store(std::uint32_t raw) noexcept
+  {
+    return load(raw);
+  }
+};
+
+/// Contains the compile-time properties
+/// shared by all of the sample formats.
+///
+/// @tparam bits_ The number of significant bits in a sample.
+/// @tparam container The number of bytes that a sample occupies.
+/// @tparam signed_ Whether or not the sample is signed.
+/// @tparam big_endian Whether or not the sample is stored
+/// with the most significant byte first.
+template <size_type bits_, size_type container, bool signed_, bool big_endian>
+struct basic_sample_traits
+{
+  /// The type that occupies exactly one sample in an audio buffer.
+  using storage_type = typename sample_storage<container, big_endian>::type;
+  /// The smallest native type that holds the value of a sample.
+  using value_type = typename std::conditional<(bits_ <= 8),
+    typename std::conditional<signed_, std::int8_t, std::uint8_t>::type,
+    typename std::conditional<(bits_ <= 16),
+      typename std::conditional<signed_, std::int16_t, std::uint16_t>::type,
+      typename std::conditional<signed_, std::int32_t, std::uint32_t>::type>::type>::type;
+  /// Gets the number of significant bits in a sample.
+  static constexpr size_type bits() noexcept { return bits_; }
+  /// Gets the number of bytes that one sample occupies.
+  static constexpr size_type container_size() noexcept { return container; }
+  /// Indicates whether or not the samples are signed.
+  static constexpr bool is_signed() noexcept { return signed_; }
+  /// Indicates whether or not the samples are
+  /// stored with the most significant byte first.
+  static constexpr bool is_big_endian() noexcept { return big_endian; }
+  /// Indicates whether or not the byte order of the samples
+  /// differs from the byte order of the host.
+  static constexpr bool needs_byte_swap() noexcept
+  {
+    return (container > 1) && (big_endian != host_is_big_endian());
+  }
+  /// Reads the value of a sample.
+  /// Bits outside of the significant bits of
+  /// the sample are ignored.
+  ///
+  /// @param s The sample to read.
+  ///
+  /// @return The value of the sample.
+  static constexpr value_type load(const storage_type& s) noexcept
+  {
+    return value_type(extend(sample_storage<container, big_endian>::load(s) & mask()));
+  }
+  /// Converts a value into a sample.
+  /// Signed values are sign extended to fill the container.
+  ///
+  /// @param value The value to convert.
+  ///
+  /// @return The sample containing the value.
+  static constexpr storage_type store(value_type value) noexcept
+  {
+    return sample_storage<container, big_endian>::store(std::uint32_t(value));
+  }
+private:
+  /// Gets the mask of the significant bits.
+  static constexpr std::uint32_t mask() noexcept
+  {
+    return (bits_ >= 32) ? 0xffffffffu : ((std::uint32_t(1) << bits_) - 1);
+  }
+  /// Sign extends the significant bits of a signed sample.
+  static constexpr std::uint32_t extend(std::uint32_t raw) noexcept
+  {
+    return (signed_ && (raw & (std::uint32_t(1) << (bits_ - 1)))) ? (raw | ~mask()) : raw;
+  }
+};
+
+template <> struct sample_traits<sample_format::s8>      final : public basic_sample_traits<8, 1, true, false> { };
+template <> struct sample_traits<sample_format::s16_le>  final : public basic_sample_traits<16, 2, true, false> { };
+template <> struct sample_traits<sample_format::s16_be>  final : public basic_sample_traits<16, 2, true, true> { };
+template <> struct sample_traits<sample_format::s18_3le> final : public basic_sample_traits<18, 3, true, false> { };
+template <> struct sample_traits<sample_format::s18_3be> final : public basic_sample_traits<18, 3, true, true> { };
+template <> struct sample_traits<sample_format::s20_3le> final : public basic_sample_traits<20, 3, true, false> { };
+template <> struct sample_traits<sample_format::s20_3be> final : public basic_sample_traits<20, 3, true, true> { };
+template <> struct sample_traits<sample_format::s24_3le> final : public basic_sample_traits<24, 3, true, false> { };
+template <> struct sample_traits<sample_format::s24_3be> final : public basic_sample_traits<24, 3, true, true> { };
+template <> struct sample_traits<sample_format::s24_le>  final : public basic_sample_traits<24, 4, true, false> { };
+template <> struct sample_traits<sample_format::s24_be>  final : public basic_sample_traits<24, 4, true, true> { };
+template <> struct sample_traits<sample_format::s32_le>  final : public basic_sample_traits<32, 4, true, false> { };
+template <> struct sample_traits<sample_format::s32_be>  final : public basic_sample_traits<32, 4, true, true> { };
+template <> struct sample_traits<sample_format::u8>      final : public basic_sample_traits<8, 1, false, false> { };
+template <> struct sample_traits<sample_format::u16_le>  final : public basic_sample_traits<16, 2, false, false> { };
+template <> struct sample_traits<sample_format::u16_be>  final : public basic_sample_traits<16, 2, false, true> { };
+template <> struct sample_traits<sample_format::u18_3le> final : public basic_sample_traits<18, 3, false, false> { };
+template <> struct sample_traits<sample_format::u18_3be> final : public basic_sample_traits<18, 3, false, true> { };
+template <> struct sample_traits<sample_format::u20_3le> final : public basic_sample_traits<20, 3, false, false> { };
+template <> struct sample_traits<sample_format::u20_3be> final : public basic_sample_traits<20, 3, false, true> { };
+template <> struct sample_traits<sample_format::u24_3le> final : public basic_sample_traits<24, 3, false, false> { };
+template <> struct sample_traits<sample_format::u24_3be> final : public basic_sample_traits<24, 3, false, true> { };
+template <> struct sample_traits<sample_format::u24_le>  final : public basic_sample_traits<24, 4, false, false> { };
+template <> struct sample_traits<sample_format::u24_be>  final : public basic_sample_traits<24, 4, false, true> { };
+template <> struct sample_traits<sample_format::u32_le>  final : public basic_sample_traits<32, 4, false, false> { };
+template <> struct sample_traits<sample_format::u32_be>  final : public basic_sample_traits<32, 4, false, true> { };
+
+/// A single frame of interleaved samples.
+/// The layout of this structure matches the layout
+/// of one frame in an interleaved audio buffer.
+///
+/// @tparam format The format of each sample.
+/// @tparam channels The number of samples in the frame.
+template <sample_format format, size_type channels>
+struct frame final
+{
+  /// The traits of the sample format.
+  using traits = sample_traits<format>;
+  /// The type that stores one sample.
+  using storage_type = typename traits::storage_type;
+  /// The native type of one sample value.
+  using value_type = typename traits::value_type;
+  /// The samples of the frame, in buffer order.
+  storage_type samples[channels];
+  /// Gets the value of a sample.
+  ///
+  /// @param channel The index of the channel to get the sample of.
+  ///
+  /// @return The value of the sample.
+  constexpr value_type get(size_type channel) const noexcept
+  {
+    return traits::load(samples[channel]);
+  }
+  /// Sets the value of a sample.
+  ///
+  /// @param channel The index of the channel to set the sample of.
+  /// @param value The value to assign the sample.
+  inline void set(size_type channel, value_type value) noexcept
+  {
+    samples[channel] = traits::store(value);
+  }
+};
+
+/// A view of an interleaved audio buffer
+/// with a sample format and channel count that
+/// are known at compile time.
+///
+/// @tparam format The format of each sample.
+/// @tparam channels The number of channels in each frame.
+template <sample_format format, size_type channels>
+class frame_view final
+{
+public:
+  /// The type of one frame in the view.
+  using frame_type = frame<format, channels>;
+private:
+  static_assert(sizeof(frame_type) == (channels * sample_traits<format>::container_size()),
+                "Frames must not contain padding.");
+  /// The first frame of the view.
+  frame_type* frames = nullptr;
+  /// The number of frames in the view.
+  size_type frame_count = 0;
+public:
+  /// Constructs an empty view.
+  constexpr frame_view() noexcept = default;
+  /// Constructs a view of an audio buffer.
+  ///
+  /// @param frames_ A pointer to the first frame.
+  /// @param frame_count_ The number of frames in the buffer.
+  constexpr frame_view(void* frames_, size_type frame_count_) noexcept
+    : frames(static_cast<frame_type*>(frames_)),
+      frame_count(frame_count_) { }
+  /// Gets the number of bytes in one frame.
+  static constexpr size_type frame_size() noexcept
+  {
+    return sizeof(frame_type);
+  }
+  /// Indicates the number of frames in the view.
+  constexpr size_type size() const noexcept
+  {
+    return frame_count;
+  }
+  /// Accesses the frames of the view.
+  constexpr frame_type* data() const noexcept
+  {
+    return frames;
+  }
+  /// Accesses a frame.
+  ///
+  /// @note This function does not perform boundary checking.
+  ///
+  /// @param index The index of the frame to access.
+  ///
+  /// @return A reference to the specified frame.
+  constexpr frame_type& operator [] (size_type index) const noexcept
+  {
+    return frames[index];
+  }
+  /// Accesses the beginning iterator of the view.
+  constexpr frame_type* begin() const noexcept
+  {
+    return frames;
+  }
+  /// Accesses the ending iterator of the view.
+  constexpr frame_type* end() const noexcept
+  {
+    return frames + frame_count;
+  }
+};
+
+/// Used to add triangular probability density function (TPDF)
+/// dither when samples are converted to a format with fewer bits.
+/// A dither instance keeps the state of its noise generator, so the
+/// same instance should be passed to consecutive conversions of a stream.
+struct dither final
+{
+  /// The state of the pseudo-random noise generator.
+  /// Any non-zero value may be used as a seed.
+  std::uint32_t state = 0x6d2b79f5;
+};
+
+/// Converts samples of any format to signed 32-bit integers.
+/// The converted samples are left-justified, so that the most
+/// significant bit of the source sample is bit 30 of the result,
+/// the sign being bit 31.
+///
+/// @param format The format of the source samples.
+/// @param samples A pointer to the source samples.
+/// @param out The array to write the converted samples to.
+/// @param sample_count The number of samples (not frames) to convert.
+void convert_to_int32(sample_format format, const void* samples, std::int32_t* out, size_type sample_count) noexcept;
+
+/// Converts left-justified signed 32-bit integer samples to any format.
+/// Samples are rounded to the nearest value of the destination format.
+///
+/// @param samples A pointer to the source samples.
+/// @param format The format to convert the samples to.
+/// @param out The buffer to write the converted samples to.
+/// @param sample_count The number of samples (not frames) to convert.
+/// @param d If not null, TPDF dither is added to samples
+/// before they're narrowed to the destination format.
+void convert_from_int32(const std::int32_t* samples, sample_format format, void* out, size_type sample_count, dither* d = nullptr) noexcept;
+
+/// Converts samples of any format to 32-bit floating point samples.
+/// The converted samples are in the range of [-1, 1).
+///
+/// @param format The format of the source samples.
+/// @param samples A pointer to the source samples.
+/// @param out The array to write the converted samples to.
+/// @param sample_count The number of samples (not frames) to convert.
+void convert_to_float(sample_format format, const void* samples, float* out, size_type sample_count) noexcept;
+
+/// Converts 32-bit floating point samples to any format.
+/// Samples outside of the range [-1, 1) are clipped.
+///
+/// @param samples A pointer to the source samples.
+/// @param format The format to convert the samples to.
+/// @param out The buffer to write the converted samples to.
+/// @param sample_count The number of samples (not frames) to convert.
+/// @param d If not null, TPDF dither is added to samples
+/// before they're narrowed to the destination format.
+void convert_from_float(const float* samples, sample_format format, void* out, size_type sample_count, dither* d = nullptr) noexcept;
+
+/// Enumerates the instruction sets that
+/// sample conversions may be made with.
+enum class conversion_isa
 {
-  bool is_signed() noexcept { return true; }
+  /// Portable code, one sample at a time.
+  /// This is the reference that the others must match.
+  scalar,
+  /// SSE2, on x86 processors.
+  sse2,
+  /// AVX2, on x86 processors.
+  avx2,
+  /// NEON, on little endian AArch64 processors.
+  neon
 };
 
+/// Indicates whether or not sample conversions may be made
+/// with an instruction set. The library must have been built
+/// with its kernels and the CPU must support it.
+bool is_conversion_isa_supported(conversion_isa isa) noexcept;
+
+/// Accesses the instruction set that sample conversions are made with.
+/// Unless one was selected, this is the fastest one that's supported.
+conversion_isa get_conversion_isa() noexcept;
+
+/// Selects the instruction set that sample conversions are made with.
+/// The channel remixer uses it as well. This is mostly useful for
+/// testing and benchmarking the kernels.
+///
+/// @param isa The instruction set to use from now on.
+///
+/// @return On success, zero is returned. If the
+/// instruction set is not supported, ENOTSUP is returned.
+result set_conversion_isa(conversion_isa isa) noexcept;
+
 /// Enumerates the several possible
 /// modes of accessing sample data from a PCM.
 enum class sample_access
@@ -221,6 +609,60 @@ enum class pcm_subclass
 /// @return A human-readable form of the subclass.
 inline constexpr const char* to_string(pcm_subclass subclass) noexcept;
 
+/// Enumerates the timestamp modes of a PCM.
+enum class pcm_timestamp_mode
+{
+  /// Timestamps are only taken when the status is queried.
+  none,
+  /// Timestamps are taken every time the driver
+  /// updates the position of the stream,
+  /// which is at least once per period.
+  enabled
+};
+
+/// Enumerates the clocks that PCM timestamps may be taken from.
+enum class pcm_timestamp_type
+{
+  /// The realtime clock, which may jump.
+  gettimeofday,
+  /// The monotonic clock, which is slewed by NTP.
+  monotonic,
+  /// The raw monotonic clock, which is
+  /// not adjusted by NTP at all.
+  monotonic_raw
+};
+
+/// Reads the clock that a timestamp type refers to.
+/// Used to compare the current time with PCM timestamps.
+///
+/// @param type The clock to read.
+///
+/// @return The current time of the clock, in nanoseconds.
+std::int64_t get_timestamp(pcm_timestamp_type type) noexcept;
+
+/// Enumerates the states that a PCM may be in.
+enum class pcm_state
+{
+  /// The PCM is opened but not set up.
+  open,
+  /// The PCM is set up but not prepared.
+  setup,
+  /// The PCM is ready to be started.
+  prepared,
+  /// The PCM is playing or capturing.
+  running,
+  /// The PCM stopped because of an overrun or underrun.
+  xrun,
+  /// The PCM is playing the remaining buffered audio.
+  draining,
+  /// The PCM is paused.
+  paused,
+  /// The system was suspended while the PCM was running.
+  suspended,
+  /// The device of the PCM was removed.
+  disconnected
+};
+
 /// Used to describe the configuration
 /// of a PCM device.
 struct pcm_config final
@@ -244,6 +686,10 @@ struct pcm_config final
   /// The number of frames to buffer
   /// before silencing the audio.
   size_type silence_threshold = 0;
+  /// When the kernel takes timestamps of the stream position.
+  pcm_timestamp_mode timestamp_mode = pcm_timestamp_mode::none;
+  /// The clock that the timestamps are taken from.
+  pcm_timestamp_type timestamp_type = pcm_timestamp_type::monotonic_raw;
 };
 
 /// Contains information on a PCM device.
@@ -255,6 +701,8 @@ struct pcm_info final
   size_type device = invalid_device();
   /// The subdevice number of the PCM.
   size_type subdevice = invalid_subdevice();
+  /// Whether the PCM is a capture or playback stream.
+  bool is_capture = false;
   /// The PCM class identifier.
   pcm_class class_;
   /// The PCM subclass identifier.
@@ -271,13 +719,167 @@ struct pcm_info final
   size_type subdevices_available = 0;
 };
 
+/// Describes an inclusive range of values.
+struct pcm_range final
+{
+  /// The smallest value in the range.
+  size_type min = 0;
+  /// The largest value in the range.
+  size_type max = 0;
+};
+
+/// Describes the range of configurations
+/// that a PCM supports.
+struct pcm_capabilities final
+{
+  /// The supported numbers of channels.
+  pcm_range channels;
+  /// The supported frame rates.
+  /// There may be unsupported rates within this range.
+  pcm_range rate;
+  /// The supported period sizes, in frames.
+  pcm_range period_size;
+  /// The supported numbers of periods.
+  pcm_range period_count;
+  /// The supported buffer sizes, in frames.
+  pcm_range buffer_size;
+  /// The supported sample formats.
+  /// Each bit is indexed by a value of @ref sample_format.
+  std::uint32_t formats = 0;
+  /// Indicates whether or not a sample format is supported.
+  ///
+  /// @param format The sample format to check for.
+  ///
+  /// @return True if it is supported, false if it's not.
+  constexpr bool supports(sample_format format) const noexcept
+  {
+    return (formats & (std::uint32_t(1) << unsigned(format))) != 0;
+  }
+};
+
+/// Describes the position and timing of a stream
+/// at the moment its status was queried.
+///
+/// Timestamps are in nanoseconds and are taken from
+/// the clock chosen by @ref pcm_config::timestamp_type.
+/// A timestamp that the driver did not provide is zero.
+struct pcm_status final
+{
+  /// The state of the PCM.
+  pcm_state state = pcm_state::open;
+  /// Whether or not the PCM is a capture stream.
+  bool is_capture = false;
+  /// The position of the hardware, in frames.
+  /// Wraps back to zero at the boundary of the stream.
+  size_type hw_ptr = 0;
+  /// The position of the application, in frames.
+  /// Wraps back to zero at the boundary of the stream.
+  size_type appl_ptr = 0;
+  /// The number of frames that may be read or written.
+  size_type avail = 0;
+  /// The largest value of @ref pcm_status::avail
+  /// since the last status query.
+  size_type avail_max = 0;
+  /// For playback, the number of frames until a frame
+  /// written now is heard. For capture, the number of
+  /// frames captured but not yet read.
+  std::int64_t delay = 0;
+  /// When the stream was last started, stopped or paused.
+  std::int64_t trigger_timestamp = 0;
+  /// When the position was last updated.
+  std::int64_t timestamp = 0;
+  /// The position of the hardware as a time,
+  /// taken from the audio clock of the device if it has one.
+  std::int64_t audio_timestamp = 0;
+  /// When the driver read the hardware position.
+  std::int64_t driver_timestamp = 0;
+};
+
+/// Describes the position of a stream.
+/// This is a subset of @ref pcm_status
+/// that is much cheaper to query.
+struct pcm_position final
+{
+  /// The state of the PCM.
+  pcm_state state = pcm_state::open;
+  /// The position of the hardware, in frames.
+  size_type hw_ptr = 0;
+  /// The position of the application, in frames.
+  size_type appl_ptr = 0;
+  /// The number of frames that may be read or written.
+  size_type avail = 0;
+  /// When the hardware position was last updated, in nanoseconds.
+  /// Zero unless timestamps are enabled in the configuration.
+  std::int64_t timestamp = 0;
+};
+
+/// Enumerates what the readers and writers do
+/// when a PCM overruns, underruns or is suspended.
+enum class xrun_policy
+{
+  /// The error is returned to the caller,
+  /// who is responsible for calling @ref pcm::recover.
+  report,
+  /// The PCM is prepared again and the transfer
+  /// is retried. Capture PCMs are started again.
+  prepare,
+  /// Like @ref xrun_policy::prepare, except playback PCMs
+  /// are filled with silence up to their start threshold,
+  /// so that they start again right away.
+  prefill_silence
+};
+
+/// Counts the overruns, underruns and
+/// suspensions of a PCM and what it cost
+/// to recover from them.
+struct xrun_counters final
+{
+  /// The number of capture overruns.
+  size_type overruns = 0;
+  /// The number of playback underruns.
+  size_type underruns = 0;
+  /// The number of times the system was
+  /// suspended while the PCM was running.
+  size_type suspends = 0;
+  /// The number of successful recoveries.
+  size_type recoveries = 0;
+  /// The number of recoveries that failed.
+  size_type failed_recoveries = 0;
+  /// An estimate of the number of frames that were
+  /// dropped (capture) or not played (playback).
+  size_type frames_lost = 0;
+  /// The total time spent recovering, in nanoseconds.
+  std::int64_t recovery_time = 0;
+  /// The longest time spent on one recovery, in nanoseconds.
+  std::int64_t max_recovery_time = 0;
+};
+
 class pcm_impl;
 
+class mmap_pcm;
+
+/// Memory that a PCM may keep its implementation data in,
+/// instead of allocating it. See @ref pcm::use_storage.
+struct pcm_storage final
+{
+  /// The number of bytes available to the implementation data.
+  static constexpr size_type size = 512;
+  /// The number of bytes available to the silence that playback
+  /// PCMs write when recovering from an xrun. The silence is
+  /// written in as many chunks as it takes to fill the buffer.
+  static constexpr size_type silence_size = 1024;
+  /// The memory of the implementation data.
+  alignas(std::max_align_t) unsigned char data[size];
+  /// The memory of the silence.
+  alignas(std::max_align_t) unsigned char silence[silence_size];
+};
+
 /// This is the base of any kind of PCM.
 /// The base class is responsible for interfacing
 /// with the file descriptor of the PCM device.
 class pcm
 {
+  friend mmap_pcm;
   /// A pointer to the implementation data.
   pcm_impl* self = nullptr;
 public:
@@ -289,6 +891,20 @@ public:
   pcm(pcm&& other) noexcept;
   /// Closes the PCM device.
   virtual ~pcm();
+  /// Constructs the implementation data of the PCM in place,
+  /// so that opening it, setting it up, transferring frames and
+  /// recovering from xruns don't allocate memory. Playback PCMs
+  /// keep the silence used by xrun recovery in the storage too.
+  /// When they're set up, ENOMEM is returned if one frame of
+  /// silence doesn't fit in @ref pcm_storage::silence_size bytes.
+  ///
+  /// @param storage The memory to keep the implementation data in.
+  /// It must outlive the PCM, or any PCM that it's moved to.
+  ///
+  /// @return On success, zero is returned.
+  /// If the PCM already has implementation
+  /// data, then EBUSY is returned.
+  result use_storage(pcm_storage& storage) noexcept;
   /// Closes the PCM device.
   /// This function does nothing if
   /// the PCM was already closed or was never opened.
@@ -307,6 +923,82 @@ public:
   ///
   /// @return A structure containing information on the PCM.
   generic_result<pcm_info> get_info() const noexcept;
+  /// Queries the configurations supported by the PCM.
+  /// This does not change the configuration of the PCM.
+  ///
+  /// @param access The access mode that the PCM would be set up with.
+  ///
+  /// @return On success, the supported ranges of each parameter.
+  /// On failure, a copy of errno is returned.
+  generic_result<pcm_capabilities> get_capabilities(sample_access access = sample_access::interleaved) const noexcept;
+  /// Finds the supported configuration that's closest to a desired one.
+  /// If the desired configuration is supported, it is returned as is.
+  /// Otherwise, the format, channel count, rate, period size and period
+  /// count are chosen in that order, each as close as possible to the
+  /// desired value, given the values chosen before it.
+  ///
+  /// @param config The desired configuration.
+  /// @param access The access mode that the PCM would be set up with.
+  ///
+  /// @return On success, a configuration that may be passed to setup.
+  /// On failure, a copy of errno is returned.
+  generic_result<pcm_config> get_nearest_config(const pcm_config& config, sample_access access = sample_access::interleaved) const noexcept;
+  /// Queries the position, state and timestamps of the stream.
+  ///
+  /// @return On success, the status of the stream.
+  /// On failure, a copy of errno is returned.
+  generic_result<pcm_status> get_status() const noexcept;
+  /// Queries the delay of the stream, which is cheaper than
+  /// querying the whole status. See @ref pcm_status::delay.
+  ///
+  /// @return On success, the delay in frames.
+  /// On failure, a copy of errno is returned.
+  generic_result<std::int64_t> get_delay() const noexcept;
+  /// Queries the position of the stream.
+  ///
+  /// The position is read from the status and control pages
+  /// of the driver, which are mapped on the first call. If the
+  /// driver does not allow them to be mapped, they are fetched
+  /// with a single SNDRV_PCM_IOCTL_SYNC_PTR call instead.
+  ///
+  /// @param hardware_sync Whether or not the driver should read
+  /// the position from the hardware first. Otherwise, the position
+  /// is the one from the last period interrupt or transfer.
+  ///
+  /// @return On success, the position of the stream.
+  /// If the PCM has not been set up, EBADFD is returned.
+  /// On any other failure, a copy of errno is returned.
+  generic_result<pcm_position> get_position(bool hardware_sync = false) noexcept;
+  /// Gets the position from the last successful call to
+  /// @ref pcm::get_position, without calling into the driver.
+  /// This lets code that runs after a wait, such as the
+  /// code filling the buffer, reuse the position it found.
+  ///
+  /// @return The last position that was queried. If none was
+  /// queried since the PCM was set up, its state is @ref pcm_state::open.
+  pcm_position get_cached_position() const noexcept;
+  /// Waits for one period of frames to become available.
+  ///
+  /// The thread sleeps in poll() until shortly before the
+  /// period is expected to complete, and then spins on the
+  /// position of the stream. This avoids the wake up latency
+  /// of poll() without spinning for the whole period.
+  ///
+  /// The position is read with a hardware sync, so that the
+  /// spin sees the DMA position move between period interrupts.
+  /// The last position read is left in the cache of
+  /// @ref pcm::get_cached_position.
+  ///
+  /// @param timeout_ms The maximum number of milliseconds to wait.
+  /// A negative value waits indefinitely.
+  /// @param spin_us The number of microseconds before the
+  /// expected end of the period to start spinning at.
+  ///
+  /// @return On success, zero is returned.
+  /// If the timeout expires, ETIMEDOUT is returned.
+  /// If the PCM is in an error state (such as an xrun), EPIPE is returned.
+  /// On any other failure, a copy of errno is returned.
+  result wait_hybrid(int timeout_ms = -1, size_type spin_us = 200) noexcept;
   /// Indicates whether or not the PCM is opened.
   ///
   /// @return True if the PCM is opened,
@@ -341,6 +1033,49 @@ public:
   /// @return On success, zero is returned.
   /// On failure, a copy of errno is returned instead.
   result drop() noexcept;
+  /// Waits for the PCM to become ready for
+  /// either reading or writing.
+  ///
+  /// @param timeout_ms The maximum number of milliseconds to wait.
+  /// A negative value waits indefinitely.
+  ///
+  /// @return On success, zero is returned.
+  /// If the timeout expires, ETIMEDOUT is returned.
+  /// If the PCM is in an error state (such as an xrun), EPIPE is returned.
+  /// On any other failure, a copy of errno is returned.
+  result wait(int timeout_ms = -1) noexcept;
+  /// Sets what the readers and writers of this PCM
+  /// do when it overruns, underruns or is suspended.
+  /// The default policy is @ref xrun_policy::report.
+  ///
+  /// @param policy The policy to use.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result set_xrun_policy(xrun_policy policy) noexcept;
+  /// Accesses the policy used when the PCM overruns,
+  /// underruns or is suspended.
+  xrun_policy get_xrun_policy() const noexcept;
+  /// Accesses the counters of the overruns, underruns
+  /// and suspensions of the PCM. The counters are
+  /// kept until they're reset, even across reopening.
+  xrun_counters get_xrun_counters() const noexcept;
+  /// Resets the xrun counters to zero.
+  void reset_xrun_counters() noexcept;
+  /// Recovers the PCM from an error returned by
+  /// a read or write operation. The recovery is done
+  /// according to the policy, except that with
+  /// @ref xrun_policy::report the PCM is only prepared.
+  /// A suspended PCM that does not resume within about
+  /// ten milliseconds is prepared instead.
+  ///
+  /// @param error The error that was returned.
+  ///
+  /// @return Zero if the PCM was recovered.
+  /// If the error is not an overrun, underrun or
+  /// suspension, it is returned as is.
+  /// If the recovery failed, a copy of errno is returned.
+  result recover(int error) noexcept;
   /// Opens a capture PCM.
   ///
   /// @param card The index of the card to open the PCM from.
@@ -353,6 +1088,12 @@ public:
   /// @param device The index of the device to open the PCM from.
   /// @param non_blocking Whether or not the PCM should be opened in non-blocking mode.
   result open_playback_device(size_type card = 0, size_type device = 0, bool non_blocking = true) noexcept;
+  /// Gets the number of bytes in one frame,
+  /// according to the last applied configuration.
+  ///
+  /// @return The size of one frame, in bytes.
+  /// If the PCM has not been set up, then zero is returned.
+  size_type get_frame_size() const noexcept;
 protected:
   /// Applys a configuration to a PCM.
   ///
@@ -361,6 +1102,16 @@ protected:
   ///
   /// @param is_capture Whether or not the PCM is a capture device.
   result setup(const pcm_config& config, sample_access access, bool is_capture) noexcept;
+  /// Handles an error returned by a transfer.
+  /// Overruns, underruns and suspensions are counted
+  /// and, unless the policy is @ref xrun_policy::report,
+  /// recovered from.
+  ///
+  /// @param error The error returned by the transfer.
+  ///
+  /// @return Zero if the transfer may be retried.
+  /// Otherwise, the error to return to the caller.
+  result handle_xrun(int error) noexcept;
 };
 
 class interleaved_reader
@@ -400,65 +1151,2053 @@ public:
   generic_result<size_type> read_unformatted(void* frames, size_type frame_count) noexcept override;
 };
 
-class pcm_list_impl;
-
-/// This class is used for enumerating
-/// the PCMs available on the system.
-///
-/// The best way to use this class is to
-/// declare it in a function scope with a
-/// short life time. That way, the list is
-/// always up to date.
-class pcm_list final
+class interleaved_writer
 {
-  /// A pointer to the implementation data.
-  pcm_list_impl* self = nullptr;
 public:
-  /// Constructs the PCM list.
-  /// Internally, this constructor will discover the PCMs on the system.
-  pcm_list() noexcept;
-  /// Moves the PCM list from one variable to another.
-  ///
-  /// @param other The PCM list to move.
-  pcm_list(pcm_list&& other) noexcept;
-  /// Releases the memory allocated by the list.
-  ~pcm_list();
-  /// Indicates the number of PCMs in the list.
-  size_type size() const noexcept;
-  /// Accesses the array of PCM info instances.
+  /// Writes unformatted data directly to the device.
   ///
-  /// @return A pointer to the beginning of the PCM info array.
-  const pcm_info* data() const noexcept;
-  /// Accesses an entry from the list.
+  /// @param frames A pointer to the frames to be written.
+  /// @param frame_count The number of audio frames to be written.
   ///
-  /// @note This function does not perform boundary checking.
+  /// @return Both an error code and the number of written frames are returned.
+  /// On success, the error code has a value of zero.
+  /// On failure, the error code has an errno value.
+  /// On failure, the number of written frames is zero.
+  virtual generic_result<size_type> write_unformatted(const void* frames, size_type frame_count) noexcept = 0;
+};
+
+class interleaved_pcm_writer final : public pcm, public interleaved_writer
+{
+public:
+  /// Opens a new PCM writer.
   ///
-  /// @param index The index of the entry to access.
+  /// @param card The index of the card to open.
+  /// @param device The index of the device to open.
+  /// @param non_blocking Whether or not the call
+  /// should block if the device is not available.
+  result open(size_type card = 0, size_type device = 0, bool non_blocking = false) noexcept;
+  /// Sets up the PCM with a given config.
   ///
-  /// @return A const-reference to the specified entry.
-  inline const pcm_info& operator [] (size_type index) const noexcept
+  /// @param config The config to setup the PCM with.
+  /// It's perfectly valid to leave out this parameter
+  /// and use the default configuration.
+  inline result setup(const pcm_config& config = pcm_config()) noexcept
   {
-    return data()[index];
+    return pcm::setup(config, sample_access::interleaved, false /* is capture */);
   }
-  /// Accesses the beginning iterator of the list.
-  /// Used in range-based for loops.
+  generic_result<size_type> write_unformatted(const void* frames, size_type frame_count) noexcept override;
+  /// Writes all of the given frames to the device.
   ///
-  /// @return A pointer to the beginning of the list.
-  inline const pcm_info* begin() const noexcept
+  /// Partial writes are continued until every frame is written.
+  /// If the PCM was opened in non-blocking mode and the buffer is full,
+  /// this function waits on the file descriptor instead of retrying.
+  /// Underruns and suspensions are recovered from according to the
+  /// xrun policy of the PCM. With @ref xrun_policy::report, they're
+  /// still counted and the PCM is prepared, as if by @ref pcm::recover.
+  ///
+  /// @param frames A pointer to the frames to be written.
+  /// @param frame_count The number of audio frames to be written.
+  ///
+  /// @return The number of frames written. On failure, the error code
+  /// is set and the number of frames is the amount written before the failure.
+  generic_result<size_type> write_all(const void* frames, size_type frame_count) noexcept;
+};
+
+/// Wraps an interleaved reader so that frames are
+/// read into buffers of a compile-time format and channel count.
+///
+/// @note The reader must be set up with a matching configuration.
+///
+/// @tparam format The sample format of the reader.
+/// @tparam channels The number of channels of the reader.
+template <sample_format format, size_type channels>
+class typed_interleaved_reader final
+{
+  /// The reader that frames are read from.
+  interleaved_reader& reader;
+public:
+  /// The type of one frame read by this reader.
+  using frame_type = frame<format, channels>;
+  /// The type of view returned by read operations.
+  using view_type = frame_view<format, channels>;
+  /// Constructs a typed reader.
+  ///
+  /// @param reader_ The reader to read the frames from.
+  constexpr explicit typed_interleaved_reader(interleaved_reader& reader_) noexcept
+    : reader(reader_) { }
+  /// Creates a configuration that matches the reader.
+  ///
+  /// @param config The configuration to take the
+  /// rate, period size, period count and thresholds from.
+  ///
+  /// @return A copy of @p config with the format and channel count replaced.
+  static pcm_config make_config(pcm_config config = pcm_config()) noexcept
   {
-    return data();
+    config.format = format;
+    config.channels = channels;
+    return config;
   }
-  /// Accesses the ending iterator of the list.
-  /// Used in range-based for loops.
+  /// Reads frames from the device.
   ///
-  /// @return A pointer to the end of the list.
-  /// This value should not be dereferenced.
-  inline const pcm_info* end() const noexcept
+  /// @param frames The buffer to read the frames into.
+  /// @param frame_count The maximum number of frames to read.
+  ///
+  /// @return On success, a view of the frames that were read.
+  /// On failure, an errno value and an empty view.
+  generic_result<view_type> read(frame_type* frames, size_type frame_count) noexcept
   {
-    return data() + size();
+    auto read_result = reader.read_unformatted(frames, frame_count);
+    if (read_result.failed()) {
+      return generic_result<view_type> { read_result.error, view_type() };
+    }
+
+    return generic_result<view_type> { 0, view_type(frames, read_result.unwrap()) };
   }
 };
 
+class non_interleaved_reader
+{
+public:
+  /// Reads unformatted data directly from the device
+  /// into one buffer per channel.
+  ///
+  /// @param channels An array of pointers, one for each channel,
+  /// to the sample buffers that are to be filled.
+  /// @param frame_count The number of audio frames to be read.
+  ///
+  /// @return Both an error code and the number of read frames are returned.
+  /// On success, the error code has a value of zero.
+  /// On failure, the error code has an errno value.
+  /// On failure, the number of read frames is zero.
+  virtual generic_result<size_type> read_unformatted(void* const* channels, size_type frame_count) noexcept = 0;
+};
+
+class non_interleaved_pcm_reader final : public pcm, public non_interleaved_reader
+{
+public:
+  /// Opens a new non-interleaved PCM reader.
+  ///
+  /// @param card The index of the card to open.
+  /// @param device The index of the device to open.
+  /// @param non_blocking Whether or not the call
+  /// should block if the device is not available.
+  result open(size_type card = 0, size_type device = 0, bool non_blocking = false) noexcept;
+  /// Sets up the PCM with a given config.
+  ///
+  /// @param config The config to setup the PCM with.
+  /// It's perfectly valid to leave out this parameter
+  /// and use the default configuration.
+  inline result setup(const pcm_config& config = pcm_config()) noexcept
+  {
+    return pcm::setup(config, sample_access::non_interleaved, true /* is capture */);
+  }
+  generic_result<size_type> read_unformatted(void* const* channels, size_type frame_count) noexcept override;
+};
+
+class non_interleaved_writer
+{
+public:
+  /// Writes unformatted data directly to the device
+  /// from one buffer per channel.
+  ///
+  /// @param channels An array of pointers, one for each channel,
+  /// to the sample buffers that are to be written.
+  /// @param frame_count The number of audio frames to be written.
+  ///
+  /// @return Both an error code and the number of written frames are returned.
+  /// On success, the error code has a value of zero.
+  /// On failure, the error code has an errno value.
+  /// On failure, the number of written frames is zero.
+  virtual generic_result<size_type> write_unformatted(const void* const* channels, size_type frame_count) noexcept = 0;
+};
+
+class non_interleaved_pcm_writer final : public pcm, public non_interleaved_writer
+{
+public:
+  /// Opens a new non-interleaved PCM writer.
+  ///
+  /// @param card The index of the card to open.
+  /// @param device The index of the device to open.
+  /// @param non_blocking Whether or not the call
+  /// should block if the device is not available.
+  result open(size_type card = 0, size_type device = 0, bool non_blocking = false) noexcept;
+  /// Sets up the PCM with a given config.
+  ///
+  /// @param config The config to setup the PCM with.
+  /// It's perfectly valid to leave out this parameter
+  /// and use the default configuration.
+  inline result setup(const pcm_config& config = pcm_config()) noexcept
+  {
+    return pcm::setup(config, sample_access::non_interleaved, false /* is capture */);
+  }
+  generic_result<size_type> write_unformatted(const void* const* channels, size_type frame_count) noexcept override;
+};
+
+/// Describes a contiguous region
+/// of a memory mapped audio buffer.
+struct mmap_region final
+{
+  /// A pointer to the first frame of the region.
+  void* frames = nullptr;
+  /// The number of frames in the region.
+  size_type frame_count = 0;
+};
+
+/// This is the base of PCMs that exchange audio
+/// data through the memory mapped buffer of the device.
+/// Frames are accessed in place, without being copied
+/// through a read or write call.
+///
+/// A typical cycle consists of calling @ref mmap_pcm::begin
+/// to get the next region of frames, processing the frames
+/// in place and then calling @ref mmap_pcm::commit to hand
+/// them back to the device.
+class mmap_pcm : public pcm
+{
+public:
+  /// Unmaps the buffer and closes the PCM.
+  ~mmap_pcm();
+  /// Indicates the number of frames that are ready to be accessed.
+  /// For capture PCMs, these are frames that have been recorded.
+  /// For playback PCMs, these are frames that may be written.
+  ///
+  /// @return On success, the number of available frames.
+  /// If an xrun occurred, EPIPE is returned.
+  /// On any other failure, an errno value is returned.
+  generic_result<size_type> available() noexcept;
+  /// Begins access to the next contiguous region of the buffer.
+  ///
+  /// @param frame_count The maximum number of frames to access.
+  ///
+  /// @return On success, the region of the buffer that may be accessed.
+  /// The region may contain fewer frames than requested, if either
+  /// fewer frames are available or the end of the buffer was reached.
+  /// If an xrun occurred, EPIPE is returned.
+  generic_result<mmap_region> begin(size_type frame_count) noexcept;
+  /// Commits frames accessed with @ref mmap_pcm::begin
+  /// back to the device.
+  ///
+  /// @param frame_count The number of frames that were accessed.
+  /// This may not be more than the number of frames returned by
+  /// the last call to @ref mmap_pcm::begin.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result commit(size_type frame_count) noexcept;
+protected:
+  /// Applies a configuration to the PCM and
+  /// maps the audio buffer, status and control
+  /// data of the device.
+  ///
+  /// @param config The configuration to apply.
+  /// @param is_capture Whether or not the PCM is a capture device.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result setup(const pcm_config& config, bool is_capture) noexcept;
+};
+
+/// Reads audio data directly from the
+/// memory mapped buffer of a capture device.
+class mmap_pcm_reader final : public mmap_pcm
+{
+public:
+  /// Closes the memory mapped PCM reader.
+  ~mmap_pcm_reader();
+  /// Opens a new memory mapped PCM reader.
+  ///
+  /// @param card The index of the card to open.
+  /// @param device The index of the device to open.
+  /// @param non_blocking Whether or not the call
+  /// should block if the device is not available.
+  result open(size_type card = 0, size_type device = 0, bool non_blocking = false) noexcept;
+  /// Sets up the PCM with a given config.
+  ///
+  /// @param config The config to setup the PCM with.
+  inline result setup(const pcm_config& config = pcm_config()) noexcept
+  {
+    return mmap_pcm::setup(config, true /* is capture */);
+  }
+};
+
+/// Writes audio data directly into the
+/// memory mapped buffer of a playback device.
+///
+/// @note Unlike write calls, committing frames
+/// does not start the device. Once the buffer is filled,
+/// call @ref pcm::start to begin playback.
+class mmap_pcm_writer final : public mmap_pcm
+{
+public:
+  /// Closes the memory mapped PCM writer.
+  ~mmap_pcm_writer();
+  /// Opens a new memory mapped PCM writer.
+  ///
+  /// @param card The index of the card to open.
+  /// @param device The index of the device to open.
+  /// @param non_blocking Whether or not the call
+  /// should block if the device is not available.
+  result open(size_type card = 0, size_type device = 0, bool non_blocking = false) noexcept;
+  /// Sets up the PCM with a given config.
+  ///
+  /// @param config The config to setup the PCM with.
+  inline result setup(const pcm_config& config = pcm_config()) noexcept
+  {
+    return mmap_pcm::setup(config, false /* is capture */);
+  }
+};
+
+/// Holds a PCM along with the memory of its implementation data,
+/// so that a PCM doesn't allocate anything. This is meant for
+/// targets where memory is scarce, and for real-time threads.
+///
+/// Since the PCM refers to memory inside of this
+/// object, it may not be copied or moved.
+///
+/// @tparam pcm_type The type of PCM, such as @ref interleaved_pcm_reader.
+template <typename pcm_type>
+class inline_pcm final
+{
+  /// The memory of the implementation data.
+  /// It's declared first so that it outlives the PCM.
+  pcm_storage storage;
+  /// The PCM using the storage.
+  pcm_type p;
+public:
+  /// Constructs an unopened PCM.
+  inline_pcm() noexcept
+  {
+    p.use_storage(storage);
+  }
+  inline_pcm(const inline_pcm&) = delete;
+  inline_pcm(inline_pcm&&) = delete;
+  inline_pcm& operator = (const inline_pcm&) = delete;
+  inline_pcm& operator = (inline_pcm&&) = delete;
+  /// Accesses the PCM.
+  inline pcm_type& get() noexcept
+  {
+    return p;
+  }
+  /// Accesses the PCM.
+  inline const pcm_type& get() const noexcept
+  {
+    return p;
+  }
+  /// Accesses the members of the PCM.
+  inline pcm_type* operator -> () noexcept
+  {
+    return &p;
+  }
+  /// Accesses the members of the PCM.
+  inline const pcm_type* operator -> () const noexcept
+  {
+    return &p;
+  }
+};
+
+/// Describes a contiguous region of a frame ring.
+struct ring_region final
+{
+  /// A pointer to the first frame of the region.
+  void* frames = nullptr;
+  /// The number of frames in the region.
+  size_type frame_count = 0;
+};
+
+class frame_ring_impl;
+
+/// A wait-free, single-producer and single-consumer
+/// ring buffer of audio frames. It is meant for passing
+/// frames from a real-time capture thread to a processing
+/// thread (or the other way around for playback).
+///
+/// The producer never blocks. The consumer may either
+/// poll the ring or block on @ref frame_ring::wait_readable,
+/// in which case the producer wakes it through an eventfd.
+///
+/// @note Functions marked as producer functions may only be
+/// called from one thread, and likewise for consumer functions.
+class frame_ring final
+{
+  /// A pointer to the implementation data.
+  frame_ring_impl* self = nullptr;
+public:
+  /// Constructs an empty ring.
+  /// Call @ref frame_ring::allocate before using it.
+  frame_ring() noexcept;
+  /// Moves a ring from one variable to another.
+  ///
+  /// @param other The ring to be moved.
+  frame_ring(frame_ring&& other) noexcept;
+  /// Releases the memory allocated by the ring.
+  ~frame_ring();
+  /// Allocates the frames of the ring.
+  /// This is not thread safe and should be done
+  /// before the producer and consumer are started.
+  ///
+  /// @param frame_capacity The minimum number of frames the ring holds.
+  /// This is rounded up to a power of two.
+  /// @param frame_size The number of bytes in one frame.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result allocate(size_type frame_capacity, size_type frame_size) noexcept;
+  /// Indicates the number of frames the ring can hold.
+  size_type capacity() const noexcept;
+  /// Indicates the number of bytes in one frame.
+  size_type frame_size() const noexcept;
+  /// Accesses a file descriptor that becomes readable
+  /// when the producer wakes a waiting consumer.
+  /// This is useful when the consumer polls other file descriptors as well.
+  int get_file_descriptor() const noexcept;
+  /// Indicates the number of frames that may be written.
+  /// This is a producer function.
+  size_type writable() noexcept;
+  /// Begins a write to the next contiguous region of free frames.
+  /// This is a producer function.
+  ///
+  /// @param frame_count The maximum number of frames to write.
+  ///
+  /// @return The region that may be written to. The region may
+  /// have fewer frames than requested, if either there is not
+  /// enough space or the end of the ring was reached.
+  ring_region begin_write(size_type frame_count) noexcept;
+  /// Makes frames written to the region returned by
+  /// @ref frame_ring::begin_write visible to the consumer.
+  /// This is a producer function.
+  ///
+  /// @param frame_count The number of frames that were written.
+  void commit_write(size_type frame_count) noexcept;
+  /// Copies frames into the ring.
+  /// This is a producer function.
+  ///
+  /// @param frames The frames to copy.
+  /// @param frame_count The number of frames to copy.
+  ///
+  /// @return The number of frames copied, which is less
+  /// than @p frame_count if the ring does not have enough space.
+  size_type write(const void* frames, size_type frame_count) noexcept;
+  /// Indicates the number of frames that may be read.
+  /// This is a consumer function.
+  size_type readable() noexcept;
+  /// Begins a read from the next contiguous region of frames.
+  /// This is a consumer function.
+  ///
+  /// @param frame_count The maximum number of frames to read.
+  ///
+  /// @return The region that may be read from.
+  ring_region begin_read(size_type frame_count) noexcept;
+  /// Releases frames read from the region returned
+  /// by @ref frame_ring::begin_read back to the producer.
+  /// This is a consumer function.
+  ///
+  /// @param frame_count The number of frames that were read.
+  void commit_read(size_type frame_count) noexcept;
+  /// Copies frames out of the ring.
+  /// This is a consumer function.
+  ///
+  /// @param frames The buffer to copy the frames to.
+  /// @param frame_count The maximum number of frames to copy.
+  ///
+  /// @return The number of frames copied.
+  size_type read(void* frames, size_type frame_count) noexcept;
+  /// Blocks until a number of frames may be read.
+  /// This is a consumer function.
+  ///
+  /// @param frame_count The number of frames to wait for.
+  /// @param timeout_ms The maximum number of milliseconds to wait
+  /// for each wake up. A negative value waits indefinitely.
+  ///
+  /// @return On success, zero is returned.
+  /// If the timeout expires, ETIMEDOUT is returned.
+  /// On any other failure, an errno value is returned.
+  result wait_readable(size_type frame_count, int timeout_ms = -1) noexcept;
+};
+
+/// Reads frames from an interleaved reader directly
+/// into the free space of a frame ring. This is meant
+/// to be called from the capture thread.
+///
+/// @param reader The reader to read frames from.
+/// @param ring The ring to put the frames into.
+/// This function acts as the producer of the ring.
+/// @param frame_count The maximum number of frames to read.
+///
+/// @return The number of frames read into the ring.
+/// If the ring has no free space, ENOBUFS is returned.
+/// If the read fails, its errno value is returned
+/// along with the number of frames read before the failure.
+generic_result<size_type> pump_capture(interleaved_reader& reader, frame_ring& ring, size_type frame_count) noexcept;
+
+/// Describes how a @ref frame_pool allocates its buffers.
+struct frame_pool_config final
+{
+  /// The number of buffers in the pool.
+  /// If zero, twice the period count is used.
+  size_type buffer_count = 0;
+  /// Whether or not to try backing the pool with huge pages.
+  /// If none are available, regular pages are used.
+  bool huge_pages = false;
+  /// Whether or not to lock the pool into memory, so that it's never
+  /// paged out. If the limit on locked memory is too low, the pool
+  /// is used without being locked.
+  bool lock_memory = true;
+};
+
+class frame_pool_impl;
+
+/// A pool of period sized frame buffers, meant for real-time threads.
+///
+/// All the buffers are allocated up front, aligned to 64 bytes for
+/// vector instructions and touched so that using them never causes
+/// a page fault. Buffers are taken and given back with a lock-free
+/// stack, so that a capture loop allocates nothing once it's running.
+class frame_pool final
+{
+  /// A pointer to the implementation data.
+  frame_pool_impl* self = nullptr;
+public:
+  /// The alignment of every buffer in the pool.
+  static constexpr size_type alignment = 64;
+  /// Constructs an empty pool.
+  frame_pool() noexcept;
+  /// Moves a pool from one variable to another.
+  ///
+  /// @param other The pool to be moved.
+  frame_pool(frame_pool&& other) noexcept;
+  /// Releases the memory of the pool. Buffers
+  /// taken from the pool may not be used afterwards.
+  ~frame_pool();
+  /// Allocates the buffers of the pool.
+  /// This is not thread safe.
+  ///
+  /// @param config The configuration to size the buffers with.
+  /// Each buffer holds one period of frames.
+  /// @param pool_config Describes how the buffers are allocated.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result allocate(const pcm_config& config, const frame_pool_config& pool_config = frame_pool_config()) noexcept;
+  /// Takes a buffer from the pool. This is lock free.
+  ///
+  /// @return A buffer, or a null pointer if all the buffers are taken.
+  void* acquire() noexcept;
+  /// Gives a buffer back to the pool. This is lock free.
+  ///
+  /// @param buffer A buffer returned by @ref frame_pool::acquire.
+  void release(void* buffer) noexcept;
+  /// Indicates the number of bytes in each buffer.
+  size_type buffer_size() const noexcept;
+  /// Indicates the number of frames in each buffer.
+  size_type frame_count() const noexcept;
+  /// Indicates the number of buffers in the pool.
+  size_type capacity() const noexcept;
+  /// Indicates whether or not the pool is locked into memory.
+  bool is_locked() const noexcept;
+  /// Indicates whether or not the pool is backed by huge pages.
+  bool uses_huge_pages() const noexcept;
+};
+
+class latency_histogram_impl;
+
+/// A histogram of durations, in nanoseconds.
+///
+/// The buckets grow with the magnitude of the values, so that
+/// every value is kept with a relative error of about 3%, in
+/// the same way as an HDR histogram. Recording is lock-free and
+/// takes a fixed amount of time, so it may be done from a
+/// real-time thread while another thread reads the histogram.
+///
+/// The buckets are allocated by @ref latency_histogram::allocate,
+/// rather than on construction, so that a histogram that's never
+/// used costs nothing and an allocation failure is reported.
+class latency_histogram final
+{
+  /// A pointer to the implementation data.
+  latency_histogram_impl* self = nullptr;
+public:
+  /// Constructs a histogram without buckets.
+  /// Nothing is recorded until it's allocated.
+  latency_histogram() noexcept;
+  /// Moves a histogram from one variable to another.
+  ///
+  /// @param other The histogram to be moved.
+  latency_histogram(latency_histogram&& other) noexcept;
+  /// Releases the memory of the histogram.
+  ~latency_histogram();
+  /// Allocates the buckets of the histogram. If they're
+  /// already allocated, the histogram is reset instead.
+  /// This is not thread safe.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, ENOMEM is returned.
+  result allocate() noexcept;
+  /// Indicates whether or not the buckets are allocated.
+  bool is_allocated() const noexcept;
+  /// Records a value. Negative values are recorded as zero.
+  ///
+  /// @param value The value to record, in nanoseconds.
+  void record(std::int64_t value) noexcept;
+  /// Indicates the number of values recorded.
+  size_type size() const noexcept;
+  /// Gets the largest value recorded.
+  std::int64_t get_max() const noexcept;
+  /// Gets the mean of the values recorded.
+  std::int64_t get_mean() const noexcept;
+  /// Gets a percentile of the values recorded.
+  ///
+  /// @param percentile The percentile to get, from 0 to 100.
+  ///
+  /// @return The highest value of the bucket that the
+  /// percentile falls in. If there are no values, zero is returned.
+  std::int64_t get_percentile(double percentile) const noexcept;
+  /// Removes all values. If values are being recorded at the
+  /// same time, some of them may survive the reset.
+  void reset() noexcept;
+};
+
+/// Describes the setup of a @ref rt_worker thread.
+struct rt_worker_config final
+{
+  /// The SCHED_FIFO priority of the thread.
+  /// If zero, the thread uses the default scheduling policy.
+  int priority = 0;
+  /// The CPU that the thread is pinned to.
+  /// If negative, the thread may run on any CPU.
+  int cpu = -1;
+  /// Whether or not to lock all the memory of the process,
+  /// including future mappings, with mlockall. This is off by
+  /// default, since locking future mappings makes allocations
+  /// fail once the limit on locked memory is reached. If the
+  /// memory can't be locked, the thread runs without it.
+  bool lock_memory = false;
+  /// The size of the thread stack, in bytes.
+  /// If zero, the default size is used.
+  size_type stack_size = 0;
+  /// The number of bytes of stack to touch before the first
+  /// period, so that the periods don't fault in stack pages.
+  /// It's limited to the stack size, less some room for the
+  /// frames of the thread and of the handler.
+  size_type stack_prefault = 64 * 1024;
+  /// The time between two periods, in nanoseconds. The thread sleeps
+  /// until each period is due, and the lateness of the wake up is recorded.
+  /// For a PCM, this is the period size times one billion, divided by the rate.
+  /// If zero, periods run back to back and the handler is expected to wait
+  /// on its own, in which case no lateness is recorded.
+  std::int64_t period_ns = 0;
+};
+
+/// Receives the periods of a @ref rt_worker.
+class rt_period_handler
+{
+public:
+  /// Called from the worker thread once per period.
+  /// This should do the work of the period, such as
+  /// reading a period from an @ref interleaved_pcm_reader.
+  ///
+  /// @return True to keep running, false to stop the thread.
+  virtual bool on_period() noexcept = 0;
+};
+
+class rt_worker_impl;
+
+/// Runs a period handler on a real-time thread.
+///
+/// The thread is given its scheduling policy, CPU affinity
+/// and stack before it runs, so that every PCM thread is
+/// set up the same way. The lateness of each wake up and the
+/// duration of each period are kept in histograms, which may
+/// be read while the thread runs.
+class rt_worker final
+{
+  /// A pointer to the implementation data.
+  rt_worker_impl* self = nullptr;
+public:
+  /// Constructs a worker with no thread.
+  rt_worker() noexcept;
+  /// Moves a worker from one variable to another.
+  ///
+  /// @param other The worker to be moved.
+  rt_worker(rt_worker&& other) noexcept;
+  /// Stops the thread, if it's running.
+  ~rt_worker();
+  /// Starts the thread. This is not thread safe.
+  ///
+  /// @param handler The handler to run once per period.
+  /// It must stay at the same address until the thread is stopped.
+  /// @param config Describes how the thread is set up.
+  ///
+  /// @return On success, zero is returned.
+  /// If the thread is already running, EBUSY is returned.
+  /// If the priority may not be set, EPERM is returned.
+  /// If the histograms can't be allocated, ENOMEM is returned.
+  /// On any other failure, an errno value is returned.
+  result start(rt_period_handler& handler, const rt_worker_config& config = rt_worker_config()) noexcept;
+  /// Asks the thread to stop after its current period and waits for it.
+  /// The handler must return from each period for this to finish.
+  void stop() noexcept;
+  /// Indicates whether or not the thread is running.
+  /// This becomes false once the handler asks to stop.
+  bool is_running() const noexcept;
+  /// Indicates whether or not the memory of the process was
+  /// locked when the thread was started. See @ref rt_worker_config::lock_memory.
+  bool is_memory_locked() const noexcept;
+  /// Indicates the number of periods that were skipped,
+  /// because a period took longer than the period time.
+  size_type get_overruns() const noexcept;
+  /// Accesses the lateness of each wake up, in nanoseconds.
+  const latency_histogram& get_lateness() const noexcept;
+  /// Accesses the time taken by each period, in nanoseconds.
+  const latency_histogram& get_duration() const noexcept;
+};
+
+/// Describes how a @ref capture_recorder buffers its writes.
+struct capture_recorder_config final
+{
+  /// The number of bytes in one buffer. This is rounded up
+  /// so that a buffer holds whole frames and is aligned to
+  /// the block size of the disk.
+  size_type buffer_size = 4 * 1024 * 1024;
+  /// The number of buffers. While the I/O thread writes one
+  /// buffer, the capture thread fills the others.
+  size_type buffer_count = 2;
+  /// Whether or not to bypass the page cache with O_DIRECT.
+  /// It is only used if the file system supports it.
+  bool direct_io = true;
+  /// Whether or not to write an RF64 header even if the file
+  /// stays below 4 GiB. This suits tools that expect a recording
+  /// of unknown length to be RF64 from the start.
+  bool always_rf64 = false;
+};
+
+/// Describes the progress of a @ref capture_recorder.
+struct capture_recorder_stats final
+{
+  /// The number of frames captured into the buffers.
+  size_type frames_captured = 0;
+  /// The number of audio bytes written to the file.
+  std::uint64_t bytes_written = 0;
+  /// The number of buffers written to the file.
+  size_type buffers_written = 0;
+  /// The number of buffers waiting for the I/O thread.
+  size_type queued_buffers = 0;
+  /// The largest number of buffers that waited for the I/O thread.
+  size_type max_queued_buffers = 0;
+  /// The number of times that no buffer was free to capture into.
+  /// This is the back pressure put on the capture thread by the disk.
+  size_type stalls = 0;
+  /// The longest time a buffer took to be written, in nanoseconds.
+  std::int64_t max_write_time = 0;
+  /// Whether or not the file is written with O_DIRECT.
+  bool direct_io = false;
+};
+
+class capture_recorder_impl;
+
+/// Records frames from an @ref interleaved_reader to a WAV file.
+///
+/// The frames are read directly into large, aligned buffers,
+/// which are written to the file by a separate I/O thread. That
+/// way, a slow disk does not block the thread reading from the
+/// device, unless all the buffers are waiting to be written.
+///
+/// Files larger than 4 GiB are written as RF64, as are all files
+/// if @ref capture_recorder_config::always_rf64 is set. The supported
+/// formats are the ones that WAV stores as they are: u8, s16_le,
+/// s24_3le and s32_le.
+///
+/// @note Only @ref capture_recorder::get_stats may be called
+/// from a different thread than the one calling @ref capture_recorder::pump.
+class capture_recorder final
+{
+  /// A pointer to the implementation data.
+  capture_recorder_impl* self = nullptr;
+public:
+  /// Constructs a recorder without a file.
+  capture_recorder() noexcept;
+  /// Moves a recorder from one variable to another.
+  ///
+  /// @param other The recorder to be moved.
+  capture_recorder(capture_recorder&& other) noexcept;
+  /// Closes the file, if it's still open.
+  ~capture_recorder();
+  /// Creates a WAV file and starts the I/O thread.
+  ///
+  /// @param path The path of the file to create.
+  /// @param format The channels, rate and format of the frames.
+  /// @param config Describes how the writes are buffered.
+  ///
+  /// @return On success, zero is returned.
+  /// If the format cannot be stored in a WAV file, EINVAL is returned.
+  /// On any other failure, an errno value is returned.
+  result open(const char* path, const pcm_config& format, const capture_recorder_config& config = capture_recorder_config()) noexcept;
+  /// Reads frames from a reader into the current buffer.
+  /// A full buffer is passed on to the I/O thread.
+  ///
+  /// @param reader The reader to read frames from.
+  /// @param frame_count The maximum number of frames to read.
+  ///
+  /// @return The number of frames read.
+  /// If no buffer is free, ENOBUFS is returned.
+  /// If a write to the file failed, its errno value is returned.
+  /// If the read fails, its errno value is returned
+  /// along with the number of frames read before the failure.
+  generic_result<size_type> pump(interleaved_reader& reader, size_type frame_count) noexcept;
+  /// Writes the remaining frames, completes the
+  /// header of the file and closes it.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, the errno value of the first failed write is returned.
+  result close() noexcept;
+  /// Indicates whether or not a file is open.
+  bool is_open() const noexcept;
+  /// Gets the progress of the recorder.
+  capture_recorder_stats get_stats() const noexcept;
+};
+
+class file_pcm_reader_impl;
+
+/// Reads frames from a WAV or RF64 file, as if it were a capture device.
+/// This is useful for feeding recorded material through the same code
+/// that normally reads from hardware.
+///
+/// The file is memory mapped, so reads are plain copies
+/// from the mapping. The kernel is advised that the file is read
+/// sequentially, so that it reads ahead of the pipeline.
+///
+/// The supported formats are the same as those
+/// written by a @ref capture_recorder.
+class file_pcm_reader final : public interleaved_reader
+{
+  /// A pointer to the implementation data.
+  file_pcm_reader_impl* self = nullptr;
+public:
+  /// Constructs a reader without a file.
+  file_pcm_reader() noexcept;
+  /// Moves a reader from one variable to another.
+  ///
+  /// @param other The reader to be moved.
+  file_pcm_reader(file_pcm_reader&& other) noexcept;
+  /// Unmaps the file, if it's open.
+  ~file_pcm_reader();
+  /// Opens and maps a WAV file.
+  ///
+  /// @param path The path of the file to open.
+  /// @param real_time If true, reads block until the frames would have
+  /// been captured by a device running at the rate of the file. The clock
+  /// starts with the first read. If false, reads return immediately.
+  ///
+  /// @return On success, zero is returned.
+  /// If the file is not a WAV file in a supported format, EPROTO is returned.
+  /// On any other failure, an errno value is returned.
+  result open(const char* path, bool real_time = false) noexcept;
+  /// Unmaps the file.
+  void close() noexcept;
+  /// Indicates whether or not a file is open.
+  bool is_open() const noexcept;
+  /// Gets a configuration that matches the channels,
+  /// rate and format of the file. This may be used to
+  /// set up the PCMs that the frames are passed on to.
+  pcm_config get_config() const noexcept;
+  /// Indicates the number of frames in the file.
+  size_type get_frame_count() const noexcept;
+  /// Indicates the index of the next frame to be read.
+  size_type get_position() const noexcept;
+  /// Moves to a frame in the file. When reads are paced,
+  /// the clock restarts with the next read.
+  ///
+  /// @param frame The index of the next frame to read.
+  ///
+  /// @return On success, zero is returned.
+  /// If the frame is past the end of the file, EINVAL is returned.
+  result seek(size_type frame) noexcept;
+  /// Copies frames from the file.
+  ///
+  /// @param frames The buffer to copy the frames to.
+  /// @param frame_count The maximum number of frames to copy.
+  ///
+  /// @return The number of frames copied, which is less than
+  /// @p frame_count near the end of the file. At the end
+  /// of the file, ENODATA is returned.
+  generic_result<size_type> read_unformatted(void* frames, size_type frame_count) noexcept override;
+};
+
+/// Selects the trade off between the quality
+/// and the speed of a @ref resampler.
+enum class resampler_quality
+{
+  /// A short filter with a wide transition band,
+  /// for voice and monitoring.
+  low,
+  /// A filter suitable for most uses.
+  medium,
+  /// A long filter with a narrow transition band
+  /// and the most attenuation, for music.
+  high
+};
+
+/// The number of frames consumed and
+/// produced by @ref resampler::process.
+struct resample_result final
+{
+  /// The number of input frames that were consumed.
+  size_type frames_read = 0;
+  /// The number of output frames that were produced.
+  size_type frames_written = 0;
+};
+
+class resampler_impl;
+
+/// Converts interleaved float frames from one rate to another.
+///
+/// This is a polyphase FIR filter with a Kaiser windowed sinc.
+/// Output frames in between two phases use coefficients interpolated
+/// from both, so any ratio is supported and it may be changed while
+/// streaming, such as to follow the drift between two clocks.
+///
+/// The inner loops use AVX2 or NEON when the CPU supports them.
+class resampler final
+{
+  /// A pointer to the implementation data.
+  resampler_impl* self = nullptr;
+public:
+  /// Constructs a resampler that is not initialized.
+  resampler() noexcept;
+  /// Moves a resampler from one variable to another.
+  ///
+  /// @param other The resampler to be moved.
+  resampler(resampler&& other) noexcept;
+  /// Releases the memory of the resampler.
+  ~resampler();
+  /// Designs the filter and allocates the history of the channels.
+  ///
+  /// @param channels The number of channels in a frame.
+  /// @param input_rate The rate of the input frames.
+  /// @param output_rate The rate of the output frames.
+  /// @param quality The quality of the filter.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result init(size_type channels, size_type input_rate, size_type output_rate, resampler_quality quality = resampler_quality::medium) noexcept;
+  /// Changes the ratio of the output rate to the input rate.
+  ///
+  /// The filter is not redesigned, so this is meant for small
+  /// adjustments. To change the rates, call @ref resampler::init again.
+  ///
+  /// @param ratio The number of output frames per input frame.
+  ///
+  /// @return On success, zero is returned.
+  /// If the ratio is not positive, EINVAL is returned.
+  result set_ratio(double ratio) noexcept;
+  /// Gets the number of output frames per input frame.
+  double get_ratio() const noexcept;
+  /// Gets the delay added by the filter, in input frames.
+  size_type get_latency() const noexcept;
+  /// Clears the history of the channels, as if no
+  /// frames had been passed to the resampler yet.
+  void reset() noexcept;
+  /// Converts frames until either the input
+  /// is consumed or the output is full.
+  ///
+  /// @param input The interleaved input frames.
+  /// @param input_frames The number of input frames.
+  /// @param output The buffer to put the interleaved output frames into.
+  /// @param output_frames The number of frames the output can hold.
+  ///
+  /// @return The number of frames consumed and produced. Input frames
+  /// that were consumed are kept by the resampler for as long as they're needed.
+  resample_result process(const float* input, size_type input_frames, float* output, size_type output_frames) noexcept;
+};
+
+class resampling_reader_impl;
+
+/// Reads frames from an @ref interleaved_reader at a different rate.
+///
+/// The frames keep the format and channels of the source.
+/// They're converted to float, resampled and converted back.
+class resampling_reader final : public interleaved_reader
+{
+  /// A pointer to the implementation data.
+  resampling_reader_impl* self = nullptr;
+public:
+  /// Constructs a reader without a source.
+  resampling_reader() noexcept;
+  /// Moves a reader from one variable to another.
+  ///
+  /// @param other The reader to be moved.
+  resampling_reader(resampling_reader&& other) noexcept;
+  /// Releases the memory of the reader.
+  ~resampling_reader();
+  /// Assigns the source of the frames.
+  ///
+  /// @param source The reader to read frames from. It must
+  /// stay at the same address while this reader is used.
+  /// @param source_config The channels, rate and format of the source.
+  /// @param rate The rate of the frames read from this reader.
+  /// @param quality The quality of the resampler.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result open(interleaved_reader& source, const pcm_config& source_config, size_type rate, resampler_quality quality = resampler_quality::medium) noexcept;
+  /// Accesses the resampler, such as to adjust its ratio.
+  /// This may only be called after a successful call to open.
+  resampler& get_resampler() noexcept;
+  /// Reads frames from the source and resamples them.
+  ///
+  /// @param frames The buffer to put the frames into.
+  /// @param frame_count The number of frames to read.
+  ///
+  /// @return The number of frames read. This is less than @p frame_count
+  /// if the source returns fewer frames or fails. A failure of the source is
+  /// only returned if no frames were read.
+  generic_result<size_type> read_unformatted(void* frames, size_type frame_count) noexcept override;
+};
+
+class resampling_writer_impl;
+
+/// Writes frames to an @ref interleaved_writer at a different rate.
+///
+/// The frames have the format and channels of the sink.
+/// They're converted to float, resampled and converted back.
+class resampling_writer final : public interleaved_writer
+{
+  /// A pointer to the implementation data.
+  resampling_writer_impl* self = nullptr;
+public:
+  /// Constructs a writer without a sink.
+  resampling_writer() noexcept;
+  /// Moves a writer from one variable to another.
+  ///
+  /// @param other The writer to be moved.
+  resampling_writer(resampling_writer&& other) noexcept;
+  /// Releases the memory of the writer.
+  ~resampling_writer();
+  /// Assigns the sink of the frames.
+  ///
+  /// @param sink The writer to write frames to. It must
+  /// stay at the same address while this writer is used.
+  /// @param sink_config The channels, rate and format of the sink.
+  /// @param rate The rate of the frames written to this writer.
+  /// @param quality The quality of the resampler.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result open(interleaved_writer& sink, const pcm_config& sink_config, size_type rate, resampler_quality quality = resampler_quality::medium) noexcept;
+  /// Accesses the resampler, such as to adjust its ratio.
+  /// This may only be called after a successful call to open.
+  resampler& get_resampler() noexcept;
+  /// Resamples frames and writes all of them to the sink.
+  ///
+  /// @param frames The frames to write.
+  /// @param frame_count The number of frames to write.
+  ///
+  /// @return On success, @p frame_count is returned.
+  /// If the sink fails, its errno value is returned along with the
+  /// number of frames that were consumed before the failure.
+  generic_result<size_type> write_unformatted(const void* frames, size_type frame_count) noexcept override;
+};
+
+class channel_remixer_impl;
+
+/// Mixes input channels into output channels with a matrix of gains.
+/// This covers downmixing, picking channels out of a large capture,
+/// reordering channels and applying a gain to each of them.
+///
+/// The matrix has one row per output channel and one column per
+/// input channel. Only the gains that are not zero are applied,
+/// and only the input channels they refer to are read, so sparse
+/// matrices cost less than dense ones. A matrix that does not
+/// change the frames is a copy.
+///
+/// Gain changes may be ramped over a number of frames,
+/// so that they do not cause zipper noise.
+class channel_remixer final
+{
+  /// A pointer to the implementation data.
+  channel_remixer_impl* self = nullptr;
+public:
+  /// Constructs a remixer that is not initialized.
+  channel_remixer() noexcept;
+  /// Moves a remixer from one variable to another.
+  ///
+  /// @param other The remixer to be moved.
+  channel_remixer(channel_remixer&& other) noexcept;
+  /// Releases the memory of the remixer.
+  ~channel_remixer();
+  /// Allocates the matrix and buffers of the remixer.
+  /// The matrix starts out passing each input channel to the
+  /// output channel of the same index, if there is one.
+  ///
+  /// @param input_channels The number of channels in an input frame.
+  /// @param output_channels The number of channels in an output frame.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result init(size_type input_channels, size_type output_channels) noexcept;
+  /// Changes all the gains of the matrix.
+  ///
+  /// @param gains The gains, with the gain from input channel @e i
+  /// to output channel @e o at index <tt>(o * input_channels) + i</tt>.
+  /// @param ramp_frames The number of frames to ramp the gains over.
+  /// Gains that are still ramping from an earlier change continue
+  /// from where they are, over the new ramp.
+  ///
+  /// @return On success, zero is returned.
+  /// If the remixer was not initialized, EBADF is returned.
+  result set_matrix(const float* gains, size_type ramp_frames = 0) noexcept;
+  /// Changes one gain of the matrix.
+  ///
+  /// @param output_channel The output channel to change the gain of.
+  /// @param input_channel The input channel to change the gain of.
+  /// @param gain The new gain.
+  /// @param ramp_frames The number of frames to ramp the gain over.
+  ///
+  /// @return On success, zero is returned.
+  /// If a channel is out of range, EINVAL is returned.
+  result set_gain(size_type output_channel, size_type input_channel, float gain, size_type ramp_frames = 0) noexcept;
+  /// Indicates whether or not gains are still ramping.
+  bool is_ramping() const noexcept;
+  /// Mixes interleaved float frames.
+  ///
+  /// @param input The input frames.
+  /// @param output The buffer to put the output frames into.
+  /// It may not overlap with the input.
+  /// @param frame_count The number of frames to mix.
+  void process(const float* input, float* output, size_type frame_count) noexcept;
+  /// Mixes interleaved frames of a sample format,
+  /// such as the frames read from a PCM.
+  ///
+  /// @param format The format of both the input and output samples.
+  /// @param input The input frames.
+  /// @param output The buffer to put the output frames into.
+  /// It may not overlap with the input.
+  /// @param frame_count The number of frames to mix.
+  /// @param d The dither to use when reducing the output to the format, if any.
+  void process(sample_format format, const void* input, void* output, size_type frame_count, dither* d = nullptr) noexcept;
+};
+
+class software_mixer_impl;
+
+/// Mixes the streams of many clients into one playback PCM.
+///
+/// Each client writes frames, in the format of the PCM, into its
+/// own wait-free ring. The thread running the mixer wakes up when
+/// the PCM can take a period, sums one period from every client
+/// with saturating arithmetic and writes it. A client that has
+/// not written enough frames is mixed as silence for the rest of
+/// the period, so a late client never stalls the device or the
+/// other clients.
+///
+/// @note Clients may be added, written to and removed from any
+/// thread, but each client must only be written to by one thread.
+/// The other functions must be called from the mixer's thread.
+class software_mixer final
+{
+  /// A pointer to the implementation data.
+  software_mixer_impl* self = nullptr;
+public:
+  /// Constructs a mixer without a PCM.
+  software_mixer() noexcept;
+  /// Moves a mixer from one variable to another.
+  ///
+  /// @param other The mixer to be moved.
+  software_mixer(software_mixer&& other) noexcept;
+  /// Closes the PCM and releases the clients.
+  ~software_mixer();
+  /// Opens and prepares the playback PCM.
+  ///
+  /// @param card The index of the card to open.
+  /// @param device The index of the device to open.
+  /// @param config The configuration of the PCM.
+  /// @param max_clients The largest number of clients at any one time.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result open(size_type card, size_type device, const pcm_config& config = pcm_config(), size_type max_clients = 16) noexcept;
+  /// Closes the PCM.
+  void close() noexcept;
+  /// Accesses the playback PCM, such as to register it with
+  /// a @ref pcm_event_loop or to read its xrun counters.
+  /// This may only be called after a successful call to open.
+  interleaved_pcm_writer& get_pcm() noexcept;
+  /// Adds a client to the mixer.
+  /// This allocates the ring of the client.
+  ///
+  /// @param ring_frames The number of frames the ring of the
+  /// client holds. If zero, it holds as many frames as the PCM buffer.
+  ///
+  /// @return The ID of the client.
+  /// If all of the client slots are taken, EBUSY is returned.
+  generic_result<size_type> add_client(size_type ring_frames = 0) noexcept;
+  /// Removes a client from the mixer. Its slot is reused once the
+  /// mixer has stopped reading from it, which happens the next
+  /// time a period is mixed.
+  ///
+  /// @param client The ID of the client to remove.
+  ///
+  /// @return On success, zero is returned.
+  /// If the client does not exist, EINVAL is returned.
+  result remove_client(size_type client) noexcept;
+  /// Indicates the number of frames a client may write.
+  ///
+  /// @param client The ID of the client.
+  size_type writable(size_type client) noexcept;
+  /// Copies frames into the ring of a client, without blocking.
+  ///
+  /// @param client The ID of the client.
+  /// @param frames The frames to copy, in the format of the PCM.
+  /// @param frame_count The number of frames to copy.
+  ///
+  /// @return The number of frames copied, which is less than
+  /// @p frame_count if the ring of the client does not have enough space.
+  size_type write(size_type client, const void* frames, size_type frame_count) noexcept;
+  /// Indicates the number of periods that a client
+  /// was mixed as silence, in part or in whole.
+  ///
+  /// @param client The ID of the client.
+  size_type get_underruns(size_type client) const noexcept;
+  /// Waits until the PCM can take a period,
+  /// then mixes one period and writes it.
+  ///
+  /// @param timeout_ms The maximum number of milliseconds to wait.
+  /// A negative value waits indefinitely.
+  ///
+  /// @return The number of clients that frames were mixed from.
+  /// If the timeout expires, ETIMEDOUT is returned.
+  /// On any other failure, an errno value is returned.
+  generic_result<size_type> run_once(int timeout_ms = -1) noexcept;
+};
+
+/// Receives the events of a PCM
+/// registered with a @ref pcm_event_loop.
+/// Each function is optional and does nothing by default.
+///
+/// The functions are defined here, so that handlers may be
+/// derived from this class in code built with RTTI, even
+/// though the library is built without it.
+class pcm_event_handler
+{
+public:
+  /// Called when a capture PCM has frames ready to be read.
+  ///
+  /// @param p The PCM that is ready.
+  virtual void on_read_ready(pcm& p) noexcept { (void) p; }
+  /// Called when a playback PCM has space for frames to be written.
+  ///
+  /// @param p The PCM that is ready.
+  virtual void on_write_ready(pcm& p) noexcept { (void) p; }
+  /// Called when a PCM is in an error state.
+  /// Usually this is an overrun or underrun,
+  /// but it also happens when the PCM is not prepared.
+  ///
+  /// @param p The PCM that has the error.
+  virtual void on_xrun(pcm& p) noexcept { (void) p; }
+};
+
+class pcm_event_loop_impl;
+
+/// Waits on the file descriptors of many PCMs
+/// at once, using a single epoll instance. This allows
+/// one thread to service a large number of streams.
+///
+/// Every time the loop wakes up, the events of all
+/// the ready PCMs are dispatched in one batch.
+class pcm_event_loop final
+{
+  /// A pointer to the implementation data.
+  pcm_event_loop_impl* self = nullptr;
+public:
+  /// Constructs an event loop with no PCMs.
+  pcm_event_loop() noexcept;
+  /// Moves an event loop from one variable to another.
+  ///
+  /// @param other The event loop to be moved.
+  pcm_event_loop(pcm_event_loop&& other) noexcept;
+  /// Releases the resources of the event loop.
+  /// The registered PCMs are not closed.
+  ~pcm_event_loop();
+  /// Registers a PCM with the event loop.
+  ///
+  /// @param p The PCM to register. It must be opened and
+  /// must stay at the same address until it is removed.
+  /// @param handler The handler that receives the events of the PCM.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result add(pcm& p, pcm_event_handler& handler) noexcept;
+  /// Removes a PCM from the event loop.
+  /// This may be called from within an event handler.
+  ///
+  /// @param p The PCM to remove.
+  ///
+  /// @return On success, zero is returned.
+  /// If the PCM was not registered, ENOENT is returned.
+  result remove(pcm& p) noexcept;
+  /// Indicates the number of PCMs registered with the loop.
+  size_type size() const noexcept;
+  /// Waits for at least one PCM to become ready and
+  /// then dispatches the events of all ready PCMs.
+  ///
+  /// @param timeout_ms The maximum number of milliseconds to wait.
+  /// A negative value waits indefinitely.
+  ///
+  /// @return The number of PCMs that events were dispatched for.
+  /// If the timeout expires, zero is returned.
+  /// On failure, an errno value is returned.
+  generic_result<size_type> run_once(int timeout_ms = -1) noexcept;
+  /// Accesses the epoll file descriptor of the loop.
+  /// It becomes readable when any of the PCMs are ready,
+  /// so the loop may be nested in another poll loop.
+  int get_file_descriptor() const noexcept;
+};
+
+/// Receives the readiness of a file descriptor
+/// that was passed to @ref pcm_reactor::wait.
+class pcm_waiter
+{
+public:
+  /// Called from @ref pcm_reactor::run_once once the file
+  /// descriptor is ready or has an error. The wait is over
+  /// by then, so this function may start another one.
+  virtual void on_ready() noexcept = 0;
+};
+
+class pcm_reactor_impl;
+
+/// Resumes work that is waiting on PCMs, such as
+/// coroutines, once the PCMs become ready.
+///
+/// Unlike @ref pcm_event_loop, each wait is done once and
+/// then forgotten, so that a PCM is only watched while
+/// something waits on it. Waits may be started from any
+/// thread, but the reactor should only be run on one.
+/// To spread streams across several threads, each
+/// thread is given a reactor of its own.
+class pcm_reactor final
+{
+  /// A pointer to the implementation data.
+  pcm_reactor_impl* self = nullptr;
+public:
+  /// Constructs a reactor with no waits.
+  pcm_reactor() noexcept;
+  /// Moves a reactor from one variable to another.
+  ///
+  /// @param other The reactor to be moved.
+  pcm_reactor(pcm_reactor&& other) noexcept;
+  /// Releases the epoll instance of the reactor.
+  /// Waiters that are still pending are not notified.
+  ~pcm_reactor();
+  /// Waits for a file descriptor to become ready, without blocking.
+  ///
+  /// @param fd The file descriptor to wait on. It's ready once it's readable
+  /// or writable, which for a PCM means that frames may be transferred.
+  /// Only one wait per file descriptor may be pending at a time.
+  /// @param waiter The waiter to notify once the file descriptor is ready.
+  /// It must stay at the same address until it's notified.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result wait(int fd, pcm_waiter& waiter) noexcept;
+  /// Waits for at least one file descriptor to become
+  /// ready and then notifies the waiters of all ready ones.
+  ///
+  /// @param timeout_ms The maximum number of milliseconds to wait.
+  /// A negative value waits indefinitely.
+  ///
+  /// @return The number of waiters notified.
+  /// If the timeout expires, zero is returned.
+  /// On failure, an errno value is returned.
+  generic_result<size_type> run_once(int timeout_ms = -1) noexcept;
+  /// Notifies waiters until there are none left.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result run() noexcept;
+  /// Indicates the number of waits that are pending.
+  size_type pending() const noexcept;
+  /// Accesses the epoll file descriptor of the reactor.
+  /// It becomes readable when any wait is ready,
+  /// so the reactor may be nested in another poll loop.
+  int get_file_descriptor() const noexcept;
+};
+
+#ifdef __cpp_impl_coroutine
+
+/// Transfers frames between a PCM and a buffer, from a coroutine.
+///
+/// The transfer is tried as soon as it's awaited. If the PCM doesn't
+/// have the frames or the space for all of it, the coroutine is suspended
+/// and the rest is transferred as the reactor reports the PCM ready.
+/// The PCM must be opened in non-blocking mode.
+///
+/// @tparam is_write Whether frames are written to the PCM or read from it.
+template <bool is_write>
+class pcm_transfer_awaitable final : public pcm_waiter
+{
+  /// The type of PCM that frames are transferred with.
+  using pcm_type = std::conditional_t<is_write, interleaved_pcm_writer, interleaved_pcm_reader>;
+  /// The type of pointer to the frames.
+  using pointer_type = std::conditional_t<is_write, const unsigned char*, unsigned char*>;
+  /// The reactor that resumes the coroutine.
+  pcm_reactor& reactor;
+  /// The PCM to transfer frames with.
+  pcm_type& p;
+  /// The frames that are left to transfer.
+  pointer_type frames;
+  /// The number of frames left to transfer.
+  size_type frames_left;
+  /// The outcome of the transfer.
+  generic_result<size_type> transferred;
+  /// The coroutine awaiting the transfer.
+  std::coroutine_handle<> handle;
+  /// Transfers as many frames as the PCM will take.
+  ///
+  /// @return True if the transfer is done or failed,
+  /// false if the PCM has to be waited on.
+  bool transfer() noexcept
+  {
+    while (frames_left > 0) {
+
+      generic_result<size_type> r;
+
+      if constexpr (is_write) {
+        r = p.write_unformatted(frames, frames_left);
+      } else {
+        r = p.read_unformatted(frames, frames_left);
+      }
+
+      if (r.failed()) {
+        if (r.error == EAGAIN) {
+          return false;
+        }
+        transferred.error = r.error;
+        return true;
+      }
+
+      if (!r.value) {
+        return false;
+      }
+
+      frames += r.value * p.get_frame_size();
+      frames_left -= r.value;
+      transferred.value += r.value;
+    }
+
+    return true;
+  }
+public:
+  /// Constructs the awaitable. Nothing is transferred until it's awaited.
+  ///
+  /// @param reactor_ The reactor that resumes the coroutine.
+  /// @param p_ The PCM to transfer frames with.
+  /// @param frames_ The frames to transfer.
+  /// @param frame_count The number of frames to transfer.
+  pcm_transfer_awaitable(pcm_reactor& reactor_, pcm_type& p_, pointer_type frames_, size_type frame_count) noexcept
+    : reactor(reactor_), p(p_), frames(frames_), frames_left(frame_count), transferred { 0, 0 } { }
+  /// Tries the transfer before suspending.
+  bool await_ready() noexcept
+  {
+    return transfer();
+  }
+  /// Waits for the PCM on the reactor.
+  ///
+  /// @return True to suspend, false if the wait failed.
+  bool await_suspend(std::coroutine_handle<> handle_) noexcept
+  {
+    handle = handle_;
+
+    // The coroutine may be resumed on the reactor
+    // thread before this returns, so no member is
+    // accessed after a successful wait.
+    auto wait_result = reactor.wait(p.get_file_descriptor(), *this);
+    if (wait_result.failed()) {
+      transferred.error = wait_result.error;
+      return false;
+    }
+
+    return true;
+  }
+  /// Gets the outcome of the transfer.
+  ///
+  /// @return The number of frames transferred. If an error
+  /// occurred, it's returned along with the frames
+  /// transferred before it.
+  generic_result<size_type> await_resume() noexcept
+  {
+    return transferred;
+  }
+  /// Continues the transfer once the PCM is ready.
+  void on_ready() noexcept override
+  {
+    if (!transfer()) {
+      auto wait_result = reactor.wait(p.get_file_descriptor(), *this);
+      if (!wait_result.failed()) {
+        return;
+      }
+      transferred.error = wait_result.error;
+    }
+
+    handle.resume();
+  }
+};
+
+/// Reads frames from a PCM, from a coroutine.
+///
+/// @param reactor The reactor that resumes the coroutine.
+/// @param reader The PCM to read from. It must be opened in non-blocking mode.
+/// @param frames The buffer to read the frames into.
+/// @param frame_count The number of frames to read.
+///
+/// @return An awaitable that completes once all the frames are
+/// read or an error occurs, giving the number of frames read.
+inline pcm_transfer_awaitable<false> async_read(pcm_reactor& reactor,
+                                                interleaved_pcm_reader& reader,
+                                                void* frames,
+                                                size_type frame_count) noexcept
+{
+  return pcm_transfer_awaitable<false>(reactor, reader, static_cast<unsigned char*>(frames), frame_count);
+}
+
+/// Writes frames to a PCM, from a coroutine.
+///
+/// @param reactor The reactor that resumes the coroutine.
+/// @param writer The PCM to write to. It must be opened in non-blocking mode.
+/// @param frames The frames to write.
+/// @param frame_count The number of frames to write.
+///
+/// @return An awaitable that completes once all the frames are
+/// written or an error occurs, giving the number of frames written.
+inline pcm_transfer_awaitable<true> async_write(pcm_reactor& reactor,
+                                                interleaved_pcm_writer& writer,
+                                                const void* frames,
+                                                size_type frame_count) noexcept
+{
+  return pcm_transfer_awaitable<true>(reactor, writer, static_cast<const unsigned char*>(frames), frame_count);
+}
+
+#endif // __cpp_impl_coroutine
+
+class pcm_group_impl;
+
+/// Starts, stops and prepares several PCMs together,
+/// so that they begin on the same sample.
+///
+/// The members are linked in the kernel when the drivers
+/// allow it, in which case one trigger acts on every member
+/// at once. Otherwise, the members are started back to back
+/// right after a timer expires, which keeps the thread from
+/// being preempted between them.
+class pcm_group final
+{
+  /// A pointer to the implementation data.
+  pcm_group_impl* self = nullptr;
+public:
+  /// Constructs an empty group.
+  pcm_group() noexcept;
+  /// Moves a group from one variable to another.
+  ///
+  /// @param other The group to be moved.
+  pcm_group(pcm_group&& other) noexcept;
+  /// Unlinks the members of the group.
+  /// The members are not closed.
+  ~pcm_group();
+  /// Adds a PCM to the group.
+  ///
+  /// @param p The PCM to add. It must be opened and must
+  /// stay at the same address until it is removed.
+  ///
+  /// @return On success, zero is returned. If the driver
+  /// refuses to link the PCM, it is still added, but the
+  /// group falls back to timed starts.
+  /// On failure, a copy of errno is returned.
+  result add(pcm& p) noexcept;
+  /// Removes a PCM from the group.
+  ///
+  /// @param p The PCM to remove.
+  ///
+  /// @return On success, zero is returned.
+  /// If the PCM is not a member, ENOENT is returned.
+  result remove(pcm& p) noexcept;
+  /// Indicates the number of PCMs in the group.
+  size_type size() const noexcept;
+  /// Indicates whether or not the members
+  /// are linked in the kernel.
+  bool is_linked() const noexcept;
+  /// Prepares every member of the group.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result prepare() noexcept;
+  /// Starts every member of the group.
+  ///
+  /// @param lead_time_us When the members are not linked,
+  /// the number of microseconds to wait on the timer
+  /// before starting them.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result start(size_type lead_time_us = 1000) noexcept;
+  /// Stops every member of the group,
+  /// dropping any buffered audio.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, a copy of errno is returned.
+  result drop() noexcept;
+  /// Gets the difference between the earliest and the
+  /// latest start timestamp of the members, as measured
+  /// after the last call to @ref pcm_group::start.
+  ///
+  /// @return The skew, in nanoseconds.
+  std::int64_t get_start_skew() const noexcept;
+};
+
+class latency_tracker_impl;
+
+/// Keeps rolling percentiles of the buffer fill
+/// and the latency of a stream, from status queries.
+///
+/// For capture, the latency is the age of the oldest
+/// frame that has not been read yet. For playback,
+/// it's the time until the newest written frame is heard.
+class latency_tracker final
+{
+  /// A pointer to the implementation data.
+  latency_tracker_impl* self = nullptr;
+public:
+  /// Constructs a latency tracker.
+  ///
+  /// @param window The number of most recent records
+  /// that the percentiles are computed from.
+  /// @param clock The clock that the timestamps of the
+  /// stream are taken from. This must match the
+  /// timestamp type that the PCM was set up with.
+  explicit latency_tracker(size_type window = 1024,
+                           pcm_timestamp_type clock = pcm_timestamp_type::monotonic_raw) noexcept;
+  /// Moves a latency tracker from one variable to another.
+  ///
+  /// @param other The latency tracker to be moved.
+  latency_tracker(latency_tracker&& other) noexcept;
+  /// Releases the memory of the tracker.
+  ~latency_tracker();
+  /// Records the status of a stream, using the current time.
+  ///
+  /// @param status The status of the stream.
+  /// @param rate The frame rate of the stream.
+  void record(const pcm_status& status, size_type rate) noexcept;
+  /// Records the status of a stream.
+  ///
+  /// @param status The status of the stream.
+  /// @param rate The frame rate of the stream.
+  /// @param now The current time, in nanoseconds,
+  /// from the clock given to the constructor.
+  void record(const pcm_status& status, size_type rate, std::int64_t now) noexcept;
+  /// Indicates the number of records in the window.
+  size_type size() const noexcept;
+  /// Removes all records.
+  void reset() noexcept;
+  /// Gets a percentile of the buffer fill.
+  ///
+  /// @param percentile The percentile to get, from 0 to 100.
+  ///
+  /// @return The buffer fill, in frames.
+  /// If there are no records, zero is returned.
+  std::int64_t get_fill_percentile(double percentile) const noexcept;
+  /// Gets a percentile of the latency.
+  ///
+  /// @param percentile The percentile to get, from 0 to 100.
+  ///
+  /// @return The latency, in nanoseconds.
+  /// If there are no records, zero is returned.
+  std::int64_t get_latency_percentile(double percentile) const noexcept;
+};
+
+class pcm_list_impl;
+
+/// This class is used for enumerating
+/// the PCMs available on the system.
+///
+/// The PCMs are enumerated through the control device
+/// of each card, so PCMs that are in use by another
+/// process are listed as well. Every subdevice of each
+/// PCM gets its own entry.
+///
+/// The best way to use this class is to
+/// declare it in a function scope with a
+/// short life time. That way, the list is
+/// always up to date.
+///
+/// Programs that need the list throughout their
+/// life time should use @ref pcm_registry instead.
+class pcm_list final
+{
+  /// A pointer to the implementation data.
+  pcm_list_impl* self = nullptr;
+public:
+  /// Constructs the PCM list.
+  /// The PCMs are discovered the first time
+  /// the list is accessed, with the cards being
+  /// enumerated in parallel.
+  ///
+  /// @param device_root The directory containing the sound devices.
+  explicit pcm_list(const char* device_root = "/dev/snd") noexcept;
+  /// Moves the PCM list from one variable to another.
+  ///
+  /// @param other The PCM list to move.
+  pcm_list(pcm_list&& other) noexcept;
+  /// Releases the memory allocated by the list.
+  ~pcm_list();
+  /// Indicates the number of PCMs in the list.
+  size_type size() const noexcept;
+  /// Accesses the array of PCM info instances.
+  ///
+  /// @return A pointer to the beginning of the PCM info array.
+  const pcm_info* data() const noexcept;
+  /// Accesses an entry from the list.
+  ///
+  /// @note This function does not perform boundary checking.
+  ///
+  /// @param index The index of the entry to access.
+  ///
+  /// @return A const-reference to the specified entry.
+  inline const pcm_info& operator [] (size_type index) const noexcept
+  {
+    return data()[index];
+  }
+  /// Accesses the beginning iterator of the list.
+  /// Used in range-based for loops.
+  ///
+  /// @return A pointer to the beginning of the list.
+  inline const pcm_info* begin() const noexcept
+  {
+    return data();
+  }
+  /// Accesses the ending iterator of the list.
+  /// Used in range-based for loops.
+  ///
+  /// @return A pointer to the end of the list.
+  /// This value should not be dereferenced.
+  inline const pcm_info* end() const noexcept
+  {
+    return data() + size();
+  }
+};
+
+class pcm_snapshot_data;
+class pcm_registry;
+
+/// An immutable list of the PCMs that a
+/// @ref pcm_registry knew of at one point in time.
+///
+/// A snapshot stays valid and unchanged while it
+/// exists, even if the registry is updated or destroyed.
+/// Copying a snapshot only increments a reference count.
+class pcm_snapshot final
+{
+  friend pcm_registry;
+  /// A pointer to the shared snapshot data.
+  pcm_snapshot_data* self = nullptr;
+  /// Constructs a snapshot that takes over a reference.
+  ///
+  /// @param data The data to reference. May be null.
+  explicit constexpr pcm_snapshot(pcm_snapshot_data* data) noexcept : self(data) {}
+public:
+  /// Constructs an empty snapshot.
+  constexpr pcm_snapshot() noexcept = default;
+  /// Shares the data of another snapshot.
+  ///
+  /// @param other The snapshot to share the data of.
+  pcm_snapshot(const pcm_snapshot& other) noexcept;
+  /// Moves a snapshot from one variable to another.
+  ///
+  /// @param other The snapshot to be moved.
+  pcm_snapshot(pcm_snapshot&& other) noexcept;
+  /// Releases the reference to the snapshot data.
+  ~pcm_snapshot();
+  /// Replaces the snapshot with another one.
+  ///
+  /// @param other The snapshot to take the place of this one.
+  ///
+  /// @return A reference to this snapshot.
+  pcm_snapshot& operator = (pcm_snapshot other) noexcept;
+  /// Indicates the number of PCMs in the snapshot.
+  size_type size() const noexcept;
+  /// Accesses the array of PCM info instances.
+  ///
+  /// @return A pointer to the beginning of the PCM info array.
+  const pcm_info* data() const noexcept;
+  /// Accesses an entry from the snapshot.
+  ///
+  /// @note This function does not perform boundary checking.
+  ///
+  /// @param index The index of the entry to access.
+  ///
+  /// @return A const-reference to the specified entry.
+  inline const pcm_info& operator [] (size_type index) const noexcept
+  {
+    return data()[index];
+  }
+  /// Accesses the beginning iterator of the snapshot.
+  /// Used in range-based for loops.
+  ///
+  /// @return A pointer to the beginning of the snapshot.
+  inline const pcm_info* begin() const noexcept
+  {
+    return data();
+  }
+  /// Accesses the ending iterator of the snapshot.
+  /// Used in range-based for loops.
+  ///
+  /// @return A pointer to the end of the snapshot.
+  /// This value should not be dereferenced.
+  inline const pcm_info* end() const noexcept
+  {
+    return data() + size();
+  }
+};
+
+class pcm_registry_impl;
+
+/// A long lived list of PCMs that follows
+/// devices as they are plugged in and removed.
+///
+/// The device root is watched with inotify and only the
+/// PCMs that changed are queried again. Readers take
+/// snapshots of the list, which never block and never
+/// observe a partially applied update.
+///
+/// @note The @ref snapshot function may be called from
+/// any thread. The other functions must be called from
+/// one thread at a time.
+class pcm_registry final
+{
+  /// A pointer to the implementation data.
+  pcm_registry_impl* self = nullptr;
+public:
+  /// Constructs a registry that is not watching any devices.
+  pcm_registry() noexcept;
+  /// Moves a registry from one variable to another.
+  ///
+  /// @param other The registry to be moved.
+  pcm_registry(pcm_registry&& other) noexcept;
+  /// Stops watching the devices and releases the
+  /// current snapshot. Existing snapshots stay valid.
+  ~pcm_registry();
+  /// Starts watching a device root and enumerates
+  /// the PCMs that are already in it.
+  ///
+  /// @param device_root The directory containing the sound devices.
+  ///
+  /// @return On success, zero is returned.
+  /// On failure, an errno value is returned.
+  result open(const char* device_root = "/dev/snd") noexcept;
+  /// Stops watching the device root.
+  /// The registry becomes empty.
+  void close() noexcept;
+  /// Takes a snapshot of the PCMs currently known to the registry.
+  /// This function does not block and does not allocate memory.
+  ///
+  /// @return The current snapshot.
+  pcm_snapshot snapshot() const noexcept;
+  /// Applies the device changes that occurred since the last update.
+  /// When there are changes, a new snapshot is published.
+  ///
+  /// @param timeout_ms The maximum number of milliseconds to wait
+  /// for a change. A negative value waits indefinitely.
+  ///
+  /// @return The number of device changes that were applied.
+  /// On failure, an errno value is returned.
+  generic_result<size_type> update(int timeout_ms = 0) noexcept;
+  /// Accesses the inotify file descriptor of the registry.
+  /// It becomes readable when @ref update has changes to apply,
+  /// so the registry may be driven from a poll loop.
+  ///
+  /// @return The file descriptor, or @ref invalid_fd
+  /// if the registry is not open.
+  int get_file_descriptor() const noexcept;
+};
+
+#ifdef TINYALSA_CXX_BACKENDS
+
+/// The operations that the library performs on PCM devices.
+/// Each function behaves like the system call of the same name,
+/// returning -1 (or MAP_FAILED) and setting errno on failure.
+///
+/// Backends are only available when the library is built with
+/// the TINYALSA_BACKENDS option, which defines TINYALSA_CXX_BACKENDS.
+/// Otherwise, the library makes the system calls directly.
+///
+/// The backend is selected with @ref set_backend, before
+/// any PCM is opened.
+struct pcm_backend final
+{
+  /// Opens a PCM device by its path.
+  int (*open)(const char* path, int flags);
+  /// Closes a PCM device.
+  int (*close)(int fd);
+  /// Issues an ioctl to a PCM device.
+  /// Requests without an argument pass a null pointer.
+  int (*ioctl)(int fd, unsigned long request, void* arg);
+  /// Waits for PCM devices to become ready.
+  int (*poll)(::pollfd* fds, unsigned long count, int timeout_ms);
+  /// Maps the buffer, status or control data of a PCM device.
+  void* (*mmap)(void* address, size_type length, int protection, int flags, int fd, long offset);
+  /// Unmaps memory mapped with @ref pcm_backend::mmap.
+  int (*munmap)(void* address, size_type length);
+};
+
+/// Accesses the backend that calls into the kernel.
+/// This is the backend used by default.
+const pcm_backend& get_native_backend() noexcept;
+
+/// Accesses the backend that emulates sound devices in the
+/// process. See @ref fake_pcm_config for how they behave.
+const pcm_backend& get_fake_backend() noexcept;
+
+/// Accesses the backend currently in use.
+const pcm_backend& get_backend() noexcept;
+
+/// Selects the backend used for PCM devices. This should be
+/// called before any PCM is opened, since a device opened with
+/// one backend can't be used with another. The switch is atomic,
+/// so calls made from other threads use either the old backend
+/// or the new one.
+///
+/// @param backend The backend to use from now on. It is
+/// not copied, so it must outlive its use.
+void set_backend(const pcm_backend& backend) noexcept;
+
+/// Describes the devices emulated by the fake backend.
+///
+/// Any PCM path whose name has the form of a PCM device
+/// (such as "pcmC0D0p") may be opened. Each device has a
+/// ring buffer that the emulated hardware moves through
+/// in real time, scaled by @ref fake_pcm_config::speed.
+/// Reading too slowly overruns a capture device and writing
+/// too slowly underruns a playback device, just like with
+/// real hardware.
+///
+/// The file descriptor of a fake device becomes readable
+/// once per period, for both capture and playback, so that
+/// it may be used with epoll. The status and control data
+/// cannot be mapped, so the library synchronizes it with
+/// SNDRV_PCM_IOCTL_SYNC_PTR, and linking is not supported.
+///
+/// Polling fake devices that are not running, with no native
+/// file descriptors, returns zero right away instead of
+/// blocking forever, since they can't become ready.
+///
+/// The control devices (such as "controlC0") of the first
+/// @ref fake_pcm_config::cards cards may be opened as well,
+/// so that @ref pcm_list and @ref pcm_registry can enumerate
+/// fake devices on machines without a sound card.
+struct fake_pcm_config final
+{
+  /// The supported numbers of channels.
+  pcm_range channels { 1, 32 };
+  /// The supported frame rates.
+  pcm_range rate { 8000, 384000 };
+  /// The supported period sizes, in frames.
+  pcm_range period_size { 16, 65536 };
+  /// The supported numbers of periods.
+  pcm_range period_count { 2, 64 };
+  /// The supported sample formats, with one bit per
+  /// @ref sample_format value. All of them by default.
+  std::uint32_t formats = ~std::uint32_t(0);
+  /// How many times faster than real time the emulated hardware runs.
+  /// A speed of zero (or less) means the hardware keeps up with
+  /// the application instantly: capture buffers are always full,
+  /// playback buffers are always empty and xruns never happen
+  /// on their own. This makes benchmarks deterministic.
+  double speed = 1.0;
+  /// If not zero, an xrun is injected every time
+  /// this many frames have been transferred.
+  size_type xrun_interval = 0;
+  /// The number of cards with a control device.
+  size_type cards = 1;
+  /// The number of PCM devices that each control device
+  /// reports, each with one playback and one capture stream.
+  /// This only affects enumeration, since any PCM device
+  /// may be opened.
+  size_type devices = 1;
+};
+
+/// Sets the configuration of the fake devices
+/// that are opened from now on.
+///
+/// @param config The configuration of the fake devices.
+void set_fake_pcm_config(const fake_pcm_config& config) noexcept;
+
+/// Starts recording the calls made to the PCM backend.
+///
+/// Every call made through the current backend is logged to
+/// a compact binary trace file. Each record has the request,
+/// the data returned by the driver, the result, errno, the
+/// frame counts and monotonic timestamps. Audio data is not
+/// recorded. Status and control data is not mapped while
+/// recording, so that positions are traced with
+/// SNDRV_PCM_IOCTL_SYNC_PTR.
+///
+/// @note Since every position update becomes a system call,
+/// a traced run does not have the same timing as one that
+/// isn't traced, and the trace reflects the traced timing.
+///
+/// Like @ref set_backend, this should be called before any
+/// PCM is opened. It may not be called from several threads
+/// at once.
+///
+/// @param path The path of the trace file to create.
+///
+/// @return On success, zero is returned.
+/// On failure, an errno value is returned.
+result start_pcm_trace(const char* path) noexcept;
+
+/// Stops recording and restores the backend that was
+/// used before @ref start_pcm_trace was called. All PCMs
+/// should be closed beforehand. Calls still in progress on
+/// other threads are waited for before the file is closed.
+///
+/// @return On success, zero is returned.
+/// On failure, the errno value of the first
+/// failed write to the trace file is returned.
+result stop_pcm_trace() noexcept;
+
+/// Describes how a trace is replayed.
+struct pcm_replay_config final
+{
+  /// How many times faster than recorded the calls return.
+  /// A speed of zero (or less) returns every call immediately.
+  double speed = 0;
+};
+
+/// Opens a trace for replay with @ref get_replay_backend.
+///
+/// The replay backend returns the recorded results, in the
+/// order they were recorded, without accessing any device.
+/// A call that does not match the next record fails with
+/// EPROTO and a call past the end of the trace fails with
+/// ENODATA. Captured audio is not part of the trace, so the
+/// frames read during a replay are left as they are.
+///
+/// The file descriptor of a replayed device is readable
+/// whenever the next record is a successful transfer on
+/// that device, so it may be waited on with epoll.
+///
+/// @param path The path of the trace file to replay.
+/// @param config Describes how the trace is replayed.
+///
+/// @return On success, zero is returned.
+/// On failure, an errno value is returned.
+result open_pcm_replay(const char* path, const pcm_replay_config& config = pcm_replay_config()) noexcept;
+
+/// Closes the trace opened with @ref open_pcm_replay.
+void close_pcm_replay() noexcept;
+
+/// Accesses the backend that replays the
+/// trace opened with @ref open_pcm_replay.
+const pcm_backend& get_replay_backend() noexcept;
+
+#endif // TINYALSA_CXX_BACKENDS
+
 /// Prints the result of an operation.
 /// If the result failed, then the error description
 /// is printed. If the result did not fail, then the value
@@ -534,6 +3273,7 @@ stream_type& operator << (stream_type& output, const pcm_info& info)
   output << "card      : " << info.card << '\n';
   output << "device    : " << info.device << '\n';
   output << "subdevice : " << info.subdevice << '\n';
+  output << "stream    : " << (info.is_capture ? "capture" : "playback") << '\n';
   output << "class     : " << info.class_ << '\n';
   output << "subclass  : " << info.subclass << '\n';
   output << "id        : " << info.id << '\n';